@@ -30,12 +30,9 @@ fi
 # default test run so every CI cycle exercises the recvmmsg drain path.
 # Stays off on non-Linux because the kernel APIs aren't available.
 #
-# Note: --udp-gso lives behind --multiplex-peer (that mode is what
-# enables the sendmmsg batching GSO piggybacks on); driving GSO from
-# this script would require flipping the server into multiplex-peer
-# mode, which changes the relay-port model in ways the protocol tests
-# below assume. run_tests_multiplex_peer.sh exercises the multiplex
-# path explicitly — leave GSO to that script.
+# Note: --udp-gso is left to run_tests_multiplex_peer.sh, where the
+# shared relay sockets give it same-destination runs to coalesce; the
+# protocol tests below rarely produce them.
 TURNSERVER_EXTRA_ARGS=""
 if [ "$(uname -s)" = "Linux" ]; then
     TURNSERVER_EXTRA_ARGS="--udp-recvmmsg"
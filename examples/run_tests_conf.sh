@@ -42,12 +42,10 @@ echo "pkey=../examples/ca/turn_server_pkey.pem" >> $BINDIR/turnserver.conf
 echo "log-file=stdout" >> $BINDIR/turnserver.conf
 if [ $IS_DARWIN -eq 0 ]; then
     # Server-side fast paths: enable on Linux so the conf-driven test
-    # cycle also exercises the recvmmsg drain path. The udp-gso path
-    # lives behind multiplex-peer (that mode is what enables sendmmsg
-    # batching, which GSO piggybacks on); exercising GSO would flip the
-    # server into multiplex-peer mode and change the relay-port model
-    # the protocol tests below assume. run_tests_multiplex_peer.sh
-    # covers the multiplex path.
+    # cycle also exercises the recvmmsg drain path and the sendmmsg
+    # batching it opens. The udp-gso path is left to
+    # run_tests_multiplex_peer.sh, whose shared relay sockets give it
+    # same-destination runs to coalesce.
     if [ "$(uname -s)" = "Linux" ]; then
         echo "udp-recvmmsg" >> $BINDIR/turnserver.conf
     fi
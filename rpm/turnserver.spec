@@ -290,6 +290,7 @@ fi
 %dir %{_includedir}/turn
 %{_includedir}/turn/ns_turn_defs.h
 %dir %{_includedir}/turn/client
+%{_includedir}/turn/client/ns_turn_crc32.h
 %{_includedir}/turn/client/ns_turn_ioaddr.h
 %{_includedir}/turn/client/ns_turn_msg_addr.h
 %{_includedir}/turn/client/ns_turn_msg_defs.h
@@ -73,6 +73,14 @@ extern int IS_TURN_SERVER;
 #define DTLS_SUPPORTED 1
 #endif
 
+/* Kernel TLS needs an OpenSSL built with it; whether the kernel takes a given
+ * connection is only known once its handshake is done. */
+#if TLS_SUPPORTED && defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+#define KTLS_SUPPORTED 1
+#else
+#define KTLS_SUPPORTED 0
+#endif
+
 #define SSL_SESSION_ECDH_AUTO_SUPPORTED 1
 
 /////////// SSL //////////////////////////
@@ -1041,7 +1041,8 @@ static const turn_dbdriver_t driver = {&mysql_get_auth_secrets,   &mysql_get_use
                                        &mysql_set_permission_ip,  &mysql_reread_realms,  &mysql_set_oauth_key,
                                        &mysql_get_oauth_key,      &mysql_del_oauth_key,  &mysql_list_oauth_keys,
                                        &mysql_get_admin_user,     &mysql_set_admin_user, &mysql_del_admin_user,
-                                       &mysql_list_admin_users,   &mysql_disconnect,     NULL};
+                                       &mysql_list_admin_users,   &mysql_disconnect,     NULL,
+                                       NULL};
 
 const turn_dbdriver_t *get_mysql_dbdriver(void) { return &driver; }
 
@@ -138,30 +138,39 @@ static int pgsql_get_auth_secrets(secrets_list_t *sl, uint8_t *realm) {
   return ret;
 }
 
+/* Reads the hmackey of a "select hmackey from turnusers_lt" result. */
+static int pq_user_key_from_result(PGconn *pqc, PGresult *res, uint8_t *usname, hmackey_t key) {
+  int ret = -1;
+  if (!res || (PQresultStatus(res) != PGRES_TUPLES_OK) || (PQntuples(res) != 1)) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Error retrieving PostgreSQL DB information: %s\n", PQerrorMessage(pqc));
+  } else {
+    char *kval = PQgetvalue(res, 0, 0);
+    int len = PQgetlength(res, 0, 0);
+    if (kval) {
+      size_t sz = get_hmackey_size(SHATYPE_DEFAULT);
+      if (((size_t)len < sz * 2) || (strlen(kval) < sz * 2)) {
+        TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Wrong key format: %s, user %s\n", kval, usname);
+      } else {
+        convert_string_key_to_binary(kval, key, sz);
+        ret = 0;
+      }
+    } else {
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Wrong hmackey data for user %s: NULL\n", usname);
+    }
+  }
+  return ret;
+}
+
+static const char *pq_user_key_query = "select hmackey from turnusers_lt where name=$1 and realm=$2";
+
 static int pgsql_get_user_key(uint8_t *usname, uint8_t *realm, hmackey_t key) {
   int ret = -1;
   PGconn *pqc = get_pqdb_connection();
   if (pqc) {
     const char *const params[] = {(const char *)usname, (const char *)realm};
-    PGresult *res = pq_exec_params(pqc, "select hmackey from turnusers_lt where name=$1 and realm=$2", 2, params);
+    PGresult *res = pq_exec_params(pqc, pq_user_key_query, 2, params);
 
-    if (!res || (PQresultStatus(res) != PGRES_TUPLES_OK) || (PQntuples(res) != 1)) {
-      TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Error retrieving PostgreSQL DB information: %s\n", PQerrorMessage(pqc));
-    } else {
-      char *kval = PQgetvalue(res, 0, 0);
-      int len = PQgetlength(res, 0, 0);
-      if (kval) {
-        size_t sz = get_hmackey_size(SHATYPE_DEFAULT);
-        if (((size_t)len < sz * 2) || (strlen(kval) < sz * 2)) {
-          TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Wrong key format: %s, user %s\n", kval, usname);
-        } else {
-          convert_string_key_to_binary(kval, key, sz);
-          ret = 0;
-        }
-      } else {
-        TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Wrong hmackey data for user %s: NULL\n", usname);
-      }
-    }
+    ret = pq_user_key_from_result(pqc, res, usname, key);
 
     if (res) {
       PQclear(res);
@@ -170,6 +179,222 @@ static int pgsql_get_user_key(uint8_t *usname, uint8_t *realm, hmackey_t key) {
   return ret;
 }
 
+/* --db-max-inflight: each auth thread opens up to that many connections of
+ * its own in non-blocking mode and runs one user key lookup on each, driven
+ * by the thread's event base. Further lookups wait in a FIFO for a
+ * connection. A broken connection fails its lookup and is reopened by the
+ * next one. */
+typedef struct _pq_async_lookup {
+  uint8_t usname[STUN_MAX_USERNAME_SIZE + 1];
+  uint8_t realm[STUN_MAX_REALM_SIZE + 1];
+  uint8_t *key;
+  user_key_lookup_cb cb;
+  void *arg;
+  struct _pq_async_lookup *next;
+} pq_async_lookup;
+
+typedef struct _pq_async_state pq_async_state;
+
+typedef struct {
+  pq_async_state *st;
+  PGconn *conn;
+  struct event *ev;
+  pq_async_lookup *lookup; /* running on this connection, or NULL */
+  int ret;
+} pq_async_conn;
+
+struct _pq_async_state {
+  struct event_base *base;
+  pq_async_conn conns[MAX_DB_INFLIGHT_LOOKUPS];
+  pq_async_lookup *head;
+  pq_async_lookup *tail;
+};
+
+static TURN_THREAD_LOCAL pq_async_state *pq_async = NULL;
+
+static void pq_async_close(pq_async_conn *c) {
+  if (c->ev) {
+    event_free(c->ev);
+    c->ev = NULL;
+  }
+  if (c->conn) {
+    PQfinish(c->conn);
+    c->conn = NULL;
+  }
+}
+
+static pq_async_lookup *pq_async_dequeue(pq_async_state *st) {
+  pq_async_lookup *l = st->head;
+  if (l) {
+    st->head = l->next;
+    if (!st->head) {
+      st->tail = NULL;
+    }
+    l->next = NULL;
+  }
+  return l;
+}
+
+static void pq_async_flush(evutil_socket_t fd, short what, void *arg);
+static void pq_async_input(evutil_socket_t fd, short what, void *arg);
+
+static bool pq_async_connect(pq_async_conn *c) {
+  persistent_users_db_t *pud = get_persistent_users_db();
+  c->conn = PQconnectdb(pud->userdb);
+  if (!c->conn || (PQstatus(c->conn) != CONNECTION_OK) || (PQsetnonblocking(c->conn, 1) != 0)) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Cannot open PostgreSQL DB async connection: <%s>, runtime error\n",
+                  pud->userdb_sanitized);
+    pq_async_close(c);
+    return false;
+  }
+  c->ev = event_new(c->st->base, PQsocket(c->conn), EV_READ | EV_PERSIST, pq_async_input, c);
+  if (!c->ev || (event_add(c->ev, NULL) < 0)) {
+    pq_async_close(c);
+    return false;
+  }
+  return true;
+}
+
+/* Sends l's query on c. False when that failed at once. */
+static bool pq_async_send(pq_async_conn *c, pq_async_lookup *l) {
+  if (!c->conn && !pq_async_connect(c)) {
+    return false;
+  }
+  const char *const params[] = {(const char *)l->usname, (const char *)l->realm};
+  const int rc = PQsendQueryParams(c->conn, pq_user_key_query, 2, NULL, params, NULL, NULL, 0) ? PQflush(c->conn) : -1;
+  if (rc < 0) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "PostgreSQL DB async lookup failed: %s\n", PQerrorMessage(c->conn));
+    pq_async_close(c);
+    return false;
+  }
+  c->lookup = l;
+  c->ret = -1;
+  if (rc > 0) {
+    event_base_once(c->st->base, PQsocket(c->conn), EV_WRITE, pq_async_flush, c, NULL);
+  }
+  return true;
+}
+
+/* Runs l, or the next queued lookup that can be sent, on the idle c. */
+static void pq_async_start(pq_async_conn *c, pq_async_lookup *l) {
+  while (l && !pq_async_send(c, l)) {
+    l->cb(-1, l->arg);
+    free(l);
+    l = pq_async_dequeue(c->st);
+  }
+}
+
+/* Hands the result to the caller and the connection to the next lookup. */
+static void pq_async_finish(pq_async_conn *c, int ret) {
+  pq_async_lookup *l = c->lookup;
+  c->lookup = NULL;
+  if (l) {
+    l->cb(ret, l->arg);
+    free(l);
+  }
+  pq_async_start(c, pq_async_dequeue(c->st));
+}
+
+static void pq_async_fail(pq_async_conn *c) {
+  TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "PostgreSQL DB async lookup failed: %s\n", PQerrorMessage(c->conn));
+  pq_async_close(c);
+  pq_async_finish(c, -1);
+}
+
+static void pq_async_input(evutil_socket_t fd, short what, void *arg) {
+  UNUSED_ARG(fd);
+  UNUSED_ARG(what);
+  pq_async_conn *c = (pq_async_conn *)arg;
+
+  if (!PQconsumeInput(c->conn)) {
+    pq_async_fail(c);
+    return;
+  }
+  while (c->lookup && !PQisBusy(c->conn)) {
+    PGresult *res = PQgetResult(c->conn);
+    if (!res) {
+      pq_async_finish(c, c->ret);
+      return;
+    }
+    c->ret = pq_user_key_from_result(c->conn, res, c->lookup->usname, c->lookup->key);
+    PQclear(res);
+  }
+  if (!c->lookup && (PQstatus(c->conn) != CONNECTION_OK)) {
+    /* The server closed an idle connection; the next lookup reopens it. */
+    pq_async_close(c);
+  }
+}
+
+/* The rest of a query that did not fit in the socket buffer. */
+static void pq_async_flush(evutil_socket_t fd, short what, void *arg) {
+  UNUSED_ARG(what);
+  pq_async_conn *c = (pq_async_conn *)arg;
+  if (!c->conn || !c->lookup) {
+    return;
+  }
+  const int rc = PQflush(c->conn);
+  if (rc < 0) {
+    pq_async_fail(c);
+  } else if (rc > 0) {
+    event_base_once(c->st->base, fd, EV_WRITE, pq_async_flush, c, NULL);
+  }
+}
+
+static int pgsql_get_user_key_async(struct event_base *base, uint8_t *usname, uint8_t *realm, hmackey_t key,
+                                    user_key_lookup_cb cb, void *arg) {
+  const size_t limit = turn_params.db_max_inflight;
+  if (!limit || !base || !cb) {
+    return -1;
+  }
+  if (!pq_async) {
+    pq_async = (pq_async_state *)calloc(1, sizeof(pq_async_state));
+    if (!pq_async) {
+      return -1;
+    }
+    pq_async->base = base;
+    for (size_t i = 0; i < MAX_DB_INFLIGHT_LOOKUPS; i++) {
+      pq_async->conns[i].st = pq_async;
+    }
+  }
+
+  pq_async_lookup *l = (pq_async_lookup *)calloc(1, sizeof(pq_async_lookup));
+  if (!l) {
+    return -1;
+  }
+  STRCPY(l->usname, usname);
+  STRCPY(l->realm, realm);
+  l->key = key;
+  l->cb = cb;
+  l->arg = arg;
+
+  /* An open idle connection first, then a new one. */
+  pq_async_conn *c = NULL;
+  for (size_t i = 0; (i < limit) && !c; i++) {
+    if (pq_async->conns[i].conn && !pq_async->conns[i].lookup) {
+      c = &(pq_async->conns[i]);
+    }
+  }
+  for (size_t i = 0; (i < limit) && !c; i++) {
+    if (!pq_async->conns[i].conn && !pq_async->conns[i].lookup) {
+      c = &(pq_async->conns[i]);
+    }
+  }
+
+  if (c) {
+    if (!pq_async_send(c, l)) {
+      free(l);
+      return -1;
+    }
+  } else if (pq_async->tail) {
+    pq_async->tail->next = l;
+    pq_async->tail = l;
+  } else {
+    pq_async->head = l;
+    pq_async->tail = l;
+  }
+  return 0;
+}
+
 static int pgsql_get_oauth_key(const uint8_t *kid, oauth_key_data_raw *key) {
 
   int ret = -1;
@@ -998,7 +1223,8 @@ static const turn_dbdriver_t driver = {&pgsql_get_auth_secrets,   &pgsql_get_use
                                        &pgsql_set_permission_ip,  &pgsql_reread_realms,  &pgsql_set_oauth_key,
                                        &pgsql_get_oauth_key,      &pgsql_del_oauth_key,  &pgsql_list_oauth_keys,
                                        &pgsql_get_admin_user,     &pgsql_set_admin_user, &pgsql_del_admin_user,
-                                       &pgsql_list_admin_users,   &pgsql_disconnect,     NULL};
+                                       &pgsql_list_admin_users,   &pgsql_disconnect,     NULL,
+                                       &pgsql_get_user_key_async};
 
 const turn_dbdriver_t *get_pgsql_dbdriver(void) { return &driver; }
 
@@ -1422,7 +1422,8 @@ static const turn_dbdriver_t driver = {&sqlite_get_auth_secrets,   &sqlite_get_u
                                        &sqlite_set_permission_ip,  &sqlite_reread_realms,  &sqlite_set_oauth_key,
                                        &sqlite_get_oauth_key,      &sqlite_del_oauth_key,  &sqlite_list_oauth_keys,
                                        &sqlite_get_admin_user,     &sqlite_set_admin_user, &sqlite_del_admin_user,
-                                       &sqlite_list_admin_users,   &sqlite_disconnect,     NULL};
+                                       &sqlite_list_admin_users,   &sqlite_disconnect,     NULL,
+                                       NULL};
 
 //////////////////////////////////////////////////
 
@@ -51,6 +51,11 @@ extern "C" {
 extern pthread_key_t connection_key;
 extern pthread_once_t connection_key_once;
 
+struct event_base;
+
+/* Completion of get_user_key_async: ret is what get_user_key would return. */
+typedef void (*user_key_lookup_cb)(int ret, void *arg);
+
 typedef struct _turn_dbdriver_t {
   int (*get_auth_secrets)(secrets_list_t *sl, uint8_t *realm);
   int (*get_user_key)(uint8_t *usname, uint8_t *realm, hmackey_t key);
@@ -80,6 +85,11 @@ typedef struct _turn_dbdriver_t {
   int (*list_admin_users)(int no_print);
   void (*disconnect)(void);
   void (*report_usage)(void *);
+  /* Optional: start a get_user_key lookup without blocking the calling
+   * thread. key must stay valid until cb runs, on base's thread. Returns -1
+   * when the lookup was not started; the caller then uses get_user_key. */
+  int (*get_user_key_async)(struct event_base *base, uint8_t *usname, uint8_t *realm, hmackey_t key,
+                            user_key_lookup_cb cb, void *arg);
 } turn_dbdriver_t;
 
 /////////// USER DB CHECK //////////////////
@@ -48,6 +48,7 @@
 
 #include "ns_turn_openssl.h"
 #include "prom_server.h"
+#include "udp_classify.h"
 
 #include <pthread.h>
 #include <stdint.h>
@@ -105,14 +106,6 @@ _Thread_local uint32_t packetcounter = 0;
 static uint32_t packetcounter = 0;
 #endif
 
-typedef enum {
-  UDP_PACKET_CLASS_INVALID = 0,
-  UDP_PACKET_CLASS_STUN_OR_CHANNEL,
-  UDP_PACKET_CLASS_DTLS_HANDSHAKE,
-  UDP_PACKET_CLASS_DTLS_OTHER,
-  UDP_PACKET_CLASS_OLD_STUN
-} udp_packet_classification_t;
-
 struct dtls_listener_relay_server_info {
   char ifname[1025];
   ioa_addr addr;
@@ -125,6 +118,8 @@ struct dtls_listener_relay_server_info {
   struct message_to_relay sm;
   size_t slen0;
   ioa_engine_new_connection_event_handler connect_cb;
+  turn_time_t rebind_second; /* --dtls-rebinding scan budget */
+  uint32_t rebind_scans;
 #if defined(__linux__)
   struct dtls_listener_recvmmsg_state *recvmmsg_state;
 #endif
@@ -133,7 +128,8 @@ struct dtls_listener_relay_server_info {
 #if defined(__linux__)
 struct dtls_listener_recvmmsg_state {
   struct mmsghdr msgs[MAX_RECVMMSG_BATCH];
-  struct iovec iovecs[MAX_RECVMMSG_BATCH];
+  struct iovec iovecs[MAX_RECVMMSG_BATCH][2];
+  uint8_t overflow[MAX_RECVMMSG_BATCH][IOA_NBH_RECV_OVERFLOW_SIZE];
   char cmsgs[MAX_RECVMMSG_BATCH][RECVMMSG_CMSG_ALLOC_SZ];
   ioa_addr src_addrs[MAX_RECVMMSG_BATCH];
   int ttls[MAX_RECVMMSG_BATCH];
@@ -294,68 +290,58 @@ static void init_dtls_cookie_secret(void) {
   }
 }
 
-static int generate_cookie(SSL *ssl, unsigned char *cookie, unsigned int *cookie_len) {
+/* The cookie for `peer`: HMAC-SHA1 of its port and address under the process
+ * secret. Shared by OpenSSL's cookie callbacks and the listener fast path, so
+ * a cookie handed out by either verifies in both. Returns the cookie length,
+ * 0 for an unsupported address family. */
+static unsigned int dtls_cookie_for_peer(const ioa_addr *peer, unsigned char *cookie) {
   unsigned char buffer[sizeof(struct in6_addr) + sizeof(in_port_t)];
-  unsigned char result[EVP_MAX_MD_SIZE];
   unsigned int length = 0;
-  unsigned int resultlength;
-  ioa_addr peer;
+  unsigned int resultlength = 0;
 
   pthread_once(&dtls_cookie_secret_once, init_dtls_cookie_secret);
 
-  /* Read peer information */
-  (void)BIO_dgram_get_peer(SSL_get_wbio(ssl), &peer);
-
-  // TURN_LOG_FUNC(TURN_LOG_LEVEL_INFO,"%s: family=%u(1)\n",__FUNCTION__,(unsigned)peer.ss.sa_family);
-
-  /* Create buffer with peer's address and port */
-  length = 0;
-  switch (peer.ss.sa_family) {
+  switch (peer->ss.sa_family) {
   case AF_INET:
-    length += sizeof(struct in_addr);
+    memcpy(buffer, &peer->s4.sin_port, sizeof(in_port_t));
+    memcpy(buffer + sizeof(in_port_t), &peer->s4.sin_addr, sizeof(struct in_addr));
+    length = sizeof(in_port_t) + sizeof(struct in_addr);
     break;
   case AF_INET6:
-    length += sizeof(struct in6_addr);
+    memcpy(buffer, &peer->s6.sin6_port, sizeof(in_port_t));
+    memcpy(buffer + sizeof(in_port_t), &peer->s6.sin6_addr, sizeof(struct in6_addr));
+    length = sizeof(in_port_t) + sizeof(struct in6_addr);
     break;
   default:
-    OPENSSL_assert(0);
-    break;
+    return 0;
   }
-  length += sizeof(in_port_t);
 
-  // TURN_LOG_FUNC(TURN_LOG_LEVEL_INFO,"%s: family=%u(2)\n",__FUNCTION__,(unsigned)peer.ss.sa_family);
-
-  switch (peer.ss.sa_family) {
-  case AF_INET:
-    memcpy(buffer, &peer.s4.sin_port, sizeof(in_port_t));
-    memcpy(buffer + sizeof(peer.s4.sin_port), &peer.s4.sin_addr, sizeof(struct in_addr));
-    break;
-  case AF_INET6:
-    memcpy(buffer, &peer.s6.sin6_port, sizeof(in_port_t));
-    memcpy(buffer + sizeof(in_port_t), &peer.s6.sin6_addr, sizeof(struct in6_addr));
-    break;
-  default:
-    OPENSSL_assert(0);
-    break;
+  /* Calculate HMAC of buffer using the secret */
+  if (!HMAC(EVP_sha1(), (const void *)dtls_cookie_secret, sizeof(dtls_cookie_secret), (const unsigned char *)buffer,
+            length, cookie, &resultlength)) {
+    return 0;
   }
 
-  /* Calculate HMAC of buffer using the secret */
-  HMAC(EVP_sha1(), (const void *)dtls_cookie_secret, sizeof(dtls_cookie_secret), (const unsigned char *)buffer, length,
-       result, &resultlength);
+  return resultlength;
+}
+
+static int generate_cookie(SSL *ssl, unsigned char *cookie, unsigned int *cookie_len) {
+  ioa_addr peer;
 
-  memcpy(cookie, result, resultlength);
-  *cookie_len = resultlength;
+  /* Read peer information */
+  (void)BIO_dgram_get_peer(SSL_get_wbio(ssl), &peer);
 
-  return 1;
+  *cookie_len = dtls_cookie_for_peer(&peer, cookie);
+  return *cookie_len ? 1 : 0;
 }
 
 static int verify_cookie(SSL *ssl, const unsigned char *cookie, unsigned int cookie_len) {
   unsigned int resultlength = 0;
-  unsigned char result[COOKIE_SECRET_LENGTH];
+  unsigned char result[EVP_MAX_MD_SIZE];
 
   generate_cookie(ssl, result, &resultlength);
 
-  if (cookie_len == resultlength && memcmp(result, cookie, resultlength) == 0) {
+  if (resultlength && cookie_len == resultlength && CRYPTO_memcmp(result, cookie, resultlength) == 0) {
     // TURN_LOG_FUNC(TURN_LOG_LEVEL_INFO,"%s: cookies are OK, length=%u\n",__FUNCTION__,cookie_len);
     return 1;
   } else {
@@ -364,6 +350,229 @@ static int verify_cookie(SSL *ssl, const unsigned char *cookie, unsigned int coo
   }
 }
 
+/* RFC 6347 section 4.1 record and section 4.2.2 handshake headers. */
+#define DTLS_RECORD_HEADER_LENGTH (13)
+#define DTLS_HANDSHAKE_HEADER_LENGTH (12)
+#define DTLS_CONTENT_TYPE_HANDSHAKE (22)
+#define DTLS_CONTENT_TYPE_APPLICATION_DATA (23)
+#define DTLS_HANDSHAKE_CLIENT_HELLO (1)
+#define DTLS_HANDSHAKE_HELLO_VERIFY_REQUEST (3)
+#define DTLS_CLIENT_HELLO_RANDOM_LENGTH (32)
+#define DTLS_HELLO_VERIFY_VERSION (0xfeff) /* DTLS 1.0, whatever is negotiated later (section 4.2.1) */
+
+static uint32_t dtls_get_u24(const uint8_t *p) { return ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2]; }
+
+static void dtls_put_u24(uint8_t *p, uint32_t v) {
+  p[0] = (uint8_t)(v >> 16);
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)v;
+}
+
+/* The RFC 6347 cookie exchange, answered from the listener buffer. A DTLS
+ * handshake datagram from a source with no session is only worth an SSL
+ * object once it is a ClientHello carrying this source's cookie, so anything
+ * else is dropped, and a ClientHello without that cookie gets the
+ * HelloVerifyRequest DTLSv1_listen() would have sent -- same cookie, record
+ * sequence number echoed -- for the cost of one HMAC and no allocation.
+ * Returns true when the datagram was handled here; false passes a verified
+ * ClientHello on to dtls_server_input_handler(). */
+static bool dtls_stateless_cookie_fast_path(dtls_listener_relay_server_type *server, ioa_net_data *nd) {
+  const uint8_t *data = ioa_network_buffer_data(nd->nbh);
+  const size_t len = ioa_network_buffer_get_size(nd->nbh);
+
+  /* One epoch-0 handshake record (trailing records are ignored, as
+   * DTLSv1_listen() ignores them) holding one unfragmented ClientHello:
+   * DTLSv1_listen() accepts nothing else either. */
+  if ((len < DTLS_RECORD_HEADER_LENGTH + DTLS_HANDSHAKE_HEADER_LENGTH) || (data[0] != DTLS_CONTENT_TYPE_HANDSHAKE) ||
+      (data[1] != DTLS1_VERSION_MAJOR) || data[3] || data[4]) {
+    prom_inc_dtls_cookie("dropped");
+    return true;
+  }
+  const size_t record_len = ((size_t)data[11] << 8) | data[12];
+  const uint8_t *hs = data + DTLS_RECORD_HEADER_LENGTH;
+  if ((record_len > len - DTLS_RECORD_HEADER_LENGTH) || (record_len < DTLS_HANDSHAKE_HEADER_LENGTH) ||
+      (hs[0] != DTLS_HANDSHAKE_CLIENT_HELLO)) {
+    prom_inc_dtls_cookie("dropped");
+    return true;
+  }
+  const size_t msg_len = dtls_get_u24(hs + 1);
+  if (dtls_get_u24(hs + 6) || (dtls_get_u24(hs + 9) != msg_len) ||
+      (msg_len > record_len - DTLS_HANDSHAKE_HEADER_LENGTH)) {
+    prom_inc_dtls_cookie("dropped");
+    return true;
+  }
+
+  /* client_version, random, session_id, then the cookie. */
+  const uint8_t *body = hs + DTLS_HANDSHAKE_HEADER_LENGTH;
+  size_t pos = 2 + DTLS_CLIENT_HELLO_RANDOM_LENGTH;
+  if ((pos >= msg_len) || (body[pos] > SSL_MAX_SSL_SESSION_ID_LENGTH)) {
+    prom_inc_dtls_cookie("dropped");
+    return true;
+  }
+  pos += 1 + body[pos];
+  if ((pos >= msg_len) || (pos + 1 + body[pos] > msg_len)) {
+    prom_inc_dtls_cookie("dropped");
+    return true;
+  }
+  const size_t cookie_len = body[pos];
+  const uint8_t *cookie = body + pos + 1;
+
+  unsigned char expected[EVP_MAX_MD_SIZE];
+  const unsigned int expected_len = dtls_cookie_for_peer(&(nd->src_addr), expected);
+  if (!expected_len) {
+    prom_inc_dtls_cookie("dropped");
+    return true;
+  }
+  if ((cookie_len == expected_len) && (CRYPTO_memcmp(cookie, expected, expected_len) == 0)) {
+    prom_inc_dtls_cookie("verified");
+    return false;
+  }
+
+  /* HelloVerifyRequest: server_version, then the cookie. Message sequence 0;
+   * the record sequence number is the ClientHello's. */
+  ioa_network_buffer_handle nbh = ioa_network_buffer_allocate(server->e);
+  uint8_t *out = ioa_network_buffer_data(nbh);
+  const size_t hvr_len = 2 + 1 + expected_len;
+
+  out[0] = DTLS_CONTENT_TYPE_HANDSHAKE;
+  out[1] = (uint8_t)(DTLS_HELLO_VERIFY_VERSION >> 8);
+  out[2] = (uint8_t)(DTLS_HELLO_VERIFY_VERSION & 0xff);
+  memcpy(out + 3, data + 3, 8); /* epoch 0 and sequence number */
+  out[11] = (uint8_t)((DTLS_HANDSHAKE_HEADER_LENGTH + hvr_len) >> 8);
+  out[12] = (uint8_t)((DTLS_HANDSHAKE_HEADER_LENGTH + hvr_len) & 0xff);
+
+  uint8_t *ohs = out + DTLS_RECORD_HEADER_LENGTH;
+  ohs[0] = DTLS_HANDSHAKE_HELLO_VERIFY_REQUEST;
+  dtls_put_u24(ohs + 1, (uint32_t)hvr_len);
+  ohs[4] = 0;
+  ohs[5] = 0;
+  dtls_put_u24(ohs + 6, 0);
+  dtls_put_u24(ohs + 9, (uint32_t)hvr_len);
+
+  uint8_t *obody = ohs + DTLS_HANDSHAKE_HEADER_LENGTH;
+  obody[0] = (uint8_t)(DTLS_HELLO_VERIFY_VERSION >> 8);
+  obody[1] = (uint8_t)(DTLS_HELLO_VERIFY_VERSION & 0xff);
+  obody[2] = (uint8_t)expected_len;
+  memcpy(obody + 3, expected, expected_len);
+
+  ioa_network_buffer_set_size(nbh, DTLS_RECORD_HEADER_LENGTH + DTLS_HANDSHAKE_HEADER_LENGTH + hvr_len);
+  udp_send_message(server, nbh, &(nd->src_addr));
+  ioa_network_buffer_delete(server->e, nbh);
+
+  prom_inc_dtls_cookie("challenged");
+  return true;
+}
+
+/* --dtls-rebinding. Each scan walks all of the listener's children, so an
+ * unmatched flood is held to eight full scans a second, and one record is
+ * tried against a bounded number of sessions. */
+#define DTLS_REBIND_SCANS_PER_SECOND (8)
+#define DTLS_REBIND_MAX_CANDIDATES (8)
+
+/* Epoch and sequence number of a datagram that holds exactly one application
+ * data record, as one value that orders like the record does; 0 otherwise. */
+static uint64_t dtls_record_position(const uint8_t *data, size_t len) {
+  if ((len <= DTLS_RECORD_HEADER_LENGTH) || (data[0] != DTLS_CONTENT_TYPE_APPLICATION_DATA) ||
+      (len != DTLS_RECORD_HEADER_LENGTH + (((size_t)data[11] << 8) | data[12]))) {
+    return 0;
+  }
+  uint64_t position = 0;
+  for (size_t i = 3; i < 11; i++) {
+    position = (position << 8) | data[i];
+  }
+  return position;
+}
+
+typedef struct {
+  const ioa_addr *src;
+  const ur_addr_map *amap;
+  uint64_t position;
+  ioa_socket_handle candidates[DTLS_REBIND_MAX_CANDIDATES];
+  size_t count;
+} dtls_rebind_search;
+
+static bool dtls_rebind_collect(const ioa_addr *key, ur_addr_map_value_type value, void *arg) {
+  dtls_rebind_search *search = (dtls_rebind_search *)arg;
+  ioa_socket_handle chs = (ioa_socket_handle)value;
+  if (chs && (chs->magic == SOCKET_MAGIC) && (chs->st == DTLS_SOCKET) && chs->ssl && !ioa_socket_tobeclosed(chs) &&
+      (chs->sockets_container == search->amap) && SSL_is_init_finished(chs->ssl) &&
+      (chs->dtls_last_record < search->position) && addr_eq_no_port(key, search->src)) {
+    search->candidates[search->count++] = chs;
+  }
+  return search->count < DTLS_REBIND_MAX_CANDIDATES;
+}
+
+/* An application data record from an unknown source may come from an
+ * established client whose NAT moved it to a new port. OpenSSL has no RFC 9146
+ * connection IDs, so the record is its own identifier: it is offered to the
+ * established DTLS sessions of the same IP, and the session whose keys
+ * authenticate it moves to the new address. DTLS discards a record that fails
+ * its MAC without touching the session. As RFC 9146 section 6 asks, a session
+ * only moves for a record newer than any it has accepted, so a copy of a
+ * record that is still on its way along the old path, which the replay window
+ * would let through, cannot move it. Only epoch 1 is tried: with
+ * renegotiation off no session has another, and a record for the next epoch
+ * would be buffered by OpenSSL rather than checked.
+ * Returns the moved socket with the record's plaintext in nd->nbh, or NULL. */
+static ioa_socket_handle dtls_rebind_session(dtls_listener_relay_server_type *server, ur_addr_map *amap,
+                                             ioa_net_data *nd) {
+  const uint8_t *data = ioa_network_buffer_data(nd->nbh);
+  const size_t len = ioa_network_buffer_get_size(nd->nbh);
+  const uint64_t position = turn_params.dtls_rebinding ? dtls_record_position(data, len) : 0;
+  if (!position || (data[3] != 0) || (data[4] != 1)) {
+    return NULL;
+  }
+
+  const turn_time_t now = turn_time();
+  if (server->rebind_second != now) {
+    server->rebind_second = now;
+    server->rebind_scans = 0;
+  }
+  if (server->rebind_scans >= DTLS_REBIND_SCANS_PER_SECOND) {
+    prom_inc_dtls_rebinding("limited");
+    return NULL;
+  }
+  server->rebind_scans++;
+
+  dtls_rebind_search search = {.src = &(nd->src_addr), .amap = amap, .position = position, .count = 0};
+  ur_addr_map_foreach_key_arg(amap, dtls_rebind_collect, &search);
+
+  ioa_network_buffer_handle trial = ioa_network_buffer_allocate(server->e);
+  for (size_t i = 0; i < search.count; i++) {
+    ioa_socket_handle chs = search.candidates[i];
+    memcpy(ioa_network_buffer_data(trial), data, len);
+    ioa_network_buffer_set_size(trial, len);
+    if (ssl_read(chs->fd, chs->ssl, trial, server->verbose) <= 0) {
+      continue;
+    }
+
+    char oldaddr[MAX_IOA_ADDR_STRING];
+    char newaddr[MAX_IOA_ADDR_STRING];
+    addr_to_string(&(chs->remote_addr), oldaddr);
+    addr_to_string(&(nd->src_addr), newaddr);
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_INFO, "DTLS session moved from %s to %s\n", oldaddr, newaddr);
+
+    delete_socket_from_map(chs);
+    chs->dtls_last_record = position;
+    addr_cpy(&(chs->remote_addr), &(nd->src_addr));
+    BIO *wbio = SSL_get_wbio(chs->ssl);
+    if (wbio) {
+      (void)BIO_dgram_set_peer(wbio, (struct sockaddr *)&(nd->src_addr));
+    }
+    add_socket_to_map(chs, amap);
+
+    memcpy(ioa_network_buffer_data(nd->nbh), ioa_network_buffer_data(trial), ioa_network_buffer_get_size(trial));
+    ioa_network_buffer_set_size(nd->nbh, ioa_network_buffer_get_size(trial));
+    ioa_network_buffer_delete(server->e, trial);
+    prom_inc_dtls_rebinding("rebound");
+    return chs;
+  }
+  ioa_network_buffer_delete(server->e, trial);
+
+  prom_inc_dtls_rebinding("unmatched");
+  return NULL;
+}
+
 /////////////// io handlers ///////////////////
 
 static ioa_socket_handle dtls_server_input_handler(dtls_listener_relay_server_type *server, ioa_socket_handle s,
@@ -375,13 +584,15 @@ static ioa_socket_handle dtls_server_input_handler(dtls_listener_relay_server_ty
   }
 
   /* RFC 8656 / RFC 6347 section 4.2.1 stateless cookie exchange, via
-   * DTLSv1_listen(). A ClientHello without a valid cookie only elicits a
-   * HelloVerifyRequest and leaves no per-source state: the SSL is built over a
-   * memory BIO holding just this datagram and is freed immediately unless the
-   * cookie verifies. Only a cookie-verified ClientHello - proof the source can
-   * receive at its claimed address - is promoted to a real socket + session.
-   * This is what the half-open cap could bound but not prevent:
-   * a spoofed-source flood now creates zero state. */
+   * DTLSv1_listen(). dtls_stateless_cookie_fast_path() has already answered
+   * ClientHellos without a valid cookie, so this normally sees only
+   * cookie-verified ones; DTLSv1_listen() checks again and leaves the SSL
+   * ready to continue. The SSL is built over a memory BIO holding just this
+   * datagram and is freed immediately unless the cookie verifies. Only a
+   * cookie-verified ClientHello - proof the source can receive at its claimed
+   * address - is promoted to a real socket + session. This is what the
+   * half-open cap could bound but not prevent: a spoofed-source flood creates
+   * zero state. */
 
   SSL *ssl = SSL_new(server->e->dtls_ctx);
   SSL_set_accept_state(ssl);
@@ -979,6 +1190,37 @@ static bool udp_stateless_nonce_fast_path(dtls_listener_relay_server_type *serve
   return true;
 }
 
+/* Hand a datagram, already decrypted for DTLS, to the child socket of its
+ * session. */
+static void udp_child_socket_input(ioa_engine_handle ioa_eng, struct message_to_relay *sm, ioa_socket_handle s) {
+  /* The DTLS handshake just finished on this session's socket: release its
+   * half-open slot so it no longer counts against the cap (it is now a
+   * return-routable, fully-established peer). */
+  if (s->dtls_half_open && s->ssl && SSL_is_init_finished(s->ssl)) {
+    s->dtls_half_open = false;
+    turn_dtls_half_open_dec();
+  }
+
+  if (ioa_socket_check_bandwidth(s, sm->m.sm.nd.nbh, 1)) {
+    s->e = ioa_eng;
+    if (s->read_cb && sm->m.sm.nd.nbh) {
+      s->read_cb(s, IOA_EV_READ, &(sm->m.sm.nd), s->read_ctx, 1);
+      ioa_network_buffer_delete(ioa_eng, sm->m.sm.nd.nbh);
+      sm->m.sm.nd.nbh = NULL;
+
+      if (ioa_socket_tobeclosed(s)) {
+        ts_ur_super_session *ss = (ts_ur_super_session *)s->session;
+        if (ss) {
+          turn_turnserver *server = (turn_turnserver *)ss->server;
+          if (server) {
+            shutdown_client_connection(server, ss, 0, "UDP packet processing error");
+          }
+        }
+      }
+    }
+  }
+}
+
 static int handle_udp_packet(dtls_listener_relay_server_type *server, struct message_to_relay *sm,
                              ioa_engine_handle ioa_eng, turn_turnserver *ts, udp_packet_classification_t packet_type) {
   const int verbose = ioa_eng->verbose;
@@ -1000,6 +1242,11 @@ static int handle_udp_packet(dtls_listener_relay_server_type *server, struct mes
     s = chs;
     sm->m.sm.s = s;
     if (s->ssl) {
+#if DTLS_SUPPORTED
+      const size_t record_len = ioa_network_buffer_get_size(sm->m.sm.nd.nbh);
+      const uint64_t position =
+          turn_params.dtls_rebinding ? dtls_record_position(ioa_network_buffer_data(sm->m.sm.nd.nbh), record_len) : 0;
+#endif
       const int sslret = ssl_read(s->fd, s->ssl, sm->m.sm.nd.nbh, verbose);
       if (sslret < 0) {
         ioa_network_buffer_delete(ioa_eng, sm->m.sm.nd.nbh);
@@ -1018,38 +1265,21 @@ static int handle_udp_packet(dtls_listener_relay_server_type *server, struct mes
         s = NULL;
         chs = NULL;
       } else if (ioa_network_buffer_get_size(sm->m.sm.nd.nbh) > 0) {
-        ;
+#if DTLS_SUPPORTED
+        /* The record authenticated: it is the newest this session has seen
+           if it is ahead of the last one (see dtls_rebind_session()). */
+        if (position > s->dtls_last_record) {
+          s->dtls_last_record = position;
+        }
+#endif
       } else {
         ioa_network_buffer_delete(ioa_eng, sm->m.sm.nd.nbh);
         sm->m.sm.nd.nbh = NULL;
       }
     }
 
-    /* The DTLS handshake just finished on this session's socket: release its
-     * half-open slot so it no longer counts against the cap (it is now a
-     * return-routable, fully-established peer). */
-    if (s && s->dtls_half_open && s->ssl && SSL_is_init_finished(s->ssl)) {
-      s->dtls_half_open = false;
-      turn_dtls_half_open_dec();
-    }
-
-    if (s && ioa_socket_check_bandwidth(s, sm->m.sm.nd.nbh, 1)) {
-      s->e = ioa_eng;
-      if (s && s->read_cb && sm->m.sm.nd.nbh) {
-        s->read_cb(s, IOA_EV_READ, &(sm->m.sm.nd), s->read_ctx, 1);
-        ioa_network_buffer_delete(ioa_eng, sm->m.sm.nd.nbh);
-        sm->m.sm.nd.nbh = NULL;
-
-        if (ioa_socket_tobeclosed(s)) {
-          ts_ur_super_session *ss = (ts_ur_super_session *)s->session;
-          if (ss) {
-            turn_turnserver *server = (turn_turnserver *)ss->server;
-            if (server) {
-              shutdown_client_connection(server, ss, 0, "UDP packet processing error");
-            }
-          }
-        }
-      }
+    if (s) {
+      udp_child_socket_input(ioa_eng, sm, s);
     }
   } else {
     if (chs && ioa_socket_tobeclosed(chs)) {
@@ -1102,6 +1332,9 @@ static int handle_udp_packet(dtls_listener_relay_server_type *server, struct mes
 
 #if DTLS_SUPPORTED
     if (turn_params.dtls && (packet_type == UDP_PACKET_CLASS_DTLS_HANDSHAKE)) {
+      if (dtls_stateless_cookie_fast_path(server, &(sm->m.sm.nd))) {
+        return 0;
+      }
       chs = dtls_server_input_handler(server, s, sm->m.sm.nd.nbh);
       ioa_network_buffer_delete(server->e, sm->m.sm.nd.nbh);
       sm->m.sm.nd.nbh = NULL;
@@ -1115,9 +1348,16 @@ static int handle_udp_packet(dtls_listener_relay_server_type *server, struct mes
     } else if (turn_params.dtls && (packet_type == UDP_PACKET_CLASS_DTLS_OTHER)) {
       /* A non-handshake DTLS record (ApplicationData / Alert /
        * ChangeCipherSpec) from a source with no established DTLS session - the
-       * per-source lookup at the top of this function already missed, so there
-       * are no session keys to decrypt it and it cannot advance any handshake.
-       * Drop it instead of falling through to create_ioa_socket_from_fd below. */
+       * per-source lookup at the top of this function already missed, so
+       * unless it is a known client from a new port there are no session keys
+       * to decrypt it and it cannot advance any handshake. Drop it instead of
+       * falling through to create_ioa_socket_from_fd below. */
+      chs = dtls_rebind_session(server, amap, &(sm->m.sm.nd));
+      if (chs) {
+        sm->m.sm.s = chs;
+        udp_child_socket_input(ioa_eng, sm, chs);
+        return 0;
+      }
       ioa_network_buffer_delete(server->e, sm->m.sm.nd.nbh);
       sm->m.sm.nd.nbh = NULL;
       return 0;
@@ -1224,27 +1464,16 @@ static int process_udp_datagram(dtls_listener_relay_server_type *server, ioa_soc
 }
 
 static udp_packet_classification_t classify_udp_packet(const uint8_t *data, size_t blen) {
-  size_t candidate_len = blen;
-  uint16_t chnum = 0;
-  uint32_t old_stun_cookie = 0;
-
-  if (stun_is_channel_message_str(data, &candidate_len, &chnum, false) ||
-      stun_is_command_message_str(data, candidate_len)) {
-    return UDP_PACKET_CLASS_STUN_OR_CHANNEL;
-  }
+  unsigned flags = 0;
 #if DTLS_SUPPORTED
-  if (turn_params.dtls && is_dtls_handshake_message(data, (int)blen)) {
-    return UDP_PACKET_CLASS_DTLS_HANDSHAKE;
-  }
-  if (turn_params.dtls && is_dtls_message(data, (int)blen)) {
-    return UDP_PACKET_CLASS_DTLS_OTHER;
+  if (turn_params.dtls) {
+    flags |= UDP_CLASSIFY_DTLS;
   }
 #endif
-  if (turn_params.rfc3489_compatibility && old_stun_is_command_message_str(data, blen, &old_stun_cookie)) {
-    return UDP_PACKET_CLASS_OLD_STUN;
+  if (turn_params.rfc3489_compatibility) {
+    flags |= UDP_CLASSIFY_OLD_STUN;
   }
-
-  return UDP_PACKET_CLASS_INVALID;
+  return udp_classify_packet(data, blen, flags);
 }
 #if defined(__linux__)
 static int ensure_recvmmsg_state(dtls_listener_relay_server_type *server) {
@@ -1260,10 +1489,10 @@ static int ensure_recvmmsg_state(dtls_listener_relay_server_type *server) {
       (struct dtls_listener_recvmmsg_state *)turn_calloc(1, sizeof(struct dtls_listener_recvmmsg_state));
 
   for (unsigned int i = 0; i < MAX_RECVMMSG_BATCH; ++i) {
-    ioa_init_recvmmsg_hdr(&(server->recvmmsg_state->msgs[i]), &(server->recvmmsg_state->iovecs[i]),
+    ioa_init_recvmmsg_hdr(&(server->recvmmsg_state->msgs[i]), server->recvmmsg_state->iovecs[i],
                           &(server->recvmmsg_state->src_addrs[i]), server->recvmmsg_state->cmsgs[i], RECVMMSG_CMSG_SZ,
                           (socklen_t)server->slen0, NULL, 0);
-    server->recvmmsg_state->elems[i] = ioa_network_buffer_allocate(server->e);
+    server->recvmmsg_state->elems[i] = ioa_network_buffer_allocate_size(server->e, IOA_NBH_MTU_RECV_SIZE);
     if (!server->recvmmsg_state->elems[i]) {
       TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: Cannot allocate recvmmsg batch buffer\n", __FUNCTION__);
       return -1;
@@ -1284,7 +1513,7 @@ static int receive_udp_batch_recvmmsg(dtls_listener_relay_server_type *server, e
 
   for (i = 0; i < MAX_RECVMMSG_BATCH; ++i) {
     if (!state->elems[i]) {
-      state->elems[i] = ioa_network_buffer_allocate(server->e);
+      state->elems[i] = ioa_network_buffer_allocate_size(server->e, IOA_NBH_MTU_RECV_SIZE);
       if (!state->elems[i]) {
         ioa_engine_record_udp_recvmmsg_no_buffer(server->e);
         break;
@@ -1296,9 +1525,8 @@ static int receive_udp_batch_recvmmsg(dtls_listener_relay_server_type *server, e
     state->ttls[i] = TTL_IGNORE;
     state->toss[i] = TOS_IGNORE;
     state->packet_types[i] = UDP_PACKET_CLASS_INVALID;
-    ioa_init_recvmmsg_hdr(&(state->msgs[i]), &(state->iovecs[i]), &(state->src_addrs[i]), state->cmsgs[i],
-                          RECVMMSG_CMSG_SZ, (socklen_t)server->slen0, ioa_network_buffer_data(state->elems[i]),
-                          ioa_network_buffer_get_capacity_udp());
+    ioa_init_recvmmsg_nbh_hdr(&(state->msgs[i]), state->iovecs[i], &(state->src_addrs[i]), state->cmsgs[i],
+                              RECVMMSG_CMSG_SZ, (socklen_t)server->slen0, state->elems[i], state->overflow[i]);
   }
 
   if (i == 0) {
@@ -1316,7 +1544,8 @@ static int receive_udp_batch_recvmmsg(dtls_listener_relay_server_type *server, e
   ioa_engine_record_udp_recvmmsg_batch(server->e, rc);
 
   for (int j = 0; j < rc; ++j) {
-    ioa_network_buffer_set_size(state->elems[j], state->msgs[j].msg_len);
+    state->elems[j] =
+        ioa_network_buffer_finish_recvmmsg(server->e, state->elems[j], state->overflow[j], state->msgs[j].msg_len);
     ioa_parse_udp_recvmsg_cmsg(&(state->msgs[j].msg_hdr), &(state->ttls[j]), &(state->toss[j]), NULL);
     state->packet_types[j] =
         classify_udp_packet(ioa_network_buffer_data(state->elems[j]), ioa_network_buffer_get_size(state->elems[j]));
@@ -1441,6 +1670,28 @@ static int create_new_connected_udp_socket(dtls_listener_relay_server_type *serv
   return server->connect_cb(server->e, &(server->sm));
 }
 
+/* --udp-io-uring: a batch the engine's receive ring read from the listener
+ * socket. Buffers handed downstream are cleared from nds; the rest are freed
+ * by the engine. */
+static void udp_server_input_batch_handler(ioa_socket_handle s, int event_type, ioa_net_data *nds, size_t count,
+                                           void *ctx) {
+  UNUSED_ARG(event_type);
+  dtls_listener_relay_server_type *server = (dtls_listener_relay_server_type *)ctx;
+  uint32_t packets_processed = 0;
+  uint32_t packets_dropped = 0;
+
+  for (size_t i = 0; i < count; ++i) {
+    const size_t bsize = ioa_network_buffer_get_size(nds[i].nbh);
+    const int packet_type = (int)classify_udp_packet(ioa_network_buffer_data(nds[i].nbh), bsize);
+    if (!process_udp_datagram(server, s, nds[i].nbh, &(nds[i].src_addr), (ssize_t)bsize, nds[i].recv_ttl,
+                              nds[i].recv_tos, packet_type, &packets_processed, &packets_dropped)) {
+      nds[i].nbh = NULL;
+    }
+  }
+
+  ioa_engine_record_packets(server->e, packets_processed, packets_dropped);
+}
+
 static void udp_server_input_handler(evutil_socket_t fd, short what, void *arg) {
 
   if (!arg) {
@@ -1514,7 +1765,7 @@ static void udp_server_input_handler(evutil_socket_t fd, short what, void *arg)
 start_udp_cycle:
 
   if (!elem) {
-    elem = ioa_network_buffer_allocate(server->e);
+    elem = ioa_network_buffer_allocate_size(server->e, ioa_network_buffer_get_capacity_udp());
   }
 
   server->sm.m.sm.nd.nbh = elem;
@@ -1699,6 +1950,7 @@ static int create_server_socket(dtls_listener_relay_server_type *server, int rep
         event_new(server->e->event_base, udp_listen_fd, EV_READ | EV_PERSIST, udp_server_input_handler, server);
 
     event_add(server->udp_listen_ev, NULL);
+    ioa_socket_attach_uring(server->udp_listen_s, server->udp_listen_ev, udp_server_input_batch_handler, server);
   }
 
   if (report_creation) {
@@ -1727,6 +1979,7 @@ static int reopen_server_socket(dtls_listener_relay_server_type *server, evutil_
 
   {
     EVENT_DEL(server->udp_listen_ev);
+    ioa_socket_detach_uring(server->udp_listen_s);
 
     if (server->udp_listen_s->fd >= 0) {
       socket_closesocket(server->udp_listen_s->fd);
@@ -1768,6 +2021,7 @@ static int reopen_server_socket(dtls_listener_relay_server_type *server, evutil_
         event_new(server->e->event_base, udp_listen_fd, EV_READ | EV_PERSIST, udp_server_input_handler, server);
 
     event_add(server->udp_listen_ev, NULL);
+    ioa_socket_attach_uring(server->udp_listen_s, server->udp_listen_ev, udp_server_input_batch_handler, server);
   }
 
   if (!turn_params.no_udp && turn_params.dtls) {
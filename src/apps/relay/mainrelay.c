@@ -38,6 +38,7 @@
 #include "dbdrivers/dbdriver.h"
 
 #include "ns_turn_ratelimit.h"
+#include "ns_ioalib_uring.h"
 #include "prom_server.h"
 #include <assert.h>
 #include <limits.h>
@@ -118,6 +119,13 @@ turn_params_t turn_params = {
 #endif
     /* dtls: the DTLS listeners are opt-in, enabled with --dtls. */
     false,
+    false, /*dtls_rebinding*/
+
+    false,                           /*no_tls_session_tickets*/
+    "",                              /*tls_ticket_key_file*/
+    TLS_TICKET_KEY_ROTATION_DEFAULT, /*tls_ticket_key_rotation*/
+    false,                           /*tls_ktls*/
+    0,                               /*tls_handshake_threads*/
 
     NULL,      /*tls_ctx_update_ev*/
     {0, NULL}, /*tls_mutex*/
@@ -154,13 +162,14 @@ turn_params_t turn_params = {
 
     {"", ""},                                                                 /*redis_statsdb*/
     false,                                                                    /*use_redis_statsdb*/
-    {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, 0, 0, NULL, NULL, NULL}, /*listener*/
+    {NULL, NULL, NULL, NULL, NULL, NULL, NULL, 0, 0, NULL, NULL, NULL},       /*listener*/
     {NULL, 0},                                                                /*ip_whitelist*/
     {NULL, 0},                                                                /*ip_blacklist*/
 
     //////////////// Relay servers //////////////////////////////////
     LOW_DEFAULT_PORTS_BOUNDARY,  /*min_port*/
     HIGH_DEFAULT_PORTS_BOUNDARY, /*max_port*/
+    false,                       /*sharded_relay_ports*/
 
     false, /*check_origin*/
 
@@ -175,6 +184,8 @@ turn_params_t turn_params = {
     NULL,                                 /*external_ip*/
     DEFAULT_GENERAL_RELAY_SERVERS_NUMBER, /*general_relay_servers_number*/
     false,                                /*relay_threads_configured*/
+    RELAY_PLACEMENT_LISTENER,             /*relay_placement*/
+    0,                                    /*relay_rebalance*/
     UR_SERVER_SOCK_BUF_SIZE,
 
     ////////////// Auth server /////////////////////////////////////
@@ -211,6 +222,9 @@ turn_params_t turn_params = {
     false,                              /* mobility */
     TURN_CREDENTIALS_NONE,              /* ct */
     false,                              /* use_auth_secret_with_timestamp */
+    0,                                  /* auth_cache_ttl */
+    DEFAULT_AUTH_CACHE_SIZE,            /* auth_cache_size */
+    0,                                  /* db_max_inflight */
     0,                                  /* max_bps */
     0,                                  /* bps_capacity */
     0,                                  /* bps_capacity_allocated */
@@ -253,6 +267,9 @@ turn_params_t turn_params = {
     false, /* udp_sendmmsg (derived from multiplex_peer) */
     false, /* udp_sendmmsg_log */
     false, /* udp_gso */
+    false, /* udp_io_uring */
+    false, /* udp_io_uring_log */
+    false, /* tcp_splice */
 #endif
     false, /* include_reason_string */
     false, /* multiplex_peer */
@@ -296,6 +313,7 @@ static char procgroupname[1025] = "\0";
 
 static void read_config_file(int argc, char **argv, int pass);
 static void reload_ssl_certs(evutil_socket_t sock, short events, void *args);
+static void start_tls_ticket_key_rotation(void);
 
 static void shutdown_handler(evutil_socket_t sock, short events, void *args);
 static void drain_handler(evutil_socket_t sock, short events, void *args);
@@ -1054,6 +1072,14 @@ static char Usage[] =
     "						In older systems (pre-Linux 3.9) the number of UDP relay threads "
     "always equals\n"
     "						the number of listening endpoints (unless -m 0 is set).\n"
+    " --relay-placement		<policy>	How new TCP/TLS client connections are spread over relay threads:\n"
+    "						listener - stay on the thread whose listener accepted them (default);\n"
+    "						least-loaded - go to the thread with the fewest sessions and bytes/s;\n"
+    "						two-choices - go to the lighter of the accepting thread and one\n"
+    "						random other thread.\n"
+    " --relay-rebalance		<percent>	Move TCP/TLS sessions off a relay thread whose CPU use stays\n"
+    "						more than <percent> of a core above the least busy relay\n"
+    "						thread's for 5 seconds. 0 (default) disables.\n"
     " --cpus				<number>	Override system CPU count detection. Use this number\n"
     "						instead of the auto-detected CPU count.\n"
     "						Useful in virtualized/containerized environments where\n"
@@ -1065,6 +1091,11 @@ static char Usage[] =
     " --max-port			<port>		Upper bound of the UDP port range for relay endpoints "
     "allocation.\n"
     "						Default value is 65535, according to RFC 5766.\n"
+    " --sharded-relay-ports				Split the relay port range into one disjoint slice per relay thread, so\n"
+    "						threads allocate relay ports without contending on a shared lock.\n"
+    "						A thread borrows from the other slices only when its own runs dry.\n"
+    "						Each slice keeps its own port table (about 384 KiB per relay IP and\n"
+    "						transport). Disabled by default.\n"
     "--sock-buf-size   <number>	Size of the socket buffer for UDP sockets (in bytes).\n"
     " -v, --verbose					'Moderate' verbose mode.\n"
     " -V, --Verbose					Extra verbose mode, very annoying (for debug purposes only).\n"
@@ -1204,6 +1235,16 @@ static char Usage[] =
     "						by a separate program, so this is why it is 'dynamic'.\n"
     "						Multiple shared secrets can be used (both in the database and in the "
     "\"static\" fashion).\n"
+    " --auth-cache-ttl		<seconds>	Cache derived long-term credential keys (REST API and database\n"
+    "						users) and REST API secrets in memory for this many seconds, so\n"
+    "						repeated authentications skip the database and the key derivation.\n"
+    "						The cache is flushed on every database reread (every 5 seconds), so\n"
+    "						credential changes made outside this server apply within that time.\n"
+    "						Default is 0 (no caching).\n"
+    " --auth-cache-size		<number>	Maximum number of cached credential keys. Default is 10000.\n"
+    " --db-max-inflight		<number>	Database user key lookups each auth thread keeps in flight at once,\n"
+    "						over as many database connections, without waiting for the answers.\n"
+    "						PostgreSQL only. Default is 0: lookups are synchronous. Maximum is 64.\n"
     " --no-auth-pings				Disable periodic health checks to 'dynamic' auth secret tables.\n"
     " --no-dynamic-ip-list				Do not use dynamic allowed/denied peer ip list.\n"
     " --no-dynamic-realms				Do not use dynamic realm assignment and options.\n"
@@ -1248,12 +1289,34 @@ static char Usage[] =
     " --no-tlsv1_2					Set TLSv1.3/DTLSv1.2 as a minimum supported protocol version.\n"
     "						With openssl-1.0.2 and below, do not allow "
     "TLSv1.2/DTLSv1.2 protocols.\n"
+    " --no-tls-session-tickets			Do not issue TLS/DTLS session tickets, so every reconnect does a full "
+    "handshake.\n"
+    " --tls-ticket-key-file	<filename>		Session ticket keys: one or more 80-byte records (16-byte name,\n"
+    "						32-byte HMAC secret, 32-byte AES secret), e.g. made by 'openssl rand 80'.\n"
+    "						The first key encrypts new tickets, all of them decrypt. Processes\n"
+    "						sharing the file resume each other's sessions. By default the keys\n"
+    "						are random and private to the process.\n"
+    " --tls-ticket-key-rotation	<seconds>	How often a new random ticket key is made or the key file is\n"
+    "						re-read. The last 4 keys decrypt, so tickets live 3 intervals.\n"
+    "						Default is 3600; 0 never rotates.\n"
+    " --tls-ktls					Let the kernel encrypt and decrypt TLS client connections (kTLS) when\n"
+    "						the negotiated suite allows it (TLS 1.2/1.3 AES-GCM). Needs Linux with\n"
+    "						the tls module and an OpenSSL built with kTLS; off by default.\n"
+    " --tls-handshake-threads	<number>	Run TLS handshakes of new TCP/TLS client connections on this many\n"
+    "						dedicated threads; a connection reaches its relay thread only once\n"
+    "						the handshake is done. Default is 0: relay threads do their own\n"
+    "						handshakes. Maximum is 64. DTLS handshakes stay on the relay threads.\n"
     " --no-udp					Do not start UDP client listeners.\n"
     " --no-tcp					Do not start TCP client listeners.\n"
     " --no-tls					Do not start TLS client listeners.\n"
     " --dtls					Start DTLS client listeners. DTLS is not started by default.\n"
     " --no-dtls					Deprecated: DTLS client listeners are not started unless\n"
     "						--dtls is given.\n"
+    " --dtls-rebinding				Let an established DTLS client that appears from a new port of the\n"
+    "						same IP (NAT rebinding) keep its session: an application data record\n"
+    "						from an unknown source is tried against the host's established\n"
+    "						sessions, and the one whose keys authenticate it moves to the new\n"
+    "						address without a new handshake. Off by default.\n"
     " --no-udp-relay					Do not allow UDP relay endpoints, use only TCP relay option.\n"
     " --no-tcp-relay					Do not allow TCP relay endpoints, use only UDP relay options.\n"
     " -l, --log-file		<filename>		Option to set the full path name of the log file.\n"
@@ -1440,10 +1503,18 @@ static char Usage[] =
     " --udp-recvmmsg-log			   Log Linux recvmmsg batch occupancy stats every 10 seconds.\n"
     " --udp-sendmmsg-log			   Log Linux sendmmsg/UDP-GSO egress batch occupancy and "
     "GSO-engagement "
-    "stats every 10 seconds. Only meaningful with --multiplex-peer (which enables sendmmsg batching).\n"
-    " --udp-gso				   Enable Linux UDP-GSO (UDP_SEGMENT cmsg) when a sendmmsg batch shares "
-    "destination and size; collapses N datagrams into one network-stack traversal. Requires "
-    "--multiplex-peer (which enables sendmmsg batching).\n"
+    "stats every 10 seconds. Sends are batched inside a --udp-recvmmsg, --udp-io-uring or --multiplex-peer "
+    "receive batch.\n"
+    " --udp-gso				   Enable Linux UDP-GSO (UDP_SEGMENT cmsg) when the datagrams a sendmmsg "
+    "batch holds for one socket share destination and size; collapses N datagrams into one network-stack "
+    "traversal.\n"
+    " --udp-io-uring				   Linux-only io_uring UDP backend: multishot recvmsg with provided "
+    "buffers on the shared fan-in sockets and one io_uring submission per sendmmsg batch. Falls back to "
+    "recvmmsg/sendmmsg when the kernel lacks multishot recvmsg. Off by default.\n"
+    " --udp-io-uring-log			   Log io_uring receive/send batch stats every 10 seconds.\n"
+    " --tcp-splice				   Linux-only zero-copy relay for RFC 6062 TCP data connections: once a "
+    "plain-TCP client data connection is bound to its peer connection, the payload moves between the two sockets "
+    "with splice() and never reaches user space. TLS data connections keep the normal path. Off by default.\n"
 #endif
     " --multiplex-peer\n"
     "        Enable peer-side multiplexing relay mode (non-standard, optional).\n"
@@ -1574,6 +1645,9 @@ enum EXTRA_OPTS {
   PKEY_PWD_OPT,
   MIN_PORT_OPT,
   MAX_PORT_OPT,
+  SHARDED_RELAY_PORTS_OPT,
+  RELAY_PLACEMENT_OPT,
+  RELAY_REBALANCE_OPT,
   SOCK_BUF_SIZE_OPT,
   STALE_NONCE_OPT,
   MAX_ALLOCATE_LIFETIME_OPT,
@@ -1593,6 +1667,9 @@ enum EXTRA_OPTS {
   NO_DYNAMIC_REALMS_OPT,
   DEL_ALL_AUTH_SECRETS_OPT,
   STATIC_AUTH_SECRET_VAL_OPT,
+  AUTH_CACHE_TTL_OPT,
+  AUTH_CACHE_SIZE_OPT,
+  DB_MAX_INFLIGHT_OPT,
   NO_STDOUT_LOG_OPT,
   SYSLOG_OPT,
   SYSLOG_FACILITY_OPT,
@@ -1637,6 +1714,12 @@ enum EXTRA_OPTS {
   ENABLE_TLSV1_OPT,
   ENABLE_TLSV1_1_OPT,
   NO_TLSV1_2_OPT,
+  NO_TLS_SESSION_TICKETS_OPT,
+  TLS_TICKET_KEY_FILE_OPT,
+  TLS_TICKET_KEY_ROTATION_OPT,
+  TLS_KTLS_OPT,
+  TLS_HANDSHAKE_THREADS_OPT,
+  DTLS_REBINDING_OPT,
   CHECK_ORIGIN_CONSISTENCY_OPT,
   ADMIN_MAX_BPS_OPT,
   ADMIN_TOTAL_QUOTA_OPT,
@@ -1663,6 +1746,9 @@ enum EXTRA_OPTS {
   UDP_RECVMMSG_LOG_OPT,
   UDP_SENDMMSG_LOG_OPT,
   UDP_GSO_OPT,
+  UDP_IO_URING_OPT,
+  UDP_IO_URING_LOG_OPT,
+  TCP_SPLICE_OPT,
 #endif
   VERSION_OPT,
   DRAIN_MIN_ALLOCATIONS_OPT,
@@ -1704,8 +1790,11 @@ static const struct myoption long_options[] = {
     {"relay-ip", required_argument, NULL, 'E'},
     {"external-ip", required_argument, NULL, 'X'},
     {"relay-threads", required_argument, NULL, 'm'},
+    {"relay-placement", required_argument, NULL, RELAY_PLACEMENT_OPT},
+    {"relay-rebalance", required_argument, NULL, RELAY_REBALANCE_OPT},
     {"min-port", required_argument, NULL, MIN_PORT_OPT},
     {"max-port", required_argument, NULL, MAX_PORT_OPT},
+    {"sharded-relay-ports", optional_argument, NULL, SHARDED_RELAY_PORTS_OPT},
     {"sock-buf-size", required_argument, NULL, SOCK_BUF_SIZE_OPT},
     {"lt-cred-mech", optional_argument, NULL, 'a'},
     {"no-auth", optional_argument, NULL, 'z'},
@@ -1738,6 +1827,9 @@ static const struct myoption long_options[] = {
 #endif
     {"use-auth-secret", optional_argument, NULL, AUTH_SECRET_OPT},
     {"static-auth-secret", required_argument, NULL, STATIC_AUTH_SECRET_VAL_OPT},
+    {"auth-cache-ttl", required_argument, NULL, AUTH_CACHE_TTL_OPT},
+    {"auth-cache-size", required_argument, NULL, AUTH_CACHE_SIZE_OPT},
+    {"db-max-inflight", required_argument, NULL, DB_MAX_INFLIGHT_OPT},
     {"no-auth-pings", optional_argument, NULL, NO_AUTH_PINGS_OPT},
     {"no-dynamic-ip-list", optional_argument, NULL, NO_DYNAMIC_IP_LIST_OPT},
     {"no-dynamic-realms", optional_argument, NULL, NO_DYNAMIC_REALMS_OPT},
@@ -1817,6 +1909,12 @@ static const struct myoption long_options[] = {
     {"tlsv1", optional_argument, NULL, ENABLE_TLSV1_OPT},
     {"tlsv1_1", optional_argument, NULL, ENABLE_TLSV1_1_OPT},
     {"no-tlsv1_2", optional_argument, NULL, NO_TLSV1_2_OPT},
+    {"no-tls-session-tickets", optional_argument, NULL, NO_TLS_SESSION_TICKETS_OPT},
+    {"tls-ticket-key-file", required_argument, NULL, TLS_TICKET_KEY_FILE_OPT},
+    {"tls-ticket-key-rotation", required_argument, NULL, TLS_TICKET_KEY_ROTATION_OPT},
+    {"tls-ktls", optional_argument, NULL, TLS_KTLS_OPT},
+    {"tls-handshake-threads", required_argument, NULL, TLS_HANDSHAKE_THREADS_OPT},
+    {"dtls-rebinding", optional_argument, NULL, DTLS_REBINDING_OPT},
     {"secret-key-file", required_argument, NULL, SECRET_KEY_OPT},
     {"keep-address-family", optional_argument, NULL, 'K'},
     {"allocation-default-address-family", required_argument, NULL, 'A'},
@@ -1836,6 +1934,9 @@ static const struct myoption long_options[] = {
     {"udp-recvmmsg-log", optional_argument, NULL, UDP_RECVMMSG_LOG_OPT},
     {"udp-sendmmsg-log", optional_argument, NULL, UDP_SENDMMSG_LOG_OPT},
     {"udp-gso", optional_argument, NULL, UDP_GSO_OPT},
+    {"udp-io-uring", optional_argument, NULL, UDP_IO_URING_OPT},
+    {"udp-io-uring-log", optional_argument, NULL, UDP_IO_URING_LOG_OPT},
+    {"tcp-splice", optional_argument, NULL, TCP_SPLICE_OPT},
 #endif
     {"include-reason-string", optional_argument, NULL, INCLUDE_REASON_STRING_OPT},
     {"multiplex-peer", no_argument, NULL, OPT_MULTIPLEX_PEER},
@@ -2187,6 +2288,34 @@ static void set_option(int c, char *value) {
   case NO_TLSV1_2_OPT:
     turn_params.no_tlsv1_2 = get_bool_value(value);
     break;
+  case NO_TLS_SESSION_TICKETS_OPT:
+    turn_params.no_tls_session_tickets = get_bool_value(value);
+    break;
+  case TLS_TICKET_KEY_FILE_OPT:
+    STRCPY(turn_params.tls_ticket_key_file, value);
+    break;
+  case TLS_TICKET_KEY_ROTATION_OPT: {
+    const int rotation = atoi(value);
+    turn_params.tls_ticket_key_rotation = (rotation > 0) ? (unsigned int)rotation : 0;
+    break;
+  }
+  case TLS_KTLS_OPT:
+    turn_params.tls_ktls = get_bool_value(value);
+    break;
+  case DTLS_REBINDING_OPT:
+    turn_params.dtls_rebinding = get_bool_value(value);
+    break;
+  case TLS_HANDSHAKE_THREADS_OPT: {
+    const int threads = atoi(value);
+    if (threads > MAX_NUMBER_OF_TLS_HANDSHAKE_THREADS) {
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_WARNING, "WARNING: max number of TLS handshake threads is %d.\n",
+                    MAX_NUMBER_OF_TLS_HANDSHAKE_THREADS);
+      turn_params.tls_handshake_threads = MAX_NUMBER_OF_TLS_HANDSHAKE_THREADS;
+    } else {
+      turn_params.tls_handshake_threads = (threads > 0) ? (unsigned int)threads : 0;
+    }
+    break;
+  }
   case DH566_OPT:
     if (get_bool_value(value)) {
       turn_params.dh_key_size = DH_566;
@@ -2311,6 +2440,28 @@ static void set_option(int c, char *value) {
   case MAX_PORT_OPT:
     turn_params.max_port = get_port_value(value);
     break;
+  case RELAY_PLACEMENT_OPT:
+    if (!strcmp(value, "listener")) {
+      turn_params.relay_placement = RELAY_PLACEMENT_LISTENER;
+    } else if (!strcmp(value, "least-loaded")) {
+      turn_params.relay_placement = RELAY_PLACEMENT_LEAST_LOADED;
+    } else if (!strcmp(value, "two-choices")) {
+      turn_params.relay_placement = RELAY_PLACEMENT_TWO_CHOICES;
+    } else {
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "ERROR: invalid relay-placement parameter: %s\n", value);
+    }
+    break;
+  case RELAY_REBALANCE_OPT: {
+    const int pct = atoi(value);
+    if ((pct < 0) || (pct > 100)) {
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "ERROR: invalid relay-rebalance parameter: %s\n", value);
+    } else {
+      turn_params.relay_rebalance = (unsigned int)pct;
+    }
+  } break;
+  case SHARDED_RELAY_PORTS_OPT:
+    turn_params.sharded_relay_ports = get_bool_value(value);
+    break;
   case SOCK_BUF_SIZE_OPT:
     turn_params.sock_buf_size = atoi(value);
     if (turn_params.sock_buf_size <= 0) {
@@ -2522,6 +2673,28 @@ static void set_option(int c, char *value) {
     turn_params.ct = TURN_CREDENTIALS_LONG_TERM;
     use_lt_credentials = 1;
     break;
+  case AUTH_CACHE_TTL_OPT:
+    turn_params.auth_cache_ttl = (vint)atoi(value);
+    if (turn_params.auth_cache_ttl < 0) {
+      turn_params.auth_cache_ttl = 0;
+    }
+    break;
+  case AUTH_CACHE_SIZE_OPT: {
+    const int sz = atoi(value);
+    turn_params.auth_cache_size = (sz > 0) ? (size_t)sz : DEFAULT_AUTH_CACHE_SIZE;
+    break;
+  }
+  case DB_MAX_INFLIGHT_OPT: {
+    const int inflight = atoi(value);
+    if (inflight > MAX_DB_INFLIGHT_LOOKUPS) {
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_WARNING, "WARNING: max number of in-flight database lookups is %d.\n",
+                    MAX_DB_INFLIGHT_LOOKUPS);
+      turn_params.db_max_inflight = MAX_DB_INFLIGHT_LOOKUPS;
+    } else {
+      turn_params.db_max_inflight = (inflight > 0) ? (unsigned int)inflight : 0;
+    }
+    break;
+  }
   case NO_AUTH_PINGS_OPT:
     turn_params.no_auth_pings = 1;
     break;
@@ -2723,6 +2896,15 @@ static void set_option(int c, char *value) {
   case UDP_GSO_OPT:
     turn_params.udp_gso = get_bool_value(value);
     break;
+  case UDP_IO_URING_OPT:
+    turn_params.udp_io_uring = get_bool_value(value);
+    break;
+  case UDP_IO_URING_LOG_OPT:
+    turn_params.udp_io_uring_log = get_bool_value(value);
+    break;
+  case TCP_SPLICE_OPT:
+    turn_params.tcp_splice = get_bool_value(value);
+    break;
 #endif
   case OPT_MULTIPLEX_PEER:
     turn_params.multiplex_peer = true;
@@ -3647,12 +3829,18 @@ int main(int argc, char **argv) {
   }
 
 #if defined(__linux__)
+  if (turn_params.udp_io_uring && !ioa_uring_supported()) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_WARNING, "--udp-io-uring: the kernel lacks multishot recvmsg with provided buffer "
+                                          "rings; falling back to recvmmsg/sendmmsg.\n");
+    turn_params.udp_io_uring = false;
+  }
   /* udp_sendmmsg is not a user-visible CLI flag; it is derived from the
-   * modes that benefit from batched UDP sends. --udp-recvmmsg is on by
-   * default (see turn_params initialiser); it provides the begin/end recvmmsg
-   * window that multiplex-peer's sendmmsg batching piggybacks on. Operators
-   * who want to opt out can pass --udp-recvmmsg=false. */
-  turn_params.udp_sendmmsg = turn_params.multiplex_peer;
+   * modes that open a batched receive window for sends to piggyback on:
+   * multiplex-peer's shared relay sockets, and the client listener's
+   * recvmmsg (on by default, see turn_params initialiser) or io_uring input
+   * batch, whose datagrams fan out to many per-session relay sockets.
+   * Operators who want to opt out can pass --udp-recvmmsg=false. */
+  turn_params.udp_sendmmsg = turn_params.multiplex_peer || turn_params.udp_recvmmsg || turn_params.udp_io_uring;
 #endif
 
   if (turn_params.rfc3489_compatibility) {
@@ -3920,6 +4108,7 @@ int main(int argc, char **argv) {
   }
 
   setup_server();
+  start_tls_ticket_key_rotation();
 
 #if defined(WINDOWS)
   // TODO: implement it!!! add windows server
@@ -4178,19 +4367,16 @@ static int ServerALPNCallback(SSL *ssl, const unsigned char **out, unsigned char
     if ((!turn_params.no_stun) && (current_len == sa_len) && (memcmp(ptr + 1, STUN_ALPN, sa_len) == 0)) {
       *out = ptr + 1;
       *outlen = sa_len;
-      SSL_set_app_data(ssl, STUN_ALPN);
       return SSL_TLSEXT_ERR_OK;
     }
     if ((!turn_params.stun_only) && (current_len == ta_len) && (memcmp(ptr + 1, TURN_ALPN, ta_len) == 0)) {
       *out = ptr + 1;
       *outlen = ta_len;
-      SSL_set_app_data(ssl, TURN_ALPN);
       return SSL_TLSEXT_ERR_OK;
     }
     if ((current_len == ha_len) && (memcmp(ptr + 1, HTTP_ALPN, ha_len) == 0)) {
       *out = ptr + 1;
       *outlen = ha_len;
-      SSL_set_app_data(ssl, HTTP_ALPN);
       found_http = 1;
     }
     ptr += 1 + current_len;
@@ -4221,7 +4407,10 @@ static void set_ctx(SSL_CTX **out, const char *protocol, const SSL_METHOD *metho
   }
 
   SSL_CTX_set_cipher_list(ctx, turn_params.cipher_list);
+  /* No server-side session cache: resumption is stateless, through tickets
+   * encrypted with the shared ticket key ring. */
   SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+  tls_tickets_setup_ctx(ctx, !turn_params.no_tls_session_tickets, turn_params.tls_ticket_key_rotation);
   SSL_CTX_set_ciphersuites(ctx, turn_params.cipher_list);
 
   if (!SSL_CTX_use_certificate_chain_file(ctx, turn_params.cert_file)) {
@@ -4409,6 +4598,48 @@ static void set_ctx(SSL_CTX **out, const char *protocol, const SSL_METHOD *metho
 #endif
 }
 
+static void load_tls_ticket_keys(void) {
+  if (turn_params.tls_ticket_key_file[0] && !turn_params.no_tls_session_tickets) {
+    const int keys = tls_tickets_load_file(turn_params.tls_ticket_key_file);
+    if (keys > 0) {
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_INFO, "TLS session ticket keys: %d loaded from %s\n", keys,
+                    turn_params.tls_ticket_key_file);
+    }
+  }
+}
+
+/* Periodic ticket key rotation on the main event loop. With a key file the
+ * file is re-read instead, so whoever rotates it controls every process. */
+static void rotate_tls_ticket_keys(evutil_socket_t sock, short events, void *args) {
+  UNUSED_ARG(sock);
+  UNUSED_ARG(events);
+  UNUSED_ARG(args);
+
+  if (turn_params.tls_ticket_key_file[0]) {
+    load_tls_ticket_keys();
+  } else {
+    tls_tickets_rotate();
+  }
+
+  tls_ticket_stats st;
+  tls_tickets_get_stats(&st);
+  TURN_LOG_FUNC(TURN_LOG_LEVEL_INFO,
+                "TLS handshakes: %llu full, %llu resumed; tickets: %llu issued, %llu renewed, %llu unknown\n",
+                (unsigned long long)st.full_handshakes, (unsigned long long)st.resumed_handshakes,
+                (unsigned long long)st.tickets_issued, (unsigned long long)st.tickets_renewed,
+                (unsigned long long)st.tickets_unknown);
+}
+
+static void start_tls_ticket_key_rotation(void) {
+  if ((turn_params.no_tls && !turn_params.dtls) || turn_params.no_tls_session_tickets ||
+      !turn_params.tls_ticket_key_rotation) {
+    return;
+  }
+  struct event *ev = event_new(turn_params.listener.event_base, -1, EV_PERSIST, rotate_tls_ticket_keys, NULL);
+  struct timeval tv = {(time_t)turn_params.tls_ticket_key_rotation, 0};
+  event_add(ev, &tv);
+}
+
 static void openssl_load_certificates(void);
 static void openssl_setup(void) {
   THREAD_setup();
@@ -4440,6 +4671,9 @@ static void openssl_setup(void) {
     adjust_key_file_names();
   }
 
+  tls_tickets_init();
+  load_tls_ticket_keys();
+
   if (turn_params.tls_port_configured && turn_params.no_tls && !turn_params.dtls) {
     TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR,
                   "tls-listening-port %d is configured, but the TLS and DTLS listeners are disabled "
@@ -4471,6 +4705,15 @@ static void openssl_load_certificates(void) {
     if (turn_params.no_tlsv1_2) {
       SSL_CTX_set_min_proto_version(turn_params.tls_ctx, TLS1_3_VERSION);
     }
+    if (turn_params.tls_ktls) {
+#if KTLS_SUPPORTED
+      /* OpenSSL hands the keys to the kernel after each handshake whose suite
+       * the kernel supports; the engine checks per socket whether it took. */
+      SSL_CTX_set_options(turn_params.tls_ctx, SSL_OP_ENABLE_KTLS);
+#else
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_WARNING, "--tls-ktls: this OpenSSL is built without kTLS support, ignored\n");
+#endif
+    }
     TURN_LOG_FUNC(TURN_LOG_LEVEL_INFO, "TLS cipher suite: %s\n", turn_params.cipher_list);
 #endif
   }
@@ -4496,6 +4739,7 @@ static void openssl_load_certificates(void) {
 
 static void reload_ssl_certs(evutil_socket_t sock, short events, void *args) {
   TURN_LOG_FUNC(TURN_LOG_LEVEL_INFO, "Reloading TLS certificates and keys\n");
+  load_tls_ticket_keys();
   openssl_load_certificates();
   if (turn_params.tls_ctx_update_ev != NULL) {
     event_active(turn_params.tls_ctx_update_ev, EV_READ, 0);
@@ -80,6 +80,7 @@
 
 #include "dtls_listener.h"
 #include "tls_listener.h"
+#include "tls_tickets.h"
 
 #include "ns_turn_maps.h"
 #include "ns_turn_server.h"
@@ -140,6 +141,9 @@ extern _Atomic
 
 #define MAX_NUMBER_OF_GENERAL_RELAY_SERVERS ((uint8_t)(0x80))
 
+#define MAX_NUMBER_OF_TLS_HANDSHAKE_THREADS (64)
+#define MAX_DB_INFLIGHT_LOOKUPS (64)
+
 #define DEFAULT_CPUS_NUMBER (2)
 
 /////////// TYPES ///////////////////////////////////
@@ -148,6 +152,15 @@ enum _DH_KEY_SIZE { DH_566, DH_1066, DH_2066, DH_CUSTOM };
 
 typedef enum _DH_KEY_SIZE DH_KEY_SIZE;
 
+/* Which relay thread a new TCP/TLS client connection is handed to. */
+enum _RELAY_PLACEMENT {
+  RELAY_PLACEMENT_LISTENER = 0, /* the thread whose listener accepted it */
+  RELAY_PLACEMENT_LEAST_LOADED,
+  RELAY_PLACEMENT_TWO_CHOICES
+};
+
+typedef enum _RELAY_PLACEMENT RELAY_PLACEMENT;
+
 ///////// LISTENER SERVER TYPES /////////////////////
 
 struct message_to_listener_to_client {
@@ -171,8 +184,7 @@ struct listener_server {
   turnipports *tp;
   struct event_base *event_base;
   ioa_engine_handle ioa_eng;
-  struct bufferevent *in_buf;
-  struct bufferevent *out_buf;
+  relay_queue *queue; /* struct message_to_listener from the relay threads */
   char **addrs;
   ioa_addr **encaddrs;
   size_t addrs_number;
@@ -208,6 +220,13 @@ typedef struct _turn_params_ {
   bool no_tlsv1_2;
   bool no_tls;
   bool dtls;
+  bool dtls_rebinding;
+
+  bool no_tls_session_tickets;
+  char tls_ticket_key_file[1025];
+  unsigned int tls_ticket_key_rotation;
+  bool tls_ktls;
+  unsigned int tls_handshake_threads;
 
   struct event *tls_ctx_update_ev;
   TURN_MUTEX_DECLARE(tls_mutex)
@@ -255,6 +274,7 @@ typedef struct _turn_params_ {
 
   uint16_t min_port;
   uint16_t max_port;
+  bool sharded_relay_ports;
 
   bool check_origin;
 
@@ -273,6 +293,8 @@ typedef struct _turn_params_ {
 
   turnserver_id general_relay_servers_number;
   bool relay_threads_configured;
+  RELAY_PLACEMENT relay_placement;
+  unsigned int relay_rebalance; /* CPU gap, in percent of a core, that moves sessions; 0 = off */
 
   int sock_buf_size;
 
@@ -319,6 +341,10 @@ typedef struct _turn_params_ {
   bool mobility;
   turn_credential_type ct;
   bool use_auth_secret_with_timestamp;
+  vint auth_cache_ttl;    /* --auth-cache-ttl, seconds; 0 disables the credential cache */
+  size_t auth_cache_size; /* --auth-cache-size, max cached (user, realm) keys */
+  /* --db-max-inflight, async user key lookups per auth thread; 0 is synchronous */
+  unsigned int db_max_inflight;
   turn_atomic_u32 max_bps;
   turn_atomic_u32 bps_capacity;
   turn_atomic_u32 bps_capacity_allocated;
@@ -365,6 +391,9 @@ typedef struct _turn_params_ {
   bool udp_sendmmsg; /* derived: multiplex_peer; not user-settable */
   bool udp_sendmmsg_log;
   bool udp_gso;
+  bool udp_io_uring;
+  bool udp_io_uring_log;
+  bool tcp_splice;
 #endif
   bool include_reason_string;
 
@@ -436,6 +465,45 @@ void shutdown_server(void);
 void run_listener_server(struct listener_server *ls);
 void enable_drain_mode(void);
 
+////////// TLS handshake threads ////////////////
+
+typedef struct _tls_handshake_pool_stats {
+  unsigned int threads;
+  uint64_t queued;     /* connections waiting for or inside a handshake now */
+  uint64_t tls;        /* handshakes completed and handed to a relay thread */
+  uint64_t plain;      /* connections that turned out not to be TLS */
+  uint64_t failed;     /* failed or timed-out handshakes */
+  uint64_t latency_us; /* sum of accept-to-handoff times */
+  uint64_t max_latency_us;
+} tls_handshake_pool_stats;
+
+void get_tls_handshake_pool_stats(tls_handshake_pool_stats *st);
+
+////////// Relay thread load ////////////////
+
+const char *relay_placement_name(RELAY_PLACEMENT placement);
+
+/* Fills in up to `max` relay threads' live session counts, smoothed byte
+ * rates and smoothed CPU time (thousandths of a core); returns the number of
+ * threads. */
+size_t get_relay_threads_load(uint32_t *sessions, uint32_t *bps, uint32_t *cpu, size_t max);
+
+typedef struct _relay_queue_stats {
+  uint32_t depth; /* messages from other threads */
+  uint32_t high_water;
+  uint32_t auth_depth; /* answers from the auth threads */
+  uint32_t auth_high_water;
+} relay_queue_stats;
+
+/* Fills in up to `max` relay threads' queue depths; returns the number of
+ * threads. */
+size_t get_relay_threads_queues(relay_queue_stats *st, size_t max);
+
+/* Asks the relay thread that owns session `sid` to move it to relay thread
+ * `to`. Returns -1 if either thread does not exist; the move itself is
+ * refused, and logged, when the session cannot leave its thread. */
+int send_session_migration_to_relay(turnsession_id sid, turnserver_id to);
+
 ////////// BPS ////////////////
 
 band_limit_t get_bps_capacity_allocated(void);
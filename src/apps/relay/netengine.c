@@ -34,6 +34,7 @@
 
 #include "mainrelay.h"
 #include <errno.h>
+#include <time.h>
 
 #include "ns_turn_ioalib.h"
 #include "prom_server.h"
@@ -120,8 +121,7 @@ typedef unsigned char authserver_id;
 struct auth_server {
   authserver_id id;
   struct event_base *event_base;
-  struct bufferevent *in_buf;
-  struct bufferevent *out_buf;
+  relay_queue *queue;
   pthread_t thr;
   redis_context_handle rch;
 };
@@ -500,10 +500,35 @@ static struct relay_server *get_relay_server(turnserver_id id) {
   return rs;
 }
 
+static relay_queue *create_thread_queue(struct event_base *base, relay_queue_cb cb, void *arg) {
+  relay_queue *q = relay_queue_new(base, RELAY_QUEUE_SIZE_DEFAULT, cb, arg);
+  if (!q) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: Cannot create inter-thread message queue\n", __FUNCTION__);
+    exit(-1);
+  }
+  return q;
+}
+
+/* Queues a copy of `sm`; the relay thread frees it. */
+static int post_message_to_relay(struct relay_server *rdest, const struct message_to_relay *sm) {
+  struct message_to_relay *msg = NULL;
+  if (rdest) {
+    msg = (struct message_to_relay *)malloc(sizeof(struct message_to_relay));
+  }
+  if (msg) {
+    memcpy(msg, sm, sizeof(struct message_to_relay));
+    if (relay_queue_push(rdest->queue, msg) >= 0) {
+      return 0;
+    }
+    free(msg);
+  }
+  TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: Cannot add message to relay queue\n", __FUNCTION__);
+  return -1;
+}
+
 static turn_atomic_u32 auth_message_counter = 0;
 
 static void send_auth_message_to_relay(struct auth_message *am) {
-  struct evbuffer *output = NULL;
   struct relay_server *relay_server = NULL;
 
   if (am) {
@@ -511,15 +536,14 @@ static void send_auth_message_to_relay(struct auth_message *am) {
   }
 
   if (relay_server) {
-    output = bufferevent_get_output(relay_server->auth_out_buf);
+    if (relay_queue_push(relay_server->auth_queue, am) >= 0) {
+      return;
+    }
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: Cannot add message to relay auth queue\n", __FUNCTION__);
   } else if (am) {
     TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: can't find relay for turn_server_id: %d\n", __FUNCTION__, (int)am->id);
   }
 
-  if (output && evbuffer_add(output, &am, sizeof(am)) >= 0) {
-    return;
-  }
-
   if (am) {
     ioa_network_buffer_delete(NULL, am->in_buffer.nbh);
     free(am);
@@ -546,67 +570,287 @@ void send_auth_message_to_auth_server(struct auth_message *am) {
   const authserver_id sn =
       (authserver_id)(turn_atomic_fetch_add_u32(&auth_message_counter, 1) % (authserver_number - 1)) + 1;
 
-  struct evbuffer *output = bufferevent_get_output(authserver[sn].out_buf);
-  if (evbuffer_add(output, &am, sizeof(am)) < 0) {
-    fprintf(stderr, "%s: Weird buffer error\n", __FUNCTION__);
+  if (relay_queue_push(authserver[sn].queue, am) < 0) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: Cannot add message to auth queue\n", __FUNCTION__);
     ioa_network_buffer_delete(NULL, am->in_buffer.nbh);
     free(am);
   }
 }
 
-static void auth_server_receive_message(struct bufferevent *bev, void *ptr) {
-  UNUSED_ARG(ptr);
+static void auth_server_receive_message(void *msg, void *arg) {
+  struct auth_server *as = (struct auth_server *)arg;
+  struct auth_message *am = (struct auth_message *)msg;
+
+  if (as && start_user_key_async(as->event_base, am, send_auth_message_to_relay)) {
+    return;
+  }
+
+  if (get_user_key(am->in_oauth, &(am->out_oauth), &(am->max_session_time), am->username, am->realm, am->key,
+                   am->in_buffer.nbh) < 0) {
+    am->success = 0;
+  } else {
+    am->success = 1;
+  }
+
+  send_auth_message_to_relay(am);
+}
+
+////////////// Relay thread placement ////////////////
 
-  struct auth_message *am = NULL;
-  int n = 0;
-  struct evbuffer *input = bufferevent_get_input(bev);
+const char *relay_placement_name(RELAY_PLACEMENT placement) {
+  switch (placement) {
+  case RELAY_PLACEMENT_LEAST_LOADED:
+    return "least-loaded";
+  case RELAY_PLACEMENT_TWO_CHOICES:
+    return "two-choices";
+  default:
+    return "listener";
+  }
+}
 
-  while ((n = evbuffer_remove(input, &am, sizeof(am))) > 0) {
-    if (n != sizeof(am)) {
-      fprintf(stderr, "%s: Weird buffer error: size=%d\n", __FUNCTION__, n);
-      continue;
+/* Live sessions plus the connections already on their way to the thread, so
+ * that a burst of accepts does not all land on the same idle thread. */
+static uint32_t relay_server_sessions(struct relay_server *rs) {
+  return turn_atomic_load_u32(&(rs->server.load_sessions)) + turn_atomic_load_u32(&(rs->placed));
+}
+
+/* A thread's load relative to the average thread: sessions and byte rate,
+ * each divided by its mean, weigh the same. */
+static double relay_server_load(struct relay_server *rs, double mean_sessions, double mean_bps) {
+  return relay_server_sessions(rs) / mean_sessions + turn_atomic_load_u32(&(rs->server.load_bps)) / mean_bps;
+}
+
+static struct relay_server *place_socket_on_relay(struct relay_server *rdest) {
+  const size_t n = get_real_general_relay_servers_number();
+  if ((turn_params.relay_placement == RELAY_PLACEMENT_LISTENER) || (n < 2) || !rdest) {
+    return rdest;
+  }
+
+  double mean_sessions = 0;
+  double mean_bps = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (general_relay_servers[i]) {
+      mean_sessions += relay_server_sessions(general_relay_servers[i]);
+      mean_bps += turn_atomic_load_u32(&(general_relay_servers[i]->server.load_bps));
     }
+  }
+  mean_sessions = (mean_sessions + 1) / n;
+  mean_bps = (mean_bps + 1) / n;
 
-    if (get_user_key(am->in_oauth, &(am->out_oauth), &(am->max_session_time), am->username, am->realm, am->key,
-                     am->in_buffer.nbh) < 0) {
-      am->success = 0;
-    } else {
-      am->success = 1;
+  /* Ties keep the accepting thread: no cross-thread handoff. */
+  struct relay_server *best = rdest;
+  double best_load = relay_server_load(rdest, mean_sessions, mean_bps);
+
+  if (turn_params.relay_placement == RELAY_PLACEMENT_TWO_CHOICES) {
+    /* The kernel already spread the accepts over the listeners, so the
+     * accepting thread is the first random choice. */
+    struct relay_server *rs = general_relay_servers[(size_t)turn_random_number() % n];
+    if (rs && (relay_server_load(rs, mean_sessions, mean_bps) < best_load)) {
+      best = rs;
     }
+  } else {
+    for (size_t i = 0; i < n; i++) {
+      struct relay_server *rs = general_relay_servers[i];
+      if (rs && (rs != rdest)) {
+        const double load = relay_server_load(rs, mean_sessions, mean_bps);
+        if (load < best_load) {
+          best = rs;
+          best_load = load;
+        }
+      }
+    }
+  }
 
-    send_auth_message_to_relay(am);
+  return best;
+}
+
+size_t get_relay_threads_load(uint32_t *sessions, uint32_t *bps, uint32_t *cpu, size_t max) {
+  size_t n = get_real_general_relay_servers_number();
+  if (n > max) {
+    n = max;
   }
+  for (size_t i = 0; i < n; i++) {
+    struct relay_server *rs = general_relay_servers[i];
+    sessions[i] = rs ? turn_atomic_load_u32(&(rs->server.load_sessions)) : 0;
+    bps[i] = rs ? turn_atomic_load_u32(&(rs->server.load_bps)) : 0;
+    cpu[i] = rs ? turn_atomic_load_u32(&(rs->load_cpu)) : 0;
+  }
+  return n;
 }
 
-static int send_socket_to_general_relay(ioa_engine_handle e, struct message_to_relay *sm) {
-  struct relay_server *rdest = sm->relay_server;
+size_t get_relay_threads_queues(relay_queue_stats *st, size_t max) {
+  size_t n = get_real_general_relay_servers_number();
+  if (n > max) {
+    n = max;
+  }
+  for (size_t i = 0; i < n; i++) {
+    struct relay_server *rs = general_relay_servers[i];
+    st[i].depth = rs ? relay_queue_depth(rs->queue) : 0;
+    st[i].high_water = rs ? relay_queue_high_water(rs->queue) : 0;
+    st[i].auth_depth = rs ? relay_queue_depth(rs->auth_queue) : 0;
+    st[i].auth_high_water = rs ? relay_queue_high_water(rs->auth_queue) : 0;
+  }
+  return n;
+}
 
-  if (!rdest) {
-    const size_t dest = (hash_int32(addr_get_port(&(sm->m.sm.nd.src_addr)))) % get_real_general_relay_servers_number();
-    rdest = general_relay_servers[dest];
+////////////// Session migration ////////////////
+
+/* Ticks a thread must stay the busiest before it gives a session away; the
+ * smoothed CPU and byte rates need about as long to show the move. */
+#define RELAY_REBALANCE_TICKS (5)
+
+int send_session_migration_to_relay(turnsession_id sid, turnserver_id to) {
+  const turnserver_id from = (turnserver_id)(sid / TURN_SESSION_ID_FACTOR);
+  if ((from == to) || (to >= get_real_general_relay_servers_number())) {
+    return -1;
+  }
+
+  struct relay_server *rs = get_relay_server(from);
+  if (!rs) {
+    return -1;
+  }
+
+  struct message_to_relay sm;
+  memset(&sm, 0, sizeof(struct message_to_relay));
+  sm.t = RMT_MIGRATE_SESSION;
+  sm.relay_server = rs;
+  sm.m.msm.id = sid;
+  sm.m.msm.to = to;
+
+  return post_message_to_relay(rs, &sm);
+}
+
+/* Runs on rs's thread: detaches the session and hands it to rdest. */
+static void migrate_session(struct relay_server *rs, turnsession_id sid, struct relay_server *rdest) {
+  ts_ur_super_session *ss = (rdest && (rdest != rs)) ? turn_detach_session(&(rs->server), sid) : NULL;
+  if (!ss) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_INFO, "session %018llu: cannot move to another relay thread now\n",
+                  (unsigned long long)sid);
+    prom_inc_session_migration(false);
+    return;
+  }
+
+  struct message_to_relay sm;
+  memset(&sm, 0, sizeof(struct message_to_relay));
+  sm.t = RMT_ADOPT_SESSION;
+  sm.relay_server = rdest;
+  sm.m.msm.id = sid;
+  sm.m.msm.ss = ss;
+
+  if (post_message_to_relay(rdest, &sm) < 0) {
+    turn_attach_session(&(rs->server), ss);
+    prom_inc_session_migration(false);
+    return;
+  }
+
+  TURN_LOG_FUNC(TURN_LOG_LEVEL_INFO, "session %018llu: moving from relay thread %d to %d\n", (unsigned long long)sid,
+                (int)rs->id, (int)rdest->id);
+  prom_inc_session_migration(true);
+}
+
+static uint64_t relay_clock_us(clockid_t clock) {
+  struct timespec ts;
+  if (clock_gettime(clock, &ts) < 0) {
+    return 0;
+  }
+  return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+/* Runs on rs's own thread, which is the only one whose CPU clock it can read. */
+static void relay_sample_cpu(struct relay_server *rs) {
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+  const uint64_t cpu_us = relay_clock_us(CLOCK_THREAD_CPUTIME_ID);
+  const uint64_t wall_us = relay_clock_us(CLOCK_MONOTONIC);
+  if (rs->wall_us_sampled && (wall_us > rs->wall_us_sampled)) {
+    const uint64_t permille = (cpu_us - rs->cpu_us_sampled) * 1000 / (wall_us - rs->wall_us_sampled);
+    const uint64_t old = turn_atomic_load_u32(&(rs->load_cpu));
+    turn_atomic_store_u32(&(rs->load_cpu), (uint32_t)((old * 3 + permille) / 4));
+  }
+  rs->cpu_us_sampled = cpu_us;
+  rs->wall_us_sampled = wall_us;
+#else
+  UNUSED_ARG(rs);
+#endif
+}
+
+/* Only the busiest thread acts: once it has stayed more than
+ * --relay-rebalance percent of a core above the idlest thread for
+ * RELAY_REBALANCE_TICKS seconds, it moves the session that best covers half
+ * the gap there. A session's share of the thread's bytes stands in for its
+ * share of the CPU. */
+static void relay_rebalance(struct relay_server *rs) {
+  const size_t n = get_real_general_relay_servers_number();
+  if (!turn_params.relay_rebalance || (n < 2)) {
+    return;
+  }
+
+  const uint32_t cpu = turn_atomic_load_u32(&(rs->load_cpu));
+  struct relay_server *idlest = NULL;
+  uint32_t idlest_cpu = cpu;
+  for (size_t i = 0; i < n; i++) {
+    struct relay_server *other = general_relay_servers[i];
+    if (!other || (other == rs)) {
+      continue;
+    }
+    const uint32_t other_cpu = turn_atomic_load_u32(&(other->load_cpu));
+    if (other_cpu > cpu) {
+      rs->imbalance_ticks = 0;
+      return;
+    }
+    if (other_cpu < idlest_cpu) {
+      idlest = other;
+      idlest_cpu = other_cpu;
+    }
+  }
+
+  if (!idlest || (cpu - idlest_cpu <= turn_params.relay_rebalance * 10)) {
+    rs->imbalance_ticks = 0;
+    return;
+  }
+  if (++(rs->imbalance_ticks) < RELAY_REBALANCE_TICKS) {
+    return;
   }
+  rs->imbalance_ticks = 0;
 
+  const uint64_t max_bps = (uint64_t)turn_atomic_load_u32(&(rs->server.load_bps)) * (cpu - idlest_cpu) / (2 * cpu);
+  const turnsession_id sid = turn_pick_session_to_migrate(&(rs->server), max_bps);
+  if (sid) {
+    migrate_session(rs, sid, idlest);
+  }
+}
+
+static void relay_load_timer_handler(ioa_engine_handle e, void *arg) {
+  UNUSED_ARG(e);
+  struct relay_server *rs = (struct relay_server *)arg;
+  relay_sample_cpu(rs);
+  prom_set_relay_thread_load((unsigned int)rs->id, turn_atomic_load_u32(&(rs->server.load_sessions)),
+                             turn_atomic_load_u32(&(rs->server.load_bps)), turn_atomic_load_u32(&(rs->load_cpu)));
+  prom_set_relay_thread_queue((unsigned int)rs->id, "relay", relay_queue_depth(rs->queue),
+                              relay_queue_high_water(rs->queue));
+  prom_set_relay_thread_queue((unsigned int)rs->id, "auth", relay_queue_depth(rs->auth_queue),
+                              relay_queue_high_water(rs->auth_queue));
+  relay_rebalance(rs);
+}
+
+static int post_socket_to_relay(ioa_engine_handle e, struct relay_server *rdest, struct message_to_relay *sm) {
   struct message_to_relay *smptr = sm;
 
+  rdest = place_socket_on_relay(rdest);
+
   smptr->t = RMT_SOCKET;
 
-  struct evbuffer *output = NULL;
   int success = 0;
 
   if (!rdest) {
     goto label_end;
   }
 
-  output = bufferevent_get_output(rdest->out_buf);
-
-  if (output) {
-
-    if (evbuffer_add(output, smptr, sizeof(struct message_to_relay)) < 0) {
-      TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: Cannot add message to relay output buffer\n", __FUNCTION__);
-    } else {
-      success = 1;
-      smptr->m.sm.nd.nbh = NULL;
-    }
+  turn_atomic_fetch_add_u32(&(rdest->placed), 1);
+  if (post_message_to_relay(rdest, smptr) < 0) {
+    turn_atomic_fetch_add_u32(&(rdest->placed), (uint32_t)-1);
+  } else {
+    success = 1;
+    smptr->m.sm.nd.nbh = NULL;
   }
 
 label_end:
@@ -621,6 +865,141 @@ label_end:
   return 0;
 }
 
+////////////// TLS handshake threads ////////////////
+
+struct handshake_server {
+  unsigned int id;
+  super_memory_t *sm;
+  struct event_base *event_base;
+  ioa_engine_handle ioa_eng;
+  relay_queue *queue;
+  pthread_t thr;
+};
+
+/* A new client connection on its way through a handshake thread. The relay
+ * thread it ends up on is chosen up front, in sm.relay_server. */
+struct handshake_message {
+  struct message_to_relay sm;
+  uint64_t queued_us;
+};
+
+static struct handshake_server *handshake_servers[MAX_NUMBER_OF_TLS_HANDSHAKE_THREADS];
+static unsigned int handshake_servers_number = 0;
+static turn_atomic_u32 handshake_message_counter = 0;
+
+static tls_handshake_pool_stats handshake_stats;
+static TURN_MUTEX_DECLARE(handshake_stats_mutex)
+
+static uint64_t handshake_clock_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+static void handshake_server_done(ioa_socket_handle s, int result, void *arg) {
+  struct handshake_message *hm = (struct handshake_message *)arg;
+  const uint64_t latency_us = handshake_clock_us() - hm->queued_us;
+
+  TURN_MUTEX_LOCK(&handshake_stats_mutex);
+  --handshake_stats.queued;
+  if (result > 0) {
+    ++handshake_stats.tls;
+  } else if (result == 0) {
+    ++handshake_stats.plain;
+  } else {
+    ++handshake_stats.failed;
+  }
+  handshake_stats.latency_us += latency_us;
+  if (latency_us > handshake_stats.max_latency_us) {
+    handshake_stats.max_latency_us = latency_us;
+  }
+  TURN_MUTEX_UNLOCK(&handshake_stats_mutex);
+
+  prom_tls_handshake_pool_done((result > 0) ? "tls" : ((result == 0) ? "plain" : "failed"), latency_us / 1000000.0);
+
+  if (result < 0) {
+    IOA_CLOSE_SOCKET(s);
+  } else {
+    post_socket_to_relay(s->e, hm->sm.relay_server, &(hm->sm));
+  }
+  free(hm);
+}
+
+static void handshake_server_receive_message(void *msg, void *arg) {
+  struct handshake_server *hs = (struct handshake_server *)arg;
+  struct handshake_message *hm = (struct handshake_message *)msg;
+
+  if (ioa_socket_tls_handshake(hs->ioa_eng, hm->sm.m.sm.s, TURN_MAX_ALLOCATE_TIMEOUT, handshake_server_done, hm) < 0) {
+    /* Nothing to do here; the relay thread takes the socket as it is. */
+    handshake_server_done(hm->sm.m.sm.s, 0, hm);
+  }
+}
+
+/* Routes a new TLS (or not yet classified TCP/TLS) client connection through
+ * a handshake thread. Returns false if the pool is off or the socket is not a
+ * candidate; the caller then posts it to the relay thread directly. */
+static bool post_socket_to_handshake_server(struct relay_server *rdest, struct message_to_relay *sm) {
+  ioa_socket_handle s = sm->m.sm.s;
+
+  if (!handshake_servers_number || !rdest || !s || s->ssl || (s->sat != CLIENT_SOCKET) || sm->m.sm.nd.nbh ||
+      ((s->st != TENTATIVE_TCP_SOCKET) && (s->st != TLS_SOCKET))) {
+    return false;
+  }
+
+  struct handshake_message *hm = (struct handshake_message *)malloc(sizeof(struct handshake_message));
+  if (!hm) {
+    return false;
+  }
+  hm->sm = *sm;
+  hm->sm.relay_server = rdest;
+  hm->queued_us = handshake_clock_us();
+
+  TURN_MUTEX_LOCK(&handshake_stats_mutex);
+  ++handshake_stats.queued;
+  TURN_MUTEX_UNLOCK(&handshake_stats_mutex);
+
+  const unsigned int id = turn_atomic_fetch_add_u32(&handshake_message_counter, 1) % handshake_servers_number;
+  if (relay_queue_push(handshake_servers[id]->queue, hm) < 0) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: Cannot add message to handshake thread queue\n", __FUNCTION__);
+    TURN_MUTEX_LOCK(&handshake_stats_mutex);
+    --handshake_stats.queued;
+    TURN_MUTEX_UNLOCK(&handshake_stats_mutex);
+    free(hm);
+    return false;
+  }
+  prom_tls_handshake_pool_queued();
+
+  return true;
+}
+
+void get_tls_handshake_pool_stats(tls_handshake_pool_stats *st) {
+  if (!st) {
+    return;
+  }
+  memset(st, 0, sizeof(tls_handshake_pool_stats));
+  if (handshake_servers_number) {
+    TURN_MUTEX_LOCK(&handshake_stats_mutex);
+    *st = handshake_stats;
+    TURN_MUTEX_UNLOCK(&handshake_stats_mutex);
+    st->threads = handshake_servers_number;
+  }
+}
+
+static int send_socket_to_general_relay(ioa_engine_handle e, struct message_to_relay *sm) {
+  struct relay_server *rdest = sm->relay_server;
+
+  if (!rdest) {
+    const size_t dest = (hash_int32(addr_get_port(&(sm->m.sm.nd.src_addr)))) % get_real_general_relay_servers_number();
+    rdest = general_relay_servers[dest];
+  }
+
+  if (post_socket_to_handshake_server(rdest, sm)) {
+    return 0;
+  }
+
+  return post_socket_to_relay(e, rdest, sm);
+}
+
 static int send_socket_to_relay(turnserver_id id, uint64_t cid, stun_tid *tid, ioa_socket_handle s,
                                 int message_integrity, MESSAGE_TO_RELAY_TYPE rmt, ioa_net_data *nd, int can_resume) {
   int ret = -1;
@@ -686,12 +1065,7 @@ static int send_socket_to_relay(turnserver_id id, uint64_t cid, stun_tid *tid, i
   }
 
   if (ret == 0) {
-
-    struct evbuffer *output = bufferevent_get_output(rs->out_buf);
-    if (output) {
-      evbuffer_add(output, &sm, sizeof(struct message_to_relay));
-    } else {
-      TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: Empty output buffer\n", __FUNCTION__);
+    if (post_message_to_relay(rs, &sm) < 0) {
       ret = -1;
       s_to_delete = s;
     }
@@ -737,15 +1111,7 @@ int send_session_cancellation_to_relay(turnsession_id sid) {
   sm.relay_server = rs;
   sm.m.csm.id = sid;
 
-  {
-    struct evbuffer *output = bufferevent_get_output(rs->out_buf);
-    if (output) {
-      evbuffer_add(output, &sm, sizeof(struct message_to_relay));
-    } else {
-      TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: Empty output buffer\n", __FUNCTION__);
-      ret = -1;
-    }
-  }
+  ret = post_message_to_relay(rs, &sm);
 
 err:
   return ret;
@@ -759,6 +1125,12 @@ static int handle_relay_message(relay_server_handle rs, struct message_to_relay
     case RMT_CANCEL_SESSION: {
       turn_cancel_session(&(rs->server), sm->m.csm.id);
     } break;
+    case RMT_MIGRATE_SESSION: {
+      migrate_session(rs, sm->m.msm.id, get_relay_server(sm->m.msm.to));
+    } break;
+    case RMT_ADOPT_SESSION: {
+      turn_attach_session(&(rs->server), sm->m.msm.ss);
+    } break;
     case RMT_SOCKET: {
 
       if (sm->m.sm.s->defer_nbh) {
@@ -787,6 +1159,8 @@ static int handle_relay_message(relay_server_handle rs, struct message_to_relay
           sm->m.sm.s = NULL;
         }
       }
+      /* The session, if any, is in load_sessions now. */
+      turn_atomic_fetch_add_u32(&(rs->placed), (uint32_t)-1);
 
       ioa_network_buffer_delete(rs->ioa_eng, sm->m.sm.nd.nbh);
       sm->m.sm.nd.nbh = NULL;
@@ -849,149 +1223,125 @@ static void handle_relay_auth_message(struct relay_server *rs, struct auth_messa
   }
 }
 
-static void relay_receive_message(struct bufferevent *bev, void *ptr) {
-  struct message_to_relay sm;
-  int n = 0;
-  struct evbuffer *input = bufferevent_get_input(bev);
-  struct relay_server *rs = (struct relay_server *)ptr;
-
-  while ((n = evbuffer_remove(input, &sm, sizeof(struct message_to_relay))) > 0) {
-
-    if (n != sizeof(struct message_to_relay)) {
-      TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Weird buffer error: %s\n", strerror(errno));
-      continue;
-    }
-
-    handle_relay_message(rs, &sm);
-  }
+static void relay_receive_message(void *msg, void *arg) {
+  struct message_to_relay *sm = (struct message_to_relay *)msg;
+  handle_relay_message((struct relay_server *)arg, sm);
+  free(sm);
 }
 
-static void relay_receive_auth_message(struct bufferevent *bev, void *ptr) {
-  struct auth_message *am = NULL;
-  int n = 0;
-  struct evbuffer *input = bufferevent_get_input(bev);
-  struct relay_server *rs = (struct relay_server *)ptr;
-
-  while ((n = evbuffer_remove(input, &am, sizeof(am))) > 0) {
-
-    if (n != sizeof(am)) {
-      TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Weird auth_buffer error: %s\n", strerror(errno));
-      continue;
-    }
-
-    handle_relay_auth_message(rs, am);
-    free(am);
-  }
+static void relay_receive_auth_message(void *msg, void *arg) {
+  struct auth_message *am = (struct auth_message *)msg;
+  handle_relay_auth_message((struct relay_server *)arg, am);
+  free(am);
 }
 
 static int send_message_from_listener_to_client(ioa_engine_handle e, ioa_network_buffer_handle nbh, ioa_addr *origin,
                                                 ioa_addr *destination) {
 
-  struct message_to_listener mm;
-  mm.t = LMT_TO_CLIENT;
-  addr_cpy(&(mm.m.tc.origin), origin);
-  addr_cpy(&(mm.m.tc.destination), destination);
-  mm.m.tc.nbh = ioa_network_buffer_allocate(e);
-  ioa_network_buffer_header_init(mm.m.tc.nbh);
-  memcpy(ioa_network_buffer_data(mm.m.tc.nbh), ioa_network_buffer_data(nbh), ioa_network_buffer_get_size(nbh));
-  ioa_network_buffer_set_size(mm.m.tc.nbh, ioa_network_buffer_get_size(nbh));
-
-  struct evbuffer *output = bufferevent_get_output(turn_params.listener.out_buf);
-
-  evbuffer_add(output, &mm, sizeof(struct message_to_listener));
+  struct message_to_listener *mm = (struct message_to_listener *)malloc(sizeof(struct message_to_listener));
+  if (!mm) {
+    return -1;
+  }
+  mm->t = LMT_TO_CLIENT;
+  addr_cpy(&(mm->m.tc.origin), origin);
+  addr_cpy(&(mm->m.tc.destination), destination);
+  mm->m.tc.nbh = ioa_network_buffer_allocate(e);
+  ioa_network_buffer_header_init(mm->m.tc.nbh);
+  memcpy(ioa_network_buffer_data(mm->m.tc.nbh), ioa_network_buffer_data(nbh), ioa_network_buffer_get_size(nbh));
+  ioa_network_buffer_set_size(mm->m.tc.nbh, ioa_network_buffer_get_size(nbh));
+
+  if (relay_queue_push(turn_params.listener.queue, mm) < 0) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: Cannot add message to listener queue\n", __FUNCTION__);
+    ioa_network_buffer_delete(e, mm->m.tc.nbh);
+    free(mm);
+    return -1;
+  }
 
   return 0;
 }
 
-static void listener_receive_message(struct bufferevent *bev, void *ptr) {
-  UNUSED_ARG(ptr);
-
-  struct message_to_listener mm;
-  int n = 0;
-  struct evbuffer *input = bufferevent_get_input(bev);
+static void listener_receive_message(void *msg, void *arg) {
+  UNUSED_ARG(arg);
 
-  while ((n = evbuffer_remove(input, &mm, sizeof(struct message_to_listener))) > 0) {
-    if (n != sizeof(struct message_to_listener)) {
-      TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Weird buffer error: %s\n", strerror(errno));
-      continue;
-    }
+  struct message_to_listener mm = *(struct message_to_listener *)msg;
+  free(msg);
 
-    if (mm.t != LMT_TO_CLIENT) {
-      TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Weird buffer type: %s\n", strerror(errno));
-      continue;
-    }
+  if (mm.t != LMT_TO_CLIENT) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Weird buffer type: %s\n", strerror(errno));
+    return;
+  }
 
-    size_t relay_thread_index = 0;
+  size_t relay_thread_index = 0;
 
-    {
-      size_t ri;
-      for (ri = 0; ri < get_real_general_relay_servers_number(); ri++) {
-        if (!(general_relay_servers[ri])) {
-          TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: Wrong general relay number: %d, total %d\n", __FUNCTION__, (int)ri,
-                        (int)get_real_general_relay_servers_number());
-        } else if (pthread_equal(general_relay_servers[ri]->thr, pthread_self())) {
-          relay_thread_index = ri;
-          break;
-        }
+  {
+    size_t ri;
+    for (ri = 0; ri < get_real_general_relay_servers_number(); ri++) {
+      if (!(general_relay_servers[ri])) {
+        TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: Wrong general relay number: %d, total %d\n", __FUNCTION__, (int)ri,
+                      (int)get_real_general_relay_servers_number());
+      } else if (pthread_equal(general_relay_servers[ri]->thr, pthread_self())) {
+        relay_thread_index = ri;
+        break;
       }
     }
+  }
 
-    size_t i;
-    int found = 0;
-    for (i = 0; i < turn_params.listener.addrs_number; i++) {
-      if (addr_eq_no_port(turn_params.listener.encaddrs[i], &mm.m.tc.origin)) {
-        const uint16_t o_port = addr_get_port(&mm.m.tc.origin);
-        if (turn_params.listener.addrs_number == turn_params.listener.services_number) {
-          if (o_port == turn_params.listener_port) {
-            if (turn_params.listener.udp_services && turn_params.listener.udp_services[i] &&
-                turn_params.listener.udp_services[i][relay_thread_index]) {
-              found = 1;
-              udp_send_message(turn_params.listener.udp_services[i][relay_thread_index], mm.m.tc.nbh,
-                               &mm.m.tc.destination);
-            }
-          } else {
-            TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: Wrong origin port(1): %hu\n", __FUNCTION__, o_port);
+  size_t i;
+  int found = 0;
+  for (i = 0; i < turn_params.listener.addrs_number; i++) {
+    if (addr_eq_no_port(turn_params.listener.encaddrs[i], &mm.m.tc.origin)) {
+      const uint16_t o_port = addr_get_port(&mm.m.tc.origin);
+      if (turn_params.listener.addrs_number == turn_params.listener.services_number) {
+        if (o_port == turn_params.listener_port) {
+          if (turn_params.listener.udp_services && turn_params.listener.udp_services[i] &&
+              turn_params.listener.udp_services[i][relay_thread_index]) {
+            found = 1;
+            udp_send_message(turn_params.listener.udp_services[i][relay_thread_index], mm.m.tc.nbh,
+                             &mm.m.tc.destination);
           }
-        } else if ((turn_params.listener.addrs_number * 2) == turn_params.listener.services_number) {
-          if (o_port == turn_params.listener_port) {
-            if (turn_params.listener.udp_services && turn_params.listener.udp_services[i * 2] &&
-                turn_params.listener.udp_services[i * 2][relay_thread_index]) {
-              found = 1;
-              udp_send_message(turn_params.listener.udp_services[i * 2][relay_thread_index], mm.m.tc.nbh,
-                               &mm.m.tc.destination);
-            }
-          } else if (o_port == get_alt_listener_port()) {
-            if (turn_params.listener.udp_services && turn_params.listener.udp_services[i * 2 + 1] &&
-                turn_params.listener.udp_services[i * 2 + 1][relay_thread_index]) {
-              found = 1;
-              udp_send_message(turn_params.listener.udp_services[i * 2 + 1][relay_thread_index], mm.m.tc.nbh,
-                               &mm.m.tc.destination);
-            }
-          } else {
-            TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: Wrong origin port(2): %hu\n", __FUNCTION__, o_port);
+        } else {
+          TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: Wrong origin port(1): %hu\n", __FUNCTION__, o_port);
+        }
+      } else if ((turn_params.listener.addrs_number * 2) == turn_params.listener.services_number) {
+        if (o_port == turn_params.listener_port) {
+          if (turn_params.listener.udp_services && turn_params.listener.udp_services[i * 2] &&
+              turn_params.listener.udp_services[i * 2][relay_thread_index]) {
+            found = 1;
+            udp_send_message(turn_params.listener.udp_services[i * 2][relay_thread_index], mm.m.tc.nbh,
+                             &mm.m.tc.destination);
+          }
+        } else if (o_port == get_alt_listener_port()) {
+          if (turn_params.listener.udp_services && turn_params.listener.udp_services[i * 2 + 1] &&
+              turn_params.listener.udp_services[i * 2 + 1][relay_thread_index]) {
+            found = 1;
+            udp_send_message(turn_params.listener.udp_services[i * 2 + 1][relay_thread_index], mm.m.tc.nbh,
+                             &mm.m.tc.destination);
           }
         } else {
-          TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: Wrong listener setup\n", __FUNCTION__);
+          TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: Wrong origin port(2): %hu\n", __FUNCTION__, o_port);
         }
-        break;
+      } else {
+        TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: Wrong listener setup\n", __FUNCTION__);
       }
+      break;
     }
+  }
 
-    if (!found) {
-      char saddr[MAX_IOA_ADDR_STRING];
-      addr_to_string(&mm.m.tc.origin, saddr);
-      TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: Cannot find local source %s\n", __FUNCTION__, saddr);
-    }
-
-    ioa_network_buffer_delete(turn_params.listener.ioa_eng, mm.m.tc.nbh);
-    mm.m.tc.nbh = NULL;
+  if (!found) {
+    char saddr[MAX_IOA_ADDR_STRING];
+    addr_to_string(&mm.m.tc.origin, saddr);
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: Cannot find local source %s\n", __FUNCTION__, saddr);
   }
+
+  ioa_network_buffer_delete(turn_params.listener.ioa_eng, mm.m.tc.nbh);
+  mm.m.tc.nbh = NULL;
 }
 
 static void setup_listener(void) {
   super_memory_t *sm = new_super_memory_region();
 
-  turn_params.listener.tp = turnipports_create(sm, turn_params.min_port, turn_params.max_port);
+  const size_t port_shards = turn_params.sharded_relay_ports ? (size_t)get_real_general_relay_servers_number() : 1;
+  turn_params.listener.tp = turnipports_create(sm, turn_params.min_port, turn_params.max_port, port_shards);
 
   turn_params.listener.event_base = turn_event_base_new();
 
@@ -1014,15 +1364,8 @@ static void setup_listener(void) {
   turn_params.listener.rtcpmap = rtcp_map_create(turn_params.listener.ioa_eng);
   ioa_engine_set_rtcp_map(turn_params.listener.ioa_eng, turn_params.listener.rtcpmap);
 
-  {
-    struct bufferevent *pair[2];
-
-    bufferevent_pair_new(turn_params.listener.event_base, TURN_BUFFEREVENTS_OPTIONS, pair);
-    turn_params.listener.in_buf = pair[0];
-    turn_params.listener.out_buf = pair[1];
-    bufferevent_setcb(turn_params.listener.in_buf, listener_receive_message, NULL, NULL, &turn_params.listener);
-    bufferevent_enable(turn_params.listener.in_buf, EV_READ);
-  }
+  turn_params.listener.queue =
+      create_thread_queue(turn_params.listener.event_base, listener_receive_message, &turn_params.listener);
 
   if (turn_params.rfc5780 == true) {
     if (turn_params.listener.addrs_number < 2 || turn_params.external_ip) {
@@ -1333,8 +1676,6 @@ void run_listener_server(struct listener_server *ls) {
 }
 
 static void setup_relay_server(struct relay_server *rs, ioa_engine_handle e, int to_set_rfc5780) {
-  struct bufferevent *pair[2];
-
   if (e) {
     rs->event_base = e->event_base;
     rs->ioa_eng = e;
@@ -1353,19 +1694,11 @@ static void setup_relay_server(struct relay_server *rs, ioa_engine_handle e, int
     }
     set_ssl_ctx(rs->ioa_eng, &turn_params);
     ioa_engine_set_rtcp_map(rs->ioa_eng, turn_params.listener.rtcpmap);
+    ioa_engine_set_port_shard(rs->ioa_eng, (int)rs->id);
   }
 
-  bufferevent_pair_new(rs->event_base, TURN_BUFFEREVENTS_OPTIONS, pair);
-  rs->in_buf = pair[0];
-  rs->out_buf = pair[1];
-  bufferevent_setcb(rs->in_buf, relay_receive_message, NULL, NULL, rs);
-  bufferevent_enable(rs->in_buf, EV_READ);
-
-  bufferevent_pair_new(rs->event_base, TURN_BUFFEREVENTS_OPTIONS, pair);
-  rs->auth_in_buf = pair[0];
-  rs->auth_out_buf = pair[1];
-  bufferevent_setcb(rs->auth_in_buf, relay_receive_auth_message, NULL, NULL, rs);
-  bufferevent_enable(rs->auth_in_buf, EV_READ);
+  rs->queue = create_thread_queue(rs->event_base, relay_receive_message, rs);
+  rs->auth_queue = create_thread_queue(rs->event_base, relay_receive_auth_message, rs);
 
   init_turn_server(
       &(rs->server), rs->id, turn_params.verbose, rs->ioa_eng, turn_params.ct, turn_params.fingerprint,
@@ -1393,6 +1726,8 @@ static void setup_relay_server(struct relay_server *rs, ioa_engine_handle e, int
     set_rfc5780(&(rs->server), get_alt_addr, send_message_from_listener_to_client);
   }
 
+  set_ioa_timer(rs->ioa_eng, 1, 0, relay_load_timer_handler, rs, 1, "relay_load_timer_handler");
+
   setup_tcp_listener_servers(rs->ioa_eng, rs);
 
 #if defined(__linux__)
@@ -1463,6 +1798,58 @@ static void setup_general_relay_servers(void) {
   }
 }
 
+static void *run_handshake_server_thread(void *arg) {
+  struct handshake_server *hs = (struct handshake_server *)arg;
+
+  ignore_sigpipe();
+
+  while (!turn_params.stop_turn_server) {
+    run_events(hs->event_base, hs->ioa_eng);
+  }
+
+  return arg;
+}
+
+static void setup_handshake_servers(void) {
+  if (!turn_params.tls_handshake_threads || turn_params.no_tls) {
+    return;
+  }
+
+  TURN_MUTEX_INIT(&handshake_stats_mutex);
+
+  for (unsigned int i = 0; i < turn_params.tls_handshake_threads; i++) {
+    super_memory_t *sm = new_super_memory_region();
+    struct handshake_server *hs =
+        (struct handshake_server *)allocate_super_memory_region(sm, sizeof(struct handshake_server));
+    hs->id = i;
+    hs->sm = sm;
+    hs->event_base = turn_event_base_new();
+    hs->ioa_eng = create_ioa_engine(sm, hs->event_base, turn_params.listener.tp, turn_params.relay_ifname,
+                                    turn_params.relays_number, turn_params.relay_addrs, turn_params.default_relays,
+                                    turn_params.verbose
+#if !defined(TURN_NO_HIREDIS)
+                                    ,
+                                    &turn_params.redis_statsdb
+#endif
+    );
+    if (!hs->ioa_eng) {
+      exit(-1);
+    }
+    set_ssl_ctx(hs->ioa_eng, &turn_params);
+
+    hs->queue = create_thread_queue(hs->event_base, handshake_server_receive_message, hs);
+
+    if (pthread_create(&(hs->thr), NULL, run_handshake_server_thread, hs)) {
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Cannot create TLS handshake thread: %s\n", strerror(errno));
+      exit(-1);
+    }
+    handshake_servers[i] = hs;
+  }
+
+  handshake_servers_number = turn_params.tls_handshake_threads;
+  TURN_LOG_FUNC(TURN_LOG_LEVEL_INFO, "Total TLS handshake threads: %u\n", handshake_servers_number);
+}
+
 static volatile int run_auth_server_flag = 1;
 
 static void *run_auth_server_thread(void *arg) {
@@ -1503,13 +1890,7 @@ static void *run_auth_server_thread(void *arg) {
      * pthread_join. */
     as->event_base = turn_event_base_new();
 
-    struct bufferevent *pair[2];
-
-    bufferevent_pair_new(as->event_base, TURN_BUFFEREVENTS_OPTIONS, pair);
-    as->in_buf = pair[0];
-    as->out_buf = pair[1];
-    bufferevent_setcb(as->in_buf, auth_server_receive_message, NULL, NULL, as);
-    bufferevent_enable(as->in_buf, EV_READ);
+    as->queue = create_thread_queue(as->event_base, auth_server_receive_message, as);
 
 #if !defined(TURN_NO_HIREDIS)
     as->rch = get_redis_async_connection(as->event_base, &turn_params.redis_statsdb, 1);
@@ -1604,6 +1985,7 @@ void setup_server(void) {
   setup_listener();
   allocate_relay_addrs_ports();
   setup_barriers();
+  setup_handshake_servers();
   setup_general_relay_servers();
   TURN_LOG_FUNC(TURN_LOG_LEVEL_INFO, "Total relay threads: %d\n", (int)get_real_general_relay_servers_number());
 
@@ -1634,6 +2016,19 @@ void setup_server(void) {
   barrier_wait();
 }
 
+/* Runs once no thread is left to post to rs. A session on its way to another
+ * thread is owned only by its RMT_ADOPT_SESSION message, so it is ended here
+ * instead of being leaked with the queue. */
+static void drain_relay_queue(struct relay_server *rs) {
+  struct message_to_relay *sm = NULL;
+  while ((sm = (struct message_to_relay *)relay_queue_pop(rs->queue))) {
+    if (sm->t == RMT_ADOPT_SESSION) {
+      turn_release_detached_session(&(rs->server), sm->m.msm.ss);
+    }
+    free(sm);
+  }
+}
+
 void shutdown_server(void) {
   run_auth_server_flag = 0; /* turn_params.stop_turn_server is already true */
 
@@ -1657,6 +2052,9 @@ void shutdown_server(void) {
   if (adminserver.event_base) {
     event_base_loopbreak(adminserver.event_base);
   }
+  for (unsigned int i = 0; i < handshake_servers_number; i++) {
+    event_base_loopbreak(handshake_servers[i]->event_base);
+  }
 
   /* Join all worker threads so none of them can be inside an OpenSSL
    * call when main returns and OPENSSL_cleanup runs from atexit
@@ -1674,6 +2072,15 @@ void shutdown_server(void) {
     pthread_join(authserver[sn].thr, NULL);
   }
   pthread_join(adminserver.thr, NULL);
+  for (unsigned int i = 0; i < handshake_servers_number; i++) {
+    pthread_join(handshake_servers[i]->thr, NULL);
+  }
+
+  for (size_t i = 0; i < get_real_general_relay_servers_number(); i++) {
+    if (general_relay_servers[i]) {
+      drain_relay_queue(general_relay_servers[i]);
+    }
+  }
 
   TURN_LOG_FUNC(TURN_LOG_LEVEL_INFO, "All worker threads joined\n");
 }
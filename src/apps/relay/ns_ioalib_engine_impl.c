@@ -129,7 +129,8 @@ struct turn_sock_extended_err {
 #if defined(__linux__)
 struct ioa_socket_recvmmsg_state {
   struct mmsghdr msgs[MAX_SOCKET_RECVMMSG_BATCH];
-  struct iovec iovecs[MAX_SOCKET_RECVMMSG_BATCH];
+  struct iovec iovecs[MAX_SOCKET_RECVMMSG_BATCH][2];
+  uint8_t overflow[MAX_SOCKET_RECVMMSG_BATCH][IOA_NBH_RECV_OVERFLOW_SIZE];
   char cmsgs[MAX_SOCKET_RECVMMSG_BATCH][SOCKET_RECVMMSG_CMSG_ALLOC_SZ];
   ioa_addr src_addrs[MAX_SOCKET_RECVMMSG_BATCH];
   int ttls[MAX_SOCKET_RECVMMSG_BATCH];
@@ -144,6 +145,7 @@ struct ioa_socket_recvmmsg_state {
 #define MAX_UDP_GSO_DGRAM_SIZE (1472)
 
 #if defined(__linux__)
+#include <fcntl.h> /* splice(), pipe2() */
 #include <netinet/udp.h>
 #ifndef UDP_SEGMENT
 #define UDP_SEGMENT 103
@@ -155,6 +157,31 @@ struct ioa_socket_recvmmsg_state {
 
 #define SSL_MAX_RENEG_NUMBER (3)
 
+/* Most bytes one splice() moves from a TCP socket into its pipe: the default
+ * Linux pipe capacity, so the pipe never has to be resized. */
+#define IOA_SPLICE_CHUNK (65536)
+
+#if defined(__linux__)
+/* One direction of a spliced RFC 6062 socket pair: src -> pipe -> dst. */
+typedef struct _ioa_splice_dir {
+  ioa_socket_handle src;
+  ioa_socket_handle dst;
+  int pipe_fds[2];
+  size_t pipe_bytes;      /* read from src, not yet written to dst */
+  struct event *read_ev;  /* src readable; removed while pipe_bytes > 0 */
+  struct event *write_ev; /* dst writable; added while pipe_bytes > 0 */
+} ioa_splice_dir;
+#endif
+
+struct _ioa_splice {
+#if defined(__linux__)
+  ioa_splice_dir dirs[2];
+#endif
+  ioa_splice_event_handler cb;
+  void *ctx;
+  bool active;
+};
+
 const int predef_timer_intervals[PREDEF_TIMERS_NUM] = {30,  60,  90,  120, 240, 300,  360,
                                                        540, 600, 700, 800, 900, 1800, 3600};
 
@@ -175,6 +202,12 @@ static void close_socket_net_data(ioa_socket_handle s);
 
 static void udp_sendmmsg_flush_before_socket_invalidation(ioa_socket_handle s);
 
+static void ioa_splice_try_start(ioa_socket_handle s);
+static void ioa_splice_release(ioa_socket_handle s);
+
+static void socket_deliver_udp_batch(ioa_socket_handle s, int event_type, ioa_net_data *nds, size_t count,
+                                     void *ctx);
+
 #if defined(__linux__)
 static int ensure_engine_recvmmsg_state(ioa_engine_handle e);
 static int socket_udp_read_batch_recvmmsg(ioa_socket_handle s, int *last_len);
@@ -339,6 +372,30 @@ static int buffer_list_empty(stun_buffer_list *bufs) {
   return 1;
 }
 
+static const size_t nbh_class_capacity[IOA_NBH_CLASSES_NUMBER] = {IOA_NBH_MTU_CAPACITY, IOA_NBH_UDP_CAPACITY,
+                                                                   IOA_NBH_FULL_CAPACITY};
+
+static const char *const nbh_class_name[IOA_NBH_CLASSES_NUMBER] = {"mtu", "udp", "full"};
+
+static const size_t nbh_class_queue_size[IOA_NBH_CLASSES_NUMBER] = {
+    MAX_MTU_BUFFER_QUEUE_SIZE_PER_ENGINE, MAX_UDP_BUFFER_QUEUE_SIZE_PER_ENGINE, MAX_BUFFER_QUEUE_SIZE_PER_ENGINE};
+
+static inline ioa_nbh_class nbh_class_for_size(size_t size) {
+  if (size <= IOA_NBH_MTU_CAPACITY) {
+    return IOA_NBH_CLASS_MTU;
+  } else if (size <= IOA_NBH_UDP_CAPACITY) {
+    return IOA_NBH_CLASS_UDP;
+  }
+  return IOA_NBH_CLASS_FULL;
+}
+
+static inline void reset_blist_elem(stun_buffer_list_elem *buf_elem) {
+  buf_elem->next = NULL;
+  buf_elem->len = 0;
+  buf_elem->offset = 0;
+  buf_elem->coffset = 0;
+}
+
 static stun_buffer_list_elem *get_elem_from_buffer_list(stun_buffer_list *bufs) {
   stun_buffer_list_elem *ret = NULL;
 
@@ -351,10 +408,7 @@ static stun_buffer_list_elem *get_elem_from_buffer_list(stun_buffer_list *bufs)
       bufs->tail = NULL;
     }
 
-    ret->next = NULL;
-    ret->buf.len = 0;
-    ret->buf.offset = 0;
-    ret->buf.coffset = 0;
+    reset_blist_elem(ret);
   }
 
   return ret;
@@ -373,25 +427,38 @@ static void pop_elem_from_buffer_list(stun_buffer_list *bufs) {
   }
 }
 
-static stun_buffer_list_elem *new_blist_elem(ioa_engine_handle e) {
-  stun_buffer_list_elem *ret = get_elem_from_buffer_list(&(e->bufs));
-
-  if (!ret) {
-    ret = (stun_buffer_list_elem *)turn_malloc(sizeof(stun_buffer_list_elem));
+static stun_buffer_list_elem *malloc_blist_elem(ioa_nbh_class c) {
+  stun_buffer_list_elem *ret =
+      (stun_buffer_list_elem *)turn_malloc(offsetof(stun_buffer_list_elem, buf) + nbh_class_capacity[c]);
+  if (ret) {
+    ret->size_class = (uint8_t)c;
+    reset_blist_elem(ret);
   }
+  return ret;
+}
+
+static stun_buffer_list_elem *new_blist_elem_class(ioa_engine_handle e, ioa_nbh_class c) {
+  stun_buffer_list_elem *ret = get_elem_from_buffer_list(&(e->bufs[c]));
+
+  ++(e->nbh_allocs[c]);
 
   if (ret) {
-    ret->buf.len = 0;
-    ret->buf.offset = 0;
-    ret->buf.coffset = 0;
-    ret->next = NULL;
+    ++(e->nbh_reuses[c]);
   } else {
+    ret = malloc_blist_elem(c);
+  }
+
+  if (!ret) {
     TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: Cannot allocate memory for STUN buffer!\n", __FUNCTION__);
   }
 
   return ret;
 }
 
+static inline stun_buffer_list_elem *new_blist_elem(ioa_engine_handle e) {
+  return new_blist_elem_class(e, IOA_NBH_CLASS_FULL);
+}
+
 static inline void add_elem_to_buffer_list(stun_buffer_list *bufs, stun_buffer_list_elem *buf_elem) {
   // We want a queue, so add to tail
   if (bufs->tail) {
@@ -406,19 +473,20 @@ static inline void add_elem_to_buffer_list(stun_buffer_list *bufs, stun_buffer_l
 
 static void add_buffer_to_buffer_list(stun_buffer_list *bufs, char *buf, size_t len) {
   if (bufs && buf && (bufs->tsz < MAX_SOCKET_BUFFER_BACKLOG)) {
-    stun_buffer_list_elem *buf_elem = (stun_buffer_list_elem *)turn_malloc(sizeof(stun_buffer_list_elem));
-    memcpy(buf_elem->buf.buf, buf, len);
-    buf_elem->buf.len = len;
-    buf_elem->buf.offset = 0;
-    buf_elem->buf.coffset = 0;
-    add_elem_to_buffer_list(bufs, buf_elem);
+    stun_buffer_list_elem *buf_elem = malloc_blist_elem(nbh_class_for_size(len));
+    if (buf_elem) {
+      memcpy(buf_elem->buf, buf, len);
+      buf_elem->len = len;
+      add_elem_to_buffer_list(bufs, buf_elem);
+    }
   }
 }
 
 static void free_blist_elem(ioa_engine_handle e, stun_buffer_list_elem *buf_elem) {
   if (buf_elem) {
-    if (e && (e->bufs.tsz < MAX_BUFFER_QUEUE_SIZE_PER_ENGINE)) {
-      add_elem_to_buffer_list(&(e->bufs), buf_elem);
+    const ioa_nbh_class c = (ioa_nbh_class)buf_elem->size_class;
+    if (e && (e->bufs[c].tsz < nbh_class_queue_size[c])) {
+      add_elem_to_buffer_list(&(e->bufs[c]), buf_elem);
     } else {
       free(buf_elem);
     }
@@ -529,6 +597,45 @@ void ioa_init_recvmmsg_hdr(struct mmsghdr *msg, struct iovec *iov, ioa_addr *src
   msg->msg_hdr.msg_controllen = cmsg_len;
   msg->msg_len = 0;
 }
+
+void ioa_init_recvmmsg_nbh_hdr(struct mmsghdr *msg, struct iovec *iov, ioa_addr *src_addr, char *cmsg,
+                               size_t cmsg_len, socklen_t slen, ioa_network_buffer_handle nbh, uint8_t *overflow) {
+  if (!msg || !iov || !nbh || !overflow) {
+    return;
+  }
+
+  ioa_init_recvmmsg_hdr(msg, iov, src_addr, cmsg, cmsg_len, slen, ioa_network_buffer_data(nbh), IOA_NBH_MTU_RECV_SIZE);
+
+  iov[1].iov_base = overflow;
+  iov[1].iov_len = IOA_NBH_RECV_OVERFLOW_SIZE;
+  msg->msg_hdr.msg_iovlen = 2;
+}
+
+ioa_network_buffer_handle ioa_network_buffer_finish_recvmmsg(ioa_engine_handle e, ioa_network_buffer_handle nbh,
+                                                             const uint8_t *overflow, size_t len) {
+  stun_buffer_list_elem *buf_elem = (stun_buffer_list_elem *)nbh;
+
+  if (!buf_elem) {
+    return NULL;
+  }
+
+  if (len > IOA_NBH_MTU_RECV_SIZE) {
+    stun_buffer_list_elem *big_elem = new_blist_elem_class(e, IOA_NBH_CLASS_UDP);
+    if (!big_elem) {
+      /* Never hand a truncated datagram up; an empty one is dropped. */
+      len = 0;
+    } else {
+      memcpy(big_elem->buf, ioa_network_buffer_data(nbh), IOA_NBH_MTU_RECV_SIZE);
+      memcpy(big_elem->buf + IOA_NBH_MTU_RECV_SIZE, overflow, len - IOA_NBH_MTU_RECV_SIZE);
+      free_blist_elem(e, buf_elem);
+      buf_elem = big_elem;
+    }
+  }
+
+  buf_elem->len = len;
+
+  return buf_elem;
+}
 #endif
 
 /************** ENGINE *************************/
@@ -602,7 +709,8 @@ static void maybe_log_udp_recvmmsg_stats(ioa_engine_handle e, turn_time_t now) {
                                      e->udp_recvmmsg_hist[15] + e->udp_recvmmsg_hist[16]));
 }
 
-void ioa_engine_record_udp_sendmmsg_flush(ioa_engine_handle e, unsigned int count, unsigned int gso_count) {
+void ioa_engine_record_udp_sendmmsg_flush(ioa_engine_handle e, unsigned int count, unsigned int fd_groups,
+                                          unsigned int gso_count) {
   if (!e || count == 0) {
     return;
   }
@@ -614,6 +722,7 @@ void ioa_engine_record_udp_sendmmsg_flush(ioa_engine_handle e, unsigned int coun
 
   e->udp_sendmmsg_flushes++;
   e->udp_sendmmsg_datagrams += (uint64_t)count;
+  e->udp_sendmmsg_fd_groups += (uint64_t)fd_groups;
   e->udp_sendmmsg_hist[bucket]++;
 
   if (gso_count > 0) {
@@ -645,15 +754,49 @@ static void maybe_log_udp_sendmmsg_stats(ioa_engine_handle e, turn_time_t now) {
       e->udp_sendmmsg_datagrams ? ((double)e->udp_sendmmsg_gso_datagrams / (double)e->udp_sendmmsg_datagrams) : 0.0;
 
   TURN_LOG_FUNC(TURN_LOG_LEVEL_INFO,
-                "udp-sendmmsg stats: flushes=%llu datagrams=%llu avg_batch=%.2f gso_flushes=%llu gso_datagrams=%llu "
-                "gso_frac=%.3f hist_1=%llu hist_2=%llu hist_3_4=%llu hist_5_8=%llu hist_9_16=%llu hist_17_32=%llu\n",
+                "udp-sendmmsg stats: flushes=%llu datagrams=%llu avg_batch=%.2f fd_groups=%llu gso_flushes=%llu "
+                "gso_datagrams=%llu gso_frac=%.3f hist_1=%llu hist_2=%llu hist_3_4=%llu hist_5_8=%llu hist_9_16=%llu "
+                "hist_17_32=%llu\n",
                 (unsigned long long)e->udp_sendmmsg_flushes, (unsigned long long)e->udp_sendmmsg_datagrams, avg_batch,
+                (unsigned long long)e->udp_sendmmsg_fd_groups,
                 (unsigned long long)e->udp_sendmmsg_gso_flushes, (unsigned long long)e->udp_sendmmsg_gso_datagrams,
                 gso_frac, (unsigned long long)e->udp_sendmmsg_hist[1], (unsigned long long)e->udp_sendmmsg_hist[2],
                 (unsigned long long)udp_sendmmsg_hist_sum(e, 3, 4), (unsigned long long)udp_sendmmsg_hist_sum(e, 5, 8),
                 (unsigned long long)udp_sendmmsg_hist_sum(e, 9, 16),
                 (unsigned long long)udp_sendmmsg_hist_sum(e, 17, 32));
 }
+
+static void maybe_log_udp_io_uring_stats(ioa_engine_handle e, turn_time_t now) {
+  if (!turn_params.udp_io_uring_log || !e || (!e->uring_recv && !e->uring_send) ||
+      ((now - e->udp_io_uring_last_report_time) < 10)) {
+    return;
+  }
+
+  static const ioa_uring_stats none = {0};
+  const ioa_uring_stats *r = e->uring_recv ? ioa_uring_get_stats(e->uring_recv) : &none;
+  const ioa_uring_stats *w = e->uring_send ? ioa_uring_get_stats(e->uring_send) : &none;
+
+  if ((r->recv_cqes == e->udp_io_uring_last_report_cqes) && (w->send_submits == e->udp_io_uring_last_report_submits)) {
+    return;
+  }
+
+  e->udp_io_uring_last_report_cqes = r->recv_cqes;
+  e->udp_io_uring_last_report_submits = w->send_submits;
+  e->udp_io_uring_last_report_time = now;
+
+  TURN_LOG_FUNC(TURN_LOG_LEVEL_INFO,
+                "udp-io-uring stats: recv_cqes=%llu recv_batches=%llu recv_packets=%llu avg_batch=%.2f rearms=%llu "
+                "nobufs=%llu truncated=%llu recv_errors=%llu send_submits=%llu send_datagrams=%llu "
+                "avg_submit=%.2f send_errors=%llu\n",
+                (unsigned long long)r->recv_cqes, (unsigned long long)r->recv_batches,
+                (unsigned long long)r->recv_datagrams,
+                r->recv_batches ? ((double)r->recv_datagrams / (double)r->recv_batches) : 0.0,
+                (unsigned long long)r->recv_rearms, (unsigned long long)r->recv_nobufs,
+                (unsigned long long)r->recv_truncated, (unsigned long long)r->recv_errors,
+                (unsigned long long)w->send_submits, (unsigned long long)w->send_sqes,
+                w->send_submits ? ((double)w->send_sqes / (double)w->send_submits) : 0.0,
+                (unsigned long long)w->send_errors);
+}
 #endif
 
 /* Flush this engine's lock-free per-thread counters into the shared prometheus
@@ -682,10 +825,38 @@ static void maybe_flush_prom_counters(ioa_engine_handle e) {
   e->udp_sendmmsg_flushes_prom_flushed = e->udp_sendmmsg_flushes;
   e->udp_sendmmsg_datagrams_prom_flushed = e->udp_sendmmsg_datagrams;
   e->udp_sendmmsg_gso_datagrams_prom_flushed = e->udp_sendmmsg_gso_datagrams;
+  if (e->uring_recv) {
+    const ioa_uring_stats *r = ioa_uring_get_stats(e->uring_recv);
+    d.io_uring_recv_batches = r->recv_batches - e->udp_io_uring_prom_flushed.recv_batches;
+    d.io_uring_recv_packets = r->recv_datagrams - e->udp_io_uring_prom_flushed.recv_datagrams;
+    e->udp_io_uring_prom_flushed.recv_batches = r->recv_batches;
+    e->udp_io_uring_prom_flushed.recv_datagrams = r->recv_datagrams;
+  }
+  if (e->uring_send) {
+    const ioa_uring_stats *w = ioa_uring_get_stats(e->uring_send);
+    d.io_uring_send_submits = w->send_submits - e->udp_io_uring_prom_flushed.send_submits;
+    d.io_uring_send_datagrams = w->send_sqes - e->udp_io_uring_prom_flushed.send_sqes;
+    e->udp_io_uring_prom_flushed.send_submits = w->send_submits;
+    e->udp_io_uring_prom_flushed.send_sqes = w->send_sqes;
+  }
 #endif
 
   prom_flush_udp_counters(&d);
 
+  for (int c = 0; c < IOA_NBH_CLASSES_NUMBER; ++c) {
+    const size_t pooled = e->bufs[c].tsz;
+    prom_flush_nbh_pool_counters(nbh_class_name[c], e->nbh_allocs[c] - e->nbh_allocs_prom_flushed[c],
+                                 e->nbh_reuses[c] - e->nbh_reuses_prom_flushed[c],
+                                 (int64_t)pooled - (int64_t)e->nbh_pooled_prom_flushed[c]);
+    e->nbh_allocs_prom_flushed[c] = e->nbh_allocs[c];
+    e->nbh_reuses_prom_flushed[c] = e->nbh_reuses[c];
+    e->nbh_pooled_prom_flushed[c] = pooled;
+  }
+
+  const uint64_t steals = turnipports_thread_steals();
+  prom_flush_relay_port_steals(steals - e->tp_steals_prom_flushed);
+  e->tp_steals_prom_flushed = steals;
+
   /* Same once-per-second-per-thread flush for the 401 mitigation counters,
    * which accumulate lock-free in _Thread_local storage on the relay hot path. */
   prom_flush_401_counters();
@@ -736,6 +907,7 @@ static void timer_handler(ioa_engine_handle e, void *arg) {
 #if defined(__linux__)
   maybe_log_udp_recvmmsg_stats(e, now);
   maybe_log_udp_sendmmsg_stats(e, now);
+  maybe_log_udp_io_uring_stats(e, now);
 #endif
 }
 
@@ -839,6 +1011,12 @@ void ioa_engine_set_rtcp_map(ioa_engine_handle e, rtcp_map *rtcpmap) {
   }
 }
 
+void ioa_engine_set_port_shard(ioa_engine_handle e, int shard) {
+  if (e) {
+    e->tp_shard = shard;
+  }
+}
+
 static const ioa_addr *ioa_engine_get_relay_addr(ioa_engine_handle e, ioa_socket_handle client_s, int address_family,
                                                  int *err_code) {
   if (e) {
@@ -1018,18 +1196,19 @@ void delete_ioa_timer(ioa_timer_handle th) {
 
 /************** SOCKETS HELPERS ***********************/
 
+/* Whether ioa_socket_check_bandwidth() can ever refuse traffic on s. */
+static bool ioa_socket_bandwidth_limited(ioa_socket_handle s) {
+  return s && (s->e) && ((s->sat == CLIENT_SOCKET) || (s->sat == RELAY_SOCKET) || (s->sat == RELAY_RTCP_SOCKET)) &&
+         (s->session) && (s->session->bps >= 1);
+}
+
 int ioa_socket_check_bandwidth(ioa_socket_handle s, ioa_network_buffer_handle nbh, int read) {
-  if (s && (s->e) && nbh && ((s->sat == CLIENT_SOCKET) || (s->sat == RELAY_SOCKET) || (s->sat == RELAY_RTCP_SOCKET)) &&
-      (s->session)) {
+  if (nbh && ioa_socket_bandwidth_limited(s)) {
 
     const size_t sz = ioa_network_buffer_get_size(nbh);
 
     const band_limit_t max_bps = s->session->bps;
 
-    if (max_bps < 1) {
-      return 1;
-    }
-
     struct traffic_bytes *traffic = &(s->data_traffic);
 
     if (s->sat == CLIENT_SOCKET) {
@@ -1360,6 +1539,26 @@ static int bind_ioa_socket(ioa_socket_handle s, const ioa_addr *local_addr, int
  * MULTIPLEX-PEER IMPLEMENTATION
  * ====================================================================== */
 
+/* The live session a datagram from peer_addr belongs to, or NULL if it is to be dropped. */
+static ts_ur_super_session *mp_route_peer(ioa_engine_handle e, const ioa_addr *peer_addr) {
+  ts_ur_super_session *ss = (ts_ur_super_session *)mp_peer_table_lookup(&e->mp_table, peer_addr);
+  if (!ss || ss->to_be_closed) {
+    return NULL;
+  }
+
+  allocation *a = get_allocation_ss(ss);
+  if (!is_allocation_valid(a)) {
+    return NULL;
+  }
+
+  turn_turnserver *server = (turn_turnserver *)ss->server;
+  if ((!server || !server->server_relay) && !allocation_get_permission(a, peer_addr)) {
+    return NULL;
+  }
+
+  return ss;
+}
+
 /*
  * UDP receive callback for the thread-local shared relay socket.
  *
@@ -1373,22 +1572,102 @@ static void mp_relay_input_handler(ioa_socket_handle s, int event_type, ioa_net_
     return;
   }
 
-  ts_ur_super_session *ss = (ts_ur_super_session *)mp_peer_table_lookup(&e->mp_table, &data->src_addr);
-  if (!ss || ss->to_be_closed) {
+  ts_ur_super_session *ss = mp_route_peer(e, &data->src_addr);
+  if (!ss) {
     return;
   }
 
-  allocation *a = get_allocation_ss(ss);
-  if (!is_allocation_valid(a)) {
+  turn_peer_input_handler(s, event_type, data, ss, can_resume);
+}
+
+/*
+ * Batch variant of mp_relay_input_handler() for the recvmmsg path.
+ *
+ * Each datagram is routed once (with the previous peer's result reused for
+ * back-to-back datagrams from the same peer), then the batch is regrouped by
+ * session, keeping arrival order within a session, so the session layer sees
+ * one run per session and its sends land next to each other in the
+ * sendmmsg/GSO egress batch.
+ *
+ * Handing a run to one session can close and free another; a freed session
+ * is also dropped from the peer table. So once a run has been dispatched,
+ * the first-pass owners are only compared as grouping keys, never
+ * dereferenced, and every later run is routed again before it is handed on.
+ */
+static void mp_relay_input_batch_handler(ioa_socket_handle s, int event_type, ioa_net_data *data, size_t count,
+                                         void *ctx) {
+  ioa_engine_handle e = (ioa_engine_handle)ctx;
+  if (!e || !data || !count) {
     return;
   }
+  if (count > IOA_UDP_RECVMMSG_MAX_BATCH) {
+    count = IOA_UDP_RECVMMSG_MAX_BATCH;
+  }
 
-  turn_turnserver *server = (turn_turnserver *)ss->server;
-  if ((!server || !server->server_relay) && !allocation_get_permission(a, &data->src_addr)) {
-    return;
+  const void *owners[IOA_UDP_RECVMMSG_MAX_BATCH];
+  const ioa_addr *last_addr = NULL;
+  ts_ur_super_session *last_ss = NULL;
+
+  for (size_t i = 0; i < count; ++i) {
+    if (!last_addr || !addr_eq(last_addr, &(data[i].src_addr))) {
+      last_addr = &(data[i].src_addr);
+      last_ss = mp_route_peer(e, last_addr);
+    }
+    owners[i] = last_ss;
   }
 
-  turn_peer_input_handler(s, event_type, data, ss, can_resume);
+  ioa_net_data grouped[IOA_UDP_RECVMMSG_MAX_BATCH];
+  size_t origin[IOA_UDP_RECVMMSG_MAX_BATCH];
+  bool dispatched = false;
+
+  for (size_t i = 0; i < count; ++i) {
+    const void *owner = owners[i];
+    if (!owner) {
+      continue;
+    }
+
+    ts_ur_super_session *ss = dispatched ? NULL : (ts_ur_super_session *)owner;
+    last_addr = NULL;
+    last_ss = NULL;
+
+    size_t n = 0;
+    for (size_t j = i; j < count; ++j) {
+      if (owners[j] != owner) {
+        continue;
+      }
+      owners[j] = NULL;
+      if (dispatched) {
+        /* A datagram whose peer has since moved to another session, or to
+           none, is dropped. */
+        if (!last_addr || !addr_eq(last_addr, &(data[j].src_addr))) {
+          last_addr = &(data[j].src_addr);
+          last_ss = mp_route_peer(e, last_addr);
+        }
+        if (!last_ss || (ss && (last_ss != ss))) {
+          continue;
+        }
+        ss = last_ss;
+      }
+      grouped[n] = data[j];
+      origin[n] = j;
+      ++n;
+    }
+    if (!n) {
+      continue;
+    }
+
+    turn_peer_input_batch_handler(s, event_type, grouped, n, ss);
+    dispatched = true;
+
+    /* Hand ownership of consumed buffers back to the caller's array. */
+    for (size_t j = 0; j < n; ++j) {
+      data[origin[j]].nbh = grouped[j].nbh;
+    }
+
+    if ((s->magic != SOCKET_MAGIC) || s->done || s->tobeclosed) {
+      break;
+    }
+  }
 }
 
 /*
@@ -1435,6 +1714,7 @@ static int mp_open_socket(ioa_engine_handle e, const char *relay_addr, int af, u
   sock_bind_to_device(s->fd, (unsigned char *)e->relay_ifname);
 
   register_callback_on_ioa_socket(e, s, IOA_EV_READ, mp_relay_input_handler, (void *)e, /*clean_preexisting=*/0);
+  register_batch_callback_on_ioa_socket(s, mp_relay_input_batch_handler);
 
   *sock_out = s;
   TURN_LOG_FUNC(TURN_LOG_LEVEL_INFO, "multiplex-peer: thread %d %s socket bound to %s:%u\n", e->relay_thread_id,
@@ -1499,6 +1779,14 @@ int init_multiplex_peer(ioa_engine_handle e, int thread_id, uint16_t base_port,
   if (e->mp_sock_v6) {
     e->mp_sock_v6->udp_recvmmsg_eligible = true;
   }
+  /* With --udp-io-uring the same sockets move to the engine's receive ring;
+   * they stay on their read events if the ring is unavailable. */
+  if (e->mp_sock_v4) {
+    ioa_socket_attach_uring(e->mp_sock_v4, e->mp_sock_v4->read_event, socket_deliver_udp_batch, NULL);
+  }
+  if (e->mp_sock_v6) {
+    ioa_socket_attach_uring(e->mp_sock_v6, e->mp_sock_v6->read_event, socket_deliver_udp_batch, NULL);
+  }
 
   e->mp_enabled = 1;
   return 0;
@@ -1651,9 +1939,9 @@ int create_relay_ioa_sockets(ioa_engine_handle e, ioa_socket_handle client_s, in
       port = 0;
       rtcp_port = -1;
       if (even_port < 0) {
-        port = turnipports_allocate(tp, transport, &relay_addr);
+        port = turnipports_allocate(tp, e->tp_shard, transport, &relay_addr);
       } else {
-        port = turnipports_allocate_even(tp, &relay_addr, even_port, out_reservation_token);
+        port = turnipports_allocate_even(tp, e->tp_shard, &relay_addr, even_port, out_reservation_token);
         if (port >= 0 && even_port > 0) {
           if (rtcp_s != NULL) {
             IOA_CLOSE_SOCKET(*rtcp_s);
@@ -2024,8 +2312,27 @@ ioa_socket_handle create_ioa_socket_from_fd(ioa_engine_handle e, ioa_socket_raw
 
 static void ssl_info_callback(SSL *ssl, int where, int ret) {
   UNUSED_ARG(ret);
-  UNUSED_ARG(ssl);
-  UNUSED_ARG(where);
+  /* Renegotiation is disabled, so this fires once per connection. */
+  if ((where & SSL_CB_HANDSHAKE_DONE) && SSL_is_server(ssl)) {
+    prom_inc_tls_handshake(tls_tickets_count_handshake(ssl));
+#if KTLS_SUPPORTED
+    /* The keys went to the kernel, if at all, while the handshake finished. */
+    ioa_socket_handle s = (ioa_socket_handle)SSL_get_app_data(ssl);
+    if (s && turn_params.tls_ktls && (s->st == TLS_SOCKET)) {
+      s->ktls = IOA_KTLS_CHECKED;
+      if (BIO_get_ktls_send(SSL_get_wbio(ssl))) {
+        s->ktls |= IOA_KTLS_TX;
+      }
+      if (BIO_get_ktls_recv(SSL_get_rbio(ssl))) {
+        s->ktls |= IOA_KTLS_RX;
+      }
+      if (s->e && s->e->verbose) {
+        TURN_LOG_FUNC(TURN_LOG_LEVEL_INFO, "%s: socket %p: %s, kTLS: %s\n", __FUNCTION__, s, SSL_get_cipher(ssl),
+                      get_ioa_socket_tls_offload(s));
+      }
+    }
+#endif
+  }
 }
 
 typedef void (*ssl_info_callback_t)(const SSL *ssl, int type, int val);
@@ -2038,6 +2345,7 @@ static void set_socket_ssl(ioa_socket_handle s, SSL *ssl) {
     }
     s->ssl = ssl;
     if (ssl) {
+      /* ssl_info_callback() finds the socket here; nothing else may set it. */
       SSL_set_app_data(ssl, s);
       SSL_set_info_callback(ssl, (ssl_info_callback_t)ssl_info_callback);
       SSL_set_options(ssl,
@@ -2147,6 +2455,8 @@ void close_ioa_socket(ioa_socket_handle s) {
      * descriptor are still valid: a deferred flush would otherwise dereference
      * freed memory or write to a closed (possibly reused) fd. */
     udp_sendmmsg_flush_before_socket_invalidation(s);
+    ioa_socket_detach_uring(s);
+    ioa_splice_release(s);
 
     s->done = 1;
 
@@ -2220,6 +2530,8 @@ ioa_socket_handle detach_ioa_socket(ioa_socket_handle s) {
     /* Detaching clears s->fd and s->parent_s, so any queued datagram would be
      * flushed to a descriptor this socket no longer owns. */
     udp_sendmmsg_flush_before_socket_invalidation(s);
+    ioa_socket_detach_uring(s);
+    ioa_splice_release(s);
 
     s->tobeclosed = 1;
 
@@ -2285,6 +2597,7 @@ ioa_socket_handle detach_ioa_socket(ioa_socket_handle s) {
     SSL *ssl = s->ssl;
     set_socket_ssl(s, NULL);
     set_socket_ssl(ret, ssl);
+    ret->ktls = s->ktls;
     ret->fd = s->fd;
 
     ret->family = get_ioa_socket_address_family(s);
@@ -2319,6 +2632,37 @@ ioa_socket_handle detach_ioa_socket(ioa_socket_handle s) {
   return ret;
 }
 
+int ioa_socket_suspend(ioa_socket_handle s) {
+  if (!s || (s->magic != SOCKET_MAGIC) || s->done || s->tobeclosed || (s->fd < 0) || !(s->e)) {
+    return -1;
+  }
+
+  /* Shared or RFC 6062 sockets cannot follow a session to another thread. */
+  if (s->parent_s || s->sockets_container || s->sub_session || s->splice || s->conn_bev || s->list_ev) {
+    return -1;
+  }
+
+  /* Bytes already taken off the kernel would have to be replayed on the new
+   * thread; wait for a quiet moment instead. */
+  if (s->defer_nbh || !buffer_list_empty(&(s->bufs))) {
+    return -1;
+  }
+  if (s->bev && (evbuffer_get_length(bufferevent_get_input(s->bev)) ||
+                 evbuffer_get_length(bufferevent_get_output(s->bev)))) {
+    return -1;
+  }
+  if (s->ssl && SSL_has_pending(s->ssl)) {
+    return -1;
+  }
+
+  udp_sendmmsg_flush_before_socket_invalidation(s);
+  ioa_socket_detach_uring(s);
+
+  detach_socket_net_data(s);
+
+  return 0;
+}
+
 ts_ur_super_session *get_ioa_socket_session(ioa_socket_handle s) {
   if (s) {
     return s->session;
@@ -2449,6 +2793,12 @@ int get_local_mtu_ioa_socket(ioa_socket_handle s) {
  * Return: -1 - error, 0 or >0 - OK
  * *read_len -1 - no data, >=0 - data available
  */
+/* Plaintext landing area for ssl_read(). Decrypting into a per-thread scratch
+ * instead of past the ciphertext lets a DTLS record arrive in any buffer size
+ * class: the plaintext is never longer than the record, so it is copied back
+ * over the (already consumed) ciphertext. */
+static TURN_THREAD_LOCAL char ssl_read_plaintext[UDP_STUN_BUFFER_SIZE];
+
 int ssl_read(evutil_socket_t fd, SSL *ssl, ioa_network_buffer_handle nbh, int verbose) {
   int ret = 0;
 
@@ -2457,14 +2807,14 @@ int ssl_read(evutil_socket_t fd, SSL *ssl, ioa_network_buffer_handle nbh, int ve
   }
 
   char *buffer = (char *)ioa_network_buffer_data(nbh);
-  const int buf_size = (int)ioa_network_buffer_get_capacity_udp();
+  const int buf_size = (int)sizeof(ssl_read_plaintext);
   const int read_len = (int)ioa_network_buffer_get_size(nbh);
 
   if (read_len < 1) {
     return -1;
   }
 
-  char *new_buffer = buffer + buf_size;
+  char *new_buffer = ssl_read_plaintext;
   const int old_buffer_len = read_len;
 
   int len = 0;
@@ -2577,9 +2927,6 @@ int ssl_read(evutil_socket_t fd, SSL *ssl, ioa_network_buffer_handle nbh, int ve
     }
   }
 
-  if (ret > 0) {
-    ioa_network_buffer_add_offset_size(nbh, (uint16_t)buf_size, 0, (size_t)ret);
-  }
 #if defined LIBRESSL_VERSION_NUMBER && LIBRESSL_VERSION_NUMBER < 0x3040000fL
   ssl->rbio = NULL;
   BIO_free(rbio);
@@ -2587,6 +2934,15 @@ int ssl_read(evutil_socket_t fd, SSL *ssl, ioa_network_buffer_handle nbh, int ve
   SSL_set0_rbio(ssl, NULL);
 #endif
 
+  if (ret > 0) {
+    if ((size_t)ret > ioa_network_buffer_get_capacity(nbh)) {
+      ret = -1;
+    } else {
+      memcpy(buffer, new_buffer, (size_t)ret);
+      ioa_network_buffer_set_size(nbh, (size_t)ret);
+    }
+  }
+
   return ret;
 }
 
@@ -2740,6 +3096,187 @@ static int ensure_engine_recvmmsg_state(ioa_engine_handle e) {
   return 0;
 }
 
+/* Hands a received batch to the socket's owner: in one call when it takes
+ * whole batches, else one datagram at a time until it closes the socket.
+ * Buffers the owner leaves in nds are freed. */
+static void socket_deliver_udp_batch(ioa_socket_handle s, int event_type, ioa_net_data *nds, size_t count,
+                                     void *ctx) {
+  UNUSED_ARG(ctx);
+  ioa_engine_handle e = s->e;
+
+  if (s->read_batch_cb) {
+    if (count) {
+      s->read_batch_cb(s, event_type, nds, count, s->read_ctx);
+    }
+  } else {
+    for (size_t i = 0; i < count; ++i) {
+      s->read_cb(s, event_type, &(nds[i]), s->read_ctx, 1);
+      if ((s->magic != SOCKET_MAGIC) || s->done || s->tobeclosed) {
+        break;
+      }
+    }
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    if (nds[i].nbh) {
+      free_blist_elem(e, (stun_buffer_list_elem *)nds[i].nbh);
+      nds[i].nbh = NULL;
+    }
+  }
+}
+
+#if defined(__linux__)
+#define IOA_URING_RECV_ENTRIES (64)
+#define IOA_URING_RECV_BUFS (128)
+
+static void uring_recv_input_handler(evutil_socket_t fd, short what, void *arg) {
+  UNUSED_ARG(fd);
+
+  if (what & EV_READ) {
+    ioa_uring_poll(((ioa_engine_handle)arg)->uring_recv);
+  }
+}
+
+static int ensure_engine_uring_recv(ioa_engine_handle e) {
+  if (e->uring_recv) {
+    return 0;
+  }
+
+  ioa_uring *u = ioa_uring_create(IOA_URING_RECV_ENTRIES, IOA_URING_RECV_BUFS, SOCKET_RECVMMSG_CMSG_SZ,
+                                  UDP_STUN_BUFFER_SIZE);
+  if (!u) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_WARNING, "%s: cannot create io_uring receive ring\n", __FUNCTION__);
+    return -1;
+  }
+
+  e->uring_recv_ev = event_new(e->event_base, ioa_uring_fd(u), EV_READ | EV_PERSIST, uring_recv_input_handler, e);
+  if (!e->uring_recv_ev || event_add(e->uring_recv_ev, NULL) < 0) {
+    if (e->uring_recv_ev) {
+      event_free(e->uring_recv_ev);
+      e->uring_recv_ev = NULL;
+    }
+    ioa_uring_free(u);
+    return -1;
+  }
+
+  e->uring_recv = u;
+  return 0;
+}
+
+/* Copies a run of datagrams out of the ring's provided buffers into network
+ * buffers and hands them to the socket's owner in one call, inside a sendmmsg
+ * window just like the recvmmsg path. */
+static void uring_socket_input(void *ctx, ioa_uring_dgram *dgrams, size_t count) {
+  ioa_socket_handle s = (ioa_socket_handle)ctx;
+  ioa_engine_handle e = s->e;
+  ioa_net_data nds[IOA_URING_MAX_BATCH];
+  size_t nds_count = 0;
+
+  for (size_t i = 0; i < count && nds_count < IOA_URING_MAX_BATCH; ++i) {
+    const size_t len = dgrams[i].len;
+    stun_buffer_list_elem *buf_elem =
+        new_blist_elem_class(e, (len > IOA_NBH_MTU_RECV_SIZE) ? IOA_NBH_CLASS_UDP : IOA_NBH_CLASS_MTU);
+    if (!buf_elem) {
+      break;
+    }
+    memcpy(ioa_network_buffer_data((ioa_network_buffer_handle)buf_elem), dgrams[i].data, len);
+    buf_elem->len = len;
+
+    if (!ioa_socket_check_bandwidth(s, (ioa_network_buffer_handle)buf_elem, 1)) {
+      free_blist_elem(e, buf_elem);
+      continue;
+    }
+
+    ioa_net_data *nd = &(nds[nds_count++]);
+    memset(nd, 0, sizeof(*nd));
+    memcpy(&(nd->src_addr), dgrams[i].msg.msg_name,
+           (dgrams[i].msg.msg_namelen < sizeof(nd->src_addr)) ? dgrams[i].msg.msg_namelen : sizeof(nd->src_addr));
+    nd->nbh = (ioa_network_buffer_handle)buf_elem;
+    nd->recv_ttl = TTL_IGNORE;
+    nd->recv_tos = TOS_IGNORE;
+    ioa_parse_udp_recvmsg_cmsg(&(dgrams[i].msg), &(nd->recv_ttl), &(nd->recv_tos), NULL);
+  }
+
+  udp_sendmmsg_batch_begin();
+  if (nds_count) {
+    s->uring_cb(s, IOA_EV_READ, nds, nds_count, s->uring_ctx);
+  }
+  udp_sendmmsg_batch_end();
+
+  for (size_t i = 0; i < nds_count; ++i) {
+    if (nds[i].nbh) {
+      free_blist_elem(e, (stun_buffer_list_elem *)nds[i].nbh);
+    }
+  }
+}
+
+static void uring_socket_error(void *ctx, int err) {
+  ioa_socket_handle s = (ioa_socket_handle)ctx;
+
+  if (err == EBADF || err == EINVAL || err == EFAULT || err == ENOTSOCK || err == EOPNOTSUPP) {
+    /* The ring cannot serve this socket at all: hand it back to its event. */
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_WARNING, "%s: io_uring receive failed (%s), falling back to the read event\n",
+                  __FUNCTION__, strerror(err));
+    struct event *ev = s->uring_fallback_ev;
+    ioa_socket_detach_uring(s);
+    if (ev) {
+      event_add(ev, NULL);
+    }
+    return;
+  }
+
+  /* ICMP errors queued on the socket end the multishot receive; drain them
+   * before the ring re-arms it. */
+  socket_readerr(s->fd, &(s->local_addr));
+}
+
+int ioa_socket_attach_uring(ioa_socket_handle s, struct event *ev, ioa_net_batch_event_handler cb, void *ctx) {
+  if (!turn_params.udp_io_uring || !s || !s->e || s->fd < 0 || !cb || s->uring_source) {
+    return -1;
+  }
+
+  if (ensure_engine_uring_recv(s->e) < 0) {
+    return -1;
+  }
+
+  s->uring_cb = cb;
+  s->uring_ctx = ctx;
+  s->uring_fallback_ev = ev;
+
+  const int id = ioa_uring_add_source(s->e->uring_recv, s->fd, uring_socket_input, uring_socket_error, s);
+  if (id < 0) {
+    return -1;
+  }
+
+  s->uring_source = id + 1;
+  if (ev) {
+    event_del(ev);
+  }
+
+  return 0;
+}
+
+void ioa_socket_detach_uring(ioa_socket_handle s) {
+  if (s && s->uring_source && s->e && s->e->uring_recv) {
+    ioa_uring_remove_source(s->e->uring_recv, s->uring_source - 1);
+  }
+  if (s) {
+    s->uring_source = 0;
+    s->uring_fallback_ev = NULL;
+  }
+}
+#else
+int ioa_socket_attach_uring(ioa_socket_handle s, struct event *ev, ioa_net_batch_event_handler cb, void *ctx) {
+  UNUSED_ARG(s);
+  UNUSED_ARG(ev);
+  UNUSED_ARG(cb);
+  UNUSED_ARG(ctx);
+  return -1;
+}
+
+void ioa_socket_detach_uring(ioa_socket_handle s) { UNUSED_ARG(s); }
+#endif
+
 static int socket_udp_read_batch_recvmmsg(ioa_socket_handle s, int *last_len) {
   if (last_len) {
     *last_len = -1;
@@ -2759,14 +3296,14 @@ static int socket_udp_read_batch_recvmmsg(ioa_socket_handle s, int *last_len) {
   unsigned int count = 0;
 
   for (count = 0; count < MAX_SOCKET_RECVMMSG_BATCH; ++count) {
-    stun_buffer_list_elem *buf_elem = new_blist_elem(e);
+    stun_buffer_list_elem *buf_elem = new_blist_elem_class(e, IOA_NBH_CLASS_MTU);
     if (!buf_elem) {
       break;
     }
     buf_elems[count] = buf_elem;
-    ioa_init_recvmmsg_hdr(&(state->msgs[count]), &(state->iovecs[count]), &(state->src_addrs[count]),
-                          state->cmsgs[count], SOCKET_RECVMMSG_CMSG_SZ, (socklen_t)get_ioa_addr_len(&(s->local_addr)),
-                          buf_elem->buf.buf, UDP_STUN_BUFFER_SIZE);
+    ioa_init_recvmmsg_nbh_hdr(&(state->msgs[count]), state->iovecs[count], &(state->src_addrs[count]),
+                              state->cmsgs[count], SOCKET_RECVMMSG_CMSG_SZ,
+                              (socklen_t)get_ioa_addr_len(&(s->local_addr)), buf_elem, state->overflow[count]);
     state->ttls[count] = TTL_IGNORE;
     state->toss[count] = TOS_IGNORE;
   }
@@ -2806,47 +3343,41 @@ static int socket_udp_read_batch_recvmmsg(ioa_socket_handle s, int *last_len) {
 
   ioa_engine_record_udp_recvmmsg_batch(e, rc);
 
-  /* Wrap the per-datagram callbacks so that any sends triggered by them can
-   * be coalesced via udp_sendmmsg / UDP-GSO. Without this, the relay-side
-   * recvmmsg path issues one send syscall per delivered datagram. */
-  udp_sendmmsg_batch_begin();
+  ioa_net_data nds[MAX_SOCKET_RECVMMSG_BATCH];
+  size_t nds_count = 0;
 
   for (int i = 0; i < rc; ++i) {
     stun_buffer_list_elem *buf_elem = buf_elems[i];
-    ioa_net_data nd;
     const int msg_len = (int)state->msgs[i].msg_len;
 
     buf_elems[i] = NULL;
 
     ioa_parse_udp_recvmsg_cmsg(&(state->msgs[i].msg_hdr), &(state->ttls[i]), &(state->toss[i]), NULL);
-    buf_elem->buf.len = (size_t)msg_len;
+    buf_elem =
+        (stun_buffer_list_elem *)ioa_network_buffer_finish_recvmmsg(e, buf_elem, state->overflow[i], (size_t)msg_len);
 
     if (!ioa_socket_check_bandwidth(s, (ioa_network_buffer_handle)buf_elem, 1)) {
       free_blist_elem(e, buf_elem);
       continue;
     }
 
-    memset(&nd, 0, sizeof(nd));
-    addr_cpy(&(nd.src_addr), &(state->src_addrs[i]));
-    nd.nbh = (ioa_network_buffer_handle)buf_elem;
-    nd.recv_ttl = state->ttls[i];
-    nd.recv_tos = state->toss[i];
-
-    s->read_cb(s, IOA_EV_READ, &nd, s->read_ctx, 1);
-
-    if (nd.nbh) {
-      free_blist_elem(e, buf_elem);
-    }
+    ioa_net_data *nd = &(nds[nds_count++]);
+    memset(nd, 0, sizeof(*nd));
+    addr_cpy(&(nd->src_addr), &(state->src_addrs[i]));
+    nd->nbh = (ioa_network_buffer_handle)buf_elem;
+    nd->recv_ttl = state->ttls[i];
+    nd->recv_tos = state->toss[i];
 
     if (last_len) {
       *last_len = msg_len;
     }
-
-    if ((s->magic != SOCKET_MAGIC) || s->done || s->tobeclosed) {
-      break;
-    }
   }
 
+  /* Wrap the per-datagram callbacks so that any sends triggered by them can
+   * be coalesced via udp_sendmmsg / UDP-GSO. Without this, the relay-side
+   * recvmmsg path issues one send syscall per delivered datagram. */
+  udp_sendmmsg_batch_begin();
+  socket_deliver_udp_batch(s, IOA_EV_READ, nds, nds_count, NULL);
   udp_sendmmsg_batch_end();
 
   for (unsigned int i = 0; i < count; ++i) {
@@ -3237,13 +3768,15 @@ try_start:
   try_again = 0;
   try_ok = 0;
 
-  stun_buffer_list_elem *buf_elem = new_blist_elem(s->e);
+  /* Stream sockets reassemble a whole STUN message; a UDP or DTLS read is at
+   * most ioa_network_buffer_get_capacity_udp() bytes. */
+  stun_buffer_list_elem *buf_elem = new_blist_elem_class(s->e, s->bev ? IOA_NBH_CLASS_FULL : IOA_NBH_CLASS_UDP);
   len = -1;
 
   if (s->bev) { /* TCP & TLS  & SCTP & SCTP/TLS */
     struct evbuffer *inbuf = bufferevent_get_input(s->bev);
     if (inbuf) {
-      ev_ssize_t blen = evbuffer_copyout(inbuf, buf_elem->buf.buf, STUN_BUFFER_SIZE);
+      ev_ssize_t blen = evbuffer_copyout(inbuf, buf_elem->buf, STUN_BUFFER_SIZE);
 
       if (blen > 0) {
         int mlen = 0;
@@ -3253,7 +3786,7 @@ try_start:
         }
 
         if (s->st == TCP_SOCKET_PROXY) {
-          const ssize_t tlen = socket_parse_proxy(s, buf_elem->buf.buf, blen);
+          const ssize_t tlen = socket_parse_proxy(s, buf_elem->buf, blen);
           blen = 0;
           if (tlen < 0) {
             s->tobeclosed = 1;
@@ -3261,9 +3794,9 @@ try_start:
             ret = -1;
             log_socket_event(s, "proxy protocol violated", 1);
           } else if (tlen > 0) {
-            bufferevent_read(s->bev, buf_elem->buf.buf, tlen);
+            bufferevent_read(s->bev, buf_elem->buf, tlen);
 
-            blen = evbuffer_copyout(inbuf, buf_elem->buf.buf, STUN_BUFFER_SIZE);
+            blen = evbuffer_copyout(inbuf, buf_elem->buf, STUN_BUFFER_SIZE);
             s->st = TCP_SOCKET;
           }
         }
@@ -3272,11 +3805,11 @@ try_start:
           if (is_stream_socket(s->st) && ((s->sat == TCP_CLIENT_DATA_SOCKET) || (s->sat == TCP_RELAY_DATA_SOCKET))) {
             mlen = blen;
           } else {
-            mlen = stun_get_message_len_str(buf_elem->buf.buf, blen, 1, &app_msg_len);
+            mlen = stun_get_message_len_str(buf_elem->buf, blen, 1, &app_msg_len);
           }
 
           if (mlen > 0 && mlen <= (int)blen) {
-            len = (int)bufferevent_read(s->bev, buf_elem->buf.buf, mlen);
+            len = (int)bufferevent_read(s->bev, buf_elem->buf, mlen);
             if (len < 0) {
               ret = -1;
               s->tobeclosed = 1;
@@ -3320,22 +3853,22 @@ try_start:
       int batch_len = -1;
       if (socket_udp_read_batch_recvmmsg(s, &batch_len)) {
         /* The recvmmsg fast path allocates its own per-datagram buffers
-         * via new_blist_elem(). The `buf_elem` allocated above for the
+         * via new_blist_elem_class(). The `buf_elem` allocated above for the
          * legacy single-recv path is unused here -- return it to the
          * engine pool so it does not leak. Without this, every successful
-         * batch leaks one 64KB stun_buffer_list_elem, which under sustained
-         * load grows RSS by ~200 MB/sec/socket. */
+         * batch leaks one UDP-class stun_buffer_list_elem, which under
+         * sustained load grows RSS steadily per socket. */
         free_blist_elem(s->e, buf_elem);
         return batch_len;
       }
     }
 #endif
-    ret = udp_recvfrom(s->fd, &remote_addr, &(s->local_addr), (char *)(buf_elem->buf.buf), UDP_STUN_BUFFER_SIZE, &ttl,
+    ret = udp_recvfrom(s->fd, &remote_addr, &(s->local_addr), (char *)(buf_elem->buf), UDP_STUN_BUFFER_SIZE, &ttl,
                        &tos, s->e->cmsg, 0, NULL);
     len = ret;
     if (s->ssl && (len > 0)) { /* DTLS */
       send_ssl_backlog_buffers(s);
-      buf_elem->buf.len = (size_t)len;
+      buf_elem->len = (size_t)len;
       ret = ssl_read(s->fd, s->ssl, (ioa_network_buffer_handle)buf_elem, (s->e ? s->e->verbose : TURN_VERBOSE_NONE));
       addr_cpy(&remote_addr, &(s->remote_addr));
       if (ret < 0) {
@@ -3364,9 +3897,9 @@ try_start:
   if ((ret != -1) && (len >= 0)) {
 
     if (app_msg_len) {
-      buf_elem->buf.len = app_msg_len;
+      buf_elem->len = app_msg_len;
     } else {
-      buf_elem->buf.len = len;
+      buf_elem->len = len;
     }
 
     if (ioa_socket_check_bandwidth(s, buf_elem, 1)) {
@@ -3495,11 +4028,361 @@ void close_ioa_socket_after_processing_if_necessary(ioa_socket_handle s) {
   }
 }
 
+/************** RFC 6062 splice relay ****************/
+
+/*
+ * --tcp-splice: once a client data connection is bound to its peer
+ * connection, both bufferevents are switched off and each direction moves
+ * bytes socket -> pipe -> socket with splice(), so the payload never reaches
+ * user space. A direction whose destination is full stops reading its source
+ * until the pipe drains, which keeps the TCP back-pressure the bufferevent
+ * path gets from tcp_congestion_control.
+ */
+
+#if defined(__linux__)
+
+static void ioa_splice_read_handler(evutil_socket_t fd, short what, void *arg);
+static void ioa_splice_write_handler(evutil_socket_t fd, short what, void *arg);
+
+static bool ioa_splice_socket_eligible(ioa_socket_handle s) {
+  return s && (s->magic == SOCKET_MAGIC) && !(s->done) && !(s->tobeclosed) && (s->fd >= 0) && s->bev && !(s->ssl) &&
+         (s->st == TCP_SOCKET) && ((s->sat == TCP_CLIENT_DATA_SOCKET) || (s->sat == TCP_RELAY_DATA_SOCKET)) &&
+         !ioa_socket_bandwidth_limited(s);
+}
+
+static bool ioa_splice_socket_idle(ioa_socket_handle s) {
+  return !evbuffer_get_length(bufferevent_get_input(s->bev)) && !evbuffer_get_length(bufferevent_get_output(s->bev));
+}
+
+static void ioa_splice_close_socket(ioa_socket_handle s, int broken, const char *msg) {
+  if (broken) {
+    s->broken = 1;
+  }
+  s->tobeclosed = 1;
+  /* eventcb_bev() does not report data connection errors either: a reset is
+   * how most peers end a TCP relay. */
+  log_socket_event(s, msg, 0);
+  /* Deletes the tcp_connection, which closes both sockets and releases the
+   * splice state. */
+  close_ioa_socket_after_processing_if_necessary(s);
+}
+
+/* Writes as much of the pipe to dst as it takes, then parks whichever side
+ * has to wait. May close the pair; d must not be used afterwards. */
+static void ioa_splice_flush(ioa_splice *sp, ioa_splice_dir *d) {
+  size_t moved = 0;
+  int err = 0;
+  while (d->pipe_bytes) {
+    const ssize_t n = splice(d->pipe_fds[0], NULL, d->dst->fd, NULL, d->pipe_bytes, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (n > 0) {
+      moved += (size_t)n;
+      d->pipe_bytes -= (size_t)n;
+    } else if ((n < 0) && (errno == EINTR)) {
+      continue;
+    } else {
+      if ((n < 0) && (errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+        err = errno;
+      }
+      break;
+    }
+  }
+
+  if (!err) {
+    if (d->pipe_bytes) {
+      event_del(d->read_ev);
+      event_add(d->write_ev, NULL);
+    } else {
+      event_del(d->write_ev);
+      event_add(d->read_ev, NULL);
+    }
+  }
+
+  ioa_socket_handle src = d->src;
+  ioa_socket_handle dst = d->dst;
+  if (moved && sp->cb) {
+    sp->cb(src, moved, sp->ctx);
+  }
+  if (err) {
+    errno = err;
+    ioa_splice_close_socket(dst, 1, "spliced TCP write failed, to be closed");
+  }
+}
+
+static void ioa_splice_read_handler(evutil_socket_t fd, short what, void *arg) {
+  ioa_splice_dir *d = (ioa_splice_dir *)arg;
+  ioa_socket_handle src = d->src;
+  if (!(what & EV_READ) || (fd != src->fd) || !(src->splice)) {
+    return;
+  }
+
+  ssize_t n;
+  do {
+    n = splice(src->fd, NULL, d->pipe_fds[1], NULL, IOA_SPLICE_CHUNK, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+  } while ((n < 0) && (errno == EINTR));
+
+  if (n > 0) {
+    d->pipe_bytes += (size_t)n;
+    ioa_splice_flush(src->splice, d);
+  } else if (n == 0) {
+    ioa_splice_close_socket(src, 0, "spliced TCP connection closed remotely");
+  } else if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+    ioa_splice_close_socket(src, 1, "spliced TCP read failed, to be closed");
+  }
+}
+
+static void ioa_splice_write_handler(evutil_socket_t fd, short what, void *arg) {
+  ioa_splice_dir *d = (ioa_splice_dir *)arg;
+  if ((what & EV_WRITE) && (fd == d->dst->fd) && d->src->splice) {
+    ioa_splice_flush(d->src->splice, d);
+  }
+}
+
+static void ioa_splice_free(ioa_splice *sp) {
+  for (int i = 0; i < 2; ++i) {
+    ioa_splice_dir *d = &(sp->dirs[i]);
+    EVENT_DEL(d->read_ev);
+    EVENT_DEL(d->write_ev);
+    for (int j = 0; j < 2; ++j) {
+      if (d->pipe_fds[j] >= 0) {
+        close(d->pipe_fds[j]);
+      }
+    }
+  }
+  free(sp);
+}
+
+static void ioa_splice_release(ioa_socket_handle s) {
+  ioa_splice *sp = s ? s->splice : NULL;
+  if (!sp) {
+    return;
+  }
+  const bool active = sp->active;
+  for (int i = 0; i < 2; ++i) {
+    ioa_socket_handle x = sp->dirs[i].src;
+    x->splice = NULL;
+    /* Normally both sockets close together; if one survives, give it its
+     * bufferevent back. */
+    if (active && (x != s) && (x->magic == SOCKET_MAGIC) && !(x->done) && x->bev) {
+      bufferevent_enable(x->bev, EV_READ | EV_WRITE);
+    }
+  }
+  ioa_splice_free(sp);
+}
+
+static void ioa_splice_try_start(ioa_socket_handle s) {
+  ioa_splice *sp = s->splice;
+  if (!sp || sp->active) {
+    return;
+  }
+
+  ioa_socket_handle a = sp->dirs[0].src;
+  ioa_socket_handle b = sp->dirs[1].src;
+  if (!ioa_splice_socket_eligible(a) || !ioa_splice_socket_eligible(b)) {
+    ioa_splice_release(s);
+    return;
+  }
+  if (!ioa_splice_socket_idle(a) || !ioa_splice_socket_idle(b)) {
+    return;
+  }
+
+  for (int i = 0; i < 2; ++i) {
+    ioa_splice_dir *d = &(sp->dirs[i]);
+    if (pipe2(d->pipe_fds, O_NONBLOCK | O_CLOEXEC) < 0) {
+      d->pipe_fds[0] = d->pipe_fds[1] = -1;
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "cannot create splice pipe: %s\n", strerror(errno));
+      ioa_splice_release(s);
+      return;
+    }
+    d->read_ev = event_new(s->e->event_base, d->src->fd, EV_READ | EV_PERSIST, ioa_splice_read_handler, d);
+    d->write_ev = event_new(s->e->event_base, d->dst->fd, EV_WRITE | EV_PERSIST, ioa_splice_write_handler, d);
+  }
+
+  bufferevent_disable(a->bev, EV_READ | EV_WRITE);
+  bufferevent_disable(b->bev, EV_READ | EV_WRITE);
+  for (int i = 0; i < 2; ++i) {
+    event_add(sp->dirs[i].read_ev, NULL);
+  }
+  sp->active = true;
+
+  log_socket_event(a, "RFC 6062 data connection spliced", 0);
+}
+
+int splice_ioa_sockets(ioa_socket_handle s1, ioa_socket_handle s2, ioa_splice_event_handler cb, void *ctx) {
+  if (!turn_params.tcp_splice || !ioa_splice_socket_eligible(s1) || !ioa_splice_socket_eligible(s2) ||
+      (s1->e != s2->e)) {
+    return -1;
+  }
+  if (s1->splice || s2->splice) {
+    return (s1->splice == s2->splice) ? 0 : -1;
+  }
+
+  ioa_splice *sp = (ioa_splice *)calloc(1, sizeof(ioa_splice));
+  if (!sp) {
+    return -1;
+  }
+  sp->cb = cb;
+  sp->ctx = ctx;
+  for (int i = 0; i < 2; ++i) {
+    sp->dirs[i].src = i ? s2 : s1;
+    sp->dirs[i].dst = i ? s1 : s2;
+    sp->dirs[i].pipe_fds[0] = sp->dirs[i].pipe_fds[1] = -1;
+  }
+  s1->splice = sp;
+  s2->splice = sp;
+
+  ioa_splice_try_start(s1);
+  return s1->splice ? 0 : -1;
+}
+
+#else
+
+static void ioa_splice_try_start(ioa_socket_handle s) { UNUSED_ARG(s); }
+
+static void ioa_splice_release(ioa_socket_handle s) { UNUSED_ARG(s); }
+
+int splice_ioa_sockets(ioa_socket_handle s1, ioa_socket_handle s2, ioa_splice_event_handler cb, void *ctx) {
+  UNUSED_ARG(s1);
+  UNUSED_ARG(s2);
+  UNUSED_ARG(cb);
+  UNUSED_ARG(ctx);
+  return -1;
+}
+
+#endif
+
+/************** TLS handshake pool ****************/
+
+/*
+ * --tls-handshake-threads: a new client connection is handed to a handshake
+ * thread first, which waits for its first bytes and, if they start a TLS
+ * ClientHello, runs the whole handshake there with SSL_do_handshake() on the
+ * raw fd. The socket then goes to its relay thread with an established SSL,
+ * where register_callback_on_ioa_socket() wraps it in an open bufferevent.
+ * OpenSSL reads record by record, so nothing past the handshake is consumed.
+ */
+
+typedef struct _ioa_tls_handshake {
+  ioa_socket_handle s;
+  struct event *ev;
+  int timeout_secs;
+  ioa_tls_handshake_cb cb;
+  void *arg;
+} ioa_tls_handshake;
+
+static void ioa_tls_handshake_handler(evutil_socket_t fd, short what, void *arg);
+
+static void ioa_tls_handshake_finish(ioa_tls_handshake *hs, int result) {
+  ioa_socket_handle s = hs->s;
+  ioa_tls_handshake_cb cb = hs->cb;
+  void *arg = hs->arg;
+  EVENT_DEL(hs->ev);
+  free(hs);
+  cb(s, result, arg);
+}
+
+static void ioa_tls_handshake_wait(ioa_tls_handshake *hs, short what) {
+  EVENT_DEL(hs->ev);
+  hs->ev = event_new(hs->s->e->event_base, hs->s->fd, what, ioa_tls_handshake_handler, hs);
+  const struct timeval tv = {hs->timeout_secs, 0};
+  if (!(hs->ev) || (event_add(hs->ev, &tv) < 0)) {
+    ioa_tls_handshake_finish(hs, -1);
+  }
+}
+
+static void ioa_tls_handshake_handler(evutil_socket_t fd, short what, void *arg) {
+  ioa_tls_handshake *hs = (ioa_tls_handshake *)arg;
+  ioa_socket_handle s = hs->s;
+
+  if (what & EV_TIMEOUT) {
+    ioa_tls_handshake_finish(hs, -1);
+    return;
+  }
+
+#if TLS_SUPPORTED
+  if (s->st == TENTATIVE_TCP_SOCKET) {
+    if (!check_tentative_tls(fd)) {
+      /* Plain TCP: the relay thread reads it as usual. */
+      ioa_tls_handshake_finish(hs, 0);
+      return;
+    }
+    s->st = TLS_SOCKET;
+  }
+
+  if (!(s->ssl)) {
+    if (s->e->tls_ctx) {
+      set_socket_ssl(s, SSL_new(s->e->tls_ctx));
+    }
+    if (!(s->ssl) || !SSL_set_fd(s->ssl, fd)) {
+      ioa_tls_handshake_finish(hs, -1);
+      return;
+    }
+    SSL_set_accept_state(s->ssl);
+  }
+
+  ERR_clear_error();
+  const int rc = SSL_do_handshake(s->ssl);
+  if (rc == 1) {
+    ioa_tls_handshake_finish(hs, 1);
+    return;
+  }
+  switch (SSL_get_error(s->ssl, rc)) {
+  case SSL_ERROR_WANT_READ:
+    ioa_tls_handshake_wait(hs, EV_READ);
+    break;
+  case SSL_ERROR_WANT_WRITE:
+    ioa_tls_handshake_wait(hs, EV_WRITE);
+    break;
+  default:
+    if (eve(s->e->verbose)) {
+      const char *reason = ERR_reason_error_string(ERR_peek_error());
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_INFO, "%s: socket %p: TLS handshake failed: %s\n", __FUNCTION__, s,
+                    reason ? reason : "connection closed");
+    }
+    ioa_tls_handshake_finish(hs, -1);
+  }
+#else
+  UNUSED_ARG(fd);
+  ioa_tls_handshake_finish(hs, 0);
+#endif
+}
+
+int ioa_socket_tls_handshake(ioa_engine_handle e, ioa_socket_handle s, int timeout_secs, ioa_tls_handshake_cb cb,
+                             void *arg) {
+  if (!e || !s || (s->fd < 0) || s->bev || s->read_event || !cb ||
+      ((s->st != TENTATIVE_TCP_SOCKET) && (s->st != TLS_SOCKET))) {
+    return -1;
+  }
+  ioa_tls_handshake *hs = (ioa_tls_handshake *)calloc(1, sizeof(ioa_tls_handshake));
+  if (!hs) {
+    return -1;
+  }
+  s->e = e;
+  hs->s = s;
+  hs->timeout_secs = timeout_secs;
+  hs->cb = cb;
+  hs->arg = arg;
+  ioa_tls_handshake_wait(hs, EV_READ);
+  return 0;
+}
+
 static void socket_output_handler_bev(struct bufferevent *bev, void *arg) {
 
   UNUSED_ARG(bev);
   UNUSED_ARG(arg);
 
+  if (bev && arg) {
+    ioa_socket_handle s = (ioa_socket_handle)arg;
+    if (s->splice && !(s->in_write) && (s->magic == SOCKET_MAGIC) && !(s->done) && !(s->tobeclosed) &&
+        (bev == s->bev)) {
+      /* The output just drained; this may be the last buffered data that
+       * kept the pair off the splice path. */
+      ioa_splice_try_start(s);
+      if (s->splice && s->splice->active) {
+        return;
+      }
+    }
+  }
+
   if (tcp_congestion_control) {
 
     if (bev && arg) {
@@ -3598,6 +4481,10 @@ static void socket_input_handler_bev(struct bufferevent *bev, void *arg) {
       return;
     }
 
+    if (s->splice && !(s->tobeclosed)) {
+      ioa_splice_try_start(s);
+    }
+
     close_ioa_socket_after_processing_if_necessary(s);
   }
 }
@@ -3853,8 +4740,8 @@ static int send_ssl_backlog_buffers(ioa_socket_handle s) {
   if (s) {
     stun_buffer_list_elem *buf_elem = s->bufs.head;
     while (buf_elem) {
-      const int rc = ssl_send(s, (char *)buf_elem->buf.buf + buf_elem->buf.offset - buf_elem->buf.coffset,
-                              (size_t)buf_elem->buf.len, (s->e ? s->e->verbose : TURN_VERBOSE_NONE));
+      const int rc = ssl_send(s, (char *)buf_elem->buf + buf_elem->offset - buf_elem->coffset, (size_t)buf_elem->len,
+                              (s->e ? s->e->verbose : TURN_VERBOSE_NONE));
       if (rc < 1) {
         break;
       }
@@ -3881,6 +4768,8 @@ typedef struct udp_sendmmsg_batch_entry {
   ioa_socket_handle s;
   ioa_engine_handle e;
   evutil_socket_t fd;
+  int ttl;
+  int tos;
   ioa_addr dest_addr;
   int has_dest_addr;
   ioa_network_buffer_handle nbh;
@@ -3888,22 +4777,17 @@ typedef struct udp_sendmmsg_batch_entry {
   struct iovec iov;
 } udp_sendmmsg_batch_entry;
 
+/* One thread-local egress batch spans every fd written inside the window: the
+ * client listener's input batch fans out to many per-session relay sockets, so
+ * entries are grouped by fd only at flush time (sendmmsg() and GSO are per fd).
+ * Within one fd, entries keep their enqueue order. */
 typedef struct udp_sendmmsg_batch_state {
   unsigned int depth;
   unsigned int count;
-  evutil_socket_t fd;
-  int ttl;
-  int tos;
-  /* GSO eligibility tracked while enqueuing: when true, all entries so far
-   * share the same destination address and size, so the batch can be flushed
-   * with one sendmsg + UDP_SEGMENT cmsg instead of N sendmsg-equivalents. */
-  int gso_eligible;
-  uint16_t gso_size;
   udp_sendmmsg_batch_entry entries[MAX_SENDMMSG_BATCH];
-  /* Contiguous mmsghdr array passed straight to sendmmsg(), which requires a
-   * packed array (stride sizeof(struct mmsghdr)). Each slot is filled at
-   * enqueue time and points at the matching entry's stable iov/dest_addr, so
-   * the flush path needs no per-call rebuild or copy. */
+  /* Packed mmsghdr slots, filled at enqueue time and pointing at the matching
+   * entry's stable iov/dest_addr. A single-fd batch is handed to sendmmsg()
+   * as is; a mixed one is packed per fd at flush time. */
   struct mmsghdr msgs[MAX_SENDMMSG_BATCH];
 } udp_sendmmsg_batch_state;
 
@@ -3921,23 +4805,42 @@ static evutil_socket_t udp_send_fd(ioa_socket_handle s) {
   return s->fd;
 }
 
-/* Attempt to flush the batch as a single UDP-GSO sendmsg.
- * Returns the number of datagrams handed to the kernel (== state->count) on
- * success, or 0 if the GSO path is disabled / not eligible / not supported.
+/* UDP-GSO needs every datagram of the group to share the destination and the
+ * segment size. Returns that size, or 0 if the group cannot be segmented. */
+static uint16_t udp_gso_group_size(const unsigned int *idx, unsigned int n) {
+  const udp_sendmmsg_batch_entry *first = &(udp_sendmmsg_batch.entries[idx[0]]);
+
+  if (n < MIN_UDP_GSO_BATCH || first->len <= 0 || first->len > MAX_UDP_GSO_DGRAM_SIZE) {
+    return 0;
+  }
+
+  for (unsigned int i = 1; i < n; ++i) {
+    const udp_sendmmsg_batch_entry *entry = &(udp_sendmmsg_batch.entries[idx[i]]);
+    if (entry->len != first->len || entry->has_dest_addr != first->has_dest_addr ||
+        (entry->has_dest_addr && !addr_eq(&(entry->dest_addr), &(first->dest_addr)))) {
+      return 0;
+    }
+  }
+
+  return (uint16_t)first->len;
+}
+
+/* Attempt to flush one fd's group as a single UDP-GSO sendmsg.
+ * Returns the number of datagrams handed to the kernel (== n) on success, or
+ * 0 if the GSO path is disabled / not eligible / not supported.
  * On EINVAL/ENOPROTOOPT the GSO flag is sticky-disabled to avoid retrying.
  */
-static int udp_gso_attempt_flush(void) {
+static int udp_gso_attempt_flush(evutil_socket_t fd, const unsigned int *idx, unsigned int n) {
   udp_sendmmsg_batch_state *state = &udp_sendmmsg_batch;
 
-  if (!turn_params.udp_gso || !state->gso_eligible || state->count < MIN_UDP_GSO_BATCH || state->gso_size == 0 ||
-      state->gso_size > MAX_UDP_GSO_DGRAM_SIZE || state->fd < 0) {
+  const uint16_t gso_size = udp_gso_group_size(idx, n);
+  if (!turn_params.udp_gso || gso_size == 0 || fd < 0) {
     return 0;
   }
 
   struct iovec iov[MAX_SENDMMSG_BATCH];
-  for (unsigned int i = 0; i < state->count; ++i) {
-    iov[i].iov_base = ioa_network_buffer_data(state->entries[i].nbh);
-    iov[i].iov_len = (size_t)state->entries[i].len;
+  for (unsigned int i = 0; i < n; ++i) {
+    iov[i] = state->entries[idx[i]].iov;
   }
 
   union {
@@ -3945,12 +4848,13 @@ static int udp_gso_attempt_flush(void) {
     char buf[CMSG_SPACE(sizeof(uint16_t))];
   } cmsg_buf = {0};
 
+  const udp_sendmmsg_batch_entry *first = &(state->entries[idx[0]]);
   struct msghdr mh = {0};
   mh.msg_iov = iov;
-  mh.msg_iovlen = state->count;
-  if (state->entries[0].has_dest_addr) {
-    mh.msg_name = &(state->entries[0].dest_addr);
-    mh.msg_namelen = (socklen_t)get_ioa_addr_len(&(state->entries[0].dest_addr));
+  mh.msg_iovlen = n;
+  if (first->has_dest_addr) {
+    mh.msg_name = (void *)&(first->dest_addr);
+    mh.msg_namelen = (socklen_t)get_ioa_addr_len(&(first->dest_addr));
   }
   mh.msg_control = cmsg_buf.buf;
   mh.msg_controllen = sizeof(cmsg_buf.buf);
@@ -3959,12 +4863,11 @@ static int udp_gso_attempt_flush(void) {
   cm->cmsg_level = SOL_UDP;
   cm->cmsg_type = UDP_SEGMENT;
   cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
-  uint16_t seg = state->gso_size;
-  memcpy(CMSG_DATA(cm), &seg, sizeof(seg));
+  memcpy(CMSG_DATA(cm), &gso_size, sizeof(gso_size));
 
   ssize_t rc = 0;
   do {
-    rc = sendmsg(state->fd, &mh, 0);
+    rc = sendmsg(fd, &mh, 0);
   } while (rc < 0 && socket_eintr());
 
   if (rc < 0) {
@@ -3978,39 +4881,104 @@ static int udp_gso_attempt_flush(void) {
     return 0;
   }
 
-  return (int)state->count;
+  return (int)n;
 }
 
-static int udp_sendmmsg_flush(void) {
+static void udp_sendmmsg_entry_send(const udp_sendmmsg_batch_entry *entry) {
+  udp_send(entry->s, entry->has_dest_addr ? &(entry->dest_addr) : NULL,
+           (const char *)ioa_network_buffer_data(entry->nbh), entry->len);
+}
+
+/* Failed and never-submitted sends go out with a plain sendto(), except
+ * when the socket is congested, where a second copy would only add to the
+ * load. An abandoned send's buffer may still be read by the kernel, so it is
+ * leaked rather than returned to the pool. */
+static void udp_io_uring_send_done(void *cookie, int res, void *arg) {
+  UNUSED_ARG(arg);
+  udp_sendmmsg_batch_entry *entry = (udp_sendmmsg_batch_entry *)cookie;
+
+  switch (res) {
+  case -EAGAIN:
+  case -ENOBUFS:
+    break;
+  case -ETIMEDOUT:
+    entry->nbh = NULL;
+    break;
+  default:
+    if (res < 0) {
+      udp_sendmmsg_entry_send(entry);
+    }
+  }
+}
+
+/* --udp-io-uring: the engine's send ring, created on first use. NULL (and
+ * sendmmsg() is used) if the ring cannot be created. */
+static ioa_uring *udp_io_uring_send_ring(ioa_engine_handle e) {
+  if (!turn_params.udp_io_uring || !e) {
+    return NULL;
+  }
+
+  if (!e->uring_send && !e->uring_send_unavailable) {
+    e->uring_send = ioa_uring_create(MAX_SENDMMSG_BATCH, 0, 0, 0);
+    if (!e->uring_send) {
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_WARNING, "%s: cannot create io_uring send ring, using sendmmsg\n", __FUNCTION__);
+      e->uring_send_unavailable = true;
+    }
+  }
+
+  return e->uring_send;
+}
+
+/* Sends one fd's group: GSO if it qualifies, else one by one when short,
+ * else queued on the io_uring send ring or written with sendmmsg(). Returns
+ * the number of datagrams sent via GSO. */
+static unsigned int udp_sendmmsg_flush_group(evutil_socket_t fd, const unsigned int *idx, unsigned int n,
+                                             ioa_uring *ring) {
   udp_sendmmsg_batch_state *state = &udp_sendmmsg_batch;
   unsigned int sent = 0;
   unsigned int gso_sent = 0;
-  const unsigned int batch_count = state->count;
-  /* All entries in a thread-local batch share the relay thread's engine. */
-  ioa_engine_handle stat_e = (batch_count > 0) ? state->entries[0].e : NULL;
 
   if (turn_params.udp_gso) {
-    gso_sent = (unsigned int)udp_gso_attempt_flush();
+    gso_sent = (unsigned int)udp_gso_attempt_flush(fd, idx, n);
     sent = gso_sent;
   }
 
-  if (sent < state->count && (state->count - sent) < MIN_SENDMMSG_BATCH) {
-    for (unsigned int i = sent; i < state->count; ++i) {
-      udp_sendmmsg_batch_entry *entry = &(state->entries[i]);
-      udp_send(entry->s, entry->has_dest_addr ? &(entry->dest_addr) : NULL,
-               (const char *)ioa_network_buffer_data(entry->nbh), entry->len);
+  if (sent < n && (n - sent) < MIN_SENDMMSG_BATCH) {
+    for (unsigned int i = sent; i < n; ++i) {
+      udp_sendmmsg_entry_send(&(state->entries[idx[i]]));
+    }
+    return gso_sent;
+  }
+
+  if (sent < n && ring) {
+    for (unsigned int i = sent; i < n; ++i) {
+      udp_sendmmsg_batch_entry *entry = &(state->entries[idx[i]]);
+      const struct msghdr *mh = &(state->msgs[idx[i]].msg_hdr);
+      /* The ring holds a whole batch and every flush drains it, so it is never
+       * full here; fall back rather than assume it. */
+      if (ioa_uring_send_queue(ring, fd, (const struct sockaddr *)mh->msg_name, mh->msg_namelen, entry->iov.iov_base,
+                               entry->iov.iov_len, entry) < 0) {
+        udp_sendmmsg_entry_send(entry);
+      }
     }
+    return gso_sent;
+  }
 
-    sent = state->count;
+  /* A group made of consecutive entries is already packed in state->msgs. */
+  struct mmsghdr packed[MAX_SENDMMSG_BATCH];
+  struct mmsghdr *msgs = &(state->msgs[idx[0]]);
+  if (idx[n - 1] - idx[0] != n - 1) {
+    for (unsigned int i = 0; i < n; ++i) {
+      packed[i] = state->msgs[idx[i]];
+    }
+    msgs = packed;
   }
 
-  /* state->msgs is already packed contiguously and was filled at enqueue
-   * time, so it can be handed straight to sendmmsg() without any rebuild. */
-  while (sent < state->count) {
+  while (sent < n) {
     int rc = 0;
 
     do {
-      rc = sendmmsg(state->fd, &(state->msgs[sent]), state->count - sent, 0);
+      rc = sendmmsg(fd, &(msgs[sent]), n - sent, 0);
     } while (rc < 0 && socket_eintr());
 
     if (rc <= 0) {
@@ -4020,26 +4988,60 @@ static int udp_sendmmsg_flush(void) {
     sent += (unsigned int)rc;
   }
 
-  for (unsigned int i = sent; i < state->count; ++i) {
-    udp_sendmmsg_batch_entry *entry = &(state->entries[i]);
-    udp_send(entry->s, entry->has_dest_addr ? &(entry->dest_addr) : NULL,
-             (const char *)ioa_network_buffer_data(entry->nbh), entry->len);
+  for (unsigned int i = sent; i < n; ++i) {
+    udp_sendmmsg_entry_send(&(state->entries[idx[i]]));
   }
 
-  for (unsigned int i = 0; i < state->count; ++i) {
+  return gso_sent;
+}
+
+static int udp_sendmmsg_flush(void) {
+  udp_sendmmsg_batch_state *state = &udp_sendmmsg_batch;
+  unsigned int gso_sent = 0;
+  const unsigned int batch_count = state->count;
+  /* All entries in a thread-local batch share the relay thread's engine. */
+  ioa_engine_handle stat_e = (batch_count > 0) ? state->entries[0].e : NULL;
+  ioa_uring *ring = udp_io_uring_send_ring(stat_e);
+
+  bool grouped[MAX_SENDMMSG_BATCH] = {false};
+  unsigned int idx[MAX_SENDMMSG_BATCH];
+  unsigned int fd_groups = 0;
+
+  for (unsigned int i = 0; i < batch_count; ++i) {
+    if (grouped[i]) {
+      continue;
+    }
+
+    const evutil_socket_t fd = state->entries[i].fd;
+    unsigned int n = 0;
+    for (unsigned int j = i; j < batch_count; ++j) {
+      if (!grouped[j] && state->entries[j].fd == fd) {
+        grouped[j] = true;
+        idx[n++] = j;
+      }
+    }
+
+    gso_sent += udp_sendmmsg_flush_group(fd, idx, n, ring);
+    ++fd_groups;
+  }
+
+  /* Every fd's queued operations go out in one submission. */
+  if (ring && (ioa_uring_send_submit(ring, udp_io_uring_send_done, NULL) < 0)) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_WARNING, "%s: io_uring send ring failed, using sendmmsg\n", __FUNCTION__);
+    ioa_uring_free(ring);
+    stat_e->uring_send = NULL;
+    stat_e->uring_send_unavailable = true;
+  }
+
+  for (unsigned int i = 0; i < batch_count; ++i) {
     ioa_network_buffer_delete(state->entries[i].e, state->entries[i].nbh);
   }
 
-  ioa_engine_record_udp_sendmmsg_flush(stat_e, batch_count, gso_sent);
+  ioa_engine_record_udp_sendmmsg_flush(stat_e, batch_count, fd_groups, gso_sent);
 
   state->count = 0;
-  state->fd = -1;
-  state->ttl = TTL_IGNORE;
-  state->tos = TOS_IGNORE;
-  state->gso_eligible = 0;
-  state->gso_size = 0;
 
-  return (int)sent;
+  return (int)batch_count;
 }
 
 void udp_sendmmsg_batch_begin(void) {
@@ -4061,6 +5063,19 @@ void udp_sendmmsg_batch_end(void) {
   }
 }
 
+/* True if an entry queued for fd was written under other socket options. */
+static bool udp_sendmmsg_options_differ(evutil_socket_t fd, int ttl, int tos) {
+  udp_sendmmsg_batch_state *state = &udp_sendmmsg_batch;
+
+  for (unsigned int i = 0; i < state->count; ++i) {
+    if (state->entries[i].fd == fd && (state->entries[i].ttl != ttl || state->entries[i].tos != tos)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
 static int udp_sendmmsg_enqueue(ioa_socket_handle s, const ioa_addr *dest_addr, ioa_network_buffer_handle nbh, int ttl,
                                 int tos) {
   udp_sendmmsg_batch_state *state = &udp_sendmmsg_batch;
@@ -4070,27 +5085,17 @@ static int udp_sendmmsg_enqueue(ioa_socket_handle s, const ioa_addr *dest_addr,
     return 0;
   }
 
-  if (state->count > 0 && (state->fd != fd || state->ttl != ttl || state->tos != tos)) {
-    udp_sendmmsg_flush();
-  }
-
-  if (state->count == MAX_SENDMMSG_BATCH) {
+  if (state->count == MAX_SENDMMSG_BATCH || udp_sendmmsg_options_differ(fd, ttl, tos)) {
     udp_sendmmsg_flush();
   }
 
-  if (state->count == 0) {
-    state->fd = fd;
-    state->ttl = ttl;
-    state->tos = tos;
-    state->gso_eligible = 1;
-    state->gso_size = 0;
-  }
-
   udp_sendmmsg_batch_entry *entry = &(state->entries[state->count]);
   memset(entry, 0, sizeof(*entry));
   entry->s = s;
   entry->e = s->e;
   entry->fd = fd;
+  entry->ttl = ttl;
+  entry->tos = tos;
   entry->nbh = nbh;
   entry->len = (int)ioa_network_buffer_get_size(nbh);
   entry->has_dest_addr = dest_addr != NULL;
@@ -4111,22 +5116,6 @@ static int udp_sendmmsg_enqueue(ioa_socket_handle s, const ioa_addr *dest_addr,
   mh->msg_hdr.msg_iov = &(entry->iov);
   mh->msg_hdr.msg_iovlen = 1;
 
-  /* Maintain GSO eligibility: same dest, same size, fits one segment. */
-  if (state->gso_eligible) {
-    if (entry->len <= 0 || entry->len > MAX_UDP_GSO_DGRAM_SIZE) {
-      state->gso_eligible = 0;
-    } else if (state->count == 0) {
-      /* First entry — lock in the segment size and dest. */
-      state->gso_size = (uint16_t)entry->len;
-    } else if ((uint16_t)entry->len != state->gso_size) {
-      state->gso_eligible = 0;
-    } else if (state->entries[0].has_dest_addr != entry->has_dest_addr) {
-      state->gso_eligible = 0;
-    } else if (entry->has_dest_addr && !addr_eq(&(entry->dest_addr), &(state->entries[0].dest_addr))) {
-      state->gso_eligible = 0;
-    }
-  }
-
   ++state->count;
 
   return 1;
@@ -4139,35 +5128,21 @@ static void udp_sendmmsg_flush_if_pending(void) {
 }
 
 static void udp_sendmmsg_flush_before_socket_options(ioa_socket_handle s, int ttl, int tos) {
-  udp_sendmmsg_batch_state *state = &udp_sendmmsg_batch;
-
-  if (state->count == 0) {
-    return;
-  }
-
-  if (state->fd == udp_send_fd(s) && (state->ttl != ttl || state->tos != tos)) {
+  if (udp_sendmmsg_batch.count > 0 && udp_sendmmsg_options_differ(udp_send_fd(s), ttl, tos)) {
     udp_sendmmsg_flush();
   }
 }
 
 static void udp_sendmmsg_flush_before_socket_invalidation(ioa_socket_handle s) {
   udp_sendmmsg_batch_state *state = &udp_sendmmsg_batch;
-
-  if (state->count == 0) {
-    return;
-  }
+  const evutil_socket_t fd = udp_send_fd(s);
 
   /* sendmmsg()/GSO write to the cached fd, so a socket can invalidate the batch
-   * without owning any entry: child sockets queue under their parent's fd. */
-  if (state->fd == udp_send_fd(s)) {
-    udp_sendmmsg_flush();
-    return;
-  }
-
-  /* A detached socket no longer resolves to the batch fd, but its queued
-   * entries still point at it. */
+   * without owning any entry: child sockets queue under their parent's fd. A
+   * detached socket no longer resolves to that fd, but its queued entries
+   * still point at it. */
   for (unsigned int i = 0; i < state->count; ++i) {
-    if (state->entries[i].s == s) {
+    if ((fd >= 0 && state->entries[i].fd == fd) || state->entries[i].s == s) {
       udp_sendmmsg_flush();
       return;
     }
@@ -4296,6 +5271,13 @@ int send_data_from_ioa_socket_nbh(ioa_socket_handle s, ioa_addr *dest_addr, ioa_
       break;
     }
 
+    if (s->splice && s->splice->active) {
+      /* The kernel owns the stream now; a write here would reorder it. */
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_WARNING, "!!! %s: send on spliced socket: %p, st=%d, sat=%d\n", __FUNCTION__, s,
+                    s->st, s->sat);
+      break;
+    }
+
     /* A pending sendmmsg batch was queued under the previous ttl/tos and is
      * per-fd; drain it before we mutate socket options or switch transports. */
     udp_sendmmsg_flush_before_socket_options(s, ttl, tos);
@@ -4558,6 +5540,7 @@ int register_callback_on_ioa_socket(ioa_engine_handle e, ioa_socket_handle s, in
       }
 
       s->read_cb = cb;
+      s->read_batch_cb = NULL;
       s->read_ctx = ctx;
       return 0;
     }
@@ -4567,6 +5550,14 @@ int register_callback_on_ioa_socket(ioa_engine_handle e, ioa_socket_handle s, in
   return -1;
 }
 
+int register_batch_callback_on_ioa_socket(ioa_socket_handle s, ioa_net_batch_event_handler cb) {
+  if (!s || !(s->read_cb)) {
+    return -1;
+  }
+  s->read_batch_cb = cb;
+  return 0;
+}
+
 int ioa_socket_tobeclosed(ioa_socket_handle s) {
   if (s) {
     if (s->magic != SOCKET_MAGIC) {
@@ -4611,12 +5602,10 @@ void set_ioa_socket_tobeclosed(ioa_socket_handle s) {
 /*
  * Network buffer functions
  */
-ioa_network_buffer_handle ioa_network_buffer_allocate(ioa_engine_handle e) {
-  stun_buffer_list_elem *buf_elem = new_blist_elem(e);
-  buf_elem->buf.len = 0;
-  buf_elem->buf.offset = 0;
-  buf_elem->buf.coffset = 0;
-  return buf_elem;
+ioa_network_buffer_handle ioa_network_buffer_allocate(ioa_engine_handle e) { return new_blist_elem(e); }
+
+ioa_network_buffer_handle ioa_network_buffer_allocate_size(ioa_engine_handle e, size_t size) {
+  return new_blist_elem_class(e, nbh_class_for_size(size));
 }
 
 /* We do not use special header in this simple implementation */
@@ -4625,15 +5614,15 @@ void ioa_network_buffer_header_init(ioa_network_buffer_handle nbh) { UNUSED_ARG(
 void ioa_network_buffer_reset(ioa_network_buffer_handle nbh) {
   if (nbh) {
     stun_buffer_list_elem *buf_elem = (stun_buffer_list_elem *)nbh;
-    buf_elem->buf.len = 0;
-    buf_elem->buf.offset = 0;
-    buf_elem->buf.coffset = 0;
+    buf_elem->len = 0;
+    buf_elem->offset = 0;
+    buf_elem->coffset = 0;
   }
 }
 
 uint8_t *ioa_network_buffer_data(ioa_network_buffer_handle nbh) {
   stun_buffer_list_elem *buf_elem = (stun_buffer_list_elem *)nbh;
-  return buf_elem->buf.buf + buf_elem->buf.offset - buf_elem->buf.coffset;
+  return buf_elem->buf + buf_elem->offset - buf_elem->coffset;
 }
 
 size_t ioa_network_buffer_get_size(ioa_network_buffer_handle nbh) {
@@ -4641,7 +5630,7 @@ size_t ioa_network_buffer_get_size(ioa_network_buffer_handle nbh) {
     return 0;
   } else {
     stun_buffer_list_elem *buf_elem = (stun_buffer_list_elem *)nbh;
-    return (size_t)(buf_elem->buf.len);
+    return (size_t)(buf_elem->len);
   }
 }
 
@@ -4650,8 +5639,9 @@ size_t ioa_network_buffer_get_capacity(ioa_network_buffer_handle nbh) {
     return 0;
   } else {
     stun_buffer_list_elem *buf_elem = (stun_buffer_list_elem *)nbh;
-    if (buf_elem->buf.offset < STUN_BUFFER_SIZE) {
-      return (STUN_BUFFER_SIZE - buf_elem->buf.offset);
+    const size_t capacity = nbh_class_capacity[buf_elem->size_class];
+    if (buf_elem->offset < capacity) {
+      return (capacity - buf_elem->offset);
     }
     return 0;
   }
@@ -4661,31 +5651,31 @@ size_t ioa_network_buffer_get_capacity_udp(void) { return UDP_STUN_BUFFER_SIZE;
 
 void ioa_network_buffer_set_size(ioa_network_buffer_handle nbh, size_t len) {
   stun_buffer_list_elem *buf_elem = (stun_buffer_list_elem *)nbh;
-  buf_elem->buf.len = (size_t)len;
+  buf_elem->len = (size_t)len;
 }
 
 void ioa_network_buffer_add_offset_size(ioa_network_buffer_handle nbh, uint16_t offset, uint8_t coffset, size_t len) {
   stun_buffer_list_elem *buf_elem = (stun_buffer_list_elem *)nbh;
-  buf_elem->buf.len = (size_t)len;
-  buf_elem->buf.offset += offset;
-  buf_elem->buf.coffset += coffset;
+  buf_elem->len = (size_t)len;
+  buf_elem->offset += offset;
+  buf_elem->coffset += coffset;
 
-  if ((buf_elem->buf.offset + buf_elem->buf.len - buf_elem->buf.coffset) >= sizeof(buf_elem->buf.buf) ||
-      (buf_elem->buf.offset + sizeof(buf_elem->buf.channel) < buf_elem->buf.coffset)) {
-    buf_elem->buf.coffset = 0;
-    buf_elem->buf.len = 0;
-    buf_elem->buf.offset = 0;
+  if ((buf_elem->offset + buf_elem->len - buf_elem->coffset) >= nbh_class_capacity[buf_elem->size_class] ||
+      (buf_elem->offset + sizeof(buf_elem->channel) < buf_elem->coffset)) {
+    buf_elem->coffset = 0;
+    buf_elem->len = 0;
+    buf_elem->offset = 0;
   }
 }
 
 uint16_t ioa_network_buffer_get_offset(ioa_network_buffer_handle nbh) {
   stun_buffer_list_elem *buf_elem = (stun_buffer_list_elem *)nbh;
-  return buf_elem->buf.offset;
+  return buf_elem->offset;
 }
 
 uint8_t ioa_network_buffer_get_coffset(ioa_network_buffer_handle nbh) {
   stun_buffer_list_elem *buf_elem = (stun_buffer_list_elem *)nbh;
-  return buf_elem->buf.coffset;
+  return buf_elem->coffset;
 }
 
 void ioa_network_buffer_delete(ioa_engine_handle e, ioa_network_buffer_handle nbh) {
@@ -4871,6 +5861,11 @@ void turn_report_session_usage(void *session, int force_invalid) {
   if (session) {
     ts_ur_super_session *ss = (ts_ur_super_session *)session;
     turn_turnserver *server = (turn_turnserver *)ss->server;
+    if (server) {
+      const uint32_t bytes = ss->received_bytes + ss->sent_bytes;
+      server->relayed_bytes += bytes - ss->load_counted_bytes;
+      ss->load_counted_bytes = bytes;
+    }
     if (server && (ss->received_packets || ss->sent_packets || force_invalid)) {
       ioa_engine_handle e = turn_server_get_engine(server);
       if (((ss->received_packets + ss->sent_packets + ss->peer_received_packets + ss->peer_sent_packets) & 4095) == 0 ||
@@ -4947,6 +5942,7 @@ void turn_report_session_usage(void *session, int force_invalid) {
         ss->received_bytes = 0;
         ss->sent_packets = 0;
         ss->sent_bytes = 0;
+        ss->load_counted_bytes = 0;
         ss->peer_received_packets = 0;
         ss->peer_received_bytes = 0;
         ss->peer_sent_packets = 0;
@@ -4972,6 +5968,22 @@ const char *get_ioa_socket_tls_method(ioa_socket_handle s) {
   return "";
 }
 
+const char *get_ioa_socket_tls_offload(ioa_socket_handle s) {
+  if (!s || !(s->ssl) || !(s->ktls & IOA_KTLS_CHECKED)) {
+    return "";
+  }
+  switch (s->ktls & (IOA_KTLS_TX | IOA_KTLS_RX)) {
+  case IOA_KTLS_TX | IOA_KTLS_RX:
+    return "tx+rx";
+  case IOA_KTLS_TX:
+    return "tx";
+  case IOA_KTLS_RX:
+    return "rx";
+  default:
+    return "none";
+  }
+}
+
 ///////////// Super Memory Region //////////////
 
 #define TURN_SM_SIZE (1024 << 11)
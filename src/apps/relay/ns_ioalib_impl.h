@@ -44,9 +44,11 @@
 #include "ns_turn_openssl.h"
 
 #include "mp_peer_table.h"
+#include "ns_ioalib_uring.h"
 #include "ns_turn_maps.h"
 #include "ns_turn_maps_rtcp.h"
 #include "ns_turn_server.h"
+#include "relay_queue.h"
 #include "turn_ports.h"
 
 #include "apputils.h"
@@ -81,11 +83,43 @@ extern "C" {
 typedef unsigned char recv_ttl_t;
 typedef unsigned char recv_tos_t;
 
+/* Network buffer size classes. The engine keeps a separate free list per
+ * class, so a datagram on the UDP hot path recycles a small cache-resident
+ * buffer and only TCP/TLS reassembly and server-built messages pay for a full
+ * STUN_BUFFER_SIZE one. The capacities leave STUN_CHANNEL_HEADER_LENGTH bytes
+ * of tail room for the stream padding added when data is forwarded in place. */
+typedef enum {
+  IOA_NBH_CLASS_MTU = 0, /* one Ethernet-MTU datagram; the whole element is 2 KiB */
+  IOA_NBH_CLASS_UDP,     /* the largest UDP read, UDP_STUN_BUFFER_SIZE */
+  IOA_NBH_CLASS_FULL,    /* STUN_BUFFER_SIZE, for stream reassembly and message building */
+  IOA_NBH_CLASSES_NUMBER
+} ioa_nbh_class;
+
+#define IOA_NBH_MTU_ELEM_SIZE (2048)
+#define IOA_NBH_UDP_CAPACITY (UDP_STUN_BUFFER_SIZE + STUN_CHANNEL_HEADER_LENGTH)
+#define IOA_NBH_FULL_CAPACITY (STUN_BUFFER_SIZE)
+
+/* Per-class free-list caps, per engine. */
+#define MAX_MTU_BUFFER_QUEUE_SIZE_PER_ENGINE (1024)
+#define MAX_UDP_BUFFER_QUEUE_SIZE_PER_ENGINE (128)
+
 typedef struct _stun_buffer_list_elem {
   struct _stun_buffer_list_elem *next;
-  stun_buffer buf;
+  size_t len;
+  uint16_t offset;
+  uint8_t coffset;
+  uint8_t size_class; /* ioa_nbh_class */
+  uint8_t channel[STUN_CHANNEL_HEADER_LENGTH];
+  uint8_t buf[]; /* ioa_nbh_class_capacity(size_class) bytes; must follow channel */
 } stun_buffer_list_elem;
 
+#define IOA_NBH_MTU_CAPACITY (IOA_NBH_MTU_ELEM_SIZE - offsetof(stun_buffer_list_elem, buf))
+/* recvmmsg batches scatter each datagram into an MTU-class buffer followed by
+ * a per-slot overflow area; only a datagram that spills past
+ * IOA_NBH_MTU_RECV_SIZE is moved into a UDP-class buffer. */
+#define IOA_NBH_MTU_RECV_SIZE (IOA_NBH_MTU_CAPACITY - STUN_CHANNEL_HEADER_LENGTH)
+#define IOA_NBH_RECV_OVERFLOW_SIZE (UDP_STUN_BUFFER_SIZE - IOA_NBH_MTU_RECV_SIZE)
+
 typedef struct _stun_buffer_list {
   stun_buffer_list_elem *head;
   stun_buffer_list_elem *tail;
@@ -110,17 +144,29 @@ struct cancelled_session_message {
   turnsession_id id;
 };
 
+struct migrated_session_message {
+  turnsession_id id;
+  turnserver_id to;
+  ts_ur_super_session *ss;
+};
+
 struct relay_server {
   turnserver_id id;
   super_memory_t *sm;
   struct event_base *event_base;
-  struct bufferevent *in_buf;
-  struct bufferevent *out_buf;
-  struct bufferevent *auth_in_buf;
-  struct bufferevent *auth_out_buf;
+  relay_queue *queue;      /* struct message_to_relay from other threads */
+  relay_queue *auth_queue; /* struct auth_message back from the auth threads */
   ioa_engine_handle ioa_eng;
   turn_turnserver server;
   pthread_t thr;
+  /* Client connections posted to this thread and not yet opened there. */
+  turn_atomic_u32 placed;
+  /* Smoothed CPU time of this thread in thousandths of a core, published by
+   * the thread's 1-second load timer, and the timer's own bookkeeping. */
+  turn_atomic_u32 load_cpu;
+  uint64_t cpu_us_sampled;
+  uint64_t wall_us_sampled;
+  int imbalance_ticks; /* consecutive ticks as the busiest thread (--relay-rebalance) */
 };
 
 struct message_to_relay {
@@ -130,6 +176,7 @@ struct message_to_relay {
     struct socket_message sm;
     struct cb_socket_message cb_sm;
     struct cancelled_session_message csm;
+    struct migrated_session_message msm;
   } m;
 };
 
@@ -150,8 +197,18 @@ struct _ioa_engine {
   int deallocate_eb;
   int verbose;
   turnipports *tp;
+  int tp_shard; /* relay port shard this engine allocates from first */
+  uint64_t tp_steals_prom_flushed;
   rtcp_map *map_rtcp;
-  stun_buffer_list bufs;
+  stun_buffer_list bufs[IOA_NBH_CLASSES_NUMBER];
+  /* Network buffer pool stats, per size class: buffers handed out, and how
+   * many of those were recycled from the free list instead of malloc'd. The
+   * *_prom_flushed fields snapshot the values last pushed to prometheus. */
+  uint64_t nbh_allocs[IOA_NBH_CLASSES_NUMBER];
+  uint64_t nbh_reuses[IOA_NBH_CLASSES_NUMBER];
+  uint64_t nbh_allocs_prom_flushed[IOA_NBH_CLASSES_NUMBER];
+  uint64_t nbh_reuses_prom_flushed[IOA_NBH_CLASSES_NUMBER];
+  size_t nbh_pooled_prom_flushed[IOA_NBH_CLASSES_NUMBER];
   SSL_CTX *tls_ctx;
   SSL_CTX *dtls_ctx;
   turn_time_t jiffie; /* bandwidth check interval */
@@ -186,6 +243,7 @@ struct _ioa_engine {
   /* sendmmsg / UDP-GSO egress batching stats (see --udp-sendmmsg-log) */
   uint64_t udp_sendmmsg_flushes;                              /* batch flushes carrying >=1 datagram */
   uint64_t udp_sendmmsg_datagrams;                            /* total datagrams handed to the kernel via batches */
+  uint64_t udp_sendmmsg_fd_groups;                            /* per-socket groups the flushes were split into */
   uint64_t udp_sendmmsg_gso_flushes;                          /* flushes that coalesced via a single UDP-GSO sendmsg */
   uint64_t udp_sendmmsg_gso_datagrams;                        /* datagrams coalesced via UDP-GSO */
   uint64_t udp_sendmmsg_hist[IOA_UDP_SENDMMSG_MAX_BATCH + 1]; /* per-flush occupancy histogram */
@@ -197,6 +255,16 @@ struct _ioa_engine {
   uint64_t udp_sendmmsg_flushes_prom_flushed;
   uint64_t udp_sendmmsg_datagrams_prom_flushed;
   uint64_t udp_sendmmsg_gso_datagrams_prom_flushed;
+  /* --udp-io-uring backend, created on first use: a receive ring whose fd sits
+   * in the event loop, and a ring udp_sendmmsg_flush() queues sends into. */
+  ioa_uring *uring_recv;
+  struct event *uring_recv_ev;
+  ioa_uring *uring_send;
+  bool uring_send_unavailable;
+  uint64_t udp_io_uring_last_report_cqes;
+  uint64_t udp_io_uring_last_report_submits;
+  turn_time_t udp_io_uring_last_report_time;
+  ioa_uring_stats udp_io_uring_prom_flushed;
 #endif
   redis_context_handle rch;
   /* multiplex-peer (zero-initialised = disabled) */
@@ -216,6 +284,14 @@ struct traffic_bytes {
   band_limit_t jiffie_bytes_write;
 };
 
+/* --tls-ktls state of a TLS-over-TCP socket (ioa_socket.ktls). */
+#define IOA_KTLS_CHECKED (0x1) /* handshake done with --tls-ktls on */
+#define IOA_KTLS_TX (0x2)      /* the kernel encrypts outgoing records */
+#define IOA_KTLS_RX (0x4)      /* the kernel decrypts incoming records */
+
+/* --tcp-splice state shared by the two sockets of an RFC 6062 pair. */
+typedef struct _ioa_splice ioa_splice;
+
 struct _ioa_socket {
   evutil_socket_t fd;
   struct _ioa_socket *parent_s;
@@ -228,6 +304,7 @@ struct _ioa_socket {
   SOCKET_APP_TYPE sat;
   SSL *ssl;
   uint32_t ssl_renegs;
+  unsigned int ktls; /* IOA_KTLS_* */
   int in_write;
   int bound;
   int local_addr_known;
@@ -237,6 +314,9 @@ struct _ioa_socket {
   ioa_engine_handle e;
   struct event *read_event;
   ioa_net_event_handler read_cb;
+  /* Set only on recvmmsg-eligible sockets whose owner can take a whole batch;
+   * called with read_ctx. */
+  ioa_net_batch_event_handler read_batch_cb;
   void *read_ctx;
   /* recvmmsg batch-receive eligibility: set once at creation for the shared
    * fan-in sockets (the client listener and the multiplex-peer relay socket).
@@ -246,6 +326,13 @@ struct _ioa_socket {
    * set-sites. Defaults to false via the calloc() zero-init every ioa_socket
    * gets; only the shared sockets flip it true. */
   bool udp_recvmmsg_eligible;
+  /* --udp-io-uring: the receive-ring source id plus one while the ring reads
+   * this socket instead of uring_fallback_ev, which is re-enabled if the ring
+   * fails it. */
+  int uring_source;
+  ioa_net_batch_event_handler uring_cb;
+  void *uring_ctx;
+  struct event *uring_fallback_ev;
   /* DTLS half-open accounting: true from the moment this DTLS child socket is
    * created (handshake not yet finished) until the handshake completes or the
    * socket is closed. While true the socket holds one slot in the global
@@ -253,6 +340,9 @@ struct _ioa_socket {
    * lets close_ioa_socket() release a slot for a handshake that never
    * completed. Zero-initialized by the calloc() every ioa_socket gets. */
   bool dtls_half_open;
+  /* --dtls-rebinding: epoch and sequence number of the newest application
+   * data record this DTLS child socket has authenticated. */
+  uint64_t dtls_last_record;
   int done;
   ts_ur_super_session *session;
   int current_df_relay_flag;
@@ -279,6 +369,8 @@ struct _ioa_socket {
   struct evconnlistener *list_ev;
   accept_cb acb;
   void *acbarg;
+  // Splice:
+  ioa_splice *splice;
   /* <<== RFC 6062 */
   void *special_session;
   size_t special_session_size;
@@ -333,6 +425,7 @@ ioa_engine_handle create_ioa_engine(super_memory_t *sm, struct event_base *eb, t
 );
 
 void ioa_engine_set_rtcp_map(ioa_engine_handle e, rtcp_map *rtcpmap);
+void ioa_engine_set_port_shard(ioa_engine_handle e, int shard);
 
 ioa_socket_handle create_ioa_socket_from_fd(ioa_engine_handle e, ioa_socket_raw fd, ioa_socket_handle parent_s,
                                             SOCKET_TYPE st, SOCKET_APP_TYPE sat, const ioa_addr *remote_addr,
@@ -358,9 +451,29 @@ int udp_recvfrom(evutil_socket_t fd, ioa_addr *orig_addr, const ioa_addr *like_a
                  int *ttl, int *tos, char *ecmsg, int flags, uint32_t *errcode);
 int ssl_read(evutil_socket_t fd, SSL *ssl, ioa_network_buffer_handle nbh, int verbose);
 
+/* Called on e's thread once ioa_socket_tls_handshake() is done with s: result
+ * is 1 if the TLS handshake completed, 0 if the connection is not TLS (its
+ * first bytes are still unread) and -1 if it failed or stalled for longer
+ * than the timeout. s belongs to the callback. */
+typedef void (*ioa_tls_handshake_cb)(ioa_socket_handle s, int result, void *arg);
+/* Runs the server handshake of a new TENTATIVE_TCP_SOCKET or TLS_SOCKET client
+ * socket on e's event loop. Returns -1 if the socket cannot be taken. */
+int ioa_socket_tls_handshake(ioa_engine_handle e, ioa_socket_handle s, int timeout_secs, ioa_tls_handshake_cb cb,
+                             void *arg);
+
 #if defined(__linux__)
 void ioa_init_recvmmsg_hdr(struct mmsghdr *msg, struct iovec *iov, ioa_addr *src_addr, char *cmsg, size_t cmsg_len,
                            socklen_t slen, void *buf, size_t len);
+/* Scatter variant for size-classed buffers: iov must have room for two entries,
+ * nbh must hold IOA_NBH_MTU_RECV_SIZE bytes and overflow
+ * IOA_NBH_RECV_OVERFLOW_SIZE bytes. */
+void ioa_init_recvmmsg_nbh_hdr(struct mmsghdr *msg, struct iovec *iov, ioa_addr *src_addr, char *cmsg,
+                               size_t cmsg_len, socklen_t slen, ioa_network_buffer_handle nbh, uint8_t *overflow);
+/* Sets the size of a buffer filled by a scatter receive, first moving the
+ * datagram into a larger buffer if it spilled into overflow. Returns the
+ * buffer now holding the datagram; nbh is released if it was replaced. */
+ioa_network_buffer_handle ioa_network_buffer_finish_recvmmsg(ioa_engine_handle e, ioa_network_buffer_handle nbh,
+                                                             const uint8_t *overflow, size_t len);
 #endif
 
 #if !defined(_MSC_VER) && defined(CMSG_SPACE)
@@ -371,12 +484,21 @@ void ioa_parse_udp_recvmsg_cmsg(struct msghdr *msg, int *ttl, int *tos, uint32_t
  * owning relay thread. Flushed to the shared prom counters by timer_handler. */
 void ioa_engine_record_packets(ioa_engine_handle e, uint32_t processed, uint32_t dropped);
 
+/* Moves s from its read event ev (if any) to the engine's io_uring receive ring
+ * when --udp-io-uring is on. Each batch goes to cb(s, IOA_EV_READ, nds, count,
+ * ctx); buffers cb leaves in nds are freed afterwards. Returns -1, leaving ev
+ * alone, if the ring cannot take the socket. */
+int ioa_socket_attach_uring(ioa_socket_handle s, struct event *ev, ioa_net_batch_event_handler cb, void *ctx);
+/* Must be called before s->fd is closed or replaced. */
+void ioa_socket_detach_uring(ioa_socket_handle s);
+
 #if defined(__linux__)
 void ioa_engine_record_udp_recvmmsg_batch(ioa_engine_handle e, int rc);
 void ioa_engine_record_udp_recvmmsg_wouldblock(ioa_engine_handle e);
 void ioa_engine_record_udp_recvmmsg_unavailable(ioa_engine_handle e);
 void ioa_engine_record_udp_recvmmsg_no_buffer(ioa_engine_handle e);
-void ioa_engine_record_udp_sendmmsg_flush(ioa_engine_handle e, unsigned int count, unsigned int gso_count);
+void ioa_engine_record_udp_sendmmsg_flush(ioa_engine_handle e, unsigned int count, unsigned int fd_groups,
+                                          unsigned int gso_count);
 #endif
 
 int set_raw_socket_ttl_options(evutil_socket_t fd, int family);
@@ -393,6 +515,11 @@ int send_ulong_from_ioa_socket_tcp(ioa_socket_handle s, size_t data);
 
 int ioa_socket_check_bandwidth(ioa_socket_handle s, ioa_network_buffer_handle nbh, int read);
 
+/* Size-classed variant of ioa_network_buffer_allocate(): the buffer holds at
+ * least `size` bytes. ioa_network_buffer_allocate() is the IOA_NBH_CLASS_FULL
+ * case; UDP readers pass ioa_network_buffer_get_capacity_udp(). */
+ioa_network_buffer_handle ioa_network_buffer_allocate_size(ioa_engine_handle e, size_t size);
+
 ///////////////////////// SUPER MEMORY ////////
 
 #define allocate_super_memory_engine(e, size)                                                                          \
@@ -0,0 +1,814 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * https://opensource.org/license/bsd-3-clause
+ *
+ * Copyright (C) 2011, 2012, 2013, 2014 Citrix Systems
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "ns_ioalib_uring.h"
+
+#include "ns_turn_utils.h"
+
+#if defined(__linux__) && !defined(TURN_NO_IO_URING) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+/* Multishot recvmsg arrived in 6.0, after provided buffer rings (5.19). */
+#if defined(IORING_RECV_MULTISHOT) && defined(IORING_CQE_F_MORE) && defined(__NR_io_uring_setup)
+#define IOA_URING_IMPL (1)
+#endif
+#endif
+#endif
+
+#if defined(IOA_URING_IMPL)
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/* user_data layout: kind(8) | slot(24) | generation(32). A source slot bumps
+ * its generation when removed, so completions still queued for the old
+ * receive no longer match. */
+#define URING_KIND_RECV (1)
+#define URING_KIND_CANCEL (2)
+#define URING_KIND_SEND (3)
+
+#define URING_BGID (0)
+#define URING_NAME_LEN (sizeof(struct sockaddr_in6))
+
+/* Failed completion waits ioa_uring_send_submit() retries before it gives up
+ * on the sends still in the kernel. */
+#define URING_SEND_WAIT_RETRIES (100)
+
+typedef struct {
+  int fd; /* -1 while the slot is free */
+  uint32_t gen;
+  bool armed;
+  struct msghdr mh; /* multishot template: only the name and control lengths are used */
+  ioa_uring_recv_handler cb;
+  ioa_uring_error_handler ecb;
+  void *ctx;
+} uring_source;
+
+typedef struct {
+  struct msghdr mh;
+  struct iovec iov;
+  struct sockaddr_in6 dest;
+  void *cookie;
+  bool completed;
+} uring_send_slot;
+
+struct _ioa_uring {
+  int fd;
+  void *ring;
+  size_t ring_len;
+  struct io_uring_sqe *sqes;
+  size_t sqes_len;
+  unsigned int sq_entries;
+  unsigned int *sq_head;
+  unsigned int *sq_tail;
+  unsigned int sq_mask;
+  unsigned int *cq_head;
+  unsigned int *cq_tail;
+  unsigned int cq_mask;
+  struct io_uring_cqe *cqes;
+  unsigned int sq_local_tail;
+  unsigned int to_submit;
+  /* provided buffers */
+  struct io_uring_buf_ring *br;
+  size_t br_len;
+  uint8_t *bufs;
+  size_t bufs_len;
+  unsigned int buf_count;
+  size_t buf_len;  /* what the kernel may fill: the payload never exceeds the size asked for */
+  size_t buf_size; /* stride between buffers */
+  size_t control_len;
+  uint16_t br_tail;
+  /* receive sources, addressed by index because handlers may add more */
+  uring_source *sources;
+  unsigned int sources_number;
+  bool in_poll;
+  /* sends, in queue order */
+  uring_send_slot *send_slots;
+  unsigned int send_pending;
+  bool send_abandoned; /* the kernel may still read send_slots */
+  ioa_uring_stats stats;
+};
+
+static inline uint64_t uring_user_data(uint64_t kind, uint32_t slot, uint32_t gen) {
+  return (kind << 56) | ((uint64_t)(slot & 0xffffffU) << 32) | (uint64_t)gen;
+}
+
+static int uring_setup(unsigned int entries, struct io_uring_params *p) {
+  return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int uring_enter(int fd, unsigned int to_submit, unsigned int min_complete, unsigned int flags) {
+  return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int uring_register(int fd, unsigned int opcode, void *arg, unsigned int nr_args) {
+  return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static struct io_uring_sqe *uring_get_sqe(ioa_uring *u) {
+  const unsigned int head = __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE);
+  if (u->sq_local_tail - head >= u->sq_entries) {
+    return NULL;
+  }
+  struct io_uring_sqe *sqe = &(u->sqes[u->sq_local_tail & u->sq_mask]);
+  memset(sqe, 0, sizeof(*sqe));
+  ++u->sq_local_tail;
+  ++u->to_submit;
+  return sqe;
+}
+
+/* Submits everything queued. Returns 0, or -1 with errno set if the kernel
+ * took none of it. */
+static int uring_submit(ioa_uring *u) {
+  __atomic_store_n(u->sq_tail, u->sq_local_tail, __ATOMIC_RELEASE);
+  while (u->to_submit > 0) {
+    const int rc = uring_enter(u->fd, u->to_submit, 0, 0);
+    if (rc < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    if (rc == 0) {
+      errno = EAGAIN;
+      return -1;
+    }
+    u->to_submit -= ((unsigned int)rc < u->to_submit) ? (unsigned int)rc : u->to_submit;
+  }
+  return 0;
+}
+
+static void uring_recycle_buf(ioa_uring *u, uint16_t bid) {
+  struct io_uring_buf *b = &(u->br->bufs[u->br_tail & (u->buf_count - 1)]);
+  b->addr = (uint64_t)(uintptr_t)(u->bufs + (size_t)bid * u->buf_size);
+  b->len = (uint32_t)u->buf_len;
+  b->bid = bid;
+  ++u->br_tail;
+}
+
+static void uring_publish_bufs(ioa_uring *u) { __atomic_store_n(&(u->br->tail), u->br_tail, __ATOMIC_RELEASE); }
+
+static bool uring_source_live(const ioa_uring *u, uint32_t slot, uint32_t gen) {
+  return (slot < u->sources_number) && (u->sources[slot].fd >= 0) && (u->sources[slot].gen == gen);
+}
+
+static int uring_arm_source(ioa_uring *u, unsigned int slot) {
+  uring_source *src = &(u->sources[slot]);
+  struct io_uring_sqe *sqe = uring_get_sqe(u);
+  if (!sqe) {
+    return -1;
+  }
+  sqe->opcode = IORING_OP_RECVMSG;
+  sqe->fd = src->fd;
+  sqe->addr = (uint64_t)(uintptr_t)&(src->mh);
+  sqe->len = 1;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = URING_BGID;
+  sqe->user_data = uring_user_data(URING_KIND_RECV, slot, src->gen);
+  src->armed = true;
+  return 0;
+}
+
+static void uring_unmap(ioa_uring *u) {
+  if (u->bufs) {
+    munmap(u->bufs, u->bufs_len);
+  }
+  if (u->br) {
+    munmap(u->br, u->br_len);
+  }
+  if (u->sqes) {
+    munmap(u->sqes, u->sqes_len);
+  }
+  if (u->ring) {
+    munmap(u->ring, u->ring_len);
+  }
+}
+
+ioa_uring *ioa_uring_create(unsigned int entries, unsigned int recv_bufs, size_t control_len, size_t payload_len) {
+  if (!entries || (recv_bufs & (recv_bufs - 1)) || recv_bufs > 32768) {
+    return NULL;
+  }
+
+  ioa_uring *u = (ioa_uring *)turn_calloc(1, sizeof(ioa_uring));
+
+  struct io_uring_params p;
+  memset(&p, 0, sizeof(p));
+  p.flags = IORING_SETUP_CLAMP | IORING_SETUP_CQSIZE;
+  p.cq_entries = 2 * ((recv_bufs > entries) ? recv_bufs : entries);
+
+  u->fd = uring_setup(entries, &p);
+  if (u->fd < 0) {
+    free(u);
+    return NULL;
+  }
+
+  /* One mmap for both rings (5.4+; anything with multishot recv has it), and
+   * no completion is ever dropped (5.5+), which ioa_uring_send_submit() relies
+   * on to know when the kernel is done with a send's buffer. */
+  if (!(p.features & IORING_FEAT_SINGLE_MMAP) || !(p.features & IORING_FEAT_NODROP)) {
+    goto err;
+  }
+
+  const size_t sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+  const size_t cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  u->ring_len = (sq_len > cq_len) ? sq_len : cq_len;
+  u->ring = mmap(NULL, u->ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+  if (u->ring == MAP_FAILED) {
+    u->ring = NULL;
+    goto err;
+  }
+  u->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+  u->sqes = (struct io_uring_sqe *)mmap(NULL, u->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd,
+                                        IORING_OFF_SQES);
+  if (u->sqes == MAP_FAILED) {
+    u->sqes = NULL;
+    goto err;
+  }
+
+  uint8_t *ring = (uint8_t *)u->ring;
+  u->sq_entries = p.sq_entries;
+  u->sq_head = (unsigned int *)(ring + p.sq_off.head);
+  u->sq_tail = (unsigned int *)(ring + p.sq_off.tail);
+  u->sq_mask = *(unsigned int *)(ring + p.sq_off.ring_mask);
+  u->cq_head = (unsigned int *)(ring + p.cq_off.head);
+  u->cq_tail = (unsigned int *)(ring + p.cq_off.tail);
+  u->cq_mask = *(unsigned int *)(ring + p.cq_off.ring_mask);
+  u->cqes = (struct io_uring_cqe *)(ring + p.cq_off.cqes);
+  u->sq_local_tail = *(u->sq_tail);
+
+  /* SQE slots are used in ring order, so the indirection array is the identity. */
+  unsigned int *sq_array = (unsigned int *)(ring + p.sq_off.array);
+  for (unsigned int i = 0; i < p.sq_entries; ++i) {
+    sq_array[i] = i;
+  }
+
+  if (recv_bufs) {
+    u->control_len = control_len;
+    u->buf_count = recv_bufs;
+    u->buf_len = sizeof(struct io_uring_recvmsg_out) + URING_NAME_LEN + control_len + payload_len;
+    u->buf_size = (u->buf_len + 63) & ~(size_t)63;
+    u->br_len = recv_bufs * sizeof(struct io_uring_buf);
+    u->br = (struct io_uring_buf_ring *)mmap(NULL, u->br_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1,
+                                             0);
+    if (u->br == MAP_FAILED) {
+      u->br = NULL;
+      goto err;
+    }
+    u->bufs_len = recv_bufs * u->buf_size;
+    u->bufs = (uint8_t *)mmap(NULL, u->bufs_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (u->bufs == MAP_FAILED) {
+      u->bufs = NULL;
+      goto err;
+    }
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)u->br;
+    reg.ring_entries = recv_bufs;
+    reg.bgid = URING_BGID;
+    if (uring_register(u->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+      goto err;
+    }
+
+    for (unsigned int i = 0; i < recv_bufs; ++i) {
+      uring_recycle_buf(u, (uint16_t)i);
+    }
+    uring_publish_bufs(u);
+  } else {
+    u->send_slots = (uring_send_slot *)turn_calloc(u->sq_entries, sizeof(uring_send_slot));
+  }
+
+  return u;
+
+err:
+  uring_unmap(u);
+  close(u->fd);
+  free(u);
+  return NULL;
+}
+
+void ioa_uring_free(ioa_uring *u) {
+  if (!u) {
+    return;
+  }
+  /* Closing the ring cancels whatever is still in flight. */
+  close(u->fd);
+  uring_unmap(u);
+  free(u->sources);
+  if (!u->send_abandoned) {
+    free(u->send_slots);
+  }
+  free(u);
+}
+
+int ioa_uring_fd(const ioa_uring *u) { return u ? u->fd : -1; }
+
+const ioa_uring_stats *ioa_uring_get_stats(const ioa_uring *u) { return u ? &(u->stats) : NULL; }
+
+int ioa_uring_add_source(ioa_uring *u, int fd, ioa_uring_recv_handler cb, ioa_uring_error_handler ecb, void *ctx) {
+  if (!u || !u->br || fd < 0 || !cb) {
+    return -1;
+  }
+
+  unsigned int slot = 0;
+  while (slot < u->sources_number && u->sources[slot].fd >= 0) {
+    ++slot;
+  }
+  if (slot == u->sources_number) {
+    u->sources = (uring_source *)turn_realloc(u->sources, (u->sources_number + 1) * sizeof(uring_source));
+    memset(&(u->sources[slot]), 0, sizeof(uring_source));
+    ++u->sources_number;
+  }
+
+  uring_source *src = &(u->sources[slot]);
+  src->fd = fd;
+  src->armed = false;
+  memset(&(src->mh), 0, sizeof(src->mh));
+  src->mh.msg_namelen = URING_NAME_LEN;
+  src->mh.msg_controllen = u->control_len;
+  src->cb = cb;
+  src->ecb = ecb;
+  src->ctx = ctx;
+
+  if (uring_arm_source(u, slot) < 0 && (uring_submit(u) < 0 || uring_arm_source(u, slot) < 0)) {
+    src->fd = -1;
+    return -1;
+  }
+  if (uring_submit(u) < 0) {
+    src->fd = -1;
+    ++src->gen;
+    return -1;
+  }
+
+  return (int)slot;
+}
+
+void ioa_uring_remove_source(ioa_uring *u, int id) {
+  if (!u || id < 0 || (unsigned int)id >= u->sources_number || u->sources[id].fd < 0) {
+    return;
+  }
+
+  uring_source *src = &(u->sources[id]);
+  if (src->armed) {
+    struct io_uring_sqe *sqe = uring_get_sqe(u);
+    if (!sqe && uring_submit(u) == 0) {
+      sqe = uring_get_sqe(u);
+    }
+    if (sqe) {
+      sqe->opcode = IORING_OP_ASYNC_CANCEL;
+      sqe->fd = -1;
+      sqe->addr = uring_user_data(URING_KIND_RECV, (uint32_t)id, src->gen);
+      sqe->user_data = uring_user_data(URING_KIND_CANCEL, (uint32_t)id, src->gen);
+      uring_submit(u);
+    }
+  }
+
+  src->fd = -1;
+  ++src->gen;
+  src->armed = false;
+  src->cb = NULL;
+  src->ecb = NULL;
+  src->ctx = NULL;
+}
+
+typedef struct {
+  ioa_uring_dgram dgrams[IOA_URING_MAX_BATCH];
+  uint16_t bids[IOA_URING_MAX_BATCH];
+  size_t count;
+  uint32_t slot;
+  uint32_t gen;
+} uring_recv_batch;
+
+static int uring_flush_batch(ioa_uring *u, uring_recv_batch *b) {
+  int delivered = 0;
+
+  if (b->count && uring_source_live(u, b->slot, b->gen)) {
+    const ioa_uring_recv_handler cb = u->sources[b->slot].cb;
+    void *ctx = u->sources[b->slot].ctx;
+    ++u->stats.recv_batches;
+    u->stats.recv_datagrams += b->count;
+    delivered = (int)b->count;
+    cb(ctx, b->dgrams, b->count);
+  }
+
+  for (size_t i = 0; i < b->count; ++i) {
+    uring_recycle_buf(u, b->bids[i]);
+  }
+  if (b->count) {
+    uring_publish_bufs(u);
+  }
+  b->count = 0;
+
+  return delivered;
+}
+
+int ioa_uring_poll(ioa_uring *u) {
+  if (!u || !u->br || u->in_poll) {
+    return 0;
+  }
+
+  u->in_poll = true;
+
+  uring_recv_batch b;
+  b.count = 0;
+  b.slot = 0;
+  b.gen = 0;
+  int delivered = 0;
+
+  for (;;) {
+    unsigned int head = *(u->cq_head);
+    const unsigned int tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+    if (head == tail) {
+      break;
+    }
+
+    for (; head != tail; ++head) {
+      const struct io_uring_cqe *cqe = &(u->cqes[head & u->cq_mask]);
+      const uint64_t ud = cqe->user_data;
+      const int res = cqe->res;
+      const uint32_t flags = cqe->flags;
+
+      if ((ud >> 56) != URING_KIND_RECV) {
+        continue;
+      }
+
+      const uint32_t slot = (uint32_t)((ud >> 32) & 0xffffffU);
+      const uint32_t gen = (uint32_t)ud;
+      const bool has_buf = (flags & IORING_CQE_F_BUFFER) != 0;
+      const uint16_t bid = (uint16_t)(flags >> IORING_CQE_BUFFER_SHIFT);
+
+      if (!uring_source_live(u, slot, gen)) {
+        if (has_buf) {
+          uring_recycle_buf(u, bid);
+          uring_publish_bufs(u);
+        }
+        continue;
+      }
+
+      ++u->stats.recv_cqes;
+      if (!(flags & IORING_CQE_F_MORE)) {
+        u->sources[slot].armed = false;
+      }
+
+      if (res < 0) {
+        if (res == -ENOBUFS) {
+          ++u->stats.recv_nobufs;
+        } else if (res != -ECANCELED) {
+          ++u->stats.recv_errors;
+          delivered += uring_flush_batch(u, &b);
+          const ioa_uring_error_handler ecb = u->sources[slot].ecb;
+          if (ecb) {
+            ecb(u->sources[slot].ctx, -res);
+          }
+        }
+        continue;
+      }
+
+      if (!has_buf) {
+        continue;
+      }
+
+      uint8_t *buf = u->bufs + (size_t)bid * u->buf_size;
+      const struct io_uring_recvmsg_out *out = (const struct io_uring_recvmsg_out *)buf;
+      const size_t header = sizeof(*out) + URING_NAME_LEN + u->control_len;
+      if ((size_t)res < header || (out->flags & MSG_TRUNC)) {
+        ++u->stats.recv_truncated;
+        uring_recycle_buf(u, bid);
+        uring_publish_bufs(u);
+        continue;
+      }
+
+      if (b.count && (b.slot != slot || b.count == IOA_URING_MAX_BATCH)) {
+        delivered += uring_flush_batch(u, &b);
+      }
+
+      ioa_uring_dgram *d = &(b.dgrams[b.count]);
+      memset(d, 0, sizeof(*d));
+      d->data = buf + header;
+      d->len = out->payloadlen;
+      d->msg.msg_name = buf + sizeof(*out);
+      d->msg.msg_namelen = (out->namelen < URING_NAME_LEN) ? out->namelen : (socklen_t)URING_NAME_LEN;
+      d->msg.msg_control = (out->controllen > 0) ? buf + sizeof(*out) + URING_NAME_LEN : NULL;
+      d->msg.msg_controllen = out->controllen;
+      b.bids[b.count++] = bid;
+      b.slot = slot;
+      b.gen = gen;
+    }
+
+    __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+  }
+
+  delivered += uring_flush_batch(u, &b);
+
+  /* A multishot receive ends on buffer exhaustion, on errors and on CQ
+   * overflow; the handlers above have returned their buffers by now. */
+  bool rearmed = false;
+  for (unsigned int slot = 0; slot < u->sources_number; ++slot) {
+    if (u->sources[slot].fd >= 0 && !u->sources[slot].armed) {
+      if (uring_arm_source(u, slot) < 0) {
+        break;
+      }
+      ++u->stats.recv_rearms;
+      rearmed = true;
+    }
+  }
+  if (rearmed) {
+    uring_submit(u);
+  }
+
+  u->in_poll = false;
+
+  return delivered;
+}
+
+int ioa_uring_send_queue(ioa_uring *u, int fd, const struct sockaddr *dest, socklen_t dest_len, const void *data,
+                         size_t len, void *cookie) {
+  if (!u || !u->send_slots || u->send_abandoned || fd < 0 || u->send_pending >= u->sq_entries ||
+      dest_len > sizeof(struct sockaddr_in6)) {
+    return -1;
+  }
+
+  struct io_uring_sqe *sqe = uring_get_sqe(u);
+  if (!sqe) {
+    return -1;
+  }
+
+  const unsigned int idx = u->send_pending++;
+  uring_send_slot *slot = &(u->send_slots[idx]);
+  memset(&(slot->mh), 0, sizeof(slot->mh));
+  if (dest && dest_len) {
+    memcpy(&(slot->dest), dest, dest_len);
+    slot->mh.msg_name = &(slot->dest);
+    slot->mh.msg_namelen = dest_len;
+  }
+  slot->iov.iov_base = (void *)(uintptr_t)data;
+  slot->iov.iov_len = len;
+  slot->mh.msg_iov = &(slot->iov);
+  slot->mh.msg_iovlen = 1;
+  slot->cookie = cookie;
+  slot->completed = false;
+
+  sqe->opcode = IORING_OP_SENDMSG;
+  sqe->fd = fd;
+  sqe->addr = (uint64_t)(uintptr_t)&(slot->mh);
+  sqe->len = 1;
+  /* Never park a send in the kernel: a full socket buffer fails it right away,
+   * as it would for sendmmsg(), so every send completes within the submit. */
+  sqe->msg_flags = MSG_DONTWAIT;
+  sqe->user_data = uring_user_data(URING_KIND_SEND, idx, 0);
+
+  return 0;
+}
+
+unsigned int ioa_uring_send_pending(const ioa_uring *u) { return u ? u->send_pending : 0; }
+
+int ioa_uring_send_submit(ioa_uring *u, ioa_uring_send_done done, void *arg) {
+  if (!u || !u->send_pending) {
+    return 0;
+  }
+
+  const unsigned int pending = u->send_pending;
+  ++u->stats.send_submits;
+  u->stats.send_sqes += pending;
+
+  unsigned int submitted = pending;
+  if (uring_submit(u) < 0) {
+    /* Take back what the kernel did not consume; those sends never happened. */
+    submitted = pending - u->to_submit;
+    u->sq_local_tail -= u->to_submit;
+    u->to_submit = 0;
+    __atomic_store_n(u->sq_tail, u->sq_local_tail, __ATOMIC_RELEASE);
+  }
+
+  /* Every submitted send must complete before returning: the caller frees the
+   * buffers, and a CQE left behind would be matched to the next batch's
+   * slots. Sends never wait on the socket, so their completions are at most
+   * an io-wq hop away. A failing wait is retried URING_SEND_WAIT_RETRIES
+   * times; after that the sends still out are abandoned to the kernel. */
+  int sent = 0;
+  unsigned int completed = 0;
+  unsigned int wait_failures = 0;
+  while (completed < submitted) {
+    unsigned int head = *(u->cq_head);
+    const unsigned int tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+    if (head == tail) {
+      if (uring_enter(u->fd, 0, submitted - completed, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+        if (++wait_failures >= URING_SEND_WAIT_RETRIES) {
+          TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: io_uring wait keeps failing (errno=%d), abandoning %u sends\n",
+                        __FUNCTION__, errno, submitted - completed);
+          break;
+        }
+        sched_yield();
+      }
+      continue;
+    }
+    for (; head != tail; ++head) {
+      const struct io_uring_cqe *cqe = &(u->cqes[head & u->cq_mask]);
+      if ((cqe->user_data >> 56) != URING_KIND_SEND) {
+        continue;
+      }
+      const uint32_t idx = (uint32_t)((cqe->user_data >> 32) & 0xffffffU);
+      ++completed;
+      if (cqe->res < 0) {
+        ++u->stats.send_errors;
+      } else {
+        ++sent;
+      }
+      if (idx < pending) {
+        u->send_slots[idx].completed = true;
+        if (done) {
+          done(u->send_slots[idx].cookie, cqe->res, arg);
+        }
+      }
+    }
+    __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+  }
+
+  if (completed < submitted) {
+    /* The slots and buffers of these may still be read by the kernel: the
+     * slots are never freed, and done is told not to reuse the buffers. */
+    u->send_abandoned = true;
+    for (unsigned int idx = 0; idx < submitted; ++idx) {
+      if (!u->send_slots[idx].completed) {
+        ++u->stats.send_errors;
+        if (done) {
+          done(u->send_slots[idx].cookie, -ETIMEDOUT, arg);
+        }
+      }
+    }
+  }
+
+  for (unsigned int idx = submitted; idx < pending; ++idx) {
+    ++u->stats.send_errors;
+    if (done) {
+      done(u->send_slots[idx].cookie, -ECANCELED, arg);
+    }
+  }
+
+  u->send_pending = 0;
+
+  return (completed < submitted) ? -1 : sent;
+}
+
+static void probe_recv_handler(void *ctx, ioa_uring_dgram *dgrams, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    if (dgrams[i].len == 5 && !memcmp(dgrams[i].data, "probe", 5)) {
+      *(bool *)ctx = true;
+    }
+  }
+}
+
+static bool ioa_uring_probe(void) {
+  bool received = false;
+  ioa_uring *u = ioa_uring_create(4, 4, 0, 64);
+  if (!u) {
+    return false;
+  }
+
+  const int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  struct sockaddr_in addr;
+  socklen_t addr_len = sizeof(addr);
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  if (fd >= 0 && bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0 &&
+      getsockname(fd, (struct sockaddr *)&addr, &addr_len) == 0 &&
+      ioa_uring_add_source(u, fd, probe_recv_handler, NULL, &received) >= 0 &&
+      sendto(fd, "probe", 5, 0, (struct sockaddr *)&addr, addr_len) == 5) {
+    /* A kernel without multishot recvmsg fails the receive at once. */
+    for (int i = 0; i < 10 && !received; ++i) {
+      struct pollfd pfd = {ioa_uring_fd(u), POLLIN, 0};
+      if (poll(&pfd, 1, 100) > 0) {
+        ioa_uring_poll(u);
+        if (u->stats.recv_errors) {
+          break;
+        }
+      }
+    }
+  }
+
+  ioa_uring_free(u);
+  if (fd >= 0) {
+    close(fd);
+  }
+  return received;
+}
+
+bool ioa_uring_supported(void) {
+  static int supported = -1;
+  if (supported < 0) {
+    supported = ioa_uring_probe() ? 1 : 0;
+  }
+  return supported > 0;
+}
+
+#else
+
+bool ioa_uring_supported(void) { return false; }
+
+ioa_uring *ioa_uring_create(unsigned int entries, unsigned int recv_bufs, size_t control_len, size_t payload_len) {
+  UNUSED_ARG(entries);
+  UNUSED_ARG(recv_bufs);
+  UNUSED_ARG(control_len);
+  UNUSED_ARG(payload_len);
+  return NULL;
+}
+
+void ioa_uring_free(ioa_uring *u) { UNUSED_ARG(u); }
+
+int ioa_uring_fd(const ioa_uring *u) {
+  UNUSED_ARG(u);
+  return -1;
+}
+
+const ioa_uring_stats *ioa_uring_get_stats(const ioa_uring *u) {
+  UNUSED_ARG(u);
+  return NULL;
+}
+
+int ioa_uring_add_source(ioa_uring *u, int fd, ioa_uring_recv_handler cb, ioa_uring_error_handler ecb, void *ctx) {
+  UNUSED_ARG(u);
+  UNUSED_ARG(fd);
+  UNUSED_ARG(cb);
+  UNUSED_ARG(ecb);
+  UNUSED_ARG(ctx);
+  return -1;
+}
+
+void ioa_uring_remove_source(ioa_uring *u, int id) {
+  UNUSED_ARG(u);
+  UNUSED_ARG(id);
+}
+
+int ioa_uring_poll(ioa_uring *u) {
+  UNUSED_ARG(u);
+  return 0;
+}
+
+#if !defined(WINDOWS)
+int ioa_uring_send_queue(ioa_uring *u, int fd, const struct sockaddr *dest, socklen_t dest_len, const void *data,
+                         size_t len, void *cookie) {
+  UNUSED_ARG(u);
+  UNUSED_ARG(fd);
+  UNUSED_ARG(dest);
+  UNUSED_ARG(dest_len);
+  UNUSED_ARG(data);
+  UNUSED_ARG(len);
+  UNUSED_ARG(cookie);
+  return -1;
+}
+#endif
+
+unsigned int ioa_uring_send_pending(const ioa_uring *u) {
+  UNUSED_ARG(u);
+  return 0;
+}
+
+int ioa_uring_send_submit(ioa_uring *u, ioa_uring_send_done done, void *arg) {
+  UNUSED_ARG(u);
+  UNUSED_ARG(done);
+  UNUSED_ARG(arg);
+  return 0;
+}
+
+#endif
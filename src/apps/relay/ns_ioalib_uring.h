@@ -0,0 +1,148 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * https://opensource.org/license/bsd-3-clause
+ *
+ * Copyright (C) 2011, 2012, 2013, 2014 Citrix Systems
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef __TURN_IOALIB_URING__
+#define __TURN_IOALIB_URING__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if !defined(WINDOWS)
+#include <sys/socket.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//////////////////////////////////////////////////
+
+/*
+ * Minimal io_uring ring for the --udp-io-uring backend, driven through the raw
+ * syscalls so that no liburing is needed. A ring is used either for receiving
+ * or for sending, never both:
+ *
+ *  - A receive ring owns a provided-buffer ring and keeps one multishot
+ *    recvmsg armed per registered UDP socket ("source"). Its fd is polled by
+ *    the engine's event loop; ioa_uring_poll() hands each run of consecutive
+ *    datagrams from one source to that source's handler as a single batch.
+ *
+ *  - A send ring queues sendmsg operations and submits all of them with one
+ *    io_uring_enter() in ioa_uring_send_submit().
+ *
+ * Builds without <linux/io_uring.h> (or with TURN_NO_IO_URING) get stubs:
+ * ioa_uring_supported() is false and ioa_uring_create() returns NULL.
+ */
+
+/* Most datagrams one receive handler call carries. */
+#define IOA_URING_MAX_BATCH (16)
+
+typedef struct _ioa_uring ioa_uring;
+
+/* One received datagram. data and the msg name/control buffers point into a
+ * provided buffer that is recycled as soon as the handler returns. */
+typedef struct _ioa_uring_dgram {
+  const uint8_t *data;
+  size_t len;
+#if !defined(WINDOWS)
+  struct msghdr msg; /* msg_name/msg_namelen: source address; msg_control/msg_controllen: ancillary data */
+#endif
+} ioa_uring_dgram;
+
+typedef void (*ioa_uring_recv_handler)(void *ctx, ioa_uring_dgram *dgrams, size_t count);
+/* The receive failed with err (an errno value) other than running out of
+ * provided buffers. The receive is re-armed after the handler returns unless
+ * it removes the source. */
+typedef void (*ioa_uring_error_handler)(void *ctx, int err);
+/* res is the sendmsg() result, or -errno. Entries that could not be submitted
+ * complete with -ECANCELED. Entries abandoned to the kernel (see
+ * ioa_uring_send_submit()) complete with -ETIMEDOUT: they may or may not be
+ * sent, and their data may still be read. */
+typedef void (*ioa_uring_send_done)(void *cookie, int res, void *arg);
+
+typedef struct _ioa_uring_stats {
+  uint64_t recv_cqes;      /* receive completions for live sources */
+  uint64_t recv_batches;   /* handler calls */
+  uint64_t recv_datagrams; /* datagrams handed to handlers */
+  uint64_t recv_rearms;    /* multishot receives armed again after terminating */
+  uint64_t recv_nobufs;    /* multishot terminations because the buffer ring ran dry */
+  uint64_t recv_truncated; /* datagrams dropped because they did not fit a provided buffer */
+  uint64_t recv_errors;    /* other receive failures */
+  uint64_t send_submits;   /* ioa_uring_send_submit() calls with work queued */
+  uint64_t send_sqes;      /* sendmsg operations submitted */
+  uint64_t send_errors;    /* sendmsg operations that failed or were not submitted */
+} ioa_uring_stats;
+
+/* True if the kernel supports multishot recvmsg with provided buffer rings.
+ * The first call probes with a loopback socket; later calls return the cached
+ * result. */
+bool ioa_uring_supported(void);
+
+/* recv_bufs (a power of two, 0 for a send ring) provided buffers, each large
+ * enough for a source address, control_len bytes of ancillary data and a
+ * payload_len-byte datagram. */
+ioa_uring *ioa_uring_create(unsigned int entries, unsigned int recv_bufs, size_t control_len, size_t payload_len);
+void ioa_uring_free(ioa_uring *u);
+int ioa_uring_fd(const ioa_uring *u);
+const ioa_uring_stats *ioa_uring_get_stats(const ioa_uring *u);
+
+/* Starts receiving from fd. Returns a source id, or -1. */
+int ioa_uring_add_source(ioa_uring *u, int fd, ioa_uring_recv_handler cb, ioa_uring_error_handler ecb, void *ctx);
+/* Cancels the source's receive. Completions already queued for it are
+ * discarded, so the handlers are never called again; fd may be closed as soon
+ * as this returns. Safe to call from the source's own handlers. */
+void ioa_uring_remove_source(ioa_uring *u, int id);
+/* Delivers everything completed so far. Returns the number of datagrams. */
+int ioa_uring_poll(ioa_uring *u);
+
+#if !defined(WINDOWS)
+/* Queues one datagram. data must stay valid until the send completes. Returns
+ * -1 if the ring is full, in which case nothing was queued. */
+int ioa_uring_send_queue(ioa_uring *u, int fd, const struct sockaddr *dest, socklen_t dest_len, const void *data,
+                         size_t len, void *cookie);
+#endif
+unsigned int ioa_uring_send_pending(const ioa_uring *u);
+/* Submits every queued datagram, waits for them and calls done once per
+ * datagram. Returns the number of datagrams sent successfully. If waiting
+ * for completions keeps failing, the sends still out are abandoned: done gets
+ * -ETIMEDOUT for them, their buffers must never be reused, and -1 is
+ * returned. The ring then takes no more sends and should be freed. */
+int ioa_uring_send_submit(ioa_uring *u, ioa_uring_send_done done, void *arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__TURN_IOALIB_URING__
@@ -88,6 +88,38 @@ prom_counter_t *turn_udp_recvmmsg_packets;
 prom_counter_t *turn_udp_sendmmsg_flushes;
 prom_counter_t *turn_udp_sendmmsg_datagrams;
 prom_counter_t *turn_udp_sendmmsg_gso_datagrams;
+prom_counter_t *turn_udp_io_uring_recv_batches;
+prom_counter_t *turn_udp_io_uring_recv_packets;
+prom_counter_t *turn_udp_io_uring_send_submits;
+prom_counter_t *turn_udp_io_uring_send_datagrams;
+
+prom_counter_t *turn_nbh_pool_allocs;
+prom_counter_t *turn_nbh_pool_reuses;
+prom_gauge_t *turn_nbh_pool_pooled;
+
+prom_counter_t *turn_relay_port_steals;
+
+prom_counter_t *turn_auth_cache_hits;
+prom_counter_t *turn_auth_cache_misses;
+
+prom_counter_t *turn_db_user_key_lookup_seconds_bucket;
+prom_counter_t *turn_db_user_key_lookup_seconds_sum;
+prom_counter_t *turn_db_user_key_lookup_seconds_count;
+
+prom_counter_t *turn_tls_handshakes;
+prom_counter_t *turn_dtls_cookie_exchanges;
+prom_counter_t *turn_dtls_rebindings;
+
+prom_gauge_t *turn_relay_thread_sessions;
+prom_gauge_t *turn_relay_thread_bytes_per_second;
+prom_gauge_t *turn_relay_thread_cpu;
+prom_gauge_t *turn_relay_thread_queue_depth;
+prom_gauge_t *turn_relay_thread_queue_high_water;
+prom_counter_t *turn_relay_session_migrations;
+
+prom_gauge_t *turn_tls_handshake_pool_queued;
+prom_counter_t *turn_tls_handshake_pool_handshakes;
+prom_counter_t *turn_tls_handshake_pool_seconds;
 
 #if MHD_VERSION >= 0x00097002
 #define MHD_RESULT enum MHD_Result
@@ -289,6 +321,101 @@ void start_prometheus_server(void) {
   turn_udp_sendmmsg_gso_datagrams = prom_collector_registry_must_register_metric(
       prom_counter_new("turn_udp_sendmmsg_gso_datagrams", "Datagrams coalesced via a single UDP-GSO sendmsg", 0, NULL));
 
+  // --udp-io-uring counterparts of the above: handler batches per multishot
+  // receive run and io_uring_enter() submissions per egress batch.
+  turn_udp_io_uring_recv_batches = prom_collector_registry_must_register_metric(prom_counter_new(
+      "turn_udp_io_uring_recv_batches", "Receive batches delivered from the io_uring completion queue", 0, NULL));
+  turn_udp_io_uring_recv_packets = prom_collector_registry_must_register_metric(
+      prom_counter_new("turn_udp_io_uring_recv_packets", "Datagrams received via io_uring multishot recvmsg", 0, NULL));
+  turn_udp_io_uring_send_submits = prom_collector_registry_must_register_metric(
+      prom_counter_new("turn_udp_io_uring_send_submits", "io_uring submissions carrying egress batches", 0, NULL));
+  turn_udp_io_uring_send_datagrams = prom_collector_registry_must_register_metric(
+      prom_counter_new("turn_udp_io_uring_send_datagrams", "Datagrams sent via io_uring sendmsg", 0, NULL));
+
+  // Network buffer pool, summed over relay engines and labelled by size class.
+  const char *nbhClassLabel[] = {"class"};
+  turn_nbh_pool_allocs = prom_collector_registry_must_register_metric(
+      prom_counter_new("turn_nbh_pool_allocs", "Network buffers handed out by the engine pools", 1, nbhClassLabel));
+  turn_nbh_pool_reuses = prom_collector_registry_must_register_metric(prom_counter_new(
+      "turn_nbh_pool_reuses", "Network buffers recycled from an engine free list", 1, nbhClassLabel));
+  turn_nbh_pool_pooled = prom_collector_registry_must_register_metric(
+      prom_gauge_new("turn_nbh_pool_pooled", "Idle network buffers parked on engine free lists", 1, nbhClassLabel));
+
+  turn_relay_port_steals = prom_collector_registry_must_register_metric(prom_counter_new(
+      "turn_relay_port_steals", "Relay port allocations served from another relay thread's shard", 0, NULL));
+
+  // Credential cache (--auth-cache-ttl), labelled by what was looked up: "key" or "secrets".
+  const char *authCacheLabel[] = {"kind"};
+  turn_auth_cache_hits = prom_collector_registry_must_register_metric(
+      prom_counter_new("turn_auth_cache_hits", "Credential lookups served from the cache", 1, authCacheLabel));
+  turn_auth_cache_misses = prom_collector_registry_must_register_metric(
+      prom_counter_new("turn_auth_cache_misses", "Credential lookups that missed the cache", 1, authCacheLabel));
+
+  // Latency of user key lookups in the database, labelled by driver. The library has no histogram type, so the
+  // series are a Prometheus histogram's written out as counters: cumulative buckets by "le", sum and count.
+  const char *dbLookupBucketLabel[] = {"driver", "le"};
+  const char *dbLookupLabel[] = {"driver"};
+  turn_db_user_key_lookup_seconds_bucket = prom_collector_registry_must_register_metric(
+      prom_counter_new("turn_db_user_key_lookup_seconds_bucket",
+                       "Database user key lookups that took at most le seconds", 2, dbLookupBucketLabel));
+  turn_db_user_key_lookup_seconds_sum = prom_collector_registry_must_register_metric(prom_counter_new(
+      "turn_db_user_key_lookup_seconds_sum", "Total time of database user key lookups", 1, dbLookupLabel));
+  turn_db_user_key_lookup_seconds_count = prom_collector_registry_must_register_metric(
+      prom_counter_new("turn_db_user_key_lookup_seconds_count", "Database user key lookups", 1, dbLookupLabel));
+
+  // TLS/DTLS server handshakes, labelled "full" or "resumed" (session ticket).
+  const char *tlsHandshakeLabel[] = {"kind"};
+  turn_tls_handshakes = prom_collector_registry_must_register_metric(
+      prom_counter_new("turn_tls_handshakes", "Completed TLS and DTLS server handshakes", 1, tlsHandshakeLabel));
+
+  // DTLS handshake datagrams from sources without a session, labelled "challenged" (HelloVerifyRequest sent),
+  // "verified" (ClientHello with a valid cookie) or "dropped" (not a ClientHello the cookie exchange accepts).
+  const char *dtlsCookieLabel[] = {"result"};
+  turn_dtls_cookie_exchanges = prom_collector_registry_must_register_metric(prom_counter_new(
+      "turn_dtls_cookie_exchanges", "DTLS handshake datagrams answered by the listener cookie exchange", 1,
+      dtlsCookieLabel));
+
+  // DTLS application data from unknown sources offered to established sessions (--dtls-rebinding), labelled
+  // "rebound" (a session moved to the new address), "unmatched" or "limited" (over the per-second scan budget).
+  turn_dtls_rebindings = prom_collector_registry_must_register_metric(prom_counter_new(
+      "turn_dtls_rebindings", "DTLS records from unknown sources tried against established sessions", 1,
+      dtlsCookieLabel));
+
+  // Relay thread load (see --relay-placement), labelled by relay thread number.
+  const char *relayThreadLabel[] = {"thread"};
+  turn_relay_thread_sessions = prom_collector_registry_must_register_metric(
+      prom_gauge_new("turn_relay_thread_sessions", "Live sessions on each relay thread", 1, relayThreadLabel));
+  turn_relay_thread_bytes_per_second = prom_collector_registry_must_register_metric(prom_gauge_new(
+      "turn_relay_thread_bytes_per_second", "Smoothed client bytes per second relayed by each relay thread", 1,
+      relayThreadLabel));
+  turn_relay_thread_cpu = prom_collector_registry_must_register_metric(prom_gauge_new(
+      "turn_relay_thread_cpu", "Smoothed CPU time of each relay thread, in cores", 1, relayThreadLabel));
+
+  // Inter-thread message queues of each relay thread, labelled by thread and queue: "relay" (sockets and session
+  // control from other threads) or "auth" (answers from the auth threads).
+  const char *relayQueueLabel[] = {"thread", "queue"};
+  turn_relay_thread_queue_depth = prom_collector_registry_must_register_metric(prom_gauge_new(
+      "turn_relay_thread_queue_depth", "Messages waiting in each relay thread queue", 2, relayQueueLabel));
+  turn_relay_thread_queue_high_water = prom_collector_registry_must_register_metric(
+      prom_gauge_new("turn_relay_thread_queue_high_water", "Most messages ever waiting in each relay thread queue", 2,
+                     relayQueueLabel));
+
+  // Sessions moved between relay threads (see --relay-rebalance), labelled "moved" or "refused".
+  const char *migrationLabel[] = {"result"};
+  turn_relay_session_migrations = prom_collector_registry_must_register_metric(prom_counter_new(
+      "turn_relay_session_migrations", "Requests to move a session to another relay thread", 1, migrationLabel));
+
+  // TLS handshake threads (--tls-handshake-threads), labelled by outcome: "tls", "plain" or "failed".
+  const char *handshakePoolLabel[] = {"result"};
+  turn_tls_handshake_pool_queued = prom_collector_registry_must_register_metric(prom_gauge_new(
+      "turn_tls_handshake_pool_queued", "Connections queued for or inside a handshake thread", 0, NULL));
+  turn_tls_handshake_pool_handshakes = prom_collector_registry_must_register_metric(prom_counter_new(
+      "turn_tls_handshake_pool_handshakes", "Connections finished by the handshake threads", 1, handshakePoolLabel));
+  turn_tls_handshake_pool_seconds = prom_collector_registry_must_register_metric(
+      prom_counter_new("turn_tls_handshake_pool_seconds",
+                       "Total time connections spent in the handshake threads, accept to handoff", 1,
+                       handshakePoolLabel));
+
   // some flags appeared first in microhttpd v0.9.53
   unsigned int flags = 0;
 #if MHD_VERSION >= 0x00095300
@@ -463,6 +590,127 @@ void prom_flush_udp_counters(const struct prom_udp_counter_deltas *d) {
   if (d->sendmmsg_gso_datagrams) {
     prom_counter_add(turn_udp_sendmmsg_gso_datagrams, (double)d->sendmmsg_gso_datagrams, NULL);
   }
+  if (d->io_uring_recv_batches) {
+    prom_counter_add(turn_udp_io_uring_recv_batches, (double)d->io_uring_recv_batches, NULL);
+  }
+  if (d->io_uring_recv_packets) {
+    prom_counter_add(turn_udp_io_uring_recv_packets, (double)d->io_uring_recv_packets, NULL);
+  }
+  if (d->io_uring_send_submits) {
+    prom_counter_add(turn_udp_io_uring_send_submits, (double)d->io_uring_send_submits, NULL);
+  }
+  if (d->io_uring_send_datagrams) {
+    prom_counter_add(turn_udp_io_uring_send_datagrams, (double)d->io_uring_send_datagrams, NULL);
+  }
+}
+
+void prom_flush_nbh_pool_counters(const char *size_class, uint64_t allocs, uint64_t reuses, int64_t pooled) {
+  if (!turn_params.prometheus || !size_class) {
+    return;
+  }
+  const char *label[] = {size_class};
+  if (allocs) {
+    prom_counter_add(turn_nbh_pool_allocs, (double)allocs, label);
+  }
+  if (reuses) {
+    prom_counter_add(turn_nbh_pool_reuses, (double)reuses, label);
+  }
+  if (pooled) {
+    prom_gauge_add(turn_nbh_pool_pooled, (double)pooled, label);
+  }
+}
+
+void prom_inc_auth_cache(const char *kind, bool hit) {
+  if (turn_params.prometheus && kind) {
+    const char *label[] = {kind};
+    prom_counter_add(hit ? turn_auth_cache_hits : turn_auth_cache_misses, 1, label);
+  }
+}
+
+void prom_observe_db_user_key_lookup(const char *driver, double seconds) {
+  static const char *const bounds[] = {"0.001", "0.005", "0.01", "0.05", "0.1", "0.5", "1", "5", "+Inf"};
+  static const double limits[] = {0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1, 5};
+  if (turn_params.prometheus && driver) {
+    for (size_t i = 0; i < sizeof(bounds) / sizeof(bounds[0]); i++) {
+      if ((i >= sizeof(limits) / sizeof(limits[0])) || (seconds <= limits[i])) {
+        const char *label[] = {driver, bounds[i]};
+        prom_counter_add(turn_db_user_key_lookup_seconds_bucket, 1, label);
+      }
+    }
+    const char *label[] = {driver};
+    prom_counter_add(turn_db_user_key_lookup_seconds_sum, seconds, label);
+    prom_counter_add(turn_db_user_key_lookup_seconds_count, 1, label);
+  }
+}
+
+void prom_inc_tls_handshake(bool resumed) {
+  if (turn_params.prometheus) {
+    const char *label[] = {resumed ? "resumed" : "full"};
+    prom_counter_add(turn_tls_handshakes, 1, label);
+  }
+}
+
+void prom_inc_dtls_cookie(const char *result) {
+  if (turn_params.prometheus && result) {
+    const char *label[] = {result};
+    prom_counter_add(turn_dtls_cookie_exchanges, 1, label);
+  }
+}
+
+void prom_inc_dtls_rebinding(const char *result) {
+  if (turn_params.prometheus && result) {
+    const char *label[] = {result};
+    prom_counter_add(turn_dtls_rebindings, 1, label);
+  }
+}
+
+void prom_set_relay_thread_load(unsigned int thread, uint32_t sessions, uint32_t bps, uint32_t cpu_permille) {
+  if (turn_params.prometheus) {
+    char thread_str[16];
+    snprintf(thread_str, sizeof(thread_str), "%u", thread);
+    const char *label[] = {thread_str};
+    prom_gauge_set(turn_relay_thread_sessions, sessions, label);
+    prom_gauge_set(turn_relay_thread_bytes_per_second, bps, label);
+    prom_gauge_set(turn_relay_thread_cpu, cpu_permille / 1000.0, label);
+  }
+}
+
+void prom_set_relay_thread_queue(unsigned int thread, const char *queue, uint32_t depth, uint32_t high_water) {
+  if (turn_params.prometheus && queue) {
+    char thread_str[16];
+    snprintf(thread_str, sizeof(thread_str), "%u", thread);
+    const char *label[] = {thread_str, queue};
+    prom_gauge_set(turn_relay_thread_queue_depth, depth, label);
+    prom_gauge_set(turn_relay_thread_queue_high_water, high_water, label);
+  }
+}
+
+void prom_inc_session_migration(bool moved) {
+  if (turn_params.prometheus) {
+    const char *label[] = {moved ? "moved" : "refused"};
+    prom_counter_add(turn_relay_session_migrations, 1, label);
+  }
+}
+
+void prom_tls_handshake_pool_queued(void) {
+  if (turn_params.prometheus) {
+    prom_gauge_inc(turn_tls_handshake_pool_queued, NULL);
+  }
+}
+
+void prom_tls_handshake_pool_done(const char *result, double seconds) {
+  if (turn_params.prometheus && result) {
+    const char *label[] = {result};
+    prom_gauge_dec(turn_tls_handshake_pool_queued, NULL);
+    prom_counter_add(turn_tls_handshake_pool_handshakes, 1, label);
+    prom_counter_add(turn_tls_handshake_pool_seconds, seconds, label);
+  }
+}
+
+void prom_flush_relay_port_steals(uint64_t steals) {
+  if (turn_params.prometheus && steals) {
+    prom_counter_add(turn_relay_port_steals, (double)steals, NULL);
+  }
 }
 
 /* The 401 mitigation counters are bumped on the relay hot path (once per
@@ -571,6 +819,56 @@ void prom_dec_allocation(SOCKET_TYPE type) { UNUSED_ARG(type); }
 
 void prom_flush_udp_counters(const struct prom_udp_counter_deltas *d) { UNUSED_ARG(d); }
 
+void prom_flush_nbh_pool_counters(const char *size_class, uint64_t allocs, uint64_t reuses, int64_t pooled) {
+  UNUSED_ARG(size_class);
+  UNUSED_ARG(allocs);
+  UNUSED_ARG(reuses);
+  UNUSED_ARG(pooled);
+}
+
+void prom_flush_relay_port_steals(uint64_t steals) { UNUSED_ARG(steals); }
+
+void prom_inc_auth_cache(const char *kind, bool hit) {
+  UNUSED_ARG(kind);
+  UNUSED_ARG(hit);
+}
+
+void prom_observe_db_user_key_lookup(const char *driver, double seconds) {
+  UNUSED_ARG(driver);
+  UNUSED_ARG(seconds);
+}
+
+void prom_inc_tls_handshake(bool resumed) {
+  UNUSED_ARG(resumed);
+}
+
+void prom_inc_dtls_cookie(const char *result) { UNUSED_ARG(result); }
+
+void prom_inc_dtls_rebinding(const char *result) { UNUSED_ARG(result); }
+
+void prom_set_relay_thread_load(unsigned int thread, uint32_t sessions, uint32_t bps, uint32_t cpu_permille) {
+  UNUSED_ARG(thread);
+  UNUSED_ARG(sessions);
+  UNUSED_ARG(bps);
+  UNUSED_ARG(cpu_permille);
+}
+
+void prom_set_relay_thread_queue(unsigned int thread, const char *queue, uint32_t depth, uint32_t high_water) {
+  UNUSED_ARG(thread);
+  UNUSED_ARG(queue);
+  UNUSED_ARG(depth);
+  UNUSED_ARG(high_water);
+}
+
+void prom_inc_session_migration(bool moved) { UNUSED_ARG(moved); }
+
+void prom_tls_handshake_pool_queued(void) {}
+
+void prom_tls_handshake_pool_done(const char *result, double seconds) {
+  UNUSED_ARG(result);
+  UNUSED_ARG(seconds);
+}
+
 void prom_inc_unauthenticated_401_request(void) {}
 
 void prom_inc_unauthenticated_401_response(void) {}
@@ -110,6 +110,27 @@ extern prom_counter_t *turn_udp_recvmmsg_packets;
 extern prom_counter_t *turn_udp_sendmmsg_flushes;
 extern prom_counter_t *turn_udp_sendmmsg_datagrams;
 extern prom_counter_t *turn_udp_sendmmsg_gso_datagrams;
+/* The same pair of ratios for the --udp-io-uring backend. */
+extern prom_counter_t *turn_udp_io_uring_recv_batches;
+extern prom_counter_t *turn_udp_io_uring_recv_packets;
+extern prom_counter_t *turn_udp_io_uring_send_submits;
+extern prom_counter_t *turn_udp_io_uring_send_datagrams;
+
+/* Network buffer pool, labelled by size class. reuses/allocs is the free-list
+ * hit rate; pooled is the number of idle buffers parked on the free lists. */
+extern prom_counter_t *turn_nbh_pool_allocs;
+extern prom_counter_t *turn_nbh_pool_reuses;
+extern prom_gauge_t *turn_nbh_pool_pooled;
+
+/* Relay port allocations a thread had to take from another thread's shard
+ * (--sharded-relay-ports). A steadily rising rate means the shards are too
+ * small for the per-thread allocation skew. */
+extern prom_counter_t *turn_relay_port_steals;
+
+/* Credential cache lookups (--auth-cache-ttl), labelled kind="key" or
+ * kind="secrets". Bumped from the auth threads, off the relay hot path. */
+extern prom_counter_t *turn_auth_cache_hits;
+extern prom_counter_t *turn_auth_cache_misses;
 
 int is_ipv6_enabled(void);
 
@@ -141,12 +162,66 @@ struct prom_udp_counter_deltas {
   uint64_t sendmmsg_flushes;
   uint64_t sendmmsg_datagrams;
   uint64_t sendmmsg_gso_datagrams;
+  uint64_t io_uring_recv_batches;
+  uint64_t io_uring_recv_packets;
+  uint64_t io_uring_send_submits;
+  uint64_t io_uring_send_datagrams;
 };
 
 /* Add the given non-zero deltas to the shared prometheus counters.
  * No-op when prometheus is disabled or compiled out. */
 void prom_flush_udp_counters(const struct prom_udp_counter_deltas *d);
 
+/* Add one engine's network buffer pool deltas for the given size class.
+ * Flushed alongside prom_flush_udp_counters(); no-op when prometheus is
+ * disabled or compiled out. */
+void prom_flush_nbh_pool_counters(const char *size_class, uint64_t allocs, uint64_t reuses, int64_t pooled);
+
+/* Count one credential cache lookup of the given kind. No-op when prometheus
+ * is disabled or compiled out. */
+void prom_inc_auth_cache(const char *kind, bool hit);
+
+/* Record how long one database user key lookup took, blocking or not. No-op
+ * when prometheus is disabled or compiled out. */
+void prom_observe_db_user_key_lookup(const char *driver, double seconds);
+
+/* Count one completed TLS/DTLS server handshake, full or resumed from a
+ * session ticket. No-op when prometheus is disabled or compiled out. */
+void prom_inc_tls_handshake(bool resumed);
+
+/* Count one DTLS handshake datagram handled by the listener cookie exchange:
+ * "challenged", "verified" or "dropped". No-op when prometheus is disabled or
+ * compiled out. */
+void prom_inc_dtls_cookie(const char *result);
+
+/* Count one DTLS record from an unknown source tried against established
+ * sessions (--dtls-rebinding): "rebound", "unmatched" or "limited". No-op when
+ * prometheus is disabled or compiled out. */
+void prom_inc_dtls_rebinding(const char *result);
+
+/* Set one relay thread's live session count, smoothed byte rate and smoothed
+ * CPU time (thousandths of a core). Called once per second from each relay
+ * thread. No-op when prometheus is disabled or compiled out. */
+void prom_set_relay_thread_load(unsigned int thread, uint32_t sessions, uint32_t bps, uint32_t cpu_permille);
+
+/* Set the current and highest depth of one relay thread queue, "relay" or
+ * "auth". No-op when prometheus is disabled or compiled out. */
+void prom_set_relay_thread_queue(unsigned int thread, const char *queue, uint32_t depth, uint32_t high_water);
+
+/* Count one attempt to move a session to another relay thread. No-op when
+ * prometheus is disabled or compiled out. */
+void prom_inc_session_migration(bool moved);
+
+/* Track one connection through the TLS handshake threads: queued, then done
+ * with result "tls", "plain" or "failed" after `seconds`. No-op when
+ * prometheus is disabled or compiled out. */
+void prom_tls_handshake_pool_queued(void);
+void prom_tls_handshake_pool_done(const char *result, double seconds);
+
+/* Add one engine's relay port steal delta. No-op when prometheus is disabled
+ * or compiled out. */
+void prom_flush_relay_port_steals(uint64_t steals);
+
 /* Flush this thread's lock-free 401 mitigation counters into the shared
  * prometheus counters. Called once per second per relay thread from the engine
  * timer. No-op when prometheus is disabled or compiled out. */
@@ -0,0 +1,276 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * https://opensource.org/license/bsd-3-clause
+ *
+ * Copyright (C) 2011, 2012, 2013, 2014 Citrix Systems
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "relay_queue.h"
+
+#include "ns_turn_atomic.h"
+#include "ns_turn_defs.h"
+
+#include <event2/util.h>
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+#define RELAY_QUEUE_SOCKETPAIR_AF AF_INET
+#else
+#define RELAY_QUEUE_SOCKETPAIR_AF AF_UNIX
+#endif
+
+/* A slot is free for the producer that claims position `pos` when its
+ * sequence is `pos`, and holds a message for the consumer when it is
+ * `pos + 1` (the bounded MPMC ring of D. Vyukov, with a single consumer). */
+typedef struct {
+  turn_atomic_u32 seq;
+  void *msg;
+} relay_queue_slot;
+
+struct _relay_queue {
+  turn_atomic_u32 tail; /* next position a producer claims */
+  turn_atomic_u32 head; /* next position the consumer takes */
+  turn_atomic_u32 high_water;
+  turn_atomic_u32 notified; /* a wakeup is pending */
+  uint32_t mask;
+  relay_queue_slot *slots;
+  evutil_socket_t wake_fd[2]; /* read end, write end; the same eventfd on Linux */
+  struct event *ev;
+  relay_queue_cb cb;
+  void *arg;
+};
+
+static void relay_queue_signal(relay_queue *q) {
+#if defined(__linux__)
+  const uint64_t one = 1;
+  if (write(q->wake_fd[1], &one, sizeof(one)) < 0) {
+    /* The counter is already non-zero; the consumer wakes anyway. */
+  }
+#else
+  const char one = 1;
+  send(q->wake_fd[1], &one, sizeof(one), 0);
+#endif
+}
+
+static void relay_queue_clear_signal(relay_queue *q) {
+#if defined(__linux__)
+  uint64_t count = 0;
+  if (read(q->wake_fd[0], &count, sizeof(count)) < 0) {
+    /* Nothing to clear. */
+  }
+#else
+  char buf[64];
+  while (recv(q->wake_fd[0], buf, sizeof(buf), 0) > 0) {
+  }
+#endif
+}
+
+static void relay_queue_drain(evutil_socket_t fd, short what, void *arg) {
+  UNUSED_ARG(fd);
+  UNUSED_ARG(what);
+  relay_queue *q = (relay_queue *)arg;
+
+  relay_queue_clear_signal(q);
+  /* Producers that push from here on signal again. */
+  turn_atomic_store_u32(&(q->notified), 0);
+
+  for (int i = 0; i < RELAY_QUEUE_BATCH; i++) {
+    void *msg = relay_queue_pop(q);
+    if (!msg) {
+      return;
+    }
+    q->cb(msg, q->arg);
+  }
+
+  /* More to do: let the thread's other events run first. */
+  if (relay_queue_depth(q)) {
+    event_active(q->ev, EV_READ, 0);
+  }
+}
+
+static int relay_queue_open_wakeup(relay_queue *q) {
+#if defined(__linux__)
+  const int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (fd < 0) {
+    return -1;
+  }
+  q->wake_fd[0] = fd;
+  q->wake_fd[1] = fd;
+#else
+  if (evutil_socketpair(RELAY_QUEUE_SOCKETPAIR_AF, SOCK_STREAM, 0, q->wake_fd) < 0) {
+    return -1;
+  }
+  evutil_make_socket_nonblocking(q->wake_fd[0]);
+  evutil_make_socket_nonblocking(q->wake_fd[1]);
+  evutil_make_socket_closeonexec(q->wake_fd[0]);
+  evutil_make_socket_closeonexec(q->wake_fd[1]);
+#endif
+  return 0;
+}
+
+static void relay_queue_close_wakeup(relay_queue *q) {
+  if (q->wake_fd[0] >= 0) {
+    evutil_closesocket(q->wake_fd[0]);
+  }
+  if ((q->wake_fd[1] >= 0) && (q->wake_fd[1] != q->wake_fd[0])) {
+    evutil_closesocket(q->wake_fd[1]);
+  }
+  q->wake_fd[0] = -1;
+  q->wake_fd[1] = -1;
+}
+
+relay_queue *relay_queue_new(struct event_base *base, size_t size, relay_queue_cb cb, void *arg) {
+  if ((size < 2) || (size > ((size_t)1 << 30)) || (base && !cb)) {
+    return NULL;
+  }
+  size_t capacity = 2;
+  while (capacity < size) {
+    capacity <<= 1;
+  }
+
+  relay_queue *q = (relay_queue *)calloc(1, sizeof(relay_queue));
+  if (!q) {
+    return NULL;
+  }
+  q->slots = (relay_queue_slot *)calloc(capacity, sizeof(relay_queue_slot));
+  if (!q->slots) {
+    free(q);
+    return NULL;
+  }
+  q->mask = (uint32_t)(capacity - 1);
+  for (uint32_t i = 0; i <= q->mask; i++) {
+    turn_atomic_store_u32(&(q->slots[i].seq), i);
+  }
+  q->cb = cb;
+  q->arg = arg;
+  q->wake_fd[0] = -1;
+  q->wake_fd[1] = -1;
+
+  if (base) {
+    if (relay_queue_open_wakeup(q) < 0) {
+      relay_queue_free(q);
+      return NULL;
+    }
+    q->ev = event_new(base, q->wake_fd[0], EV_READ | EV_PERSIST, relay_queue_drain, q);
+    if (!q->ev || (event_add(q->ev, NULL) < 0)) {
+      relay_queue_free(q);
+      return NULL;
+    }
+  }
+
+  return q;
+}
+
+void relay_queue_free(relay_queue *q) {
+  if (q) {
+    if (q->ev) {
+      event_free(q->ev);
+    }
+    relay_queue_close_wakeup(q);
+    free(q->slots);
+    free(q);
+  }
+}
+
+int relay_queue_push(relay_queue *q, void *msg) {
+  if (!q || !msg) {
+    return -1;
+  }
+
+  uint32_t pos = turn_atomic_load_u32(&(q->tail));
+  relay_queue_slot *slot = NULL;
+  for (;;) {
+    slot = &(q->slots[pos & q->mask]);
+    const int32_t dif = (int32_t)(turn_atomic_load_u32(&(slot->seq)) - pos);
+    if (dif == 0) {
+      if (turn_atomic_cas_u32(&(q->tail), pos, pos + 1)) {
+        break;
+      }
+    } else if (dif < 0) {
+      /* The consumer has not taken this slot's previous message yet. */
+      return -1;
+    }
+    pos = turn_atomic_load_u32(&(q->tail));
+  }
+
+  slot->msg = msg;
+  turn_atomic_store_u32(&(slot->seq), pos + 1);
+
+  /* The consumer may already be past this message. */
+  const int32_t depth = (int32_t)(pos + 1 - turn_atomic_load_u32(&(q->head)));
+  uint32_t hw = turn_atomic_load_u32(&(q->high_water));
+  while ((depth > (int32_t)hw) && !turn_atomic_cas_u32(&(q->high_water), hw, (uint32_t)depth)) {
+    hw = turn_atomic_load_u32(&(q->high_water));
+  }
+
+  if (q->ev && turn_atomic_cas_u32(&(q->notified), 0, 1)) {
+    relay_queue_signal(q);
+  }
+
+  return 0;
+}
+
+void *relay_queue_pop(relay_queue *q) {
+  if (!q) {
+    return NULL;
+  }
+
+  const uint32_t pos = turn_atomic_load_u32(&(q->head));
+  relay_queue_slot *slot = &(q->slots[pos & q->mask]);
+  if (turn_atomic_load_u32(&(slot->seq)) != pos + 1) {
+    /* Empty, or the next producer has claimed the slot but not filled it;
+     * it signals once it has. */
+    return NULL;
+  }
+
+  void *msg = slot->msg;
+  slot->msg = NULL;
+  turn_atomic_store_u32(&(slot->seq), pos + q->mask + 1);
+  turn_atomic_store_u32(&(q->head), pos + 1);
+
+  return msg;
+}
+
+uint32_t relay_queue_depth(relay_queue *q) {
+  if (!q) {
+    return 0;
+  }
+  const uint32_t head = turn_atomic_load_u32(&(q->head));
+  return turn_atomic_load_u32(&(q->tail)) - head;
+}
+
+uint32_t relay_queue_high_water(relay_queue *q) { return q ? turn_atomic_load_u32(&(q->high_water)) : 0; }
@@ -0,0 +1,89 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * https://opensource.org/license/bsd-3-clause
+ *
+ * Copyright (C) 2011, 2012, 2013, 2014 Citrix Systems
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef __TURN_RELAY_QUEUE__
+#define __TURN_RELAY_QUEUE__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <event2/event.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//////////////////////////////////////////////////
+
+/*
+ * Message queue between the listener, auth, handshake and relay threads.
+ *
+ * A bounded lock-free ring of message pointers with any number of producer
+ * threads and one consumer thread, the one running the queue's event base.
+ * A producer wakes the consumer through an eventfd (a socket pair where there
+ * is none) only when no wakeup is already pending, and the consumer drains up
+ * to RELAY_QUEUE_BATCH messages per wakeup before yielding to its other
+ * events.
+ */
+
+#define RELAY_QUEUE_SIZE_DEFAULT (16384)
+#define RELAY_QUEUE_BATCH (64)
+
+typedef struct _relay_queue relay_queue;
+
+/* Called on the consumer thread, once per message. */
+typedef void (*relay_queue_cb)(void *msg, void *arg);
+
+/* `size` is rounded up to a power of two. Without an event base the queue has
+ * no wakeup; the owner polls it with relay_queue_pop(). */
+relay_queue *relay_queue_new(struct event_base *base, size_t size, relay_queue_cb cb, void *arg);
+void relay_queue_free(relay_queue *q);
+
+/* Any thread. Returns -1, and keeps nothing, if the queue is full. */
+int relay_queue_push(relay_queue *q, void *msg);
+
+/* Consumer thread only. Returns NULL if the queue is empty. */
+void *relay_queue_pop(relay_queue *q);
+
+/* Messages queued and not yet taken, and the most there have ever been. */
+uint32_t relay_queue_depth(relay_queue *q);
+uint32_t relay_queue_high_water(relay_queue *q);
+
+//////////////////////////////////////////////////
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__TURN_RELAY_QUEUE__
@@ -0,0 +1,276 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * https://opensource.org/license/bsd-3-clause
+ *
+ * Copyright (C) 2011, 2012, 2013, 2014 Citrix Systems
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "tls_tickets.h"
+
+#include "ns_turn_ioalib.h"
+#include "ns_turn_utils.h"
+
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#else
+#include <openssl/hmac.h>
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Tickets from several processes sharing a key file must carry the same
+ * session id context, or OpenSSL refuses to resume them. */
+static const unsigned char tls_tickets_sid_ctx[] = "turnserver";
+
+static struct {
+  TURN_MUTEX_DECLARE(mutex)
+  tls_ticket_key keys[TLS_TICKET_MAX_KEYS];
+  size_t count;
+  tls_ticket_stats stats;
+} ring;
+
+static int random_key(tls_ticket_key *key) { return RAND_bytes((unsigned char *)key, sizeof(*key)) == 1 ? 0 : -1; }
+
+void tls_tickets_init(void) {
+  TURN_MUTEX_INIT(&ring.mutex);
+  ring.count = 0;
+  memset(&ring.stats, 0, sizeof(ring.stats));
+  if (random_key(&(ring.keys[0])) == 0) {
+    ring.count = 1;
+  }
+}
+
+int tls_tickets_rotate(void) {
+  tls_ticket_key key;
+  if (random_key(&key) < 0) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Cannot generate a TLS session ticket key\n");
+    return -1;
+  }
+
+  TURN_MUTEX_LOCK(&ring.mutex);
+  const size_t keep = ring.count < TLS_TICKET_MAX_KEYS ? ring.count : TLS_TICKET_MAX_KEYS - 1;
+  memmove(&(ring.keys[1]), &(ring.keys[0]), keep * sizeof(tls_ticket_key));
+  ring.keys[0] = key;
+  ring.count = keep + 1;
+  ++ring.stats.key_changes;
+  TURN_MUTEX_UNLOCK(&ring.mutex);
+
+  OPENSSL_cleanse(&key, sizeof(key));
+  return 0;
+}
+
+int tls_tickets_load_file(const char *path) {
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Cannot open TLS session ticket key file %s: %s\n", path, strerror(errno));
+    return -1;
+  }
+
+  tls_ticket_key keys[TLS_TICKET_MAX_KEYS];
+  size_t count = 0;
+  size_t records = 0;
+  bool partial = false;
+  uint8_t record[TLS_TICKET_KEY_RECORD_SIZE];
+  for (;;) {
+    const size_t len = fread(record, 1, sizeof(record), f);
+    if (len == sizeof(record)) {
+      if (count < TLS_TICKET_MAX_KEYS) {
+        memcpy(keys[count].name, record, TLS_TICKET_KEY_NAME_SIZE);
+        memcpy(keys[count].hmac_secret, record + TLS_TICKET_KEY_NAME_SIZE, TLS_TICKET_KEY_SECRET_SIZE);
+        memcpy(keys[count].aes_secret, record + TLS_TICKET_KEY_NAME_SIZE + TLS_TICKET_KEY_SECRET_SIZE,
+               TLS_TICKET_KEY_SECRET_SIZE);
+        ++count;
+      }
+      ++records;
+    } else {
+      partial = (len != 0);
+      break;
+    }
+  }
+  fclose(f);
+  OPENSSL_cleanse(record, sizeof(record));
+
+  if (partial || !count) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "TLS session ticket key file %s must hold one or more %d-byte keys\n", path,
+                  TLS_TICKET_KEY_RECORD_SIZE);
+    OPENSSL_cleanse(keys, sizeof(keys));
+    return -1;
+  }
+  if (records > count) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_WARNING, "TLS session ticket key file %s: only the first %d keys are used\n", path,
+                  TLS_TICKET_MAX_KEYS);
+  }
+
+  TURN_MUTEX_LOCK(&ring.mutex);
+  if (count != ring.count || CRYPTO_memcmp(keys, ring.keys, count * sizeof(tls_ticket_key))) {
+    memcpy(ring.keys, keys, count * sizeof(tls_ticket_key));
+    ring.count = count;
+    ++ring.stats.key_changes;
+  }
+  TURN_MUTEX_UNLOCK(&ring.mutex);
+
+  OPENSSL_cleanse(keys, sizeof(keys));
+  return (int)count;
+}
+
+size_t tls_tickets_key_count(void) {
+  TURN_MUTEX_LOCK(&ring.mutex);
+  const size_t count = ring.count;
+  TURN_MUTEX_UNLOCK(&ring.mutex);
+  return count;
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+
+typedef EVP_MAC_CTX ticket_mac_ctx;
+
+static int set_ticket_mac(ticket_mac_ctx *hctx, tls_ticket_key *key) {
+  OSSL_PARAM params[3];
+  params[0] = OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, key->hmac_secret, sizeof(key->hmac_secret));
+  params[1] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, (char *)"SHA256", 0);
+  params[2] = OSSL_PARAM_construct_end();
+  return EVP_MAC_CTX_set_params(hctx, params);
+}
+
+#else // OPENSSL_VERSION_NUMBER < 0x30000000L
+
+typedef HMAC_CTX ticket_mac_ctx;
+
+static int set_ticket_mac(ticket_mac_ctx *hctx, tls_ticket_key *key) {
+  return HMAC_Init_ex(hctx, key->hmac_secret, sizeof(key->hmac_secret), EVP_sha256(), NULL);
+}
+
+#endif // OPENSSL_VERSION_NUMBER >= 0x30000000L
+
+/* SSL_CTX_set_tlsext_ticket_key_evp_cb() (SSL_CTX_set_tlsext_ticket_key_cb()
+ * before 3.0) contract: -1 is an error and 0 means no ticket is issued
+ * (encryption) or the key name is unknown (decryption); decryption returns 2
+ * to have the ticket renewed. */
+static int tls_ticket_key_cb(SSL *ssl, unsigned char key_name[TLS_TICKET_KEY_NAME_SIZE], unsigned char *iv,
+                             EVP_CIPHER_CTX *cctx, ticket_mac_ctx *hctx, int enc) {
+  UNUSED_ARG(ssl);
+
+  const EVP_CIPHER *cipher = EVP_aes_256_cbc();
+  tls_ticket_key key;
+  int ret = -1;
+
+  if (enc) {
+    TURN_MUTEX_LOCK(&ring.mutex);
+    const bool have_key = ring.count > 0;
+    if (have_key) {
+      key = ring.keys[0];
+      ++ring.stats.tickets_issued;
+    }
+    TURN_MUTEX_UNLOCK(&ring.mutex);
+
+    if (!have_key) {
+      return 0;
+    }
+    memcpy(key_name, key.name, TLS_TICKET_KEY_NAME_SIZE);
+    if (RAND_bytes(iv, EVP_CIPHER_iv_length(cipher)) == 1 &&
+        EVP_EncryptInit_ex(cctx, cipher, NULL, key.aes_secret, iv) == 1 && set_ticket_mac(hctx, &key) == 1) {
+      ret = 1;
+    }
+  } else {
+    size_t i = 0;
+    TURN_MUTEX_LOCK(&ring.mutex);
+    while (i < ring.count && CRYPTO_memcmp(ring.keys[i].name, key_name, TLS_TICKET_KEY_NAME_SIZE)) {
+      ++i;
+    }
+    const bool found = i < ring.count;
+    if (found) {
+      key = ring.keys[i];
+      if (i) {
+        ++ring.stats.tickets_renewed;
+      }
+    } else {
+      ++ring.stats.tickets_unknown;
+    }
+    TURN_MUTEX_UNLOCK(&ring.mutex);
+
+    if (!found) {
+      return 0;
+    }
+    if (set_ticket_mac(hctx, &key) == 1 && EVP_DecryptInit_ex(cctx, cipher, NULL, key.aes_secret, iv) == 1) {
+      ret = i ? 2 : 1;
+    }
+  }
+
+  OPENSSL_cleanse(&key, sizeof(key));
+  return ret;
+}
+
+void tls_tickets_setup_ctx(SSL_CTX *ctx, bool enable, unsigned int rotation) {
+  if (!ctx) {
+    return;
+  }
+
+  SSL_CTX_set_session_id_context(ctx, tls_tickets_sid_ctx, sizeof(tls_tickets_sid_ctx) - 1);
+
+  if (!enable) {
+    /* With the session cache off, TLS 1.3 would otherwise still send
+     * stateful tickets that can never be resumed. */
+    SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+    SSL_CTX_set_num_tickets(ctx, 0);
+    return;
+  }
+
+  SSL_CTX_clear_options(ctx, SSL_OP_NO_TICKET);
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+  SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx, tls_ticket_key_cb);
+#else
+  SSL_CTX_set_tlsext_ticket_key_cb(ctx, tls_ticket_key_cb);
+#endif
+  if (rotation) {
+    SSL_CTX_set_timeout(ctx, (long)rotation * (TLS_TICKET_MAX_KEYS - 1));
+  }
+}
+
+bool tls_tickets_count_handshake(const SSL *ssl) {
+  const bool resumed = SSL_session_reused(ssl) == 1;
+  TURN_MUTEX_LOCK(&ring.mutex);
+  if (resumed) {
+    ++ring.stats.resumed_handshakes;
+  } else {
+    ++ring.stats.full_handshakes;
+  }
+  TURN_MUTEX_UNLOCK(&ring.mutex);
+  return resumed;
+}
+
+void tls_tickets_get_stats(tls_ticket_stats *st) {
+  TURN_MUTEX_LOCK(&ring.mutex);
+  *st = ring.stats;
+  TURN_MUTEX_UNLOCK(&ring.mutex);
+}
@@ -0,0 +1,118 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * https://opensource.org/license/bsd-3-clause
+ *
+ * Copyright (C) 2011, 2012, 2013, 2014 Citrix Systems
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef __TURN_TLS_TICKETS__
+#define __TURN_TLS_TICKETS__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <openssl/ssl.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//////////////////////////////////////////////////
+
+/*
+ * Stateless TLS session resumption (TLS 1.2 session tickets and TLS 1.3
+ * PSK tickets) for the TLS and DTLS listeners.
+ *
+ * One process-wide key ring encrypts the tickets of every SSL_CTX, so tickets
+ * stay valid when the contexts are rebuilt on a certificate reload. The first
+ * key encrypts new tickets; every key in the ring decrypts, and a ticket
+ * decrypted with an older key is renewed under the current one. Keys come
+ * either from a key file, which lets several relay processes behind one
+ * address resume each other's sessions, or from RAND_bytes().
+ */
+
+#define TLS_TICKET_KEY_NAME_SIZE (16)
+#define TLS_TICKET_KEY_SECRET_SIZE (32)
+/* Key file record: name, HMAC secret, AES secret -- the layout of nginx's
+ * ssl_session_ticket_key, so `openssl rand 80` makes a valid key. */
+#define TLS_TICKET_KEY_RECORD_SIZE (TLS_TICKET_KEY_NAME_SIZE + 2 * TLS_TICKET_KEY_SECRET_SIZE)
+/* The current key plus the ones that still decrypt. */
+#define TLS_TICKET_MAX_KEYS (4)
+
+#define TLS_TICKET_KEY_ROTATION_DEFAULT (3600)
+
+typedef struct _tls_ticket_key {
+  uint8_t name[TLS_TICKET_KEY_NAME_SIZE];
+  uint8_t hmac_secret[TLS_TICKET_KEY_SECRET_SIZE];
+  uint8_t aes_secret[TLS_TICKET_KEY_SECRET_SIZE];
+} tls_ticket_key;
+
+typedef struct _tls_ticket_stats {
+  uint64_t full_handshakes;
+  uint64_t resumed_handshakes;
+  uint64_t tickets_issued;
+  uint64_t tickets_renewed; /* decrypted with an older key and reissued */
+  uint64_t tickets_unknown; /* no key in the ring matched; a full handshake follows */
+  uint64_t key_changes;     /* rotations and key file reloads that changed the ring */
+} tls_ticket_stats;
+
+//////////////////////////////////////////////////
+
+/* Must be called once before any other function. Starts with one random key. */
+void tls_tickets_init(void);
+
+/* Pushes a new random key in front; the oldest key falls off a full ring.
+ * Returns 0, or -1 if no random key could be made. */
+int tls_tickets_rotate(void);
+
+/* Replaces the ring with the first TLS_TICKET_MAX_KEYS records of a key file.
+ * Returns the number of keys loaded, or -1 if the file cannot be read or is
+ * not a whole, non-zero number of records; the ring is then left unchanged. */
+int tls_tickets_load_file(const char *path);
+
+size_t tls_tickets_key_count(void);
+
+/* Installs the ticket key callback on ctx and, for rotation > 0, a session
+ * lifetime that ends before the ticket's key leaves the ring. With enable
+ * false no tickets are issued at all. */
+void tls_tickets_setup_ctx(SSL_CTX *ctx, bool enable, unsigned int rotation);
+
+/* Counts a completed server-side handshake as full or resumed. Returns true
+ * if it was resumed. */
+bool tls_tickets_count_handshake(const SSL *ssl);
+
+void tls_tickets_get_stats(tls_ticket_stats *st);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__TURN_TLS_TICKETS__
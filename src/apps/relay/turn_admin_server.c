@@ -184,6 +184,7 @@ static const char *CLI_HELP_STR[] = {"",
                                      "  dudpas ip[:port] - delete a UDP alternate server reference",
                                      "",
                                      "  cs <session-id> - cancel session, forcefully",
+                                     "  ms <session-id> <thread> - move a TCP/TLS session to another relay thread",
                                      "",
                                      NULL};
 
@@ -551,6 +552,9 @@ static bool print_session(ur_map_key_type key, ur_map_value_type value, void *ar
         if (tsi->tls_method[0]) {
           myprintf(cs, "      TLS method: %s\n", tsi->tls_method);
           myprintf(cs, "      TLS cipher: %s\n", tsi->tls_cipher);
+          if (tsi->tls_offload[0]) {
+            myprintf(cs, "      TLS offload (kTLS): %s\n", tsi->tls_offload);
+          }
         }
         if (tsi->bps) {
           myprintf(cs, "      Max throughput: %lu bytes per second\n", (unsigned long)tsi->bps);
@@ -593,6 +597,17 @@ static void cancel_session(struct cli_session *cs, const char *ssid) {
   }
 }
 
+static void migrate_session(struct cli_session *cs, const char *args) {
+  if (cs && cs->ts && args && *args) {
+    char *end = NULL;
+    const turnsession_id sid = strtoull(args, &end, 10);
+    const unsigned long to = strtoul(end, NULL, 10);
+    if (!sid || (end == args) || (to > 255) || (send_session_migration_to_relay(sid, (turnserver_id)to) < 0)) {
+      myprintf(cs, "  wrong session id or relay thread\n");
+    }
+  }
+}
+
 static void print_sessions(struct cli_session *cs, const char *pn, int exact_match, int print_users) {
   if (cs && cs->ts && pn) {
 
@@ -698,12 +713,34 @@ static void cli_print_configuration(struct cli_session *cs) {
     cli_print_flag(cs, turn_params.fingerprint, "enforce fingerprints", 0);
     cli_print_flag(cs, turn_params.mobility, "mobility", 1);
     cli_print_flag(cs, turn_params.udp_self_balance, "udp-self-balance", 0);
+    cli_print_str(cs, relay_placement_name(turn_params.relay_placement), "relay-placement", 0);
+    cli_print_uint(cs, (unsigned long)turn_params.relay_rebalance, "relay-rebalance", 0);
+    {
+      uint32_t sessions[MAX_NUMBER_OF_GENERAL_RELAY_SERVERS];
+      uint32_t bps[MAX_NUMBER_OF_GENERAL_RELAY_SERVERS];
+      uint32_t cpu[MAX_NUMBER_OF_GENERAL_RELAY_SERVERS];
+      const size_t n = get_relay_threads_load(sessions, bps, cpu, MAX_NUMBER_OF_GENERAL_RELAY_SERVERS);
+      for (size_t i = 0; i < n; i++) {
+        myprintf(cs, "  relay thread %lu load: %lu sessions, %lu B/s, %lu.%lu%% CPU\n", (unsigned long)i,
+                 (unsigned long)sessions[i], (unsigned long)bps[i], (unsigned long)(cpu[i] / 10),
+                 (unsigned long)(cpu[i] % 10));
+      }
+      relay_queue_stats queues[MAX_NUMBER_OF_GENERAL_RELAY_SERVERS];
+      const size_t nq = get_relay_threads_queues(queues, MAX_NUMBER_OF_GENERAL_RELAY_SERVERS);
+      for (size_t i = 0; i < nq; i++) {
+        myprintf(cs, "  relay thread %lu queues: %lu messages (max %lu), %lu auth (max %lu)\n", (unsigned long)i,
+                 (unsigned long)queues[i].depth, (unsigned long)queues[i].high_water,
+                 (unsigned long)queues[i].auth_depth, (unsigned long)queues[i].auth_high_water);
+      }
+    }
 #if defined(__linux__)
     cli_print_flag(cs, turn_params.udp_recvmmsg, "udp-recvmmsg", 0);
     cli_print_flag(cs, turn_params.udp_recvmmsg_log, "udp-recvmmsg-log", 0);
     cli_print_flag(cs, turn_params.multiplex_peer, "multiplex-peer", 0);
     cli_print_flag(cs, turn_params.udp_sendmmsg, "udp-sendmmsg (derived)", 0);
     cli_print_flag(cs, turn_params.udp_gso, "udp-gso", 0);
+    cli_print_flag(cs, turn_params.udp_io_uring, "udp-io-uring", 0);
+    cli_print_flag(cs, turn_params.tcp_splice, "tcp-splice", 0);
 #endif
     cli_print_str(cs, turn_params.pidfile, "pidfile", 0);
 #if defined(WINDOWS)
@@ -756,12 +793,41 @@ static void cli_print_configuration(struct cli_session *cs) {
     cli_print_flag(cs, turn_params.no_udp, "no-udp", 0);
     cli_print_flag(cs, turn_params.no_tcp, "no-tcp", 0);
     cli_print_flag(cs, turn_params.dtls, "dtls", 0);
+    cli_print_flag(cs, (turn_params.dtls_rebinding && turn_params.dtls), "dtls-rebinding", 0);
     cli_print_flag(cs, turn_params.no_tls, "no-tls", 0);
 
     cli_print_flag(cs, (turn_params.enable_tlsv1 && !turn_params.no_tls), "TLSv1.0", 0);
     cli_print_flag(cs, (turn_params.enable_tlsv1_1 && !turn_params.no_tls), "TLSv1.1", 0);
     cli_print_flag(cs, (!turn_params.no_tlsv1_2 && !turn_params.no_tls), "TLSv1.2", 0);
 
+    cli_print_flag(cs, !turn_params.no_tls_session_tickets, "tls-session-tickets", 0);
+    if (!turn_params.no_tls_session_tickets) {
+      if (turn_params.tls_ticket_key_file[0]) {
+        cli_print_str(cs, turn_params.tls_ticket_key_file, "tls-ticket-key-file", 0);
+      }
+      cli_print_uint(cs, (unsigned long)turn_params.tls_ticket_key_rotation, "tls-ticket-key-rotation", 0);
+      cli_print_uint(cs, (unsigned long)tls_tickets_key_count(), "TLS ticket keys", 0);
+      tls_ticket_stats st;
+      tls_tickets_get_stats(&st);
+      cli_print_uint(cs, (unsigned long)st.full_handshakes, "TLS full handshakes", 0);
+      cli_print_uint(cs, (unsigned long)st.resumed_handshakes, "TLS resumed handshakes", 0);
+    }
+    cli_print_flag(cs, (turn_params.tls_ktls && !turn_params.no_tls), "tls-ktls", 0);
+    {
+      tls_handshake_pool_stats st;
+      get_tls_handshake_pool_stats(&st);
+      cli_print_uint(cs, (unsigned long)st.threads, "tls-handshake-threads", 0);
+      if (st.threads) {
+        const uint64_t done = st.tls + st.plain + st.failed;
+        cli_print_uint(cs, (unsigned long)st.queued, "TLS handshake queue depth", 0);
+        cli_print_uint(cs, (unsigned long)st.tls, "TLS handshakes off relay threads", 0);
+        cli_print_uint(cs, (unsigned long)st.plain, "TLS handshake threads, plain TCP", 0);
+        cli_print_uint(cs, (unsigned long)st.failed, "TLS handshake threads, failed", 0);
+        cli_print_uint(cs, (unsigned long)(done ? st.latency_us / done : 0), "TLS handshake avg latency (us)", 0);
+        cli_print_uint(cs, (unsigned long)st.max_latency_us, "TLS handshake max latency (us)", 0);
+      }
+    }
+
     cli_print_uint(cs, (unsigned long)turn_params.listener_port, "listener-port", 0);
     cli_print_uint(cs, (unsigned long)turn_params.tls_listener_port, "tls-listener-port", 0);
     cli_print_uint(cs, (unsigned long)turn_params.alt_listener_port, "alt-listener-port", 0);
@@ -815,6 +881,7 @@ static void cli_print_configuration(struct cli_session *cs) {
     if (turn_params.default_users_db.persistent_users_db.userdb[0]) {
       cli_print_str(cs, userdb_type_to_string(turn_params.default_users_db.userdb_type), "DB type", 0);
       cli_print_str(cs, turn_params.default_users_db.persistent_users_db.userdb, "DB", 0);
+      cli_print_uint(cs, (unsigned long)turn_params.db_max_inflight, "db-max-inflight", 0);
     } else {
       cli_print_str(cs, "none", "DB type", 0);
       cli_print_str(cs, "none", "DB", 0);
@@ -1078,6 +1145,9 @@ static int run_cli_input(struct cli_session *cs, const char *buf0, unsigned int
       } else if (strstr(cmd, "cs ") == cmd) {
         cancel_session(cs, cmd + 3);
         type_cli_cursor(cs);
+      } else if (strstr(cmd, "ms ") == cmd) {
+        migrate_session(cs, cmd + 3);
+        type_cli_cursor(cs);
       } else if (strstr(cmd, "lr") == cmd) {
         log_reset(cs);
         type_cli_cursor(cs);
@@ -2433,6 +2503,8 @@ static bool https_print_session(ur_map_key_type key, ur_map_value_type value, vo
         str_buffer_append(sb, "</td><td>");
         str_buffer_append_html_escaped(sb, tsi->tls_cipher);
         str_buffer_append(sb, "</td><td>");
+        str_buffer_append_html_escaped(sb, tsi->tls_offload);
+        str_buffer_append(sb, "</td><td>");
         str_buffer_append_sz(sb, (size_t)tsi->bps);
         str_buffer_append(sb, "</td><td>");
         {
@@ -2552,7 +2624,7 @@ static void write_ps_page(ioa_socket_handle s, const char *client_protocol, cons
           "<tr><th>N</th><th>Session ID</th><th>User</th><th>Realm</th><th>Origin</th><th>Age, secs</th><th>Expires, "
           "secs</th><th>Client protocol</th><th>Relay protocol</th><th>Client addr</th><th>Server addr</th><th>Relay "
           "addr (IPv4)</th><th>Relay addr (IPv6)</th><th>Fingerprints</th><th>Mobile</th><th>TLS method</th><th>TLS "
-          "cipher</th><th>BPS (allocated)</th><th>Packets</th><th>Rate</th><th>Peers</th></tr>\r\n");
+          "cipher</th><th>kTLS</th><th>BPS (allocated)</th><th>Packets</th><th>Rate</th><th>Peers</th></tr>\r\n");
 
       const size_t total_sz = https_print_sessions(sb, client_protocol, user_pattern, max_sessions, cs);
 
@@ -3603,6 +3675,7 @@ static void handle_https(ioa_socket_handle s, ioa_network_buffer_handle nbh) {
                   STRCPY(u, user);
                   STRCPY(r, realm);
                   dbd->del_user(u, r);
+                  invalidate_auth_cache();
                 }
               }
             }
@@ -3661,6 +3734,7 @@ static void handle_https(ioa_socket_handle s, ioa_network_buffer_handle nbh) {
                     skey[sz * 2] = 0;
 
                     (*dbd->set_user_key)(u, r, skey);
+                    invalidate_auth_cache();
                   }
 
                   add_realm = (const uint8_t *)"";
@@ -3704,6 +3778,7 @@ static void handle_https(ioa_socket_handle s, ioa_network_buffer_handle nbh) {
                   STRCPY(ss, secret);
                   STRCPY(r, realm);
                   dbd->del_secret(ss, r);
+                  invalidate_auth_cache();
                 }
               }
             }
@@ -3739,6 +3814,7 @@ static void handle_https(ioa_socket_handle s, ioa_network_buffer_handle nbh) {
                 STRCPY(ss, add_secret);
                 STRCPY(r, add_realm);
                 (*dbd->set_secret)(ss, r);
+                invalidate_auth_cache();
               }
 
               add_secret = (const uint8_t *)"";
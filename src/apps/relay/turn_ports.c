@@ -32,6 +32,7 @@
  * SUCH DAMAGE.
  */
 
+#include "ns_turn_atomic.h" // for TURN_THREAD_LOCAL
 #include "ns_turn_maps.h"
 #include "ns_turn_msg_defs.h"
 
@@ -294,17 +295,140 @@ int turnports_is_available(turnports *tp, uint16_t port) {
   return 0;
 }
 
+/////////////////// SHARDED PORTS ///////////////////////////////////////
+
+/*
+ * One relay IP's port range, cut into nshards disjoint slices. Shard i owns
+ * [base + i*span, base + (i+1)*span - 1] clipped to the range, the last shard
+ * taking the remainder. base is the range start rounded down to even and span
+ * is even, so every slice boundary falls on an even port and an EVEN-PORT
+ * RTP/RTCP pair never straddles two shards. A port always goes back to the
+ * shard whose slice contains it, whichever thread releases it.
+ */
+typedef struct _turnportshards {
+  size_t nshards;
+  uint16_t base;
+  uint16_t span;
+  turnports **shards;
+} turnportshards;
+
+static TURN_THREAD_LOCAL uint64_t tl_port_steals = 0;
+
+static turnportshards *turnportshards_create(super_memory_t *sm, uint16_t start, uint16_t end, size_t nshards) {
+
+  if (start > end) {
+    return NULL;
+  }
+
+  const uint16_t base = (uint16_t)(start & ~((uint16_t)1));
+  const size_t width = (size_t)end - (size_t)base + 1;
+
+  if (nshards < 1) {
+    nshards = 1;
+  }
+  if (nshards > width / 2) {
+    nshards = (width / 2) ? (width / 2) : 1;
+  }
+
+  turnportshards *ret = (turnportshards *)allocate_super_memory_region(sm, sizeof(turnportshards));
+  ret->shards = (turnports **)allocate_super_memory_region(sm, sizeof(turnports *) * nshards);
+  ret->nshards = nshards;
+  ret->base = base;
+  ret->span = (uint16_t)((width / nshards) & ~((size_t)1));
+
+  size_t i = 0;
+  for (i = 0; i < nshards; i++) {
+    const uint32_t lo = (uint32_t)base + (uint32_t)(i * ret->span);
+    const uint16_t first = (uint16_t)((lo < start) ? start : lo);
+    const uint16_t last = (i + 1 == nshards) ? end : (uint16_t)(lo + ret->span - 1);
+    ret->shards[i] = turnports_create(sm, first, last);
+  }
+
+  return ret;
+}
+
+static turnports *turnportshards_owner(turnportshards *ps, uint16_t port) {
+  if (!ps || port < ps->base) {
+    return NULL;
+  }
+  size_t i = ps->nshards - 1;
+  if (ps->span) {
+    const size_t idx = (size_t)(port - ps->base) / ps->span;
+    if (idx < i) {
+      i = idx;
+    }
+  }
+  return ps->shards[i];
+}
+
+/* Try the caller's own shard first, then the others in ring order. Each shard
+ * has its own mutex, so threads only contend when one of them steals. */
+static int turnportshards_allocate(turnportshards *ps, int shard, int even, int allocate_rtcp,
+                                   uint64_t *reservation_token) {
+  if (!ps) {
+    return -1;
+  }
+  const size_t home = (size_t)(shard < 0 ? 0 : shard) % ps->nshards;
+  size_t i = 0;
+  for (i = 0; i < ps->nshards; i++) {
+    turnports *t = ps->shards[(home + i) % ps->nshards];
+    const int port = even ? turnports_allocate_even(t, allocate_rtcp, reservation_token) : turnports_allocate(t);
+    if (port >= 0) {
+      if (i) {
+        ++tl_port_steals;
+      }
+      return port;
+    }
+  }
+  return -1;
+}
+
+static void turnportshards_release(turnportshards *ps, uint16_t port) {
+  turnports *t = turnportshards_owner(ps, port);
+  if (t) {
+    turnports_release(t, port);
+  }
+}
+
+static int turnportshards_is_allocated(turnportshards *ps, uint16_t port) {
+  return turnports_is_allocated(turnportshards_owner(ps, port), port);
+}
+
+static int turnportshards_is_available(turnportshards *ps, uint16_t port) {
+  return turnports_is_available(turnportshards_owner(ps, port), port);
+}
+
+uint64_t turnipports_thread_steals(void) { return tl_port_steals; }
+
 /////////////////// IP-mapped PORTS /////////////////////////////////////
 
 struct _turnipports {
   super_memory_t *sm;
   uint16_t start;
   uint16_t end;
+  size_t nshards;
   ur_addr_map ip_to_turnports_udp;
   ur_addr_map ip_to_turnports_tcp;
   TURN_MUTEX_DECLARE(mutex)
 };
 
+/*
+ * Relay IPs are registered once at startup and their shard sets live as long
+ * as the process, so each thread remembers the last few it looked up and only
+ * takes the map mutex on a miss.
+ */
+#define TURNIPPORTS_CACHE_SIZE (4)
+
+typedef struct _turnipports_cache_entry {
+  const turnipports *tp;
+  uint8_t transport;
+  ioa_addr addr;
+  turnportshards *ps;
+} turnipports_cache_entry;
+
+static TURN_THREAD_LOCAL turnipports_cache_entry tl_ports_cache[TURNIPPORTS_CACHE_SIZE];
+static TURN_THREAD_LOCAL size_t tl_ports_cache_next = 0;
+
 //////////////////////////////////////////////////
 
 static ur_addr_map *get_map(turnipports *tp, uint8_t transport) {
@@ -317,105 +441,95 @@ static ur_addr_map *get_map(turnipports *tp, uint8_t transport) {
 
 static turnipports *turnipports_singleton = NULL;
 
-turnipports *turnipports_create(super_memory_t *sm, uint16_t start, uint16_t end) {
+turnipports *turnipports_create(super_memory_t *sm, uint16_t start, uint16_t end, size_t nshards) {
   turnipports *ret = (turnipports *)allocate_super_memory_region(sm, sizeof(turnipports));
   ret->sm = sm;
   ur_addr_map_init(&(ret->ip_to_turnports_udp));
   ur_addr_map_init(&(ret->ip_to_turnports_tcp));
   ret->start = start;
   ret->end = end;
+  ret->nshards = nshards ? nshards : 1;
   TURN_MUTEX_INIT_RECURSIVE(&(ret->mutex));
   turnipports_singleton = ret;
   return ret;
 }
 
-static turnports *turnipports_add(turnipports *tp, uint8_t transport, const ioa_addr *backend_addr) {
-  ur_addr_map_value_type t = 0;
-  if (tp && backend_addr) {
-    ioa_addr ba;
-    addr_cpy(&ba, backend_addr);
-    addr_set_port(&ba, 0);
-    TURN_MUTEX_LOCK((const turn_mutex *)&(tp->mutex));
-    if (!ur_addr_map_get(get_map(tp, transport), &ba, &t)) {
-      t = (ur_addr_map_value_type)turnports_create(tp->sm, tp->start, tp->end);
-      ur_addr_map_put(get_map(tp, transport), &ba, t);
+static turnportshards *turnipports_find(turnipports *tp, uint8_t transport, const ioa_addr *backend_addr,
+                                        int create) {
+  if (!tp || !backend_addr) {
+    return NULL;
+  }
+
+  ioa_addr ba;
+  addr_cpy(&ba, backend_addr);
+  addr_set_port(&ba, 0);
+
+  size_t i = 0;
+  for (i = 0; i < TURNIPPORTS_CACHE_SIZE; i++) {
+    const turnipports_cache_entry *c = &(tl_ports_cache[i]);
+    if (c->ps && (c->tp == tp) && (c->transport == transport) && addr_eq(&(c->addr), &ba)) {
+      return c->ps;
     }
-    TURN_MUTEX_UNLOCK((const turn_mutex *)&(tp->mutex));
   }
-  return (turnports *)t;
+
+  ur_addr_map_value_type t = 0;
+  TURN_MUTEX_LOCK((const turn_mutex *)&(tp->mutex));
+  if (!ur_addr_map_get(get_map(tp, transport), &ba, &t) && create) {
+    t = (ur_addr_map_value_type)turnportshards_create(tp->sm, tp->start, tp->end, tp->nshards);
+    ur_addr_map_put(get_map(tp, transport), &ba, t);
+  }
+  TURN_MUTEX_UNLOCK((const turn_mutex *)&(tp->mutex));
+
+  if (t) {
+    turnipports_cache_entry *c = &(tl_ports_cache[tl_ports_cache_next]);
+    tl_ports_cache_next = (tl_ports_cache_next + 1) % TURNIPPORTS_CACHE_SIZE;
+    c->tp = tp;
+    c->transport = transport;
+    addr_cpy(&(c->addr), &ba);
+    c->ps = (turnportshards *)t;
+  }
+
+  return (turnportshards *)t;
 }
 
 void turnipports_add_ip(uint8_t transport, const ioa_addr *backend_addr) {
-  turnipports_add(turnipports_singleton, transport, backend_addr);
+  turnipports_find(turnipports_singleton, transport, backend_addr, 1);
 }
 
-int turnipports_allocate(turnipports *tp, uint8_t transport, const ioa_addr *backend_addr) {
-  int ret = -1;
-  if (tp && backend_addr) {
-    TURN_MUTEX_LOCK((const turn_mutex *)&(tp->mutex));
-    turnports *t = turnipports_add(tp, transport, backend_addr);
-    ret = turnports_allocate(t);
-    TURN_MUTEX_UNLOCK((const turn_mutex *)&(tp->mutex));
-  }
-  return ret;
+int turnipports_allocate(turnipports *tp, int shard, uint8_t transport, const ioa_addr *backend_addr) {
+  return turnportshards_allocate(turnipports_find(tp, transport, backend_addr, 1), shard, 0, 0, NULL);
 }
 
-int turnipports_allocate_even(turnipports *tp, const ioa_addr *backend_addr, int allocate_rtcp,
+int turnipports_allocate_even(turnipports *tp, int shard, const ioa_addr *backend_addr, int allocate_rtcp,
                               uint64_t *reservation_token) {
-  int ret = -1;
-  if (tp && backend_addr) {
-    TURN_MUTEX_LOCK((const turn_mutex *)&(tp->mutex));
-    turnports *t = turnipports_add(tp, STUN_ATTRIBUTE_TRANSPORT_UDP_VALUE, backend_addr);
-    ret = turnports_allocate_even(t, allocate_rtcp, reservation_token);
-    TURN_MUTEX_UNLOCK((const turn_mutex *)&(tp->mutex));
-  }
-  return ret;
+  return turnportshards_allocate(turnipports_find(tp, STUN_ATTRIBUTE_TRANSPORT_UDP_VALUE, backend_addr, 1), shard,
+                                 1, allocate_rtcp, reservation_token);
 }
 
 void turnipports_release(turnipports *tp, uint8_t transport, const ioa_addr *socket_addr) {
-  if (tp && socket_addr) {
-    ioa_addr ba;
-    ur_addr_map_value_type t;
-    addr_cpy(&ba, socket_addr);
-    addr_set_port(&ba, 0);
-    TURN_MUTEX_LOCK((const turn_mutex *)&(tp->mutex));
-    if (ur_addr_map_get(get_map(tp, transport), &ba, &t)) {
-      turnports_release((turnports *)t, addr_get_port(socket_addr));
-    }
-    TURN_MUTEX_UNLOCK((const turn_mutex *)&(tp->mutex));
+  turnportshards *ps = turnipports_find(tp, transport, socket_addr, 0);
+  if (ps) {
+    turnportshards_release(ps, addr_get_port(socket_addr));
   }
 }
 
 int turnipports_is_allocated(turnipports *tp, uint8_t transport, const ioa_addr *backend_addr, uint16_t port) {
-  int ret = 0;
-  if (tp && backend_addr) {
-    ioa_addr ba;
-    ur_addr_map_value_type t;
-    addr_cpy(&ba, backend_addr);
-    addr_set_port(&ba, 0);
-    TURN_MUTEX_LOCK((const turn_mutex *)&(tp->mutex));
-    if (ur_addr_map_get(get_map(tp, transport), &ba, &t)) {
-      ret = turnports_is_allocated((turnports *)t, port);
-    }
-    TURN_MUTEX_UNLOCK((const turn_mutex *)&(tp->mutex));
+  turnportshards *ps = turnipports_find(tp, transport, backend_addr, 0);
+  if (ps) {
+    return turnportshards_is_allocated(ps, port);
   }
-  return ret;
+  return 0;
 }
 
 int turnipports_is_available(turnipports *tp, uint8_t transport, const ioa_addr *backend_addr, uint16_t port) {
   int ret = 0;
   if (tp && backend_addr) {
-    ioa_addr ba;
-    ur_addr_map_value_type t;
-    addr_cpy(&ba, backend_addr);
-    addr_set_port(&ba, 0);
-    TURN_MUTEX_LOCK((const turn_mutex *)&(tp->mutex));
-    if (!ur_addr_map_get(get_map(tp, transport), &ba, &t)) {
+    turnportshards *ps = turnipports_find(tp, transport, backend_addr, 0);
+    if (!ps) {
       ret = 1;
     } else {
-      ret = turnports_is_available((turnports *)t, port);
+      ret = turnportshards_is_available(ps, port);
     }
-    TURN_MUTEX_UNLOCK((const turn_mutex *)&(tp->mutex));
   }
   return ret;
 }
@@ -55,14 +55,25 @@ typedef struct _turnipports turnipports;
 
 //////////////////////////////////////////////////
 
-turnipports *turnipports_create(super_memory_t *sm, uint16_t start, uint16_t end);
+/*
+ * nshards > 1 splits every relay IP's [start, end] range into that many
+ * disjoint slices, one per relay thread. A thread allocates from its own
+ * shard (see the shard argument below, taken modulo nshards) and only steals
+ * from the others when its slice is exhausted. nshards <= 1 keeps the single
+ * shared pool.
+ */
+turnipports *turnipports_create(super_memory_t *sm, uint16_t start, uint16_t end, size_t nshards);
 
 void turnipports_add_ip(uint8_t transport, const ioa_addr *backend_addr);
 
-int turnipports_allocate(turnipports *tp, uint8_t transport, const ioa_addr *backend_addr);
-int turnipports_allocate_even(turnipports *tp, const ioa_addr *backend_addr, int allocate_rtcp,
+int turnipports_allocate(turnipports *tp, int shard, uint8_t transport, const ioa_addr *backend_addr);
+int turnipports_allocate_even(turnipports *tp, int shard, const ioa_addr *backend_addr, int allocate_rtcp,
                               uint64_t *reservation_token);
 
+/* Allocations made by the calling thread that had to be served from
+ * another thread's shard, since the thread started. */
+uint64_t turnipports_thread_steals(void);
+
 void turnipports_release(turnipports *tp, uint8_t transport, const ioa_addr *socket_addr);
 
 int turnipports_is_allocated(turnipports *tp, uint8_t transport, const ioa_addr *backend_addr, uint16_t port);
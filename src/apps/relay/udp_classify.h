@@ -0,0 +1,126 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * https://opensource.org/license/bsd-3-clause
+ *
+ * Copyright (C) 2011, 2012, 2013, 2014 Citrix Systems
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef __TURN_UDP_CLASSIFY__
+#define __TURN_UDP_CLASSIFY__
+
+#include "ns_turn_defs.h"
+#include "ns_turn_msg_defs.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//////////////////////////////////////////////////
+
+/* What a datagram on a UDP listener is, judged from its header alone. */
+typedef enum {
+  UDP_PACKET_CLASS_INVALID = 0,
+  UDP_PACKET_CLASS_STUN_OR_CHANNEL,
+  UDP_PACKET_CLASS_DTLS_HANDSHAKE,
+  UDP_PACKET_CLASS_DTLS_OTHER,
+  UDP_PACKET_CLASS_OLD_STUN
+} udp_packet_classification_t;
+
+/* udp_classify_packet() flags. */
+#define UDP_CLASSIFY_DTLS (0x1)     /* DTLS is enabled on the listener */
+#define UDP_CLASSIFY_OLD_STUN (0x2) /* RFC 3489 clients are accepted */
+
+//////////////////////////////////////////////////
+
+/*
+ * One pass over the first 20 bytes. The first byte picks the candidate
+ * protocols, as in RFC 7983 demultiplexing: 0-63 STUN (or DTLS for 20-23),
+ * 64-127 ChannelData, the rest nothing. Each branch checks only the fields
+ * its protocol defines.
+ *
+ * The result is what the separate checks return when tried in order
+ * (stun_is_channel_message_str() without mandatory padding,
+ * stun_is_command_message_str(), is_dtls_handshake_message(),
+ * is_dtls_message(), old_stun_is_command_message_str()), which
+ * tests/test_udp_classify.c verifies.
+ */
+static inline udp_packet_classification_t udp_classify_packet(const uint8_t *data, size_t blen, unsigned flags) {
+  if (!data || (blen < 4)) {
+    return UDP_PACKET_CLASS_INVALID;
+  }
+
+  const uint8_t b0 = data[0];
+  const uint16_t hdr_len = turn_read_u16(data + 2);
+
+  if (b0 < 0x40) {
+    /* STUN: 2 zero bits, length without padding covering the datagram. */
+    const bool stun_shape = (blen >= STUN_HEADER_LENGTH) && !(hdr_len & 0x0003) &&
+                            ((size_t)hdr_len + STUN_HEADER_LENGTH == blen);
+    const bool magic = stun_shape && (turn_read_u32(data + 4) == STUN_MAGIC_COOKIE);
+    if (magic) {
+      return UDP_PACKET_CLASS_STUN_OR_CHANNEL;
+    }
+    /* DTLS: content type 20-23, then version 1.0 (fe ff) or 1.2 (fe fd). */
+    if ((flags & UDP_CLASSIFY_DTLS) && ((uint8_t)(b0 - 0x14) < 4) && (data[1] == 0xfe) &&
+        ((data[2] == 0xff) || (data[2] == 0xfd))) {
+      return (b0 == 0x16) ? UDP_PACKET_CLASS_DTLS_HANDSHAKE : UDP_PACKET_CLASS_DTLS_OTHER;
+    }
+    if ((flags & UDP_CLASSIFY_OLD_STUN) && stun_shape) {
+      return UDP_PACKET_CLASS_OLD_STUN;
+    }
+    return UDP_PACKET_CLASS_INVALID;
+  }
+
+  if (b0 < 0x80) {
+    /* ChannelData: the length may leave up to 3 bytes of optional padding. */
+    const uint16_t actual = (uint16_t)(((blen > 0xFFFF) ? 0xFFFF : blen) - 4);
+    if (hdr_len > actual) {
+      return UDP_PACKET_CLASS_INVALID;
+    }
+    if ((hdr_len != actual) && (actual & 0x0003) && (!hdr_len || (actual - hdr_len > 3))) {
+      return UDP_PACKET_CLASS_INVALID;
+    }
+    return UDP_PACKET_CLASS_STUN_OR_CHANNEL;
+  }
+
+  return UDP_PACKET_CLASS_INVALID;
+}
+
+//////////////////////////////////////////////////
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__TURN_UDP_CLASSIFY__
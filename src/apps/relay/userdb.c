@@ -58,10 +58,12 @@
 
 #include "ns_turn_utils.h"
 
+#include "ns_turn_ip_trie.h"
 #include "ns_turn_maps.h"
 #include "ns_turn_server.h"
 
 #include "apputils.h"
+#include "prom_server.h"
 
 //////////// REALM //////////////
 
@@ -72,6 +74,8 @@ static TURN_MUTEX_DECLARE(o_to_realm_mutex);
 static ur_string_map *o_to_realm = NULL;
 static secrets_list_t realms_list;
 
+static void init_auth_cache(void);
+
 static char userdb_type_unknown[] = "Unknown";
 static char userdb_type_sqlite[] = "SQLite";
 static char userdb_type_postgresql[] = "PostgreSQL";
@@ -128,6 +132,7 @@ void create_default_realm(void) {
   o_to_realm = ur_string_map_create(free);
   default_realm_params_ptr = &_default_realm_params;
   realms = ur_string_map_create(NULL);
+  init_auth_cache();
   lock_realms();
   default_realm_params_ptr->status.alloc_counters = ur_string_map_create(NULL);
   unlock_realms();
@@ -324,6 +329,209 @@ static int get_auth_secrets(secrets_list_t *sl, uint8_t *realm) {
   return ret;
 }
 
+/////////// CREDENTIAL CACHE /////////////
+
+/*
+ * Bounded cache of derived long-term keys per (realm, username), and of the
+ * REST API secret list per realm, so that repeated authentications of the
+ * same users do no database I/O and no key derivation. Disabled unless
+ * --auth-cache-ttl is set. Entries expire after the TTL and are all dropped
+ * on credential changes made through the admin interface and on every
+ * periodic database reread in reread_realms(), which is what picks up edits
+ * made by turnadmin or directly in the database. A full cache is flushed
+ * wholesale rather than tracking recency.
+ *
+ * Every flush starts a new generation. A lookup takes the generation before
+ * it goes to the database and stores its result only if no flush happened in
+ * between, so a query that was already running cannot put a key from before
+ * the change back into the cache.
+ */
+
+typedef struct _auth_key_cache_entry {
+  hmackey_t key;
+  turn_time_t expires;
+  uint32_t generation;
+} auth_key_cache_entry;
+
+typedef struct _auth_secrets_cache_entry {
+  secrets_list_t sl;
+  turn_time_t expires;
+  uint32_t generation;
+} auth_secrets_cache_entry;
+
+static ur_string_map *auth_key_cache = NULL;
+static size_t auth_key_cache_size = 0;
+static ur_string_map *auth_secrets_cache = NULL;
+static size_t auth_secrets_cache_size = 0;
+static turn_atomic_u32 auth_cache_generation = 0;
+
+static void free_auth_secrets_cache_entry(ur_string_map_value_type value) {
+  auth_secrets_cache_entry *entry = (auth_secrets_cache_entry *)value;
+  if (entry) {
+    clean_secrets_list(&(entry->sl));
+    free(entry);
+  }
+}
+
+static void init_auth_cache(void) {
+  auth_key_cache = ur_string_map_create(free);
+  auth_secrets_cache = ur_string_map_create(free_auth_secrets_cache_entry);
+}
+
+static bool auth_cache_enabled(void) { return (turn_params.auth_cache_ttl > 0) && auth_key_cache; }
+
+static uint32_t auth_cache_generation_get(void) { return turn_atomic_load_u32(&auth_cache_generation); }
+
+void invalidate_auth_cache(void) {
+  if (auth_key_cache) {
+    ur_string_map_lock(auth_key_cache);
+    /* Bumped under the lock that auth_key_cache_put() checks it under. The
+       secrets cache is cleaned after the bump, so a stale put there either
+       sees the new generation or is wiped by the clean. */
+    turn_atomic_fetch_add_u32(&auth_cache_generation, 1);
+    ur_string_map_clean(auth_key_cache);
+    auth_key_cache_size = 0;
+    ur_string_map_unlock(auth_key_cache);
+  }
+  if (auth_secrets_cache) {
+    ur_string_map_lock(auth_secrets_cache);
+    ur_string_map_clean(auth_secrets_cache);
+    auth_secrets_cache_size = 0;
+    ur_string_map_unlock(auth_secrets_cache);
+  }
+}
+
+static void auth_key_cache_name(char *name, size_t name_size, const uint8_t *usname, const uint8_t *realm) {
+  /* 0x1F (unit separator) cannot occur in a realm or user name. */
+  snprintf(name, name_size, "%s\x1f%s", realm ? (const char *)realm : "", (const char *)usname);
+}
+
+static bool auth_key_cache_get(const uint8_t *usname, const uint8_t *realm, hmackey_t key) {
+  if (!auth_cache_enabled()) {
+    return false;
+  }
+
+  char name[STUN_MAX_REALM_SIZE + STUN_MAX_USERNAME_SIZE + 2];
+  auth_key_cache_name(name, sizeof(name), usname, realm);
+
+  bool found = false;
+  ur_string_map_value_type value = NULL;
+  ur_string_map_lock(auth_key_cache);
+  if (ur_string_map_get(auth_key_cache, name, &value)) {
+    const auth_key_cache_entry *entry = (const auth_key_cache_entry *)value;
+    if (turn_time_before(turn_time(), entry->expires) && (entry->generation == auth_cache_generation_get())) {
+      memcpy(key, entry->key, sizeof(hmackey_t));
+      found = true;
+    } else {
+      ur_string_map_del(auth_key_cache, name);
+      --auth_key_cache_size;
+    }
+  }
+  ur_string_map_unlock(auth_key_cache);
+
+  return found;
+}
+
+static void auth_key_cache_put(const uint8_t *usname, const uint8_t *realm, const hmackey_t key,
+                               uint32_t generation) {
+  if (!auth_cache_enabled()) {
+    return;
+  }
+
+  char name[STUN_MAX_REALM_SIZE + STUN_MAX_USERNAME_SIZE + 2];
+  auth_key_cache_name(name, sizeof(name), usname, realm);
+
+  auth_key_cache_entry *entry = (auth_key_cache_entry *)malloc(sizeof(auth_key_cache_entry));
+  if (!entry) {
+    return;
+  }
+  memcpy(entry->key, key, sizeof(hmackey_t));
+  entry->expires = turn_time() + (turn_time_t)turn_params.auth_cache_ttl;
+  entry->generation = generation;
+
+  ur_string_map_lock(auth_key_cache);
+  if (generation != auth_cache_generation_get()) {
+    ur_string_map_unlock(auth_key_cache);
+    free(entry);
+    return;
+  }
+  if (!ur_string_map_get(auth_key_cache, name, NULL)) {
+    if (auth_key_cache_size >= turn_params.auth_cache_size) {
+      ur_string_map_clean(auth_key_cache);
+      auth_key_cache_size = 0;
+    }
+    ++auth_key_cache_size;
+  }
+  ur_string_map_put(auth_key_cache, name, entry);
+  ur_string_map_unlock(auth_key_cache);
+}
+
+static void copy_secrets_list(secrets_list_t *dst, secrets_list_t *src) {
+  size_t i = 0;
+  for (i = 0; i < get_secrets_list_size(src); ++i) {
+    add_to_secrets_list(dst, get_secrets_list_elem(src, i));
+  }
+}
+
+static int get_auth_secrets_cached(secrets_list_t *sl, uint8_t *realm) {
+  if (!auth_cache_enabled()) {
+    return get_auth_secrets(sl, realm);
+  }
+
+  char *name = (char *)(realm ? realm : (uint8_t *)"");
+  bool found = false;
+  ur_string_map_value_type value = NULL;
+
+  ur_string_map_lock(auth_secrets_cache);
+  if (ur_string_map_get(auth_secrets_cache, name, &value)) {
+    auth_secrets_cache_entry *entry = (auth_secrets_cache_entry *)value;
+    if (turn_time_before(turn_time(), entry->expires) && (entry->generation == auth_cache_generation_get())) {
+      clean_secrets_list(sl);
+      copy_secrets_list(sl, &(entry->sl));
+      found = true;
+    } else {
+      ur_string_map_del(auth_secrets_cache, name);
+      --auth_secrets_cache_size;
+    }
+  }
+  ur_string_map_unlock(auth_secrets_cache);
+
+  prom_inc_auth_cache("secrets", found);
+  if (found) {
+    return 0;
+  }
+
+  const uint32_t generation = auth_cache_generation_get();
+  const int ret = get_auth_secrets(sl, realm);
+  if (ret < 0) {
+    return ret;
+  }
+
+  auth_secrets_cache_entry *entry = (auth_secrets_cache_entry *)calloc(1, sizeof(auth_secrets_cache_entry));
+  if (entry) {
+    copy_secrets_list(&(entry->sl), sl);
+    entry->expires = turn_time() + (turn_time_t)turn_params.auth_cache_ttl;
+    entry->generation = generation;
+    ur_string_map_lock(auth_secrets_cache);
+    if (generation != auth_cache_generation_get()) {
+      ur_string_map_unlock(auth_secrets_cache);
+      free_auth_secrets_cache_entry(entry);
+      return ret;
+    }
+    if (!ur_string_map_get(auth_secrets_cache, name, NULL)) {
+      if (auth_secrets_cache_size >= turn_params.auth_cache_size) {
+        ur_string_map_clean(auth_secrets_cache);
+        auth_secrets_cache_size = 0;
+      }
+      ++auth_secrets_cache_size;
+    }
+    ur_string_map_put(auth_secrets_cache, name, entry);
+    ur_string_map_unlock(auth_secrets_cache);
+  }
+
+  return ret;
+}
+
 /*
  * Timestamp retrieval
  */
@@ -396,6 +604,16 @@ static char *get_real_username(char *usname) {
   return turn_strdup(usname);
 }
 
+static double db_lookup_clock(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static const char *db_lookup_driver_name(void) {
+  return userdb_type_to_string(turn_params.default_users_db.userdb_type);
+}
+
 /*
  * Password retrieval
  */
@@ -542,13 +760,6 @@ int get_user_key(int in_oauth, int *out_oauth, int *max_session_time, uint8_t *u
 
     init_secrets_list(&sl);
 
-    /* get_auth_secrets() populates the list before it can fail, so every exit
-       from here on has to release it. */
-    if (get_auth_secrets(&sl, realm) < 0) {
-      clean_secrets_list(&sl);
-      return ret;
-    }
-
     ts = get_rest_api_timestamp((char *)usname);
 
     if (!turn_time_before(ts, ctime)) {
@@ -562,7 +773,6 @@ int get_user_key(int in_oauth, int *out_oauth, int *max_session_time, uint8_t *u
       stun_attr_ref sar = stun_attr_get_first_by_type_str(
           ioa_network_buffer_data(nbh), ioa_network_buffer_get_size(nbh), STUN_ATTRIBUTE_MESSAGE_INTEGRITY);
       if (!sar) {
-        clean_secrets_list(&sl);
         return -1;
       }
 
@@ -575,10 +785,32 @@ int get_user_key(int in_oauth, int *out_oauth, int *max_session_time, uint8_t *u
       case SHA384SIZEBYTES:
       case SHA512SIZEBYTES:
       default:
-        clean_secrets_list(&sl);
         return -1;
       };
 
+      /* A cached key is used only if it verifies this message; a key that does
+         not match falls through to the current secrets. This does not notice
+         a rotated-out secret: a key derived from it keeps verifying the
+         client's messages until the entry expires or the cache is flushed. */
+      if (auth_key_cache_get(usname, realm, key) &&
+          stun_check_message_integrity_by_key_str(TURN_CREDENTIALS_LONG_TERM, ioa_network_buffer_data(nbh),
+                                                  ioa_network_buffer_get_size(nbh), key, pwdtmp,
+                                                  SHATYPE_DEFAULT) > 0) {
+        prom_inc_auth_cache("key", true);
+        return 0;
+      }
+      if (auth_cache_enabled()) {
+        prom_inc_auth_cache("key", false);
+      }
+
+      /* get_auth_secrets() populates the list before it can fail, so every exit
+         from here on has to release it. */
+      const uint32_t generation = auth_cache_generation_get();
+      if (get_auth_secrets_cached(&sl, realm) < 0) {
+        clean_secrets_list(&sl);
+        return ret;
+      }
+
       for (sll = 0; sll < get_secrets_list_size(&sl); ++sll) {
 
         const char *secret = get_secrets_list_elem(&sl, sll);
@@ -599,6 +831,7 @@ int get_user_key(int in_oauth, int *out_oauth, int *max_session_time, uint8_t *u
                                                               SHATYPE_DEFAULT) > 0) {
 
                     ret = 0;
+                    auth_key_cache_put(usname, realm, key, generation);
                   }
                 }
                 free(pwd);
@@ -633,12 +866,88 @@ int get_user_key(int in_oauth, int *out_oauth, int *max_session_time, uint8_t *u
 
   const turn_dbdriver_t *dbd = get_dbdriver();
   if (dbd && dbd->get_user_key) {
+    if (auth_key_cache_get(usname, realm, key)) {
+      prom_inc_auth_cache("key", true);
+      return 0;
+    }
+    if (auth_cache_enabled()) {
+      prom_inc_auth_cache("key", false);
+    }
+    const uint32_t generation = auth_cache_generation_get();
+    const double started = db_lookup_clock();
     ret = (*(dbd->get_user_key))(usname, realm, key);
+    prom_observe_db_user_key_lookup(db_lookup_driver_name(), db_lookup_clock() - started);
+    if (ret == 0) {
+      auth_key_cache_put(usname, realm, key, generation);
+    }
   }
 
   return ret;
 }
 
+typedef struct _user_key_lookup {
+  struct auth_message *am;
+  void (*done)(struct auth_message *am);
+  double started;
+  uint32_t generation;
+} user_key_lookup;
+
+static void user_key_lookup_done(int ret, void *arg) {
+  user_key_lookup *lookup = (user_key_lookup *)arg;
+  struct auth_message *am = lookup->am;
+
+  prom_observe_db_user_key_lookup(db_lookup_driver_name(), db_lookup_clock() - lookup->started);
+  if (ret == 0) {
+    auth_key_cache_put(am->username, am->realm, am->key, lookup->generation);
+  }
+  am->success = (ret == 0);
+  lookup->done(am);
+  free(lookup);
+}
+
+bool start_user_key_async(struct event_base *base, struct auth_message *am, void (*done)(struct auth_message *am)) {
+  const turn_dbdriver_t *dbd = get_dbdriver();
+  if (!base || !am || !done || !dbd || !dbd->get_user_key_async || !am->username[0]) {
+    return false;
+  }
+
+  /* Everything that does not end in a database query stays on the synchronous path. */
+  if (turn_params.use_auth_secret_with_timestamp) {
+    return false;
+  }
+  if (am->in_oauth && stun_attr_get_first_by_type_str(ioa_network_buffer_data(am->in_buffer.nbh),
+                                                      ioa_network_buffer_get_size(am->in_buffer.nbh),
+                                                      STUN_ATTRIBUTE_OAUTH_ACCESS_TOKEN)) {
+    return false;
+  }
+  ur_string_map *static_accounts = turn_params.default_users_db.ram_db.static_accounts;
+  ur_string_map_lock(static_accounts);
+  const bool static_account = ur_string_map_get(static_accounts, (ur_string_map_key_type)am->username, NULL);
+  ur_string_map_unlock(static_accounts);
+  if (static_account || auth_key_cache_get(am->username, am->realm, am->key)) {
+    return false;
+  }
+
+  user_key_lookup *lookup = (user_key_lookup *)malloc(sizeof(user_key_lookup));
+  if (!lookup) {
+    return false;
+  }
+  lookup->am = am;
+  lookup->done = done;
+  lookup->started = db_lookup_clock();
+  lookup->generation = auth_cache_generation_get();
+  am->max_session_time = 0;
+
+  if ((*(dbd->get_user_key_async))(base, am->username, am->realm, am->key, user_key_lookup_done, lookup) < 0) {
+    free(lookup);
+    return false;
+  }
+  if (auth_cache_enabled()) {
+    prom_inc_auth_cache("key", false);
+  }
+  return true;
+}
+
 uint8_t *start_user_check(turnserver_id id, turn_credential_type ct, int in_oauth, int *out_oauth, uint8_t *usname,
                           uint8_t *realm, get_username_resume_cb resume, ioa_net_data *in_buffer, uint64_t ctxkey,
                           int *postpone_reply) {
@@ -1104,86 +1413,102 @@ void run_db_test(void) {
 
 ///////////////// WHITE/BLACK IP LISTS ///////////////////
 
-#if !defined(TURN_NO_RWLOCK)
-static pthread_rwlock_t *whitelist_rwlock = NULL;
-static pthread_rwlock_t *blacklist_rwlock = NULL;
-#else
-static TURN_MUTEX_DECLARE(whitelist_mutex);
-static TURN_MUTEX_DECLARE(blacklist_mutex);
-#endif
-
-static ip_range_list_t *ipwhitelist = NULL;
-static ip_range_list_t *ipblacklist = NULL;
+/*
+ * The dynamic lists are published as immutable, reference-counted snapshots
+ * (the range list plus its compiled prefix trie). update_white_and_black_lists()
+ * builds a new snapshot off to the side and swaps it in under the publisher
+ * mutex, bumping a generation counter. Relay threads keep a thread-local
+ * reference to the snapshot they last saw and only touch the mutex when the
+ * generation has moved, so a peer check is a lock-free trie walk.
+ */
 
-void init_dynamic_ip_lists(void) {
-#if !defined(TURN_NO_RWLOCK)
-  whitelist_rwlock = (pthread_rwlock_t *)turn_malloc(sizeof(pthread_rwlock_t));
-  pthread_rwlock_init(whitelist_rwlock, NULL);
-
-  blacklist_rwlock = (pthread_rwlock_t *)turn_malloc(sizeof(pthread_rwlock_t));
-  pthread_rwlock_init(blacklist_rwlock, NULL);
-#else
-  TURN_MUTEX_INIT(&whitelist_mutex);
-  TURN_MUTEX_INIT(&blacklist_mutex);
-#endif
+typedef struct _ip_list_snapshot {
+  ip_range_list_t *list;
+  ip_trie *trie;
+  turn_atomic_u32 refs;
+} ip_list_snapshot;
+
+typedef struct _ip_list_publisher {
+  TURN_MUTEX_DECLARE(mutex)
+  ip_list_snapshot *current;
+  turn_atomic_u32 generation;
+} ip_list_publisher;
+
+typedef struct _ip_list_view {
+  ip_list_snapshot *snapshot;
+  uint32_t generation;
+} ip_list_view;
+
+static ip_list_publisher ipwhitelist;
+static ip_list_publisher ipblacklist;
+
+static TURN_THREAD_LOCAL ip_list_view tl_whitelist_view;
+static TURN_THREAD_LOCAL ip_list_view tl_blacklist_view;
+
+static ip_list_snapshot *ip_list_snapshot_create(ip_range_list_t *list) {
+  ip_list_snapshot *snap = (ip_list_snapshot *)turn_calloc(1, sizeof(ip_list_snapshot));
+  snap->list = list;
+  snap->trie = ip_trie_create(list);
+  turn_atomic_store_u32(&(snap->refs), 1);
+  return snap;
 }
 
-void ioa_lock_whitelist(ioa_engine_handle e) {
-  UNUSED_ARG(e);
-#if !defined(TURN_NO_RWLOCK)
-  pthread_rwlock_rdlock(whitelist_rwlock);
-#else
-  TURN_MUTEX_LOCK(&whitelist_mutex);
-#endif
-}
-void ioa_unlock_whitelist(ioa_engine_handle e) {
-  UNUSED_ARG(e);
-#if !defined(TURN_NO_RWLOCK)
-  pthread_rwlock_unlock(whitelist_rwlock);
-#else
-  TURN_MUTEX_UNLOCK(&whitelist_mutex);
-#endif
+static void ip_list_snapshot_unref(ip_list_snapshot *snap) {
+  if (snap && (turn_atomic_fetch_add_u32(&(snap->refs), (uint32_t)-1) == 1)) {
+    ip_trie_free(snap->trie);
+    ip_list_free(snap->list);
+    free(snap);
+  }
 }
-static void ioa_wrlock_whitelist(ioa_engine_handle e) {
-  UNUSED_ARG(e);
-#if !defined(TURN_NO_RWLOCK)
-  pthread_rwlock_wrlock(whitelist_rwlock);
-#else
-  TURN_MUTEX_LOCK(&whitelist_mutex);
-#endif
+
+static void ip_list_publisher_init(ip_list_publisher *pub) {
+  TURN_MUTEX_INIT(&(pub->mutex));
+  pub->current = ip_list_snapshot_create((ip_range_list_t *)turn_calloc(1, sizeof(ip_range_list_t)));
+  turn_atomic_store_u32(&(pub->generation), 1);
 }
-const ip_range_list_t *ioa_get_whitelist(ioa_engine_handle e) {
-  UNUSED_ARG(e);
-  return ipwhitelist;
+
+static void ip_list_publish(ip_list_publisher *pub, ip_range_list_t *list) {
+  ip_list_snapshot *snap = ip_list_snapshot_create(list);
+  ip_list_snapshot *old = NULL;
+  TURN_MUTEX_LOCK(&(pub->mutex));
+  old = pub->current;
+  pub->current = snap;
+  turn_atomic_fetch_add_u32(&(pub->generation), 1);
+  TURN_MUTEX_UNLOCK(&(pub->mutex));
+  ip_list_snapshot_unref(old);
 }
 
-void ioa_lock_blacklist(ioa_engine_handle e) {
-  UNUSED_ARG(e);
-#if !defined(TURN_NO_RWLOCK)
-  pthread_rwlock_rdlock(blacklist_rwlock);
-#else
-  TURN_MUTEX_LOCK(&blacklist_mutex);
-#endif
+static const ip_list_snapshot *ip_list_acquire(ip_list_publisher *pub, ip_list_view *view) {
+  const uint32_t generation = turn_atomic_load_u32(&(pub->generation));
+  if (view->generation != generation) {
+    ip_list_snapshot *old = view->snapshot;
+    TURN_MUTEX_LOCK(&(pub->mutex));
+    view->snapshot = pub->current;
+    if (view->snapshot) {
+      turn_atomic_fetch_add_u32(&(view->snapshot->refs), 1);
+    }
+    view->generation = turn_atomic_load_u32(&(pub->generation));
+    TURN_MUTEX_UNLOCK(&(pub->mutex));
+    ip_list_snapshot_unref(old);
+  }
+  return view->snapshot;
 }
-void ioa_unlock_blacklist(ioa_engine_handle e) {
-  UNUSED_ARG(e);
-#if !defined(TURN_NO_RWLOCK)
-  pthread_rwlock_unlock(blacklist_rwlock);
-#else
-  TURN_MUTEX_UNLOCK(&blacklist_mutex);
-#endif
+
+void init_dynamic_ip_lists(void) {
+  ip_list_publisher_init(&ipwhitelist);
+  ip_list_publisher_init(&ipblacklist);
 }
-static void ioa_wrlock_blacklist(ioa_engine_handle e) {
+
+const ip_range_t *ioa_match_whitelist(ioa_engine_handle e, const char *realm, const ioa_addr *addr) {
   UNUSED_ARG(e);
-#if !defined(TURN_NO_RWLOCK)
-  pthread_rwlock_wrlock(blacklist_rwlock);
-#else
-  TURN_MUTEX_LOCK(&blacklist_mutex);
-#endif
+  const ip_list_snapshot *snap = ip_list_acquire(&ipwhitelist, &tl_whitelist_view);
+  return snap ? ip_trie_match(snap->trie, realm, addr) : NULL;
 }
-const ip_range_list_t *ioa_get_blacklist(ioa_engine_handle e) {
+
+const ip_range_t *ioa_match_blacklist(ioa_engine_handle e, const char *realm, const ioa_addr *addr) {
   UNUSED_ARG(e);
-  return ipblacklist;
+  const ip_list_snapshot *snap = ip_list_acquire(&ipblacklist, &tl_blacklist_view);
+  return snap ? ip_trie_match(snap->trie, realm, addr) : NULL;
 }
 
 ip_range_list_t *get_ip_list(const char *kind) {
@@ -1207,24 +1532,8 @@ void ip_list_free(ip_range_list_t *l) {
 }
 
 void update_white_and_black_lists(void) {
-  {
-    ip_range_list_t *wl = get_ip_list("allowed");
-    ip_range_list_t *owl = NULL;
-    ioa_wrlock_whitelist(NULL);
-    owl = ipwhitelist;
-    ipwhitelist = wl;
-    ioa_unlock_whitelist(NULL);
-    ip_list_free(owl);
-  }
-  {
-    ip_range_list_t *bl = get_ip_list("denied");
-    ip_range_list_t *obl = NULL;
-    ioa_wrlock_blacklist(NULL);
-    obl = ipblacklist;
-    ipblacklist = bl;
-    ioa_unlock_blacklist(NULL);
-    ip_list_free(obl);
-  }
+  ip_list_publish(&ipwhitelist, get_ip_list("allowed"));
+  ip_list_publish(&ipblacklist, get_ip_list("denied"));
 }
 
 /////////////// add ACL record ///////////////////
@@ -1328,6 +1637,13 @@ void reread_realms(void) {
   if (dbd && dbd->reread_realms && !turn_params.no_dynamic_realms) {
     (*dbd->reread_realms)(&realms_list);
   }
+
+  /* Users, secrets and realms may have been edited by turnadmin or directly
+     in the database, and nothing tells this process which ones. Every reread
+     therefore starts a new credential cache generation. */
+  if (dbd) {
+    invalidate_auth_cache();
+  }
 }
 
 ///////////////////////////////
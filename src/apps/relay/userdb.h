@@ -181,8 +181,17 @@ void add_to_secrets_list(secrets_list_t *sl, const char *elem);
 
 /////////// USER DB CHECK //////////////////
 
+#define DEFAULT_AUTH_CACHE_SIZE (10000)
+
+/* Drop every cached credential key and REST API secret list. */
+void invalidate_auth_cache(void);
+
 int get_user_key(int in_oauth, int *out_oauth, int *max_session_time, uint8_t *uname, uint8_t *realm, hmackey_t key,
                  ioa_network_buffer_handle nbh);
+/* Start a database key lookup for am without blocking the calling thread; done(am) runs on base with
+ * am->success set. Returns false when the lookup needs no database, is cached, or the driver cannot do it
+ * asynchronously; the caller then uses get_user_key(). */
+bool start_user_key_async(struct event_base *base, struct auth_message *am, void (*done)(struct auth_message *am));
 uint8_t *start_user_check(turnserver_id id, turn_credential_type ct, int in_oauth, int *out_oauth, uint8_t *usname,
                           uint8_t *realm, get_username_resume_cb resume, ioa_net_data *in_buffer, uint64_t ctxkey,
                           int *postpone_reply);
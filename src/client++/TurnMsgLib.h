@@ -660,6 +660,18 @@ public:
     stun_attr_add_fingerprint_str(_buffer, &_sz);
   }
 
+  /**
+   * Add a pre-encoded attribute (see stun_attr_image_init()) to the message
+   */
+  void addAttrImage(const stun_attr_image &attr) {
+    if (!_constructed || !isCommand()) {
+      throw WrongStunBufferFormatException();
+    }
+    if (!stun_attr_image_add_str(&attr, _buffer, &_sz)) {
+      throw WrongStunBufferFormatException();
+    }
+  }
+
   /**
    * Check message integrity, in secure communications.
    */
@@ -922,6 +934,19 @@ public:
     stun_set_channel_bind_response_str(_buffer, &_sz, &tid, error_code, reason);
   }
 
+  /**
+   * Construct success response from a template laid out once with
+   * stun_resp_template_init(); lifetime is used if the template has LIFETIME
+   */
+  void constructFromTemplate(const stun_resp_template &t, stun_tid &tid, uint32_t lifetime) {
+    stun_resp_template_emit_str(&t, _buffer, &_sz, &tid, lifetime);
+    _method = stun_get_method_str(_buffer, _sz);
+    _err = 0;
+    _reason = "";
+    _tid = tid;
+    _constructed = true;
+  }
+
 protected:
   virtual void constructBuffer() {
     if (_err) {
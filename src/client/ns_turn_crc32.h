@@ -0,0 +1,75 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * https://opensource.org/license/bsd-3-clause
+ *
+ * Copyright (C) 2011, 2012, 2013 Citrix Systems
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef __LIB_TURN_CRC32__
+#define __LIB_TURN_CRC32__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///////////////////////////////////////////
+
+/*
+ * CRC-32 (ISO-HDLC, as used by the STUN FINGERPRINT attribute, RFC 5389 15.5).
+ * All functions return the finished CRC of len bytes of buf, before the
+ * FINGERPRINT XOR.
+ *
+ * ns_turn_crc32() picks the fastest variant the CPU supports: carry-less
+ * multiply folding (PCLMULQDQ) on x86, the CRC32 instructions on ARMv8, and
+ * slicing-by-8 everywhere else and for inputs too short to fold.
+ */
+uint32_t ns_turn_crc32(const uint8_t *buf, size_t len);
+
+/* The individual variants, for tests and benchmarks. */
+uint32_t ns_turn_crc32_bytewise(const uint8_t *buf, size_t len);
+uint32_t ns_turn_crc32_slice8(const uint8_t *buf, size_t len);
+/* Falls back to slicing-by-8 when ns_turn_crc32_hw_available() is false. */
+uint32_t ns_turn_crc32_hw(const uint8_t *buf, size_t len);
+
+bool ns_turn_crc32_hw_available(void);
+/* "pclmulqdq", "armv8-crc" or "none". */
+const char *ns_turn_crc32_hw_name(void);
+
+///////////////////////////////////////////
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__LIB_TURN_CRC32__
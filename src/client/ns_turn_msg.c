@@ -33,11 +33,16 @@
  */
 
 #include "ns_turn_msg.h"
+#include "ns_turn_crc32.h"
 #include "ns_turn_msg_addr.h"
 
 ///////////// Security functions implementation from ns_turn_msg.h ///////////
 
 #include "ns_turn_openssl.h"
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#include <openssl/params.h>
+#endif
 #include "ns_turn_utils.h"
 
 ///////////
@@ -209,6 +214,138 @@ bool stun_calculate_hmac(const uint8_t *buf, size_t len, const uint8_t *key, siz
   return true;
 }
 
+////////////// Keyed HMAC contexts ////////////////
+
+static const char *stun_hmac_digest_name(SHATYPE shatype) {
+  switch (shatype) {
+  case SHATYPE_SHA256:
+    return "SHA256";
+  case SHATYPE_SHA384:
+    return "SHA384";
+  case SHATYPE_SHA512:
+    return "SHA512";
+  default:
+    return "SHA1";
+  }
+}
+
+static void stun_hmac_ctx_free_mac(stun_hmac_ctx *hc) {
+  if (hc->mac) {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    EVP_MAC_CTX_free((EVP_MAC_CTX *)hc->mac);
+#else
+    HMAC_CTX_free((HMAC_CTX *)hc->mac);
+#endif
+    hc->mac = NULL;
+  }
+}
+
+void stun_hmac_ctx_clean(stun_hmac_ctx *hc) {
+  if (hc) {
+    stun_hmac_ctx_free_mac(hc);
+    memset(hc, 0, sizeof(*hc));
+  }
+}
+
+/* Key the context from scratch: this is the ipad/opad derivation that
+   HMAC() repeats on every call. */
+static bool stun_hmac_ctx_rekey(stun_hmac_ctx *hc, const uint8_t *key, size_t keylen, SHATYPE shatype) {
+  stun_hmac_ctx_free_mac(hc);
+  hc->keylen = 0;
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+  EVP_MAC *mac = EVP_MAC_fetch(NULL, "HMAC", NULL);
+  if (!mac) {
+    return false;
+  }
+  EVP_MAC_CTX *ctx = EVP_MAC_CTX_new(mac);
+  EVP_MAC_free(mac);
+  if (!ctx) {
+    return false;
+  }
+  OSSL_PARAM params[] = {
+      OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, (char *)stun_hmac_digest_name(shatype), 0),
+      OSSL_PARAM_construct_end()};
+  if (!EVP_MAC_init(ctx, key, keylen, params)) {
+    EVP_MAC_CTX_free(ctx);
+    return false;
+  }
+#else
+  const EVP_MD *md = EVP_get_digestbyname(stun_hmac_digest_name(shatype));
+  HMAC_CTX *ctx = md ? HMAC_CTX_new() : NULL;
+  if (!ctx) {
+    return false;
+  }
+  if (!HMAC_Init_ex(ctx, key, (int)keylen, md, NULL)) {
+    HMAC_CTX_free(ctx);
+    return false;
+  }
+#endif
+
+  hc->mac = ctx;
+  hc->shatype = shatype;
+  hc->keylen = keylen;
+  memcpy(hc->key, key, keylen);
+  hc->fresh = true;
+  return true;
+}
+
+bool stun_hmac_ctx_begin(stun_hmac_ctx *hc, const uint8_t *key, size_t keylen, SHATYPE shatype) {
+  if (!hc || !key || (keylen > sizeof(hc->key))) {
+    return false;
+  }
+  ERR_clear_error();
+  if (!hc->mac || (hc->shatype != shatype) || (hc->keylen != keylen) || memcmp(hc->key, key, keylen)) {
+    return stun_hmac_ctx_rekey(hc, key, keylen, shatype);
+  }
+  if (hc->fresh) {
+    return true;
+  }
+  /* Same key: restart from the saved inner/outer state without a key. */
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+  if (!EVP_MAC_init((EVP_MAC_CTX *)hc->mac, NULL, 0, NULL)) {
+#else
+  if (!HMAC_Init_ex((HMAC_CTX *)hc->mac, NULL, 0, NULL, NULL)) {
+#endif
+    stun_hmac_ctx_free_mac(hc);
+    return false;
+  }
+  hc->fresh = true;
+  return true;
+}
+
+bool stun_hmac_ctx_update(stun_hmac_ctx *hc, const uint8_t *buf, size_t len) {
+  hc->fresh = false;
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+  return EVP_MAC_update((EVP_MAC_CTX *)hc->mac, buf, len) == 1;
+#else
+  return HMAC_Update((HMAC_CTX *)hc->mac, buf, len) == 1;
+#endif
+}
+
+bool stun_hmac_ctx_final(stun_hmac_ctx *hc, uint8_t *hmac, unsigned int *hmac_len) {
+  hc->fresh = false;
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+  size_t outl = 0;
+  if (!EVP_MAC_final((EVP_MAC_CTX *)hc->mac, hmac, &outl, MAXSHASIZE)) {
+    return false;
+  }
+  *hmac_len = (unsigned int)outl;
+  return true;
+#else
+  return HMAC_Final((HMAC_CTX *)hc->mac, hmac, hmac_len) == 1;
+#endif
+}
+
+/* HMAC of a message prefix, through hc when there is one, one-shot otherwise. */
+static bool stun_message_hmac(stun_hmac_ctx *hc, const uint8_t *key, size_t keylen, SHATYPE shatype,
+                              const uint8_t *buf, size_t len, uint8_t *hmac, unsigned int *hmac_len) {
+  if (hc && stun_hmac_ctx_begin(hc, key, keylen, shatype)) {
+    return stun_hmac_ctx_update(hc, buf, len) && stun_hmac_ctx_final(hc, hmac, hmac_len);
+  }
+  return stun_calculate_hmac(buf, len, key, keylen, hmac, hmac_len, shatype);
+}
+
 /* MAC half of the stateless nonce: 16 lowercase hex chars = first 8 bytes of
  * HMAC-SHA256(key, "<client-addr>|<timestamp-hex>"). `ts_hex` is the 8-char
  * timestamp exactly as it appears in the nonce, so the MAC covers the same
@@ -514,12 +651,6 @@ bool check_password_equal(const char *pin, const char *pwd) {
   return const_time_str_equal(enc_pin, pwd);
 }
 
-/////////////////////////////////////////////////////////////////
-
-static uint32_t ns_crc32(const uint8_t *buffer, uint32_t len);
-
-/////////////////////////////////////////////////////////////////
-
 int stun_get_command_message_len_str(const uint8_t *buf, size_t len) {
   if (len < STUN_HEADER_LENGTH) {
     return -1;
@@ -633,7 +764,7 @@ bool stun_is_command_message_full_check_str(const uint8_t *buf, size_t blen, boo
     return !must_check_fingerprint;
   }
   const uint32_t crc32len = (uint32_t)((fingerprint - buf) - 4);
-  const bool ret = (turn_read_u32(fingerprint) == (ns_crc32(buf, crc32len) ^ ((uint32_t)FINGERPRINT_XOR)));
+  const bool ret = (turn_read_u32(fingerprint) == (ns_turn_crc32(buf, crc32len) ^ ((uint32_t)FINGERPRINT_XOR)));
   if (ret && fingerprint_present) {
     *fingerprint_present = ret;
   }
@@ -807,9 +938,14 @@ void stun_init_indication_str(uint16_t method, uint8_t *buf, size_t *len) {
 }
 
 void stun_init_success_response_str(uint16_t method, uint8_t *buf, size_t *len, stun_tid *id) {
-  stun_init_command_str(stun_make_success_response(method), buf, len);
   if (id) {
+    /* The request's transaction ID; no point generating a random one first. */
+    stun_init_buffer_str(buf, len);
+    turn_write_u16(buf, (uint16_t)(stun_make_success_response(method) & 0x3FFF));
+    turn_write_u32(buf + 4, STUN_MAGIC_COOKIE);
     stun_tid_message_cpy(buf, id);
+  } else {
+    stun_init_command_str(stun_make_success_response(method), buf, len);
   }
 }
 
@@ -820,6 +956,30 @@ void old_stun_init_success_response_str(uint16_t method, uint8_t *buf, size_t *l
   }
 }
 
+void stun_resp_template_init(stun_resp_template *t, uint16_t method, bool with_lifetime) {
+  memset(t, 0, sizeof(*t));
+  turn_write_u16(t->image, (uint16_t)(stun_make_success_response(method) & 0x3FFF));
+  turn_write_u32(t->image + 4, STUN_MAGIC_COOKIE);
+  t->len = STUN_HEADER_LENGTH;
+  if (with_lifetime) {
+    turn_write_u16(t->image + t->len, STUN_ATTRIBUTE_LIFETIME);
+    turn_write_u16(t->image + t->len + 2, 4);
+    t->lifetime_offset = (uint16_t)(t->len + 4);
+    t->len += 8;
+  }
+  turn_write_u16(t->image + 2, (uint16_t)(t->len - STUN_HEADER_LENGTH));
+}
+
+void stun_resp_template_emit_str(const stun_resp_template *t, uint8_t *buf, size_t *len, const stun_tid *tid,
+                                 uint32_t lifetime) {
+  memcpy(buf, t->image, t->len);
+  stun_tid_message_cpy(buf, tid);
+  if (t->lifetime_offset) {
+    turn_write_u32(buf + t->lifetime_offset, lifetime);
+  }
+  *len = t->len;
+}
+
 const uint8_t *get_default_reason(int error_code) {
   const char *reason = "Unknown error";
 
@@ -1613,6 +1773,122 @@ stun_attr_ref stun_attr_get_first_by_type_str(const uint8_t *buf, size_t len, ui
   return NULL;
 }
 
+/* Slot of each indexed attribute type, -1 for the rest. */
+static int stun_attr_index_slot(uint16_t attr_type) {
+  switch (attr_type) {
+  case STUN_ATTRIBUTE_USERNAME:
+    return 0;
+  case STUN_ATTRIBUTE_MESSAGE_INTEGRITY:
+    return 1;
+  case STUN_ATTRIBUTE_REALM:
+    return 2;
+  case STUN_ATTRIBUTE_NONCE:
+    return 3;
+  case STUN_ATTRIBUTE_FINGERPRINT:
+    return 4;
+  case STUN_ATTRIBUTE_LIFETIME:
+    return 5;
+  case STUN_ATTRIBUTE_XOR_PEER_ADDRESS:
+    return 6;
+  case STUN_ATTRIBUTE_CHANNEL_NUMBER:
+    return 7;
+  case STUN_ATTRIBUTE_DATA:
+    return 8;
+  case STUN_ATTRIBUTE_REQUESTED_TRANSPORT:
+    return 9;
+  case STUN_ATTRIBUTE_REQUESTED_ADDRESS_FAMILY:
+    return 10;
+  case STUN_ATTRIBUTE_ADDITIONAL_ADDRESS_FAMILY:
+    return 11;
+  case STUN_ATTRIBUTE_EVEN_PORT:
+    return 12;
+  case STUN_ATTRIBUTE_RESERVATION_TOKEN:
+    return 13;
+  case STUN_ATTRIBUTE_DONT_FRAGMENT:
+    return 14;
+  case STUN_ATTRIBUTE_CONNECTION_ID:
+    return 15;
+  case STUN_ATTRIBUTE_SOFTWARE:
+    return 16;
+  case STUN_ATTRIBUTE_ORIGIN:
+    return 17;
+  case STUN_ATTRIBUTE_MOBILITY_TICKET:
+    return 18;
+  case STUN_ATTRIBUTE_OAUTH_ACCESS_TOKEN:
+    return 19;
+  case STUN_ATTRIBUTE_ERROR_CODE:
+    return 20;
+  case STUN_ATTRIBUTE_CHANGE_REQUEST:
+    return 21;
+  case STUN_ATTRIBUTE_RESPONSE_PORT:
+    return 22;
+  case STUN_ATTRIBUTE_PADDING:
+    return 23;
+  default:
+    return -1;
+  }
+}
+
+void stun_attr_index_build(const uint8_t *buf, size_t len, stun_attr_index *idx) {
+  memset(idx, 0, sizeof(*idx));
+  const int msg_len = stun_get_command_message_len_str(buf, len);
+  if (msg_len <= STUN_HEADER_LENGTH) {
+    return;
+  }
+  /* The stun_attr_get_first_str()/stun_attr_get_next_str() walk, without
+     re-reading the message length at every step. */
+  const size_t end = ((size_t)msg_len < UINT16_MAX) ? (size_t)msg_len : UINT16_MAX;
+  size_t offset = STUN_HEADER_LENGTH;
+  while (end - offset >= 4) {
+    stun_attr_ref attr = (stun_attr_ref)(buf + offset);
+    size_t attrlen = (size_t)stun_attr_get_len(attr);
+    attrlen = (attrlen + 3) & ~(size_t)3;
+    if (attrlen > end - offset - 4) {
+      break;
+    }
+    const int slot = stun_attr_index_slot((uint16_t)stun_attr_get_type(attr));
+    if (slot >= 0) {
+      if (!(idx->seen & (1u << slot))) {
+        idx->seen |= (1u << slot);
+        idx->first[slot] = (uint16_t)offset;
+      }
+      idx->last[slot] = (uint16_t)offset;
+    }
+    ++idx->count;
+    offset += 4 + attrlen;
+  }
+}
+
+bool stun_attr_index_has(const stun_attr_index *idx, uint16_t attr_type) {
+  const int slot = stun_attr_index_slot(attr_type);
+  if (slot < 0) {
+    return true; /* not tracked: the caller has to look */
+  }
+  return (idx->seen & (1u << slot)) != 0;
+}
+
+stun_attr_ref stun_attr_index_first(const stun_attr_index *idx, const uint8_t *buf, size_t len, uint16_t attr_type) {
+  const int slot = stun_attr_index_slot(attr_type);
+  if (slot < 0) {
+    return stun_attr_get_first_by_type_str(buf, len, attr_type);
+  }
+  return idx->first[slot] ? (stun_attr_ref)(buf + idx->first[slot]) : NULL;
+}
+
+stun_attr_ref stun_attr_index_last(const stun_attr_index *idx, const uint8_t *buf, size_t len, uint16_t attr_type) {
+  const int slot = stun_attr_index_slot(attr_type);
+  if (slot < 0) {
+    stun_attr_ref last = NULL;
+    for (stun_attr_ref attr = stun_attr_get_first_str(buf, len); attr; attr = stun_attr_get_next_str(buf, len, attr)) {
+      if (stun_attr_get_type(attr) == attr_type) {
+        last = attr;
+      }
+    }
+    return last;
+  }
+  return idx->last[slot] ? (stun_attr_ref)(buf + idx->last[slot]) : NULL;
+}
+
 static stun_attr_ref stun_attr_check_valid(stun_attr_ref attr, size_t remaining) {
   if (remaining >= 4) {
     /* Read the size of the attribute */
@@ -1702,6 +1978,33 @@ bool stun_attr_add_str(uint8_t *buf, size_t *len, uint16_t attr, const uint8_t *
   return true;
 }
 
+bool stun_attr_image_init(stun_attr_image *a, uint16_t attr, const uint8_t *avalue, size_t alen) {
+  memset(a, 0, sizeof(*a));
+  const size_t padded = 4 + ((alen + 3) & ~(size_t)3);
+  if (padded > sizeof(a->image)) {
+    return false;
+  }
+  turn_write_u16(a->image, attr);
+  turn_write_u16(a->image + 2, (uint16_t)alen);
+  if (alen) {
+    memcpy(a->image + 4, avalue, alen);
+  }
+  a->len = (uint16_t)padded;
+  return true;
+}
+
+bool stun_attr_image_add_str(const stun_attr_image *a, uint8_t *buf, size_t *len) {
+  const int clen = stun_get_command_message_len_str(buf, *len);
+  const int newlen = clen + a->len;
+  if (!a->len || (clen < 0) || (newlen >= MAX_STUN_MESSAGE_SIZE)) {
+    return false;
+  }
+  memcpy(buf + clen, a->image, a->len);
+  stun_set_command_message_len_str(buf, newlen);
+  *len = newlen;
+  return true;
+}
+
 bool stun_attr_add_addr_str(uint8_t *buf, size_t *len, uint16_t attr_type, const ioa_addr *ca) {
 
   stun_tid tid;
@@ -1851,55 +2154,10 @@ bool stun_attr_add_fingerprint_str(uint8_t *buf, size_t *len) {
   if (!stun_attr_add_str(buf, len, STUN_ATTRIBUTE_FINGERPRINT, (uint8_t *)&crc32, 4)) {
     return false;
   }
-  crc32 = ns_crc32(buf, (int)*len - 8);
+  crc32 = ns_turn_crc32(buf, *len - 8);
   turn_write_u32(buf + *len - 4, crc32 ^ ((uint32_t)FINGERPRINT_XOR));
   return true;
 }
-////////////// CRC ///////////////////////////////////////////////
-
-#define CRC_MASK 0xFFFFFFFFUL
-
-#define UPDATE_CRC(crc, c) crc = crctable[(uint8_t)crc ^ (uint8_t)(c)] ^ (crc >> 8)
-
-static const uint32_t crctable[256] = {
-    0x00000000, 0x77073096, 0xee0e612c, 0x990951ba, 0x076dc419, 0x706af48f, 0xe963a535, 0x9e6495a3, 0x0edb8832,
-    0x79dcb8a4, 0xe0d5e91e, 0x97d2d988, 0x09b64c2b, 0x7eb17cbd, 0xe7b82d07, 0x90bf1d91, 0x1db71064, 0x6ab020f2,
-    0xf3b97148, 0x84be41de, 0x1adad47d, 0x6ddde4eb, 0xf4d4b551, 0x83d385c7, 0x136c9856, 0x646ba8c0, 0xfd62f97a,
-    0x8a65c9ec, 0x14015c4f, 0x63066cd9, 0xfa0f3d63, 0x8d080df5, 0x3b6e20c8, 0x4c69105e, 0xd56041e4, 0xa2677172,
-    0x3c03e4d1, 0x4b04d447, 0xd20d85fd, 0xa50ab56b, 0x35b5a8fa, 0x42b2986c, 0xdbbbc9d6, 0xacbcf940, 0x32d86ce3,
-    0x45df5c75, 0xdcd60dcf, 0xabd13d59, 0x26d930ac, 0x51de003a, 0xc8d75180, 0xbfd06116, 0x21b4f4b5, 0x56b3c423,
-    0xcfba9599, 0xb8bda50f, 0x2802b89e, 0x5f058808, 0xc60cd9b2, 0xb10be924, 0x2f6f7c87, 0x58684c11, 0xc1611dab,
-    0xb6662d3d, 0x76dc4190, 0x01db7106, 0x98d220bc, 0xefd5102a, 0x71b18589, 0x06b6b51f, 0x9fbfe4a5, 0xe8b8d433,
-    0x7807c9a2, 0x0f00f934, 0x9609a88e, 0xe10e9818, 0x7f6a0dbb, 0x086d3d2d, 0x91646c97, 0xe6635c01, 0x6b6b51f4,
-    0x1c6c6162, 0x856530d8, 0xf262004e, 0x6c0695ed, 0x1b01a57b, 0x8208f4c1, 0xf50fc457, 0x65b0d9c6, 0x12b7e950,
-    0x8bbeb8ea, 0xfcb9887c, 0x62dd1ddf, 0x15da2d49, 0x8cd37cf3, 0xfbd44c65, 0x4db26158, 0x3ab551ce, 0xa3bc0074,
-    0xd4bb30e2, 0x4adfa541, 0x3dd895d7, 0xa4d1c46d, 0xd3d6f4fb, 0x4369e96a, 0x346ed9fc, 0xad678846, 0xda60b8d0,
-    0x44042d73, 0x33031de5, 0xaa0a4c5f, 0xdd0d7cc9, 0x5005713c, 0x270241aa, 0xbe0b1010, 0xc90c2086, 0x5768b525,
-    0x206f85b3, 0xb966d409, 0xce61e49f, 0x5edef90e, 0x29d9c998, 0xb0d09822, 0xc7d7a8b4, 0x59b33d17, 0x2eb40d81,
-    0xb7bd5c3b, 0xc0ba6cad, 0xedb88320, 0x9abfb3b6, 0x03b6e20c, 0x74b1d29a, 0xead54739, 0x9dd277af, 0x04db2615,
-    0x73dc1683, 0xe3630b12, 0x94643b84, 0x0d6d6a3e, 0x7a6a5aa8, 0xe40ecf0b, 0x9309ff9d, 0x0a00ae27, 0x7d079eb1,
-    0xf00f9344, 0x8708a3d2, 0x1e01f268, 0x6906c2fe, 0xf762575d, 0x806567cb, 0x196c3671, 0x6e6b06e7, 0xfed41b76,
-    0x89d32be0, 0x10da7a5a, 0x67dd4acc, 0xf9b9df6f, 0x8ebeeff9, 0x17b7be43, 0x60b08ed5, 0xd6d6a3e8, 0xa1d1937e,
-    0x38d8c2c4, 0x4fdff252, 0xd1bb67f1, 0xa6bc5767, 0x3fb506dd, 0x48b2364b, 0xd80d2bda, 0xaf0a1b4c, 0x36034af6,
-    0x41047a60, 0xdf60efc3, 0xa867df55, 0x316e8eef, 0x4669be79, 0xcb61b38c, 0xbc66831a, 0x256fd2a0, 0x5268e236,
-    0xcc0c7795, 0xbb0b4703, 0x220216b9, 0x5505262f, 0xc5ba3bbe, 0xb2bd0b28, 0x2bb45a92, 0x5cb36a04, 0xc2d7ffa7,
-    0xb5d0cf31, 0x2cd99e8b, 0x5bdeae1d, 0x9b64c2b0, 0xec63f226, 0x756aa39c, 0x026d930a, 0x9c0906a9, 0xeb0e363f,
-    0x72076785, 0x05005713, 0x95bf4a82, 0xe2b87a14, 0x7bb12bae, 0x0cb61b38, 0x92d28e9b, 0xe5d5be0d, 0x7cdcefb7,
-    0x0bdbdf21, 0x86d3d2d4, 0xf1d4e242, 0x68ddb3f8, 0x1fda836e, 0x81be16cd, 0xf6b9265b, 0x6fb077e1, 0x18b74777,
-    0x88085ae6, 0xff0f6a70, 0x66063bca, 0x11010b5c, 0x8f659eff, 0xf862ae69, 0x616bffd3, 0x166ccf45, 0xa00ae278,
-    0xd70dd2ee, 0x4e048354, 0x3903b3c2, 0xa7672661, 0xd06016f7, 0x4969474d, 0x3e6e77db, 0xaed16a4a, 0xd9d65adc,
-    0x40df0b66, 0x37d83bf0, 0xa9bcae53, 0xdebb9ec5, 0x47b2cf7f, 0x30b5ffe9, 0xbdbdf21c, 0xcabac28a, 0x53b39330,
-    0x24b4a3a6, 0xbad03605, 0xcdd70693, 0x54de5729, 0x23d967bf, 0xb3667a2e, 0xc4614ab8, 0x5d681b02, 0x2a6f2b94,
-    0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d,
-};
-
-static uint32_t ns_crc32(const uint8_t *buffer, uint32_t len) {
-  uint32_t crc = CRC_MASK;
-  while (len--) {
-    UPDATE_CRC(crc, *buffer++);
-  }
-  return (~crc);
-}
 
 //////////// SASLprep RFC 4013 /////////////////////////////////////////
 
@@ -1968,8 +2226,8 @@ void print_bin_func(const char *name, size_t len, const void *s, const char *fun
   printf("]\n");
 }
 
-bool stun_attr_add_integrity_str(turn_credential_type ct, uint8_t *buf, size_t *len, hmackey_t key, password_t pwd,
-                                 SHATYPE shatype) {
+static bool stun_attr_add_integrity_with(stun_hmac_ctx *hc, turn_credential_type ct, uint8_t *buf, size_t *len,
+                                         hmackey_t key, password_t pwd, SHATYPE shatype) {
   uint8_t hmac[MAXSHASIZE] = {0};
 
   unsigned int shasize;
@@ -1993,14 +2251,24 @@ bool stun_attr_add_integrity_str(turn_credential_type ct, uint8_t *buf, size_t *
   }
 
   if (ct == TURN_CREDENTIALS_SHORT_TERM) {
-    return stun_calculate_hmac(buf, *len - 4 - shasize, pwd, strlen((char *)pwd), buf + *len - shasize, &shasize,
-                               shatype);
+    return stun_message_hmac(hc, pwd, strlen((char *)pwd), shatype, buf, *len - 4 - shasize, buf + *len - shasize,
+                             &shasize);
   } else {
-    return stun_calculate_hmac(buf, *len - 4 - shasize, key, get_hmackey_size(shatype), buf + *len - shasize, &shasize,
-                               shatype);
+    return stun_message_hmac(hc, key, get_hmackey_size(shatype), shatype, buf, *len - 4 - shasize,
+                             buf + *len - shasize, &shasize);
   }
 }
 
+bool stun_attr_add_integrity_str(turn_credential_type ct, uint8_t *buf, size_t *len, hmackey_t key, password_t pwd,
+                                 SHATYPE shatype) {
+  return stun_attr_add_integrity_with(NULL, ct, buf, len, key, pwd, shatype);
+}
+
+bool stun_attr_add_integrity_ctx_str(stun_hmac_ctx *hc, turn_credential_type ct, uint8_t *buf, size_t *len,
+                                     hmackey_t key, password_t pwd, SHATYPE shatype) {
+  return stun_attr_add_integrity_with(hc, ct, buf, len, key, pwd, shatype);
+}
+
 bool stun_attr_add_integrity_by_key_str(uint8_t *buf, size_t *len, const uint8_t *uname, const uint8_t *realm,
                                         hmackey_t key, const uint8_t *nonce, SHATYPE shatype) {
   if (!stun_attr_add_str(buf, len, STUN_ATTRIBUTE_USERNAME, uname, (int)strlen((const char *)uname))) {
@@ -2043,9 +2311,8 @@ bool stun_attr_add_integrity_by_user_short_term_str(uint8_t *buf, size_t *len, c
 /*
  * Return -1 if failure, 0 if the integrity is not correct, 1 if OK
  */
-int stun_check_message_integrity_by_key_str(turn_credential_type ct, uint8_t *buf, size_t len, hmackey_t key,
-                                            password_t pwd, SHATYPE shatype) {
-  stun_attr_ref sar = stun_attr_get_first_by_type_str(buf, len, STUN_ATTRIBUTE_MESSAGE_INTEGRITY);
+static int stun_check_message_integrity_at(stun_hmac_ctx *hc, turn_credential_type ct, uint8_t *buf, size_t len,
+                                           stun_attr_ref sar, hmackey_t key, password_t pwd, SHATYPE shatype) {
   if (!sar) {
     return -1;
   }
@@ -2097,15 +2364,15 @@ int stun_check_message_integrity_by_key_str(turn_credential_type ct, uint8_t *bu
   int res = 0;
   uint8_t new_hmac[MAXSHASIZE] = {0};
   if (ct == TURN_CREDENTIALS_SHORT_TERM) {
-    if (!stun_calculate_hmac(buf, (size_t)new_len - 4 - shasize, pwd, strlen((char *)pwd), new_hmac, &shasize,
-                             shatype)) {
+    if (!stun_message_hmac(hc, pwd, strlen((char *)pwd), shatype, buf, (size_t)new_len - 4 - shasize, new_hmac,
+                           &shasize)) {
       res = -1;
     } else {
       res = 0;
     }
   } else {
-    if (!stun_calculate_hmac(buf, (size_t)new_len - 4 - shasize, key, get_hmackey_size(shatype), new_hmac, &shasize,
-                             shatype)) {
+    if (!stun_message_hmac(hc, key, get_hmackey_size(shatype), shatype, buf, (size_t)new_len - 4 - shasize, new_hmac,
+                           &shasize)) {
       res = -1;
     } else {
       res = 0;
@@ -2131,6 +2398,29 @@ int stun_check_message_integrity_by_key_str(turn_credential_type ct, uint8_t *bu
   return +1;
 }
 
+/*
+ * Return -1 if failure, 0 if the integrity is not correct, 1 if OK
+ */
+int stun_check_message_integrity_by_key_str(turn_credential_type ct, uint8_t *buf, size_t len, hmackey_t key,
+                                            password_t pwd, SHATYPE shatype) {
+  stun_attr_ref sar = stun_attr_get_first_by_type_str(buf, len, STUN_ATTRIBUTE_MESSAGE_INTEGRITY);
+  return stun_check_message_integrity_at(NULL, ct, buf, len, sar, key, pwd, shatype);
+}
+
+int stun_check_message_integrity_by_key_idx_str(turn_credential_type ct, uint8_t *buf, size_t len,
+                                                const stun_attr_index *idx, hmackey_t key, password_t pwd,
+                                                SHATYPE shatype) {
+  stun_attr_ref sar = stun_attr_index_first(idx, buf, len, STUN_ATTRIBUTE_MESSAGE_INTEGRITY);
+  return stun_check_message_integrity_at(NULL, ct, buf, len, sar, key, pwd, shatype);
+}
+
+int stun_check_message_integrity_ctx_str(stun_hmac_ctx *hc, turn_credential_type ct, uint8_t *buf, size_t len,
+                                         const stun_attr_index *idx, hmackey_t key, password_t pwd, SHATYPE shatype) {
+  stun_attr_ref sar = idx ? stun_attr_index_first(idx, buf, len, STUN_ATTRIBUTE_MESSAGE_INTEGRITY)
+                          : stun_attr_get_first_by_type_str(buf, len, STUN_ATTRIBUTE_MESSAGE_INTEGRITY);
+  return stun_check_message_integrity_at(hc, ct, buf, len, sar, key, pwd, shatype);
+}
+
 /*
  * Return -1 if failure, 0 if the integrity is not correct, 1 if OK
  */
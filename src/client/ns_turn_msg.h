@@ -177,6 +177,87 @@ stun_attr_ref stun_attr_get_next_str(const uint8_t *buf, size_t len, stun_attr_r
  * yet; when it is, this boundary moves to the end of that attribute.
  */
 stun_attr_ref stun_attr_get_next_covered_str(const uint8_t *buf, size_t len, stun_attr_ref prev);
+
+/**
+ * Attribute offsets of one message, found in a single walk so that request
+ * handling can look up USERNAME, REALM, NONCE, MESSAGE-INTEGRITY and the
+ * other attributes TURN acts on without re-walking the TLV list each time.
+ * Offsets are from the start of the message; 0 means absent (no attribute
+ * can start inside the header). The walk is the one stun_attr_get_next_str()
+ * does, so a lookup returns exactly what stun_attr_get_first_by_type_str()
+ * would. Types outside the indexed set fall back to that walk.
+ *
+ * An index is only valid for the buffer it was built from, as long as the
+ * attributes are not changed.
+ */
+#define STUN_ATTR_INDEX_SLOTS (24)
+typedef struct {
+  uint32_t seen; /* bit per slot */
+  uint16_t first[STUN_ATTR_INDEX_SLOTS];
+  uint16_t last[STUN_ATTR_INDEX_SLOTS];
+  uint16_t count; /* attributes walked, indexed or not */
+} stun_attr_index;
+
+void stun_attr_index_build(const uint8_t *buf, size_t len, stun_attr_index *idx);
+bool stun_attr_index_has(const stun_attr_index *idx, uint16_t attr_type);
+stun_attr_ref stun_attr_index_first(const stun_attr_index *idx, const uint8_t *buf, size_t len, uint16_t attr_type);
+stun_attr_ref stun_attr_index_last(const stun_attr_index *idx, const uint8_t *buf, size_t len, uint16_t attr_type);
+
+/**
+ * A keyed HMAC context kept between messages. HMAC() derives the inner and
+ * outer padded key state and allocates a context on every call; a session's
+ * key does not change, so the state can be derived once and restarted for
+ * each message. The context remembers its key and re-keys itself when a
+ * different one is passed, so callers need not track key changes.
+ *
+ * Zero-initialise, release with stun_hmac_ctx_clean(). Not thread-safe; one
+ * per session.
+ */
+typedef struct {
+  void *mac; /* EVP_MAC_CTX, or HMAC_CTX before OpenSSL 3.0 */
+  SHATYPE shatype;
+  bool fresh; /* keyed and nothing hashed yet */
+  size_t keylen;
+  uint8_t key[sizeof(hmackey_t)];
+} stun_hmac_ctx;
+
+void stun_hmac_ctx_clean(stun_hmac_ctx *hc);
+/* Streaming use: begin, any number of updates, final. Keys longer than
+ * hmackey_t are not kept; begin fails for them. */
+bool stun_hmac_ctx_begin(stun_hmac_ctx *hc, const uint8_t *key, size_t keylen, SHATYPE shatype);
+bool stun_hmac_ctx_update(stun_hmac_ctx *hc, const uint8_t *buf, size_t len);
+bool stun_hmac_ctx_final(stun_hmac_ctx *hc, uint8_t *hmac, unsigned int *hmac_len);
+
+/**
+ * A success response laid out once: the header and, optionally, a LIFETIME
+ * attribute at a fixed offset. Emitting it copies the image and stores the
+ * transaction ID and lifetime; nothing is encoded per message. Variable-size
+ * attributes are appended afterwards with the usual stun_attr_add_*() calls.
+ */
+#define STUN_RESP_TEMPLATE_SIZE (STUN_HEADER_LENGTH + 8)
+typedef struct {
+  uint16_t len;
+  uint16_t lifetime_offset; /* LIFETIME value; 0 if the template has none */
+  uint8_t image[STUN_RESP_TEMPLATE_SIZE];
+} stun_resp_template;
+
+void stun_resp_template_init(stun_resp_template *t, uint16_t method, bool with_lifetime);
+void stun_resp_template_emit_str(const stun_resp_template *t, uint8_t *buf, size_t *len, const stun_tid *tid,
+                                 uint32_t lifetime);
+
+/**
+ * An attribute encoded once, with its padding, and appended verbatim: for
+ * values fixed by the server configuration, like SOFTWARE.
+ */
+#define STUN_ATTR_IMAGE_SIZE (128)
+typedef struct {
+  uint16_t len; /* 0 if the value did not fit */
+  uint8_t image[STUN_ATTR_IMAGE_SIZE];
+} stun_attr_image;
+
+bool stun_attr_image_init(stun_attr_image *a, uint16_t attr, const uint8_t *avalue, size_t alen);
+bool stun_attr_image_add_str(const stun_attr_image *a, uint8_t *buf, size_t *len);
+
 bool stun_attr_add_str(uint8_t *buf, size_t *len, uint16_t attr, const uint8_t *avalue, int alen);
 bool stun_attr_add_addr_str(uint8_t *buf, size_t *len, uint16_t attr_type, const ioa_addr *ca);
 bool stun_attr_get_addr_str(const uint8_t *buf, size_t len, stun_attr_ref attr, ioa_addr *ca,
@@ -214,6 +295,15 @@ void print_bin_func(const char *name, size_t len, const void *s, const char *fun
  */
 int stun_check_message_integrity_by_key_str(turn_credential_type ct, uint8_t *buf, size_t len, hmackey_t key,
                                             password_t pwd, SHATYPE shatype);
+/* The same check, with MESSAGE-INTEGRITY taken from an index of buf. */
+int stun_check_message_integrity_by_key_idx_str(turn_credential_type ct, uint8_t *buf, size_t len,
+                                                const stun_attr_index *idx, hmackey_t key, password_t pwd,
+                                                SHATYPE shatype);
+/* The same check and signing through a kept HMAC context; idx may be NULL. */
+int stun_check_message_integrity_ctx_str(stun_hmac_ctx *hc, turn_credential_type ct, uint8_t *buf, size_t len,
+                                         const stun_attr_index *idx, hmackey_t key, password_t pwd, SHATYPE shatype);
+bool stun_attr_add_integrity_ctx_str(stun_hmac_ctx *hc, turn_credential_type ct, uint8_t *buf, size_t *len,
+                                     hmackey_t key, password_t pwd, SHATYPE shatype);
 int stun_check_message_integrity_str(turn_credential_type ct, uint8_t *buf, size_t len, const uint8_t *uname,
                                      const uint8_t *realm, const uint8_t *upwd, SHATYPE shatype);
 bool stun_attr_add_integrity_str(turn_credential_type ct, uint8_t *buf, size_t *len, hmackey_t key, password_t pwd,
@@ -57,8 +57,9 @@
  * though WINDOWS is defined for it.
  *
  * Only the widths/operations that current callers need are provided (32-bit
- * load/store/fetch_add/compare-exchange). Add more here when a caller needs
- * them rather than reintroducing a per-file shim.
+ * load/store/fetch_add/compare-exchange; 64-bit and pointer
+ * load/store/compare-exchange). Add more here when a caller needs them rather
+ * than reintroducing a per-file shim.
  */
 
 #include <stdbool.h>
@@ -85,6 +86,35 @@ static inline bool turn_atomic_cas_u32(turn_atomic_u32 *p, uint32_t expected, ui
   return (uint32_t)_InterlockedCompareExchange(p, (long)desired, (long)expected) == expected;
 }
 
+/* unsigned 64-bit atomic. _InterlockedExchange64 is x64-only, so the store
+ * is a compare-exchange loop, which 32-bit x86 has too. */
+typedef volatile __int64 turn_atomic_u64;
+
+static inline uint64_t turn_atomic_load_u64(turn_atomic_u64 *p) {
+  return (uint64_t)_InterlockedCompareExchange64(p, 0, 0);
+}
+static inline void turn_atomic_store_u64(turn_atomic_u64 *p, uint64_t v) {
+  __int64 old = *p;
+  __int64 seen;
+  while ((seen = _InterlockedCompareExchange64(p, (__int64)v, old)) != old) {
+    old = seen;
+  }
+}
+static inline bool turn_atomic_cas_u64(turn_atomic_u64 *p, uint64_t expected, uint64_t desired) {
+  return (uint64_t)_InterlockedCompareExchange64(p, (__int64)desired, (__int64)expected) == expected;
+}
+
+/* Pointer-sized atomic. */
+typedef void *volatile turn_atomic_ptr;
+
+static inline void *turn_atomic_load_ptr(turn_atomic_ptr *p) {
+  return _InterlockedCompareExchangePointer(p, NULL, NULL);
+}
+static inline void turn_atomic_store_ptr(turn_atomic_ptr *p, void *v) { _InterlockedExchangePointer(p, v); }
+static inline bool turn_atomic_cas_ptr(turn_atomic_ptr *p, void *expected, void *desired) {
+  return _InterlockedCompareExchangePointer(p, desired, expected) == expected;
+}
+
 #else
 
 #include <stdatomic.h>
@@ -98,6 +128,22 @@ static inline bool turn_atomic_cas_u32(turn_atomic_u32 *p, uint32_t expected, ui
   return atomic_compare_exchange_strong(p, &expected, desired);
 }
 
+typedef _Atomic uint64_t turn_atomic_u64;
+
+static inline uint64_t turn_atomic_load_u64(turn_atomic_u64 *p) { return atomic_load(p); }
+static inline void turn_atomic_store_u64(turn_atomic_u64 *p, uint64_t v) { atomic_store(p, v); }
+static inline bool turn_atomic_cas_u64(turn_atomic_u64 *p, uint64_t expected, uint64_t desired) {
+  return atomic_compare_exchange_strong(p, &expected, desired);
+}
+
+typedef void *_Atomic turn_atomic_ptr;
+
+static inline void *turn_atomic_load_ptr(turn_atomic_ptr *p) { return atomic_load(p); }
+static inline void turn_atomic_store_ptr(turn_atomic_ptr *p, void *v) { atomic_store(p, v); }
+static inline bool turn_atomic_cas_ptr(turn_atomic_ptr *p, void *expected, void *desired) {
+  return atomic_compare_exchange_strong(p, &expected, desired);
+}
+
 #endif
 
 /*
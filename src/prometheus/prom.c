@@ -37,28 +37,53 @@
 
 #include "prom.h"
 
+#include "ns_turn_atomic.h" // portable atomics and TURN_THREAD_LOCAL (MSVC)
+
 #include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 typedef enum { PROM_COUNTER, PROM_GAUGE } prom_metric_type_t;
 
-/* One time-series: a metric plus a specific set of label values. */
+/* Every counter keeps PROM_SHARDS copies of its samples. A thread picks a
+ * shard on its first update and keeps it, so relay threads (fewer than
+ * PROM_SHARDS in any sane configuration) each write their own shard with
+ * atomics and never share a lock or, usually, a cache line. A scrape
+ * sums the shards. Gauges can be set, and a set cannot replace a sum of
+ * shards in one step, so a gauge keeps a single unsharded copy. Power of
+ * two. */
+#define PROM_SHARDS (16)
+
+/* Hash buckets per shard for labelled metrics; unlabelled ones have one
+ * sample and use a single bucket. */
+#define PROM_BUCKETS (64)
+
+/* One time-series in one shard: a metric plus a specific set of label values.
+ * Samples are pushed onto a bucket lock-free and never removed before the
+ * metric is destroyed. A shard holds at most one sample per series. */
 typedef struct prom_sample {
-  char **label_values; /* label_count owned strings, NULL when label_count==0 */
-  double value;
-  struct prom_sample *next;
+  char **label_values;   /* label_count owned strings, NULL when label_count==0 */
+  turn_atomic_u64 bits; /* the double value's representation */
+  uint32_t hash;
+  struct prom_sample *next; /* immutable once published */
 } prom_sample_t;
 
+typedef struct {
+  turn_atomic_ptr *buckets; /* prom_sample_t chains */
+  char pad[64 - sizeof(void *)]; /* keep shards on separate cache lines */
+} prom_shard_t;
+
 struct prom_metric {
   prom_metric_type_t type;
   char *name;
   char *help;
   size_t label_count;
   char **label_keys; /* owned copies */
-  prom_sample_t *samples;
-  pthread_mutex_t mutex; /* guards samples and sample values */
+  size_t bucket_count;
+  size_t shard_count; /* PROM_SHARDS for counters, 1 for gauges */
+  prom_shard_t shards[PROM_SHARDS];
   struct prom_metric *next;
 };
 
@@ -72,6 +97,16 @@ prom_collector_registry_t *PROM_COLLECTOR_REGISTRY_DEFAULT = NULL;
 /* Guards the one-shot creation of the default registry. */
 static pthread_mutex_t g_default_init_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+static turn_atomic_u32 g_next_shard;
+static TURN_THREAD_LOCAL int tl_shard = -1;
+
+unsigned prom_thread_shard(void) {
+  if (tl_shard < 0) {
+    tl_shard = (int)(turn_atomic_fetch_add_u32(&g_next_shard, 1) & (PROM_SHARDS - 1));
+  }
+  return (unsigned)tl_shard;
+}
+
 static char *prom_strdup(const char *s) {
   if (s == NULL) {
     return NULL;
@@ -84,10 +119,61 @@ static char *prom_strdup(const char *s) {
   return p;
 }
 
+static double bits_to_double(uint64_t bits) {
+  double v;
+  memcpy(&v, &bits, sizeof(v));
+  return v;
+}
+
+static uint64_t double_to_bits(double v) {
+  uint64_t bits;
+  memcpy(&bits, &v, sizeof(bits));
+  return bits;
+}
+
 /* -------------------------------------------------------------------------- */
 /* Metric lifecycle                                                           */
 /* -------------------------------------------------------------------------- */
 
+static void prom_sample_free(const prom_metric_t *m, prom_sample_t *s) {
+  if (s->label_values != NULL) {
+    for (size_t i = 0; i < m->label_count; i++) {
+      free(s->label_values[i]);
+    }
+    free(s->label_values);
+  }
+  free(s);
+}
+
+static void prom_metric_destroy(prom_metric_t *m) {
+  if (m == NULL) {
+    return;
+  }
+  for (size_t i = 0; i < m->shard_count; i++) {
+    if (m->shards[i].buckets == NULL) {
+      continue;
+    }
+    for (size_t b = 0; b < m->bucket_count; b++) {
+      prom_sample_t *s = (prom_sample_t *)turn_atomic_load_ptr(&m->shards[i].buckets[b]);
+      while (s != NULL) {
+        prom_sample_t *next = s->next;
+        prom_sample_free(m, s);
+        s = next;
+      }
+    }
+    free((void *)m->shards[i].buckets);
+  }
+  if (m->label_keys != NULL) {
+    for (size_t i = 0; i < m->label_count; i++) {
+      free(m->label_keys[i]);
+    }
+    free(m->label_keys);
+  }
+  free(m->name);
+  free(m->help);
+  free(m);
+}
+
 static prom_metric_t *prom_metric_new(prom_metric_type_t type, const char *name, const char *help,
                                       size_t label_key_count, const char **label_keys) {
   if (name == NULL) {
@@ -103,6 +189,8 @@ static prom_metric_t *prom_metric_new(prom_metric_type_t type, const char *name,
   m->name = prom_strdup(name);
   m->help = prom_strdup(help != NULL ? help : "");
   m->label_count = label_key_count;
+  m->bucket_count = label_key_count > 0 ? PROM_BUCKETS : 1;
+  m->shard_count = type == PROM_COUNTER ? PROM_SHARDS : 1;
   if (m->name == NULL || m->help == NULL) {
     goto fail;
   }
@@ -120,52 +208,19 @@ static prom_metric_t *prom_metric_new(prom_metric_type_t type, const char *name,
     }
   }
 
-  if (pthread_mutex_init(&m->mutex, NULL) != 0) {
-    goto fail;
+  for (size_t i = 0; i < m->shard_count; i++) {
+    m->shards[i].buckets = calloc(m->bucket_count, sizeof(*m->shards[i].buckets));
+    if (m->shards[i].buckets == NULL) {
+      goto fail;
+    }
   }
   return m;
 
 fail:
-  if (m->label_keys != NULL) {
-    for (size_t i = 0; i < label_key_count; i++) {
-      free(m->label_keys[i]);
-    }
-    free(m->label_keys);
-  }
-  free(m->name);
-  free(m->help);
-  free(m);
+  prom_metric_destroy(m);
   return NULL;
 }
 
-static void prom_metric_destroy(prom_metric_t *m) {
-  if (m == NULL) {
-    return;
-  }
-  prom_sample_t *s = m->samples;
-  while (s != NULL) {
-    prom_sample_t *next = s->next;
-    if (s->label_values != NULL) {
-      for (size_t i = 0; i < m->label_count; i++) {
-        free(s->label_values[i]);
-      }
-      free(s->label_values);
-    }
-    free(s);
-    s = next;
-  }
-  if (m->label_keys != NULL) {
-    for (size_t i = 0; i < m->label_count; i++) {
-      free(m->label_keys[i]);
-    }
-    free(m->label_keys);
-  }
-  pthread_mutex_destroy(&m->mutex);
-  free(m->name);
-  free(m->help);
-  free(m);
-}
-
 prom_counter_t *prom_counter_new(const char *name, const char *help, size_t label_key_count, const char **label_keys) {
   return prom_metric_new(PROM_COUNTER, name, help, label_key_count, label_keys);
 }
@@ -175,27 +230,45 @@ prom_gauge_t *prom_gauge_new(const char *name, const char *help, size_t label_ke
 }
 
 /* -------------------------------------------------------------------------- */
-/* Sample lookup / mutation (caller holds m->mutex)                           */
+/* Sample lookup / mutation                                                   */
 /* -------------------------------------------------------------------------- */
 
-static int label_values_equal(const prom_metric_t *m, char *const *a, const char *const *b) {
+static const char *label_value_at(const char *const *values, size_t i) {
+  return (values != NULL && values[i] != NULL) ? values[i] : "";
+}
+
+/* FNV-1a over the label values, each terminated by its NUL. */
+static uint32_t label_values_hash(const prom_metric_t *m, const char *const *values) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < m->label_count; i++) {
+    const char *p = label_value_at(values, i);
+    do {
+      h = (h ^ (uint8_t)*p) * 16777619u;
+    } while (*p++ != '\0');
+  }
+  return h;
+}
+
+static int label_values_equal(const prom_metric_t *m, const char *const *a, const char *const *b) {
   for (size_t i = 0; i < m->label_count; i++) {
-    const char *av = a[i] != NULL ? a[i] : "";
-    const char *bv = (b != NULL && b[i] != NULL) ? b[i] : "";
-    if (strcmp(av, bv) != 0) {
+    if (strcmp(label_value_at(a, i), label_value_at(b, i)) != 0) {
       return 0;
     }
   }
   return 1;
 }
 
-static prom_sample_t *prom_metric_find_or_create_sample(prom_metric_t *m, const char **label_values) {
-  for (prom_sample_t *s = m->samples; s != NULL; s = s->next) {
-    if (label_values_equal(m, s->label_values, label_values)) {
+static prom_sample_t *bucket_find(const prom_metric_t *m, prom_sample_t *s, uint32_t hash,
+                                  const char *const *label_values) {
+  for (; s != NULL; s = s->next) {
+    if (s->hash == hash && label_values_equal(m, (const char *const *)s->label_values, label_values)) {
       return s;
     }
   }
+  return NULL;
+}
 
+static prom_sample_t *prom_sample_new(const prom_metric_t *m, uint32_t hash, const char **label_values) {
   prom_sample_t *s = calloc(1, sizeof(*s));
   if (s == NULL) {
     return NULL;
@@ -207,54 +280,87 @@ static prom_sample_t *prom_metric_find_or_create_sample(prom_metric_t *m, const
       return NULL;
     }
     for (size_t i = 0; i < m->label_count; i++) {
-      const char *v = (label_values != NULL && label_values[i] != NULL) ? label_values[i] : "";
-      s->label_values[i] = prom_strdup(v);
+      s->label_values[i] = prom_strdup(label_value_at(label_values, i));
       if (s->label_values[i] == NULL) {
-        for (size_t j = 0; j < i; j++) {
-          free(s->label_values[j]);
-        }
-        free(s->label_values);
-        free(s);
+        prom_sample_free(m, s);
         return NULL;
       }
     }
   }
-  s->value = 0.0;
-  s->next = m->samples;
-  m->samples = s;
+  s->hash = hash; /* bits: calloc()'s all-zero pattern is 0.0 */
   return s;
 }
 
+static prom_sample_t *prom_shard_find_or_create_sample(prom_metric_t *m, unsigned shard, uint32_t hash,
+                                                       const char **label_values) {
+  turn_atomic_ptr *bucket = &m->shards[shard].buckets[hash & (m->bucket_count - 1)];
+  prom_sample_t *head = (prom_sample_t *)turn_atomic_load_ptr(bucket);
+  prom_sample_t *s = bucket_find(m, head, hash, label_values);
+  if (s != NULL) {
+    return s;
+  }
+
+  s = prom_sample_new(m, hash, label_values);
+  if (s == NULL) {
+    return NULL;
+  }
+  for (;;) {
+    s->next = head;
+    if (turn_atomic_cas_ptr(bucket, head, s)) {
+      return s;
+    }
+    /* Another writer of this shard got in first; it may have created the
+     * same series, which must not exist twice. */
+    head = (prom_sample_t *)turn_atomic_load_ptr(bucket);
+    prom_sample_t *other = bucket_find(m, head, hash, label_values);
+    if (other != NULL) {
+      prom_sample_free(m, s);
+      return other;
+    }
+  }
+}
+
+static unsigned prom_metric_shard(const prom_metric_t *m) {
+  return m->shard_count > 1 ? prom_thread_shard() : 0;
+}
+
+/* A shard normally has one writer, so the exchange succeeds first time. */
+static void prom_sample_add(prom_sample_t *s, double r_value) {
+  uint64_t old = turn_atomic_load_u64(&s->bits);
+  while (!turn_atomic_cas_u64(&s->bits, old, double_to_bits(bits_to_double(old) + r_value))) {
+    old = turn_atomic_load_u64(&s->bits);
+  }
+}
+
 static int prom_metric_add(prom_metric_t *self, prom_metric_type_t expected, double r_value,
                            const char **label_values) {
   if (self == NULL || self->type != expected) {
     return 1;
   }
-  pthread_mutex_lock(&self->mutex);
-  prom_sample_t *s = prom_metric_find_or_create_sample(self, label_values);
-  int rc = 1;
-  if (s != NULL) {
-    s->value += r_value;
-    rc = 0;
+  const uint32_t hash = label_values_hash(self, label_values);
+  prom_sample_t *s = prom_shard_find_or_create_sample(self, prom_metric_shard(self), hash, label_values);
+  if (s == NULL) {
+    return 1;
   }
-  pthread_mutex_unlock(&self->mutex);
-  return rc;
+  prom_sample_add(s, r_value);
+  return 0;
 }
 
+/* Only gauges are set, and a gauge has a single copy of each series, so a
+ * set is one store that a scrape sees whole or not at all. An add racing it
+ * may or may not survive, as with any set racing an add. */
 static int prom_metric_set(prom_metric_t *self, prom_metric_type_t expected, double r_value,
                            const char **label_values) {
   if (self == NULL || self->type != expected) {
     return 1;
   }
-  pthread_mutex_lock(&self->mutex);
-  prom_sample_t *s = prom_metric_find_or_create_sample(self, label_values);
-  int rc = 1;
-  if (s != NULL) {
-    s->value = r_value;
-    rc = 0;
+  const uint32_t hash = label_values_hash(self, label_values);
+  prom_sample_t *s = prom_shard_find_or_create_sample(self, 0, hash, label_values);
+  if (s == NULL) {
+    return 1;
   }
-  pthread_mutex_unlock(&self->mutex);
-  return rc;
+  turn_atomic_store_u64(&s->bits, double_to_bits(r_value));
+  return 0;
 }
 
 int prom_counter_add(prom_counter_t *self, double r_value, const char **label_values) {
@@ -397,6 +503,91 @@ static void prom_buf_append_value(prom_buf_t *b, double v) {
   }
 }
 
+typedef struct {
+  const prom_sample_t *sample; /* the first shard's copy, for its labels */
+  double value;                /* summed over the shards */
+} prom_merged_t;
+
+/* The merged series in first-seen order, plus an open-addressing index into
+ * them. The index holds slot + 1 (0 is empty) and is kept at most half full. */
+typedef struct {
+  prom_merged_t *series;
+  size_t n;
+  size_t cap;
+  size_t *index;
+  size_t index_mask;
+} prom_merge_t;
+
+static void prom_merge_free(prom_merge_t *mg) {
+  free(mg->series);
+  free(mg->index);
+}
+
+static int prom_merge_grow(prom_merge_t *mg) {
+  const size_t ncap = mg->cap ? mg->cap * 2 : 16;
+  prom_merged_t *series = realloc(mg->series, ncap * sizeof(*series));
+  if (series == NULL) {
+    return 0;
+  }
+  mg->series = series;
+  size_t *index = calloc(ncap * 2, sizeof(*index));
+  if (index == NULL) {
+    return 0;
+  }
+  free(mg->index);
+  mg->index = index;
+  mg->index_mask = ncap * 2 - 1;
+  mg->cap = ncap;
+  for (size_t j = 0; j < mg->n; j++) {
+    size_t i = mg->series[j].sample->hash & mg->index_mask;
+    while (mg->index[i] != 0) {
+      i = (i + 1) & mg->index_mask;
+    }
+    mg->index[i] = j + 1;
+  }
+  return 1;
+}
+
+static int prom_merge_add(prom_merge_t *mg, const prom_metric_t *m, const prom_sample_t *s, double value) {
+  if (mg->n == mg->cap && !prom_merge_grow(mg)) {
+    return 0;
+  }
+  size_t i = s->hash & mg->index_mask;
+  for (; mg->index[i] != 0; i = (i + 1) & mg->index_mask) {
+    prom_merged_t *e = &mg->series[mg->index[i] - 1];
+    if (e->sample->hash == s->hash &&
+        label_values_equal(m, (const char *const *)e->sample->label_values, (const char *const *)s->label_values)) {
+      e->value += value;
+      return 1;
+    }
+  }
+  mg->index[i] = mg->n + 1;
+  mg->series[mg->n].sample = s;
+  mg->series[mg->n].value = value;
+  mg->n++;
+  return 1;
+}
+
+static void prom_sample_render(prom_buf_t *b, const prom_metric_t *m, const prom_sample_t *s, double value) {
+  prom_buf_append_str(b, m->name);
+  if (m->label_count > 0) {
+    prom_buf_append(b, "{", 1);
+    for (size_t i = 0; i < m->label_count; i++) {
+      if (i > 0) {
+        prom_buf_append(b, ",", 1);
+      }
+      prom_buf_append_str(b, m->label_keys[i]);
+      prom_buf_append(b, "=\"", 2);
+      prom_buf_append_label_value(b, s->label_values != NULL ? s->label_values[i] : "");
+      prom_buf_append(b, "\"", 1);
+    }
+    prom_buf_append(b, "}", 1);
+  }
+  prom_buf_append(b, " ", 1);
+  prom_buf_append_value(b, value);
+  prom_buf_append(b, "\n", 1);
+}
+
 static void prom_metric_render(prom_buf_t *b, prom_metric_t *m) {
   const char *type_str = (m->type == PROM_COUNTER) ? "counter" : "gauge";
 
@@ -412,27 +603,25 @@ static void prom_metric_render(prom_buf_t *b, prom_metric_t *m) {
   prom_buf_append_str(b, type_str);
   prom_buf_append(b, "\n", 1);
 
-  pthread_mutex_lock(&m->mutex);
-  for (prom_sample_t *s = m->samples; s != NULL; s = s->next) {
-    prom_buf_append_str(b, m->name);
-    if (m->label_count > 0) {
-      prom_buf_append(b, "{", 1);
-      for (size_t i = 0; i < m->label_count; i++) {
-        if (i > 0) {
-          prom_buf_append(b, ",", 1);
+  /* Merge the shards through a scrape-time index keyed on the sample hash and
+   * label values, so the work is linear in the number of samples. */
+  prom_merge_t mg = {0};
+  for (size_t bucket = 0; bucket < m->bucket_count; bucket++) {
+    for (size_t shard = 0; shard < m->shard_count; shard++) {
+      prom_sample_t *s = (prom_sample_t *)turn_atomic_load_ptr(&m->shards[shard].buckets[bucket]);
+      for (; s != NULL; s = s->next) {
+        if (!prom_merge_add(&mg, m, s, bits_to_double(turn_atomic_load_u64(&s->bits)))) {
+          b->oom = 1;
+          prom_merge_free(&mg);
+          return;
         }
-        prom_buf_append_str(b, m->label_keys[i]);
-        prom_buf_append(b, "=\"", 2);
-        prom_buf_append_label_value(b, s->label_values != NULL ? s->label_values[i] : "");
-        prom_buf_append(b, "\"", 1);
       }
-      prom_buf_append(b, "}", 1);
     }
-    prom_buf_append(b, " ", 1);
-    prom_buf_append_value(b, s->value);
-    prom_buf_append(b, "\n", 1);
   }
-  pthread_mutex_unlock(&m->mutex);
+  for (size_t j = 0; j < mg.n; j++) {
+    prom_sample_render(b, m, mg.series[j].sample, mg.series[j].value);
+  }
+  prom_merge_free(&mg);
 }
 
 char *prom_collector_registry_bridge(prom_collector_registry_t *registry) {
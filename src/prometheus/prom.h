@@ -90,6 +90,11 @@ int prom_gauge_inc(prom_gauge_t *self, const char **label_values);
 int prom_gauge_dec(prom_gauge_t *self, const char **label_values);
 int prom_gauge_set(prom_gauge_t *self, double r_value, const char **label_values);
 
+/* Updates are lock-free: each counter is sharded, and a thread writes the
+ * shard it was given on its first update. Scrapes sum the shards. Gauges,
+ * which can be set, are not sharded. Returns the calling thread's shard. */
+unsigned prom_thread_shard(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -190,6 +190,7 @@ void turn_permission_clean(turn_permission_info *tinfo) {
 
   lm_map_foreach(&(tinfo->chns), (foreachcb_type)delete_channel_info_from_allocation_map);
   lm_map_clean(&(tinfo->chns));
+  turn_timer_wheel_cancel(&(tinfo->expiry));
   memset(tinfo, 0, sizeof(turn_permission_info));
 }
 
@@ -266,6 +267,7 @@ static void ch_info_clean(ch_info *c) {
       DELETE_TURN_CHANNEL_KERNEL(c->kernel_channel);
       c->kernel_channel = 0;
     }
+    turn_timer_wheel_cancel(&(c->expiry));
     memset(c, 0, sizeof(ch_info));
   }
 }
@@ -397,6 +399,25 @@ static size_t allocation_count_permissions(const turn_permission_hashtable *map)
   return count;
 }
 
+void allocation_foreach_permission(allocation *a, allocation_permission_cb cb, void *arg) {
+  if (!a || !cb) {
+    return;
+  }
+  for (size_t b = 0; b < TURN_PERMISSION_HASHTABLE_SIZE; ++b) {
+    turn_permission_array *parray = &(a->addr_to_perm.table[b]);
+    for (size_t i = 0; i < TURN_PERMISSION_ARRAY_SIZE; ++i) {
+      if (parray->main_slots[i].info.allocated) {
+        cb(&(parray->main_slots[i].info), arg);
+      }
+    }
+    for (size_t i = 0; i < parray->extra_sz; ++i) {
+      if (parray->extra_slots[i] && parray->extra_slots[i]->info.allocated) {
+        cb(&(parray->extra_slots[i]->info), arg);
+      }
+    }
+  }
+}
+
 turn_permission_info *allocation_add_permission(allocation *a, const ioa_addr *addr) {
   if (!a || !addr) {
     return NULL;
@@ -509,6 +530,25 @@ ch_info *ch_map_get(ch_map *const map, const uint16_t chnum, const int new_chn)
   return NULL;
 }
 
+void allocation_foreach_channel(allocation *a, allocation_channel_cb cb, void *arg) {
+  if (!a || !cb) {
+    return;
+  }
+  for (size_t index = 0; index < CH_MAP_HASH_SIZE; ++index) {
+    ch_map_array *parray = &(a->chns.table[index]);
+    for (size_t i = 0; i < CH_MAP_ARRAY_SIZE; ++i) {
+      if (parray->main_chns[i].allocated) {
+        cb(&(parray->main_chns[i]), arg);
+      }
+    }
+    for (size_t i = 0; i < parray->extra_sz; ++i) {
+      if (parray->extra_chns[i] && parray->extra_chns[i]->allocated) {
+        cb(parray->extra_chns[i], arg);
+      }
+    }
+  }
+}
+
 void ch_map_clean(ch_map *map) {
   if (!map) {
     return;
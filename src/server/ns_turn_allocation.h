@@ -40,6 +40,7 @@
 #include "ns_turn_ioalib.h"
 #include "ns_turn_maps.h"
 #include "ns_turn_msg.h"
+#include "ns_turn_timer_wheel.h"
 
 #include <stdbool.h>
 
@@ -127,7 +128,8 @@ typedef struct _ch_info {
   uint16_t port;
   ioa_addr peer_addr;
   turn_time_t expiration_time;
-  void *owner; // perm
+  turn_timer_wheel_entry expiry; // in the server's channel expiry wheel
+  void *owner;                   // perm
   TURN_CHANNEL_HANDLER_KERNEL kernel_channel;
 } ch_info;
 
@@ -156,7 +158,8 @@ typedef struct _turn_permission_info {
   lm_map chns;
   ioa_addr addr;
   turn_time_t expiration_time;
-  void *owner; // a
+  turn_timer_wheel_entry expiry; // in the server's permission expiry wheel
+  void *owner;                   // a
   bool verbose;
   unsigned long long session_id;
 } turn_permission_info;
@@ -216,6 +219,13 @@ turn_permission_info *allocation_get_permission(allocation *a, const ioa_addr *a
 turn_permission_hashtable *allocation_get_turn_permission_hashtable(allocation *a);
 turn_permission_info *allocation_add_permission(allocation *a, const ioa_addr *addr);
 
+/* Visit the allocated permissions / channels; the callbacks must not add or
+ * remove entries. */
+typedef void (*allocation_permission_cb)(turn_permission_info *tinfo, void *arg);
+typedef void (*allocation_channel_cb)(ch_info *chn, void *arg);
+void allocation_foreach_permission(allocation *a, allocation_permission_cb cb, void *arg);
+void allocation_foreach_channel(allocation *a, allocation_channel_cb cb, void *arg);
+
 ch_info *allocation_get_new_ch_info(allocation *a, uint16_t chnum, ioa_addr *peer_addr);
 ch_info *allocation_get_ch_info(allocation *a, uint16_t chnum);
 ch_info *allocation_get_ch_info_by_peer_addr(allocation *a, ioa_addr *peer_addr);
@@ -186,13 +186,10 @@ struct _ip_range_list {
 
 typedef struct _ip_range_list ip_range_list_t;
 
-void ioa_lock_whitelist(ioa_engine_handle e);
-void ioa_unlock_whitelist(ioa_engine_handle e);
-const ip_range_list_t *ioa_get_whitelist(ioa_engine_handle e);
-
-void ioa_lock_blacklist(ioa_engine_handle e);
-void ioa_unlock_blacklist(ioa_engine_handle e);
-const ip_range_list_t *ioa_get_blacklist(ioa_engine_handle e);
+/* Dynamic (DB-backed) lists: return the last range in list order that matches
+ * addr for the realm, or NULL. Lock-free on the calling thread's snapshot. */
+const ip_range_t *ioa_match_whitelist(ioa_engine_handle e, const char *realm, const ioa_addr *addr);
+const ip_range_t *ioa_match_blacklist(ioa_engine_handle e, const char *realm, const ioa_addr *addr);
 
 ////////////////////////////////////////////
 
@@ -238,6 +235,20 @@ void turn_report_session_usage(void *session, int force_invalid);
 typedef void (*ioa_net_event_handler)(ioa_socket_handle s, int event_type, ioa_net_data *data, void *ctx,
                                       int can_resume);
 
+/*
+ * Batch network event handler: receives every datagram of one recvmmsg()
+ * call at once. Like the single-packet handler, it takes ownership of a
+ * buffer by setting data[i].nbh to NULL; the rest are freed by the caller.
+ */
+typedef void (*ioa_net_batch_event_handler)(ioa_socket_handle s, int event_type, ioa_net_data *data, size_t count,
+                                            void *ctx);
+
+/*
+ * Spliced TCP relay accounting: bytes that arrived on s have been written to
+ * the other socket of the pair.
+ */
+typedef void (*ioa_splice_event_handler)(ioa_socket_handle s, size_t bytes, void *ctx);
+
 /*
  * Timer callback
  */
@@ -288,6 +299,9 @@ SOCKET_TYPE get_ioa_socket_type(ioa_socket_handle s);
 SOCKET_APP_TYPE get_ioa_socket_app_type(ioa_socket_handle s);
 const char *get_ioa_socket_tls_method(ioa_socket_handle s);
 const char *get_ioa_socket_tls_cipher(ioa_socket_handle s);
+/* kTLS state of a --tls-ktls connection ("none", "tx", "rx", "tx+rx", ...);
+ * empty when it was not asked for. */
+const char *get_ioa_socket_tls_offload(ioa_socket_handle s);
 void set_ioa_socket_app_type(ioa_socket_handle s, SOCKET_APP_TYPE sat);
 ioa_addr *get_local_addr_from_ioa_socket(ioa_socket_handle s);
 ioa_addr *get_remote_addr_from_ioa_socket(ioa_socket_handle s);
@@ -299,6 +313,17 @@ tcp_connection *get_ioa_socket_sub_session(ioa_socket_handle s);
 void set_ioa_socket_sub_session(ioa_socket_handle s, tcp_connection *tc);
 int register_callback_on_ioa_socket(ioa_engine_handle e, ioa_socket_handle s, int event_type, ioa_net_event_handler cb,
                                     void *ctx, int clean_preexisting);
+/* Optional batch variant for recvmmsg-eligible UDP sockets. Must follow
+ * register_callback_on_ioa_socket(), which resets it; the single-packet
+ * callback and its ctx are still used for non-batched reads. */
+int register_batch_callback_on_ioa_socket(ioa_socket_handle s, ioa_net_batch_event_handler cb);
+/* RFC 6062: moves all further data between a ready client data connection and
+ * its peer connection inside the kernel, bypassing the read callbacks. Starts
+ * once neither socket holds buffered input or output, so the stream order is
+ * kept; until then the read callbacks keep relaying. Returns -1 if the pair
+ * stays on the read callbacks (not supported, disabled, TLS, or bandwidth
+ * limited). */
+int splice_ioa_sockets(ioa_socket_handle s1, ioa_socket_handle s2, ioa_splice_event_handler cb, void *ctx);
 int send_data_from_ioa_socket_nbh(ioa_socket_handle s, ioa_addr *dest_addr, ioa_network_buffer_handle nbh, int ttl,
                                   int tos, int *skip);
 void close_ioa_socket(ioa_socket_handle s);
@@ -310,6 +335,11 @@ void close_ioa_socket(ioa_socket_handle s);
     }                                                                                                                  \
   } while (0)
 ioa_socket_handle detach_ioa_socket(ioa_socket_handle s);
+/* Takes a connected socket off its engine's event loop, keeping its descriptor
+ * and TLS state, so that another engine can adopt it with
+ * register_callback_on_ioa_socket(). Returns -1, leaving the socket as it was,
+ * while data is buffered above the kernel. */
+int ioa_socket_suspend(ioa_socket_handle s);
 void detach_socket_net_data(ioa_socket_handle s);
 int set_df_on_ioa_socket(ioa_socket_handle s, int value);
 void set_do_not_use_df(ioa_socket_handle s);
@@ -0,0 +1,366 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * https://opensource.org/license/bsd-3-clause
+ *
+ * Copyright (C) 2011, 2012, 2013 Citrix Systems
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "ns_turn_ip_trie.h"
+
+#include "ns_turn_utils.h" // for turn_calloc, turn_realloc, turn_strdup
+
+#include <stdlib.h> // for qsort, bsearch, free
+#include <string.h> // for memcmp, memset, strcmp
+
+#define IP_TRIE_NO_RANGE (-1)
+#define IP_TRIE_MAX_BYTES (16)
+
+typedef struct _ip_trie_node {
+  uint32_t child[2]; /* 0 = none; the root is never a child */
+  int32_t range;     /* highest list index whose range covers this prefix */
+} ip_trie_node;
+
+typedef struct _ip_trie_tree {
+  ip_trie_node *nodes;
+  size_t nodes_number;
+  size_t nodes_capacity;
+} ip_trie_tree;
+
+typedef struct _ip_trie_set {
+  char *realm;
+  ip_trie_tree v4;
+  ip_trie_tree v6;
+} ip_trie_set;
+
+struct _ip_trie {
+  const ip_range_list_t *list;
+  ip_trie_set unrealmed; /* ranges without a realm */
+  ip_trie_set all;       /* every range, for sessions without a realm */
+  ip_trie_set *realms;   /* ranges of one realm each, sorted by name */
+  size_t realms_number;
+  int32_t *fallback; /* list indexes scanned linearly, ascending */
+  size_t fallback_number;
+};
+
+/////////////// tree ///////////////
+
+static uint32_t tree_new_node(ip_trie_tree *t) {
+  if (t->nodes_number == t->nodes_capacity) {
+    t->nodes_capacity = t->nodes_capacity ? (t->nodes_capacity * 2) : 64;
+    t->nodes = (ip_trie_node *)turn_realloc(t->nodes, t->nodes_capacity * sizeof(ip_trie_node));
+  }
+  ip_trie_node *n = &(t->nodes[t->nodes_number]);
+  n->child[0] = 0;
+  n->child[1] = 0;
+  n->range = IP_TRIE_NO_RANGE;
+  return (uint32_t)(t->nodes_number++);
+}
+
+static void set_bit(uint8_t *key, unsigned bit, int value) {
+  const uint8_t mask = (uint8_t)(0x80u >> (bit & 7));
+  if (value) {
+    key[bit >> 3] |= mask;
+  } else {
+    key[bit >> 3] &= (uint8_t)~mask;
+  }
+}
+
+static int get_bit(const uint8_t *key, unsigned bit) { return (key[bit >> 3] >> (7 - (bit & 7))) & 1; }
+
+/* Lowest and highest addresses under the prefix made of the first depth bits of key. */
+static void prefix_span(const uint8_t *key, unsigned depth, unsigned nbytes, uint8_t *lo, uint8_t *hi) {
+  memcpy(lo, key, nbytes);
+  memcpy(hi, key, nbytes);
+  for (unsigned bit = depth; bit < nbytes * 8; ++bit) {
+    set_bit(lo, bit, 0);
+    set_bit(hi, bit, 1);
+  }
+}
+
+static bool prefix_overlaps(const uint8_t *key, unsigned depth, unsigned nbytes, const uint8_t *min,
+                            const uint8_t *max) {
+  uint8_t lo[IP_TRIE_MAX_BYTES];
+  uint8_t hi[IP_TRIE_MAX_BYTES];
+  prefix_span(key, depth, nbytes, lo, hi);
+  return (memcmp(hi, min, nbytes) >= 0) && (memcmp(lo, max, nbytes) <= 0);
+}
+
+/* Mark every maximal prefix under node that lies inside [min, max]. The
+ * caller has checked that node's own prefix overlaps the range. */
+static void tree_insert(ip_trie_tree *t, uint32_t node, unsigned depth, unsigned nbytes, uint8_t *key,
+                        const uint8_t *min, const uint8_t *max, int32_t range) {
+  uint8_t lo[IP_TRIE_MAX_BYTES];
+  uint8_t hi[IP_TRIE_MAX_BYTES];
+  prefix_span(key, depth, nbytes, lo, hi);
+  if ((memcmp(lo, min, nbytes) >= 0) && (memcmp(hi, max, nbytes) <= 0)) {
+    if (t->nodes[node].range < range) {
+      t->nodes[node].range = range;
+    }
+    return;
+  }
+  for (int b = 0; b < 2; ++b) {
+    set_bit(key, depth, b);
+    if (prefix_overlaps(key, depth + 1, nbytes, min, max)) {
+      uint32_t child = t->nodes[node].child[b];
+      if (!child) {
+        child = tree_new_node(t);
+        t->nodes[node].child[b] = child;
+      }
+      tree_insert(t, child, depth + 1, nbytes, key, min, max, range);
+    }
+  }
+  set_bit(key, depth, 0);
+}
+
+static void tree_add(ip_trie_tree *t, unsigned nbytes, const uint8_t *min, const uint8_t *max, int32_t range) {
+  if (!t->nodes_number) {
+    tree_new_node(t);
+  }
+  uint8_t key[IP_TRIE_MAX_BYTES];
+  memset(key, 0, sizeof(key));
+  tree_insert(t, 0, 0, nbytes, key, min, max, range);
+}
+
+static int32_t tree_match(const ip_trie_tree *t, unsigned nbytes, const uint8_t *addr) {
+  int32_t best = IP_TRIE_NO_RANGE;
+  if (!t->nodes_number) {
+    return best;
+  }
+  uint32_t node = 0;
+  for (unsigned depth = 0;; ++depth) {
+    if (t->nodes[node].range > best) {
+      best = t->nodes[node].range;
+    }
+    if (depth == nbytes * 8) {
+      break;
+    }
+    node = t->nodes[node].child[get_bit(addr, depth)];
+    if (!node) {
+      break;
+    }
+  }
+  return best;
+}
+
+/////////////// ranges ///////////////
+
+/* Fills min/max with the range bounds as big-endian bytes. Returns the byte
+ * width (4 or 16), 0 if the range needs the linear fallback, -1 if the range
+ * is empty. Mirrors the corner cases of ioa_addr_in_range()/addr_less_eq(). */
+static int range_bounds(const ioa_addr_range *r, uint8_t *min, uint8_t *max) {
+  const int family = r->max.ss.sa_family;
+
+  if (addr_any(&(r->max))) {
+    return 0; /* no upper bound: matches across families */
+  }
+
+  int nbytes = 0;
+  if (family == AF_INET) {
+    nbytes = 4;
+    memcpy(max, &(r->max.s4.sin_addr), 4);
+  } else if (family == AF_INET6) {
+    nbytes = 16;
+    memcpy(max, &(r->max.s6.sin6_addr), 16);
+  } else {
+    return 0;
+  }
+
+  if (addr_any(&(r->min))) {
+    if (family != AF_INET) {
+      return 0; /* an open IPv6 lower bound also admits every IPv4 address */
+    }
+    memset(min, 0, (size_t)nbytes);
+  } else if (r->min.ss.sa_family != family) {
+    return 0;
+  } else if (family == AF_INET) {
+    memcpy(min, &(r->min.s4.sin_addr), 4);
+  } else {
+    memcpy(min, &(r->min.s6.sin6_addr), 16);
+  }
+
+  if (memcmp(min, max, (size_t)nbytes) > 0) {
+    return -1;
+  }
+
+  return nbytes;
+}
+
+static void set_add(ip_trie_set *s, int nbytes, const uint8_t *min, const uint8_t *max, int32_t range) {
+  tree_add((nbytes == 4) ? &(s->v4) : &(s->v6), (unsigned)nbytes, min, max, range);
+}
+
+static int32_t set_match(const ip_trie_set *s, const ioa_addr *addr) {
+  int32_t best = IP_TRIE_NO_RANGE;
+  if (addr->ss.sa_family == AF_INET) {
+    best = tree_match(&(s->v4), 4, (const uint8_t *)&(addr->s4.sin_addr));
+  } else if (addr->ss.sa_family == AF_INET6) {
+    best = tree_match(&(s->v6), 16, (const uint8_t *)&(addr->s6.sin6_addr));
+    /* IPv4 ranges see the IPv4 embedded in mapped/compatible/6to4/NAT64 addresses. */
+    ioa_addr embedded;
+    if (ioa_addr_get_embedded_ipv4(addr, &embedded)) {
+      const int32_t v4 = tree_match(&(s->v4), 4, (const uint8_t *)&(embedded.s4.sin_addr));
+      if (v4 > best) {
+        best = v4;
+      }
+    }
+  }
+  return best;
+}
+
+static void set_clean(ip_trie_set *s) {
+  free(s->realm);
+  free(s->v4.nodes);
+  free(s->v6.nodes);
+}
+
+static int compare_sets(const void *a, const void *b) {
+  return strcmp(((const ip_trie_set *)a)->realm, ((const ip_trie_set *)b)->realm);
+}
+
+static ip_trie_set *find_realm_set(const ip_trie *trie, const char *realm) {
+  if (!trie->realms_number) {
+    return NULL;
+  }
+  ip_trie_set key;
+  memset(&key, 0, sizeof(key));
+  key.realm = (char *)realm;
+  return (ip_trie_set *)bsearch(&key, trie->realms, trie->realms_number, sizeof(ip_trie_set), compare_sets);
+}
+
+/////////////// API ///////////////
+
+ip_trie *ip_trie_create(const ip_range_list_t *list) {
+  ip_trie *trie = (ip_trie *)turn_calloc(1, sizeof(ip_trie));
+  if (!trie) {
+    return NULL;
+  }
+  trie->list = list;
+  if (!list) {
+    return trie;
+  }
+
+  /* One set per distinct realm, sorted so lookups can bsearch. */
+  for (size_t i = 0; i < list->ranges_number; ++i) {
+    const char *realm = list->rs[i].realm;
+    if (!realm[0]) {
+      continue;
+    }
+    bool found = false;
+    for (size_t j = 0; j < trie->realms_number && !found; ++j) {
+      found = !strcmp(trie->realms[j].realm, realm);
+    }
+    if (!found) {
+      trie->realms = (ip_trie_set *)turn_realloc(trie->realms, (trie->realms_number + 1) * sizeof(ip_trie_set));
+      memset(&(trie->realms[trie->realms_number]), 0, sizeof(ip_trie_set));
+      trie->realms[trie->realms_number].realm = turn_strdup(realm);
+      ++(trie->realms_number);
+    }
+  }
+  if (trie->realms_number > 1) {
+    qsort(trie->realms, trie->realms_number, sizeof(ip_trie_set), compare_sets);
+  }
+
+  for (size_t i = 0; i < list->ranges_number; ++i) {
+    const ip_range_t *r = &(list->rs[i]);
+    const int32_t range = (int32_t)i;
+    uint8_t min[IP_TRIE_MAX_BYTES];
+    uint8_t max[IP_TRIE_MAX_BYTES];
+    const int nbytes = range_bounds(&(r->enc), min, max);
+    if (nbytes < 0) {
+      continue;
+    }
+    if (nbytes == 0) {
+      trie->fallback = (int32_t *)turn_realloc(trie->fallback, (trie->fallback_number + 1) * sizeof(int32_t));
+      trie->fallback[trie->fallback_number++] = range;
+      continue;
+    }
+    set_add(&(trie->all), nbytes, min, max, range);
+    if (r->realm[0]) {
+      set_add(find_realm_set(trie, r->realm), nbytes, min, max, range);
+    } else {
+      set_add(&(trie->unrealmed), nbytes, min, max, range);
+    }
+  }
+
+  return trie;
+}
+
+void ip_trie_free(ip_trie *trie) {
+  if (trie) {
+    set_clean(&(trie->unrealmed));
+    set_clean(&(trie->all));
+    for (size_t i = 0; i < trie->realms_number; ++i) {
+      set_clean(&(trie->realms[i]));
+    }
+    free(trie->realms);
+    free(trie->fallback);
+    free(trie);
+  }
+}
+
+const ip_range_t *ip_trie_match(const ip_trie *trie, const char *realm, const ioa_addr *addr) {
+  if (!trie || !trie->list || !addr) {
+    return NULL;
+  }
+
+  const bool has_realm = realm && realm[0];
+  int32_t best = IP_TRIE_NO_RANGE;
+
+  if (!has_realm) {
+    best = set_match(&(trie->all), addr);
+  } else {
+    best = set_match(&(trie->unrealmed), addr);
+    const ip_trie_set *s = find_realm_set(trie, realm);
+    if (s) {
+      const int32_t r = set_match(s, addr);
+      if (r > best) {
+        best = r;
+      }
+    }
+  }
+
+  /* Ascending indexes: scan backwards and stop at the first hit above best. */
+  for (size_t i = trie->fallback_number; i > 0; --i) {
+    const int32_t idx = trie->fallback[i - 1];
+    if (idx <= best) {
+      break;
+    }
+    const ip_range_t *r = &(trie->list->rs[idx]);
+    if (r->realm[0] && has_realm && strcmp(r->realm, realm)) {
+      continue;
+    }
+    if (ioa_addr_in_range(&(r->enc), addr)) {
+      best = idx;
+      break;
+    }
+  }
+
+  return (best == IP_TRIE_NO_RANGE) ? NULL : &(trie->list->rs[best]);
+}
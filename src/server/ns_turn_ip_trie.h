@@ -0,0 +1,76 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * https://opensource.org/license/bsd-3-clause
+ *
+ * Copyright (C) 2011, 2012, 2013 Citrix Systems
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef __TURN_IP_TRIE__
+#define __TURN_IP_TRIE__
+
+#include "ns_turn_ioalib.h" // for ip_range_list_t, ip_range_t
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Read-only lookup structure compiled from an ip_range_list_t, answering the
+ * same question as a reverse linear scan of the list with ioa_addr_in_range()
+ * and the per-range realm filter, in O(address bits).
+ *
+ * Every [min, max] range is split into the CIDR prefixes that cover it and
+ * those are stored in a binary trie per address family. There is one set of
+ * tries for realm-less ranges, one per realm, and one holding every range for
+ * sessions that have no realm. A lookup walks at most two tries and reports
+ * the matching range with the highest list index, which is the one the
+ * reverse scan would have found first. The few ranges a prefix cannot
+ * express (mixed address families, open upper bounds, IPv6 ranges starting
+ * at ::) are kept aside and scanned linearly with the original predicate.
+ *
+ * The trie does not copy the list: the list must outlive it and must not
+ * change. Once built, it is immutable and safe to query from any thread.
+ */
+
+struct _ip_trie;
+typedef struct _ip_trie ip_trie;
+
+ip_trie *ip_trie_create(const ip_range_list_t *list);
+void ip_trie_free(ip_trie *trie);
+
+/* The range of the list that matches addr for a session in realm (NULL or ""
+ * for none), or NULL if there is none. */
+const ip_range_t *ip_trie_match(const ip_trie *trie, const char *realm, const ioa_addr *addr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__TURN_IP_TRIE__
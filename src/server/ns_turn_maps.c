@@ -459,262 +459,143 @@ bool lm_map_foreach_arg(lm_map *map, foreachcb_arg_type func, void *arg) {
   return false;
 }
 
-////////////////////  ADDR LISTS ///////////////////////////////////
+////////// ADDR MAPS ////////////////////////////////////////////
 
-static void addr_list_free(addr_list_header *slh) {
-  if (slh) {
-    if (slh->extra_list) {
-      free(slh->extra_list);
-    }
-    memset(slh, 0, sizeof(addr_list_header));
+#define ur_addr_map_valid(map) ((map) && ((map)->magic == MAGIC_HASH))
+
+static inline uint64_t addr_map_mix64(uint64_t h) {
+  h ^= h >> 30;
+  h *= 0xbf58476d1ce4e5b9ULL;
+  h ^= h >> 27;
+  h *= 0x94d049bb133111ebULL;
+  h ^= h >> 31;
+  return h;
+}
+
+/* Mixes the whole address and the port, so keys that differ only in the port
+ * (many clients behind one NAT) still spread over the table. */
+static uint32_t addr_map_hash(const ioa_addr *key) {
+  uint64_t h = 0;
+  if (key->ss.sa_family == AF_INET) {
+    h = addr_map_mix64(((uint64_t)key->s4.sin_addr.s_addr << 16) ^ (uint64_t)key->s4.sin_port ^
+                       ((uint64_t)AF_INET << 48));
+  } else {
+    uint64_t a[2];
+    memcpy(&a, &(key->s6.sin6_addr), sizeof(a));
+    h = addr_map_mix64(a[0] ^ ((uint64_t)key->s6.sin6_port << 48));
+    h = addr_map_mix64(h ^ a[1]);
   }
+  return (uint32_t)(h ^ (h >> 32));
 }
 
-static void addr_list_add(addr_list_header *slh, const ioa_addr *key, ur_addr_map_value_type value) {
-  if (!key || !value) {
-    return;
+static addr_elem *addr_map_find(const ur_addr_map *map, const ioa_addr *key, uint32_t hash) {
+  if (!map->capacity) {
+    return NULL;
   }
 
-  addr_elem *elem = NULL;
-
-  for (size_t i = 0; i < ADDR_ARRAY_SIZE; ++i) {
-    if (!(slh->main_list[i].value)) {
-      elem = &(slh->main_list[i]);
-      break;
+  const size_t mask = map->capacity - 1;
+  size_t i = hash & mask;
+  for (uint32_t dist = 0;; ++dist) {
+    addr_elem *elem = &(map->slots[i]);
+    /* An empty slot, or an entry closer to its home than we are to ours,
+     * ends the probe: Robin Hood insertion would have placed key before it. */
+    if (!(elem->value) || (elem->dist < dist)) {
+      return NULL;
     }
-  }
-
-  if (!elem && slh->extra_list) {
-    for (size_t i = 0; i < slh->extra_sz; ++i) {
-      if (!(slh->extra_list[i].value)) {
-        elem = &(slh->extra_list[i]);
-        break;
-      }
+    if ((elem->hash == hash) && addr_eq(&(elem->key), key)) {
+      return elem;
     }
+    i = (i + 1) & mask;
   }
-
-  if (!elem) {
-    const size_t old_sz = slh->extra_sz;
-    const size_t old_sz_mem = old_sz * sizeof(addr_elem);
-    slh->extra_list = (addr_elem *)turn_realloc(slh->extra_list, old_sz_mem + sizeof(addr_elem));
-    assert(slh->extra_list);
-    elem = &(slh->extra_list[old_sz]);
-    slh->extra_sz += 1;
-  }
-
-  addr_cpy(&(elem->key), key);
-  elem->value = value;
 }
 
-static void addr_list_remove(addr_list_header *slh, const ioa_addr *key, ur_addr_map_func delfunc, int *counter) {
-  if (!slh || !key) {
-    return;
-  }
-
-  if (counter) {
-    *counter = 0;
-  }
+/* Insert a key known to be absent into a table with room for it. */
+static void addr_map_insert_absent(ur_addr_map *map, const ioa_addr *key, uint32_t hash,
+                                   ur_addr_map_value_type value) {
+  addr_elem cur;
+  memset(&cur, 0, sizeof(cur));
+  addr_cpy(&(cur.key), key);
+  cur.value = value;
+  cur.hash = hash;
 
-  for (size_t i = 0; i < ADDR_ARRAY_SIZE; ++i) {
-    addr_elem *elem = &(slh->main_list[i]);
-    if (elem->value) {
-      if (addr_eq(&(elem->key), key)) {
-        if (delfunc && elem->value) {
-          delfunc(elem->value);
-        }
-        elem->value = 0;
-        if (counter) {
-          *counter += 1;
-        }
-      }
+  const size_t mask = map->capacity - 1;
+  size_t i = hash & mask;
+  for (;;) {
+    addr_elem *elem = &(map->slots[i]);
+    if (!(elem->value)) {
+      *elem = cur;
+      return;
     }
-  }
-
-  if (slh->extra_list) {
-    for (size_t i = 0; i < slh->extra_sz; ++i) {
-      addr_elem *elem = &(slh->extra_list[i]);
-      if (elem->value) {
-        if (addr_eq(&(elem->key), key)) {
-          if (delfunc && elem->value) {
-            delfunc(elem->value);
-          }
-          elem->value = 0;
-          if (counter) {
-            *counter += 1;
-          }
-        }
-      }
+    if (elem->dist < cur.dist) {
+      const addr_elem tmp = *elem;
+      *elem = cur;
+      cur = tmp;
     }
+    i = (i + 1) & mask;
+    cur.dist += 1;
   }
 }
 
-static void addr_list_foreach(addr_list_header *slh, ur_addr_map_func func) {
-  if (slh && func) {
+static bool addr_map_resize(ur_addr_map *map, size_t capacity) {
+  addr_elem *slots = (addr_elem *)turn_calloc(capacity, sizeof(addr_elem));
+  if (!slots) {
+    return false;
+  }
 
-    for (size_t i = 0; i < ADDR_ARRAY_SIZE; ++i) {
-      addr_elem *elem = &(slh->main_list[i]);
-      if (elem->value) {
-        func(elem->value);
-      }
-    }
+  addr_elem *old_slots = map->slots;
+  const size_t old_capacity = map->capacity;
 
-    if (slh->extra_list) {
-      for (size_t i = 0; i < slh->extra_sz; ++i) {
-        addr_elem *elem = &(slh->extra_list[i]);
-        if (elem->value) {
-          func(elem->value);
-        }
-      }
+  map->slots = slots;
+  map->capacity = capacity;
+  for (size_t i = 0; i < old_capacity; ++i) {
+    if (old_slots[i].value) {
+      addr_map_insert_absent(map, &(old_slots[i].key), old_slots[i].hash, old_slots[i].value);
     }
   }
-}
+  free(old_slots);
 
-/* Returns false as soon as the callback returns false (early exit). */
-static bool addr_list_foreach_arg(addr_list_header *slh, ur_addr_map_func_arg func, void *arg) {
-  if (slh && func) {
-    for (size_t i = 0; i < ADDR_ARRAY_SIZE; ++i) {
-      addr_elem *elem = &(slh->main_list[i]);
-      if (elem->value) {
-        if (!func(elem->value, arg)) {
-          return false;
-        }
-      }
-    }
-    if (slh->extra_list) {
-      for (size_t i = 0; i < slh->extra_sz; ++i) {
-        addr_elem *elem = &(slh->extra_list[i]);
-        if (elem->value) {
-          if (!func(elem->value, arg)) {
-            return false;
-          }
-        }
-      }
-    }
-  }
   return true;
 }
 
-/* Returns false as soon as the callback returns false (early exit). */
-static bool addr_list_foreach_key_arg(addr_list_header *slh, ur_addr_map_key_func_arg func, void *arg) {
-  if (slh && func) {
-    for (size_t i = 0; i < ADDR_ARRAY_SIZE; ++i) {
-      addr_elem *elem = &(slh->main_list[i]);
-      if (elem->value) {
-        if (!func(&(elem->key), elem->value, arg)) {
-          return false;
-        }
-      }
-    }
-    if (slh->extra_list) {
-      for (size_t i = 0; i < slh->extra_sz; ++i) {
-        addr_elem *elem = &(slh->extra_list[i]);
-        if (elem->value) {
-          if (!func(&(elem->key), elem->value, arg)) {
-            return false;
-          }
-        }
-      }
+/* Backward-shift deletion: pull the rest of the probe run one slot closer to
+ * home, so no tombstones are needed and probe lengths stay short. */
+static void addr_map_remove_at(ur_addr_map *map, addr_elem *elem) {
+  const size_t mask = map->capacity - 1;
+  size_t i = (size_t)(elem - map->slots);
+  for (;;) {
+    const size_t next = (i + 1) & mask;
+    addr_elem *nelem = &(map->slots[next]);
+    if (!(nelem->value) || !(nelem->dist)) {
+      break;
     }
+    map->slots[i] = *nelem;
+    map->slots[i].dist -= 1;
+    i = next;
   }
-  return true;
+  memset(&(map->slots[i]), 0, sizeof(addr_elem));
+  map->size -= 1;
 }
 
-static size_t addr_list_num_elements(const addr_list_header *slh) {
-  size_t ret = 0;
-
-  if (slh) {
-    for (size_t i = 0; i < ADDR_ARRAY_SIZE; ++i) {
-      const addr_elem *elem = &(slh->main_list[i]);
-      if (elem->value) {
-        ++ret;
-      }
-    }
-
-    if (slh->extra_list) {
-      for (size_t i = 0; i < slh->extra_sz; ++i) {
-        addr_elem *elem = &(slh->extra_list[i]);
-        if (elem->value) {
-          ++ret;
-        }
-      }
+/* Iteration starts at a slot that cannot receive an entry shifted back from a
+ * later slot (empty, or holding an entry at its home position), so deleting
+ * the visited entry only moves not-yet-visited entries into its slot. */
+static size_t addr_map_iter_start(const ur_addr_map *map) {
+  for (size_t i = 0; i < map->capacity; ++i) {
+    if (!(map->slots[i].value) || !(map->slots[i].dist)) {
+      return i;
     }
   }
-
-  return ret;
-}
-
-static size_t addr_list_size(const addr_list_header *slh) {
-  if (slh) {
-    return ADDR_ARRAY_SIZE + slh->extra_sz;
-  }
-
   return 0;
 }
 
-static addr_elem *addr_list_get(addr_list_header *slh, const ioa_addr *key) {
-  if (!slh || !key) {
-    return NULL;
-  }
-
-  for (size_t i = 0; i < ADDR_ARRAY_SIZE; ++i) {
-    addr_elem *elem = &(slh->main_list[i]);
-    if (elem->value) {
-      if (addr_eq(&(elem->key), key)) {
-        return elem;
-      }
-    }
-  }
-
-  if (slh->extra_list) {
-    for (size_t i = 0; i < slh->extra_sz; ++i) {
-      addr_elem *elem = &(slh->extra_list[i]);
-      if (elem->value) {
-        if (addr_eq(&(elem->key), key)) {
-          return elem;
-        }
-      }
-    }
-  }
-
-  return NULL;
-}
-
-static const addr_elem *addr_list_get_const(const addr_list_header *slh, const ioa_addr *key) {
-  if (!slh || !key) {
-    return NULL;
-  }
-
-  for (size_t i = 0; i < ADDR_ARRAY_SIZE; ++i) {
-    const addr_elem *elem = &(slh->main_list[i]);
-    if (elem->value) {
-      if (addr_eq(&(elem->key), key)) {
-        return elem;
-      }
-    }
-  }
-
-  if (slh->extra_list) {
-    for (size_t i = 0; i < slh->extra_sz; ++i) {
-      const addr_elem *elem = &(slh->extra_list[i]);
-      if (elem->value) {
-        if (addr_eq(&(elem->key), key)) {
-          return elem;
-        }
-      }
-    }
-  }
-
-  return NULL;
+/* Visit the slot at *pos and say whether the iterator should move on. If the
+ * callback deleted the entry and another one shifted into its slot, that
+ * entry has not been visited yet, so the position is kept. */
+static bool addr_map_iter_advance(const ur_addr_map *map, size_t pos, size_t size_before, const ioa_addr *visited) {
+  const addr_elem *elem = &(map->slots[pos]);
+  return (map->size == size_before) || !(elem->value) || addr_eq(&(elem->key), visited);
 }
 
-////////// ADDR MAPS ////////////////////////////////////////////
-
-#define addr_map_index(key) (addr_hash((key)) & (ADDR_MAP_SIZE - 1))
-
-#define get_addr_list_header(map, key) (&((map)->lists[addr_map_index((key))]))
-
-#define ur_addr_map_valid(map) ((map) && ((map)->magic == MAGIC_HASH))
-
 void ur_addr_map_init(ur_addr_map *map) {
   if (map) {
     memset(map, 0, sizeof(ur_addr_map));
@@ -724,40 +605,50 @@ void ur_addr_map_init(ur_addr_map *map) {
 
 void ur_addr_map_clean(ur_addr_map *map) {
   if (map && ur_addr_map_valid(map)) {
-    for (size_t i = 0; i < ADDR_MAP_SIZE; i++) {
-      addr_list_free(&(map->lists[i]));
-    }
+    free(map->slots);
     memset(map, 0, sizeof(ur_addr_map));
   }
 }
 
 bool ur_addr_map_put(ur_addr_map *map, ioa_addr *key, ur_addr_map_value_type value) {
-  if (!ur_addr_map_valid(map)) {
+  if (!ur_addr_map_valid(map) || !key) {
     return false;
   }
 
-  else {
-
-    addr_list_header *slh = get_addr_list_header(map, key);
-
-    addr_elem *elem = addr_list_get(slh, key);
-    if (elem) {
+  const uint32_t hash = addr_map_hash(key);
+  addr_elem *elem = addr_map_find(map, key, hash);
+  if (elem) {
+    if (value) {
       elem->value = value;
     } else {
-      addr_list_add(slh, key, value);
+      addr_map_remove_at(map, elem);
     }
+    return true;
+  }
 
+  if (!value) {
     return true;
   }
+
+  if ((map->size + 1) * ADDR_MAP_MAX_LOAD_DEN > map->capacity * ADDR_MAP_MAX_LOAD_NUM) {
+    const size_t capacity = map->capacity ? map->capacity * 2 : ADDR_MAP_MIN_CAPACITY;
+    if (!addr_map_resize(map, capacity)) {
+      return false;
+    }
+  }
+
+  addr_map_insert_absent(map, key, hash, value);
+  map->size += 1;
+
+  return true;
 }
 
 bool ur_addr_map_get(const ur_addr_map *map, ioa_addr *key, ur_addr_map_value_type *value) {
-  if (!ur_addr_map_valid(map)) {
+  if (!ur_addr_map_valid(map) || !key) {
     return false;
   }
 
-  const addr_list_header *slh = get_addr_list_header(map, key);
-  const addr_elem *elem = addr_list_get_const(slh, key);
+  const addr_elem *elem = addr_map_find(map, key, addr_map_hash(key));
   if (elem) {
     if (value) {
       *value = elem->value;
@@ -768,46 +659,88 @@ bool ur_addr_map_get(const ur_addr_map *map, ioa_addr *key, ur_addr_map_value_ty
 }
 
 bool ur_addr_map_del(ur_addr_map *map, ioa_addr *key, ur_addr_map_func delfunc) {
-  if (!ur_addr_map_valid(map)) {
+  if (!ur_addr_map_valid(map) || !key) {
     return false;
   }
 
-  addr_list_header *slh = get_addr_list_header(map, key);
+  addr_elem *elem = addr_map_find(map, key, addr_map_hash(key));
+  if (!elem) {
+    return false;
+  }
 
-  int counter = 0;
-  addr_list_remove(slh, key, delfunc, &counter);
+  ur_addr_map_value_type value = elem->value;
+  addr_map_remove_at(map, elem);
+  if (delfunc) {
+    delfunc(value);
+  }
 
-  return (counter > 0);
+  return true;
 }
 
 void ur_addr_map_foreach(ur_addr_map *map, ur_addr_map_func func) {
-  if (ur_addr_map_valid(map)) {
-    for (size_t i = 0; i < ADDR_MAP_SIZE; i++) {
-      addr_list_header *slh = &(map->lists[i]);
-      addr_list_foreach(slh, func);
+  if (ur_addr_map_valid(map) && func && map->capacity) {
+    const size_t mask = map->capacity - 1;
+    size_t pos = addr_map_iter_start(map);
+    for (size_t n = 0; n < map->capacity;) {
+      addr_elem *elem = &(map->slots[pos]);
+      if (elem->value) {
+        const size_t size_before = map->size;
+        ioa_addr visited;
+        addr_cpy(&visited, &(elem->key));
+        func(elem->value);
+        if (!addr_map_iter_advance(map, pos, size_before, &visited)) {
+          continue;
+        }
+      }
+      pos = (pos + 1) & mask;
+      ++n;
     }
   }
 }
 
 bool ur_addr_map_foreach_arg(ur_addr_map *map, ur_addr_map_func_arg func, void *arg) {
-  if (ur_addr_map_valid(map)) {
-    for (size_t i = 0; i < ADDR_MAP_SIZE; i++) {
-      addr_list_header *slh = &(map->lists[i]);
-      if (!addr_list_foreach_arg(slh, func, arg)) {
-        return false;
+  if (ur_addr_map_valid(map) && func && map->capacity) {
+    const size_t mask = map->capacity - 1;
+    size_t pos = addr_map_iter_start(map);
+    for (size_t n = 0; n < map->capacity;) {
+      addr_elem *elem = &(map->slots[pos]);
+      if (elem->value) {
+        const size_t size_before = map->size;
+        ioa_addr visited;
+        addr_cpy(&visited, &(elem->key));
+        if (!func(elem->value, arg)) {
+          return false;
+        }
+        if (!addr_map_iter_advance(map, pos, size_before, &visited)) {
+          continue;
+        }
       }
+      pos = (pos + 1) & mask;
+      ++n;
     }
   }
   return true;
 }
 
 bool ur_addr_map_foreach_key_arg(ur_addr_map *map, ur_addr_map_key_func_arg func, void *arg) {
-  if (ur_addr_map_valid(map)) {
-    for (size_t i = 0; i < ADDR_MAP_SIZE; i++) {
-      addr_list_header *slh = &(map->lists[i]);
-      if (!addr_list_foreach_key_arg(slh, func, arg)) {
-        return false;
+  if (ur_addr_map_valid(map) && func && map->capacity) {
+    const size_t mask = map->capacity - 1;
+    size_t pos = addr_map_iter_start(map);
+    for (size_t n = 0; n < map->capacity;) {
+      addr_elem *elem = &(map->slots[pos]);
+      if (elem->value) {
+        const size_t size_before = map->size;
+        ioa_addr visited;
+        addr_cpy(&visited, &(elem->key));
+        if (!func(&visited, elem->value, arg)) {
+          return false;
+        }
+        if (!addr_map_iter_advance(map, pos, size_before, &visited)) {
+          continue;
+        }
       }
+      pos = (pos + 1) & mask;
+      ++n;
     }
   }
   return true;
@@ -817,28 +750,14 @@ size_t ur_addr_map_num_elements(const ur_addr_map *map) {
   if (!ur_addr_map_valid(map)) {
     return 0;
   }
-
-  size_t ret = 0;
-  for (size_t i = 0; i < ADDR_MAP_SIZE; i++) {
-    const addr_list_header *slh = &(map->lists[i]);
-    ret += addr_list_num_elements(slh);
-  }
-
-  return ret;
+  return map->size;
 }
 
 size_t ur_addr_map_size(const ur_addr_map *map) {
   if (!ur_addr_map_valid(map)) {
     return 0;
   }
-
-  size_t ret = 0;
-  for (size_t i = 0; i < ADDR_MAP_SIZE; i++) {
-    const addr_list_header *slh = &(map->lists[i]);
-    ret += addr_list_size(slh);
-  }
-
-  return ret;
+  return map->capacity;
 }
 
 ////////////////////  STRING LISTS ///////////////////////////////////
@@ -178,22 +178,29 @@ bool lm_map_foreach_arg(lm_map *map, foreachcb_arg_type func, void *arg);
 
 typedef void *ur_addr_map_value_type;
 
-#define ADDR_MAP_SIZE (1024)
-#define ADDR_ARRAY_SIZE (4)
+/*
+ * Open-addressing hash map keyed by the full address (IP and port), using
+ * Robin Hood linear probing with backward-shift deletion. The table starts
+ * empty, is allocated on first insert and doubles whenever the load factor
+ * would exceed ADDR_MAP_MAX_LOAD_NUM / ADDR_MAP_MAX_LOAD_DEN, so lookups stay
+ * O(1) on average however many client 5-tuples a listener holds. A NULL
+ * value marks an empty slot.
+ */
+#define ADDR_MAP_MIN_CAPACITY (16)
+#define ADDR_MAP_MAX_LOAD_NUM (7)
+#define ADDR_MAP_MAX_LOAD_DEN (8)
 
 typedef struct _addr_elem {
   ioa_addr key;
   ur_addr_map_value_type value;
+  uint32_t hash;
+  uint32_t dist; /* probe distance from the home slot */
 } addr_elem;
 
-typedef struct _addr_list_header {
-  addr_elem main_list[ADDR_ARRAY_SIZE];
-  addr_elem *extra_list;
-  size_t extra_sz;
-} addr_list_header;
-
 struct _ur_addr_map {
-  addr_list_header lists[ADDR_MAP_SIZE];
+  addr_elem *slots;
+  size_t capacity; /* power of two, or 0 before the first insert */
+  size_t size;
   uint64_t magic;
 };
 
@@ -230,11 +237,14 @@ bool ur_addr_map_get(const ur_addr_map *map, ioa_addr *key, ur_addr_map_value_ty
  */
 bool ur_addr_map_del(ur_addr_map *map, ioa_addr *key, ur_addr_map_func func);
 
+/* The foreach callbacks may delete the element being visited, but must not
+ * otherwise modify the map. */
 void ur_addr_map_foreach(ur_addr_map *map, ur_addr_map_func func);
 bool ur_addr_map_foreach_arg(ur_addr_map *map, ur_addr_map_func_arg func, void *arg);
 bool ur_addr_map_foreach_key_arg(ur_addr_map *map, ur_addr_map_key_func_arg func, void *arg);
 
 size_t ur_addr_map_num_elements(const ur_addr_map *map);
+/* Number of slots currently allocated. */
 size_t ur_addr_map_size(const ur_addr_map *map);
 
 //////////////// UR STRING MAP //////////////////
@@ -40,11 +40,13 @@
 #include "ns_turn_maps.h"
 #include "ns_turn_msg_defs.h" // for STUN_ATTRIBUTE_NONCE
 #include "ns_turn_ratelimit.h"
+#include "ns_turn_timer_wheel.h"
 #include "ns_turn_utils.h"
 
 #include "apputils.h" // for turn_random, base64_decode
 
 #include <stdbool.h> // for bool, false
+#include <stddef.h>  // for offsetof
 #include <stdio.h>   // for snprintf
 #include <stdlib.h>  // for free, malloc, calloc, realloc
 #include <string.h>  // for memcpy, strlen, strcmp
@@ -91,10 +93,14 @@ const char *get_version(turn_turnserver *server) {
 
 static void maybe_add_software_attribute(turn_turnserver *server, ioa_network_buffer_handle nbh) {
   if (server->software_attribute) {
-    const char *software = get_version(server);
-    size_t fsz = strlen(get_version(server));
     size_t len = ioa_network_buffer_get_size(nbh);
-    stun_attr_add_str(ioa_network_buffer_data(nbh), &len, STUN_ATTRIBUTE_SOFTWARE, (const uint8_t *)software, fsz);
+    if (server->software_attr.len) {
+      stun_attr_image_add_str(&(server->software_attr), ioa_network_buffer_data(nbh), &len);
+    } else {
+      const char *software = get_version(server);
+      stun_attr_add_str(ioa_network_buffer_data(nbh), &len, STUN_ATTRIBUTE_SOFTWARE, (const uint8_t *)software,
+                        strlen(software));
+    }
     ioa_network_buffer_set_size(nbh, len);
   }
 }
@@ -148,8 +154,8 @@ static void client_to_be_allocated_timeout_handler(ioa_engine_handle e, void *ar
 
 static int check_stun_auth(turn_turnserver *server, ts_ur_super_session *ss, stun_tid *tid, int *resp_constructed,
                            int *err_code, const uint8_t **reason, ioa_net_data *in_buffer,
-                           ioa_network_buffer_handle nbh, uint16_t method, int *message_integrity, int *postpone_reply,
-                           int can_resume);
+                           const stun_attr_index *attrs, ioa_network_buffer_handle nbh, uint16_t method,
+                           int *message_integrity, int *postpone_reply, int can_resume);
 
 static int create_relay_connection(turn_turnserver *server, ts_ur_super_session *ss, uint32_t lifetime,
                                    int address_family, uint8_t transport, int even_port, uint64_t in_reservation_token,
@@ -172,14 +178,24 @@ static int need_stun_authentication(turn_turnserver *server, ts_ur_super_session
 
 /////////////////// timer //////////////////////////
 
-static void turn_server_sweep_timed_events(turn_turnserver *server);
+static void turn_server_expire_timed_events(turn_turnserver *server);
+
+/* Publishes the relayed byte rate of the last second, smoothed over a few
+ * seconds so one burst does not steer every new client away. */
+static void turn_server_sample_load(turn_turnserver *server) {
+  const uint64_t sample = server->relayed_bytes - server->relayed_bytes_sampled;
+  server->relayed_bytes_sampled = server->relayed_bytes;
+  const uint64_t bps = ((uint64_t)turn_atomic_load_u32(&(server->load_bps)) * 3 + sample) / 4;
+  turn_atomic_store_u32(&(server->load_bps), (bps > UINT32_MAX) ? UINT32_MAX : (uint32_t)bps);
+}
 
 static void timer_timeout_handler(ioa_engine_handle e, void *arg) {
   UNUSED_ARG(e);
   if (arg) {
     turn_turnserver *server = (turn_turnserver *)arg;
     server->ctime = turn_time();
-    turn_server_sweep_timed_events(server);
+    turn_server_expire_timed_events(server);
+    turn_server_sample_load(server);
   }
 }
 
@@ -332,22 +348,8 @@ static int good_peer_addr(turn_turnserver *server, const char *realm, ioa_addr *
       }
     }
 
-    {
-      ioa_lock_whitelist(server->e);
-
-      const ip_range_list_t *wl = ioa_get_whitelist(server->e);
-      if (wl) {
-        // White listing of addr ranges
-        for (int i = wl->ranges_number - 1; i >= 0; --i) {
-          CHECK_REALM(wl->rs[i].realm);
-          if (ioa_addr_in_range(&(wl->rs[i].enc), peer_addr)) {
-            ioa_unlock_whitelist(server->e);
-            return 1;
-          }
-        }
-      }
-
-      ioa_unlock_whitelist(server->e);
+    if (ioa_match_whitelist(server->e, realm, peer_addr)) {
+      return 1;
     }
 
     if (server->ip_blacklist) {
@@ -365,25 +367,14 @@ static int good_peer_addr(turn_turnserver *server, const char *realm, ioa_addr *
     }
 
     {
-      ioa_lock_blacklist(server->e);
-
-      const ip_range_list_t *bl = ioa_get_blacklist(server->e);
-      if (bl) {
-        // Black listing of addr ranges
-        for (int i = bl->ranges_number - 1; i >= 0; --i) {
-          CHECK_REALM(bl->rs[i].realm);
-          if (ioa_addr_in_range(&(bl->rs[i].enc), peer_addr)) {
-            ioa_unlock_blacklist(server->e);
-            char saddr[MAX_IOA_ADDR_STRING] = "";
-            addr_to_string_no_port(peer_addr, saddr);
-            TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "session %018llu: A peer IP %s denied in the range= %s in server %d \n",
-                          (unsigned long long)session_id, saddr, bl->rs[i].str, server_id);
-            return 0;
-          }
-        }
+      const ip_range_t *r = ioa_match_blacklist(server->e, realm, peer_addr);
+      if (r) {
+        char saddr[MAX_IOA_ADDR_STRING] = "";
+        addr_to_string_no_port(peer_addr, saddr);
+        TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "session %018llu: A peer IP %s denied in the range= %s in server %d \n",
+                      (unsigned long long)session_id, saddr, r->str, server_id);
+        return 0;
       }
-
-      ioa_unlock_blacklist(server->e);
     }
   }
 
@@ -559,6 +550,7 @@ int turn_session_info_copy_from(struct turn_session_info *tsi, ts_ur_super_sessi
       tsi->enforce_fingerprints = ss->enforce_fingerprints;
       STRCPY(tsi->tls_method, get_ioa_socket_tls_method(ss->client_socket));
       STRCPY(tsi->tls_cipher, get_ioa_socket_tls_cipher(ss->client_socket));
+      STRCPY(tsi->tls_offload, get_ioa_socket_tls_offload(ss->client_socket));
       STRCPY(tsi->realm, ss->realm_options.name);
       STRCPY(tsi->origin, ss->origin);
 
@@ -804,6 +796,7 @@ static void put_session_into_map(ts_ur_super_session *ss) {
       ss->start_time = server->ctime;
     }
     ur_map_put(server->sessions_map, (ur_map_key_type)(ss->id), (ur_map_value_type)ss);
+    turn_atomic_store_u32(&(server->load_sessions), (uint32_t)ur_map_size(server->sessions_map));
     put_session_into_mobile_map(ss);
   }
 }
@@ -823,6 +816,7 @@ static void delete_session_from_map(ts_ur_super_session *ss) {
   if (ss && ss->server) {
     turn_turnserver *server = (turn_turnserver *)(ss->server);
     ur_map_del(server->sessions_map, (ur_map_key_type)(ss->id), NULL);
+    turn_atomic_store_u32(&(server->load_sessions), (uint32_t)ur_map_size(server->sessions_map));
     delete_session_from_mobile_map(ss);
   }
 }
@@ -878,6 +872,8 @@ static void delete_ur_map_ss(void *p, SOCKET_TYPE socket_type) {
     IOA_CLOSE_SOCKET(ss->client_socket);
     clear_allocation(get_allocation_ss(ss), socket_type);
     IOA_EVENT_DEL(ss->to_be_allocated_timeout_ev);
+    turn_timer_wheel_cancel(&(ss->mobile_transition_expiry));
+    stun_hmac_ctx_clean(&(ss->hmac_ctx));
     free(p);
   }
 }
@@ -950,6 +946,12 @@ static void client_ss_perm_timeout_handler(ioa_engine_handle e, void *arg) {
 
 ///////////////////////////////////////////////////////////////////
 
+/* Permissions and channels are reaped once expiration_time is strictly in the
+ * past, i.e. on the first tick after it. */
+static inline void schedule_expiry(turn_timer_wheel *w, turn_timer_wheel_entry *entry, turn_time_t expiration_time) {
+  turn_timer_wheel_schedule(w, entry, expiration_time + 1);
+}
+
 static int update_turn_permission_lifetime(ts_ur_super_session *ss, turn_permission_info *tinfo,
                                            turn_time_t time_delta) {
 
@@ -963,9 +965,7 @@ static int update_turn_permission_lifetime(ts_ur_super_session *ss, turn_permiss
         time_delta = *(server->permission_lifetime);
       }
       tinfo->expiration_time = server->ctime + time_delta;
-
-      /* Expiry is reaped lazily by the per-thread sweep in timer_timeout_handler();
-       * touching the permission only needs to push its expiration_time forward. */
+      schedule_expiry(&(server->permission_expiry_wheel), &(tinfo->expiry), tinfo->expiration_time);
 
       if (server->verbose) {
         tinfo->verbose = true;
@@ -999,9 +999,7 @@ static int update_channel_lifetime(ts_ur_super_session *ss, ch_info *chn) {
         }
 
         chn->expiration_time = server->ctime + *(server->channel_lifetime);
-
-        /* Channel expiry is reaped lazily by the per-thread sweep in
-         * timer_timeout_handler(); just push its expiration_time forward. */
+        schedule_expiry(&(server->channel_expiry_wheel), &(chn->expiry), chn->expiration_time);
 
         return 0;
       }
@@ -1010,83 +1008,61 @@ static int update_channel_lifetime(ts_ur_super_session *ss, ch_info *chn) {
   return -1;
 }
 
-//////////////// lazy expiry sweep ////////////////////////
+//////////////// expiry wheels ////////////////////////
 
-/* Reap expired permissions and channels for a single allocation. This replaces
- * the former per-permission / per-channel libevent timers: update_*_lifetime()
- * only pushes expiration_time forward, and this sweep (driven once per second by
- * the per-thread timer_timeout_handler) tears down whatever has fallen past its
- * deadline. At high allocation counts this trades ~1M libevent min-heap nodes and
- * two heap ops per refresh for a bounded per-thread array walk. */
-static void sweep_allocation_timed_events(turn_turnserver *server, allocation *a) {
-  if (!a || !is_allocation_valid(a)) {
-    return;
-  }
+/* Permissions, channels and mobility transitions are expired through the
+ * per-thread timing wheels in turn_turnserver instead of one libevent timer
+ * each, or a walk over every session: update_*_lifetime() re-files the entry
+ * in O(1), and each 1-second tick of timer_timeout_handler only touches the
+ * entries that actually fall due. */
 
-  const turn_time_t ctime = server->ctime;
+#define EXPIRY_WHEEL_OWNER(entry, type, member) ((type *)((char *)(entry) - offsetof(type, member)))
 
-  /* Permissions first: cleaning a permission also tears down its channels, so
-   * channels of an expired permission are already gone by the channel pass. */
-  turn_permission_hashtable *pmap = allocation_get_turn_permission_hashtable(a);
-  for (size_t i = 0; i < TURN_PERMISSION_HASHTABLE_SIZE; ++i) {
-    turn_permission_array *parray = &(pmap->table[i]);
-    for (size_t j = 0; j < TURN_PERMISSION_ARRAY_SIZE; ++j) {
-      turn_permission_info *tinfo = &(parray->main_slots[j].info);
-      if (tinfo->allocated && turn_time_before(tinfo->expiration_time, ctime)) {
-        client_ss_perm_timeout_handler(server->e, tinfo);
-      }
-    }
-    if (parray->extra_slots) {
-      for (size_t j = 0; j < parray->extra_sz; ++j) {
-        turn_permission_slot *slot = parray->extra_slots[j];
-        if (slot && slot->info.allocated && turn_time_before(slot->info.expiration_time, ctime)) {
-          client_ss_perm_timeout_handler(server->e, &(slot->info));
-        }
-      }
-    }
+static void permission_expiry_cb(turn_timer_wheel_entry *entry, void *arg) {
+  turn_turnserver *server = (turn_turnserver *)arg;
+  turn_permission_info *tinfo = EXPIRY_WHEEL_OWNER(entry, turn_permission_info, expiry);
+  if (!tinfo->allocated) {
+    return;
+  }
+  /* The wheel only indexes expiration_time; the field is what decides. */
+  if (!turn_time_before(tinfo->expiration_time, server->ctime)) {
+    schedule_expiry(&(server->permission_expiry_wheel), entry, tinfo->expiration_time);
+    return;
   }
+  /* Cleaning a permission also tears down (and disarms) its channels. */
+  client_ss_perm_timeout_handler(server->e, tinfo);
+}
 
-  /* Channels whose owning permission is still alive but whose own deadline passed. */
-  ch_map *cmap = &(a->chns);
-  for (size_t i = 0; i < CH_MAP_HASH_SIZE; ++i) {
-    ch_map_array *carray = &(cmap->table[i]);
-    for (size_t j = 0; j < CH_MAP_ARRAY_SIZE; ++j) {
-      ch_info *chn = &(carray->main_chns[j]);
-      if (chn->allocated && turn_time_before(chn->expiration_time, ctime)) {
-        client_ss_channel_timeout_handler(server->e, chn);
-      }
-    }
-    if (carray->extra_chns) {
-      for (size_t j = 0; j < carray->extra_sz; ++j) {
-        ch_info *chn = carray->extra_chns[j];
-        if (chn && chn->allocated && turn_time_before(chn->expiration_time, ctime)) {
-          client_ss_channel_timeout_handler(server->e, chn);
-        }
-      }
-    }
+static void channel_expiry_cb(turn_timer_wheel_entry *entry, void *arg) {
+  turn_turnserver *server = (turn_turnserver *)arg;
+  ch_info *chn = EXPIRY_WHEEL_OWNER(entry, ch_info, expiry);
+  if (!chn->allocated) {
+    return;
   }
+  if (!turn_time_before(chn->expiration_time, server->ctime)) {
+    schedule_expiry(&(server->channel_expiry_wheel), entry, chn->expiration_time);
+    return;
+  }
+  client_ss_channel_timeout_handler(server->e, chn);
 }
 
-static bool sweep_session_cb(ur_map_key_type key, ur_map_value_type value, void *arg) {
-  UNUSED_ARG(key);
-  if (value) {
-    ts_ur_super_session *ss = (ts_ur_super_session *)value;
-    turn_turnserver *server = (turn_turnserver *)arg;
-    /* RFC 8016: if a mobility handoff has been open past its deadline without the
-     * client sending on the new path, abandon it — keep the allocation on the
-     * old path and reap the pending session. Only marks sessions to_be_closed /
-     * clears links, so it is safe during map iteration. */
-    if (ss->mobile_pending_resume && !turn_time_before(server->ctime, ss->mobile_transition_deadline)) {
-      mobile_abort_transition(server, ss);
-    }
-    sweep_allocation_timed_events(server, get_allocation_ss(ss));
+static void mobile_transition_expiry_cb(turn_timer_wheel_entry *entry, void *arg) {
+  turn_turnserver *server = (turn_turnserver *)arg;
+  ts_ur_super_session *ss = EXPIRY_WHEEL_OWNER(entry, ts_ur_super_session, mobile_transition_expiry);
+  /* RFC 8016: if a mobility handoff has been open past its deadline without the
+   * client sending on the new path, abandon it — keep the allocation on the
+   * old path and reap the pending session. The entry is left armed when a
+   * transition completes or is superseded, so re-check that it is still open. */
+  if (ss->mobile_pending_resume && !turn_time_before(server->ctime, ss->mobile_transition_deadline)) {
+    mobile_abort_transition(server, ss);
   }
-  return false; /* keep iterating all sessions */
 }
 
-static void turn_server_sweep_timed_events(turn_turnserver *server) {
-  if (server && server->sessions_map) {
-    ur_map_foreach_arg(server->sessions_map, sweep_session_cb, server);
+static void turn_server_expire_timed_events(turn_turnserver *server) {
+  if (server) {
+    turn_timer_wheel_advance(&(server->permission_expiry_wheel), server->ctime, permission_expiry_cb, server);
+    turn_timer_wheel_advance(&(server->channel_expiry_wheel), server->ctime, channel_expiry_cb, server);
+    turn_timer_wheel_advance(&(server->mobile_transition_wheel), server->ctime, mobile_transition_expiry_cb, server);
   }
 }
 
@@ -1689,9 +1665,9 @@ static void mobile_begin_transition(turn_turnserver *server, ts_ur_super_session
    * Otherwise chained resumes from fresh 5-tuples would overwrite the single
    * backlink below and orphan every superseded pending session: each has had its
    * un-allocated watchdog disarmed and, once orig_ss->mobile_pending_resume no
-   * longer names it, is unreachable by the transition-deadline sweep, so it
+   * longer names it, is unreachable by the transition-deadline expiry, so it
    * stays allocated indefinitely. This runs in REFRESH packet context (not the
-   * session-map sweep), so a synchronous shutdown is safe; it also clears
+   * expiry-wheel callback), so a synchronous shutdown is safe; it also clears
    * orig_ss->mobile_pending_resume via shutdown's transition-unlink path. */
   if (orig_ss->mobile_pending_resume) {
     ts_ur_super_session *stale_ss = get_session_from_map(server, orig_ss->mobile_pending_resume);
@@ -1710,6 +1686,8 @@ static void mobile_begin_transition(turn_turnserver *server, ts_ur_super_session
 
   orig_ss->mobile_pending_resume = pending_ss->id;
   orig_ss->mobile_transition_deadline = server->ctime + MOBILITY_TRANSITION_TIMEOUT;
+  turn_timer_wheel_schedule(&(server->mobile_transition_wheel), &(orig_ss->mobile_transition_expiry),
+                            orig_ss->mobile_transition_deadline);
   pending_ss->mobile_resume_target = orig_ss->id;
 
   if (server->verbose) {
@@ -1785,7 +1763,7 @@ static void mobile_abort_transition(turn_turnserver *server, ts_ur_super_session
      * path), and to_be_closed is only observed when a packet next arrives on the
      * session's socket. The pending's un-allocated watchdog was disarmed when the
      * transition opened, so re-arm it to reap the session from timer context. This
-     * only schedules a timer, so it is safe during the map-iterating sweep (the
+     * only schedules a timer, so it is safe from the expiry-wheel callback (the
      * shutdown happens later, from the timer handler, not here). */
     IOA_EVENT_DEL(pending_ss->to_be_allocated_timeout_ev);
     pending_ss->to_be_allocated_timeout_ev =
@@ -1795,8 +1773,8 @@ static void mobile_abort_transition(turn_turnserver *server, ts_ur_super_session
 
 static int handle_turn_refresh(turn_turnserver *server, ts_ur_super_session *ss, stun_tid *tid, int *resp_constructed,
                                int *err_code, const uint8_t **reason, uint16_t *unknown_attrs, uint16_t *ua_num,
-                               ioa_net_data *in_buffer, ioa_network_buffer_handle nbh, int message_integrity,
-                               int *no_response, int can_resume) {
+                               ioa_net_data *in_buffer, const stun_attr_index *attrs, ioa_network_buffer_handle nbh,
+                               int message_integrity, int *no_response, int can_resume) {
 
   allocation *a = get_allocation_ss(ss);
   int af4c = 0;
@@ -1992,7 +1970,7 @@ static int handle_turn_refresh(turn_turnserver *server, ts_ur_super_session *ss,
             // legitimate resumes under --user-quota / --total-quota.
             copy_auth_parameters(orig_ss, ss, false);
 
-            if (check_stun_auth(server, ss, tid, resp_constructed, err_code, reason, in_buffer, nbh,
+            if (check_stun_auth(server, ss, tid, resp_constructed, err_code, reason, in_buffer, attrs, nbh,
                                 STUN_METHOD_REFRESH, &message_integrity, &postpone_reply, can_resume) < 0) {
               if (!(*err_code)) {
                 *err_code = 401;
@@ -2036,7 +2014,7 @@ static int handle_turn_refresh(turn_turnserver *server, ts_ur_super_session *ss,
                 // allocation is promoted onto this new socket on the client's
                 // first Send/ChannelData on the new path (see read_client_connection),
                 // or abandoned back to the old path after a bounded deadline (see
-                // the per-session sweep).
+                // mobile_transition_expiry_cb).
 
                 // Rotate the mobility ticket (the new ticket MUST differ from the
                 // old) and re-key orig_ss in the mobile map under the new id.
@@ -2055,10 +2033,7 @@ static int handle_turn_refresh(turn_turnserver *server, ts_ur_super_session *ss,
                 nbh = ioa_network_buffer_allocate(server->e);
                 size_t len = ioa_network_buffer_get_size(nbh);
 
-                stun_init_success_response_str(STUN_METHOD_REFRESH, ioa_network_buffer_data(nbh), &len, tid);
-                uint32_t lt = nswap32(lifetime);
-
-                stun_attr_add_str(ioa_network_buffer_data(nbh), &len, STUN_ATTRIBUTE_LIFETIME, (const uint8_t *)&lt, 4);
+                stun_resp_template_emit_str(&(server->refresh_resp), ioa_network_buffer_data(nbh), &len, tid, lifetime);
                 ioa_network_buffer_set_size(nbh, len);
 
                 stun_attr_add_str(ioa_network_buffer_data(nbh), &len, STUN_ATTRIBUTE_MOBILITY_TICKET,
@@ -2069,8 +2044,8 @@ static int handle_turn_refresh(turn_turnserver *server, ts_ur_super_session *ss,
 
                 if (message_integrity) {
                   size_t ilen = ioa_network_buffer_get_size(nbh);
-                  stun_attr_add_integrity_str(server->ct, ioa_network_buffer_data(nbh), &ilen, ss->hmackey, ss->pwd,
-                                              SHATYPE_DEFAULT);
+                  stun_attr_add_integrity_ctx_str(&(ss->hmac_ctx), server->ct, ioa_network_buffer_data(nbh), &ilen,
+                                                  ss->hmackey, ss->pwd, SHATYPE_DEFAULT);
                   ioa_network_buffer_set_size(nbh, ilen);
                 }
 
@@ -2130,17 +2105,13 @@ static int handle_turn_refresh(turn_turnserver *server, ts_ur_super_session *ss,
         turn_report_allocation_set(&(ss->alloc), lifetime, 1);
 
         size_t len = ioa_network_buffer_get_size(nbh);
-        stun_init_success_response_str(STUN_METHOD_REFRESH, ioa_network_buffer_data(nbh), &len, tid);
+        stun_resp_template_emit_str(&(server->refresh_resp), ioa_network_buffer_data(nbh), &len, tid, lifetime);
 
         if (ss->s_mobile_id[0]) {
           stun_attr_add_str(ioa_network_buffer_data(nbh), &len, STUN_ATTRIBUTE_MOBILITY_TICKET,
                             (uint8_t *)ss->s_mobile_id, strlen(ss->s_mobile_id));
-          ioa_network_buffer_set_size(nbh, len);
         }
 
-        uint32_t lt = nswap32(lifetime);
-        stun_attr_add_str(ioa_network_buffer_data(nbh), &len, STUN_ATTRIBUTE_LIFETIME, (const uint8_t *)&lt, 4);
-
         ioa_network_buffer_set_size(nbh, len);
 
         *resp_constructed = 1;
@@ -2287,6 +2258,30 @@ static void tcp_client_input_handler_rfc6062data(ioa_socket_handle s, int event_
   }
 }
 
+static void tcp_spliced_data_handler(ioa_socket_handle s, size_t bytes, void *arg) {
+  tcp_connection *tc = (tcp_connection *)arg;
+  allocation *a = (allocation *)tc->owner;
+  if (!a || !(a->owner)) {
+    return;
+  }
+
+  ts_ur_super_session *ss = (ts_ur_super_session *)a->owner;
+  const uint32_t n = (uint32_t)bytes;
+  if (s == tc->client_s) {
+    ++(ss->received_packets);
+    ss->received_bytes += n;
+    ++(ss->peer_sent_packets);
+    ss->peer_sent_bytes += n;
+  } else {
+    ++(ss->peer_received_packets);
+    ss->peer_received_bytes += n;
+    ++(ss->sent_packets);
+    ss->sent_bytes += n;
+  }
+
+  turn_report_session_usage(ss, 0);
+}
+
 static void tcp_conn_bind_timeout_handler(ioa_engine_handle e, void *arg) {
   UNUSED_ARG(e);
   if (arg) {
@@ -2348,8 +2343,8 @@ static void tcp_peer_connection_completed_callback(int success, void *arg) {
     ioa_network_buffer_set_size(nbh, len);
 
     if (need_stun_authentication(server, ss)) {
-      stun_attr_add_integrity_str(server->ct, ioa_network_buffer_data(nbh), &len, ss->hmackey, ss->pwd,
-                                  SHATYPE_DEFAULT);
+      stun_attr_add_integrity_ctx_str(&(ss->hmac_ctx), server->ct, ioa_network_buffer_data(nbh), &len, ss->hmackey,
+                                      ss->pwd, SHATYPE_DEFAULT);
       ioa_network_buffer_set_size(nbh, len);
     }
 
@@ -2775,7 +2770,10 @@ int turnserver_accept_tcp_client_data_connection(turn_turnserver *server, tcp_co
         } else {
           // Check security:
           int postpone_reply = 0;
-          check_stun_auth(server, ss, tid, &resp_constructed, &err_code, &reason, in_buffer, nbh,
+          stun_attr_index attrs;
+          stun_attr_index_build(ioa_network_buffer_data(in_buffer->nbh), ioa_network_buffer_get_size(in_buffer->nbh),
+                                &attrs);
+          check_stun_auth(server, ss, tid, &resp_constructed, &err_code, &reason, in_buffer, &attrs, nbh,
                           STUN_METHOD_CONNECTION_BIND, &message_integrity, &postpone_reply, can_resume);
 
           if (postpone_reply) {
@@ -2823,8 +2821,8 @@ int turnserver_accept_tcp_client_data_connection(turn_turnserver *server, tcp_co
 
     if (message_integrity && ss) {
       size_t len = ioa_network_buffer_get_size(nbh);
-      stun_attr_add_integrity_str(server->ct, ioa_network_buffer_data(nbh), &len, ss->hmackey, ss->pwd,
-                                  SHATYPE_DEFAULT);
+      stun_attr_add_integrity_ctx_str(&(ss->hmac_ctx), server->ct, ioa_network_buffer_data(nbh), &len, ss->hmackey,
+                                      ss->pwd, SHATYPE_DEFAULT);
       ioa_network_buffer_set_size(nbh, len);
     }
 
@@ -2841,6 +2839,9 @@ int turnserver_accept_tcp_client_data_connection(turn_turnserver *server, tcp_co
     if (ss && !err_code) {
       send_data_from_ioa_socket_nbh(s, NULL, nbh, TTL_IGNORE, TOS_IGNORE, NULL);
       tcp_deliver_delayed_buffer(&(tc->ub_to_client), s, ss);
+      if (tc->peer_s && !ioa_socket_tobeclosed(s)) {
+        splice_ioa_sockets(s, tc->peer_s, tcp_spliced_data_handler, tc);
+      }
       IOA_CLOSE_SOCKET(s_to_delete);
       FUNCEND;
       return 0;
@@ -3013,8 +3014,7 @@ static int handle_turn_channel_bind(turn_turnserver *server, ts_ur_super_session
           ;
         } else {
           size_t len = ioa_network_buffer_get_size(nbh);
-          stun_set_channel_bind_response_str(ioa_network_buffer_data(nbh), &len, tid, 0, NULL,
-                                             server->include_reason_string);
+          stun_resp_template_emit_str(&(server->channel_bind_resp), ioa_network_buffer_data(nbh), &len, tid, 0);
           ioa_network_buffer_set_size(nbh, len);
           *resp_constructed = 1;
 
@@ -3478,7 +3478,7 @@ static int handle_turn_create_permission(turn_turnserver *server, ts_ur_super_se
 
       if (*err_code == 0) {
         size_t len = ioa_network_buffer_get_size(nbh);
-        stun_init_success_response_str(STUN_METHOD_CREATE_PERMISSION, ioa_network_buffer_data(nbh), &len, tid);
+        stun_resp_template_emit_str(&(server->permission_resp), ioa_network_buffer_data(nbh), &len, tid, 0);
         ioa_network_buffer_set_size(nbh, len);
 
         ret = 0;
@@ -3597,8 +3597,8 @@ static void resume_processing_after_username_check(int success, int oauth, int m
 
 static int check_stun_auth(turn_turnserver *server, ts_ur_super_session *ss, stun_tid *tid, int *resp_constructed,
                            int *err_code, const uint8_t **reason, ioa_net_data *in_buffer,
-                           ioa_network_buffer_handle nbh, uint16_t method, int *message_integrity, int *postpone_reply,
-                           int can_resume) {
+                           const stun_attr_index *attrs, ioa_network_buffer_handle nbh, uint16_t method,
+                           int *message_integrity, int *postpone_reply, int can_resume) {
   uint8_t usname[STUN_MAX_USERNAME_SIZE + 1];
   uint8_t nonce[STUN_MAX_NONCE_SIZE + 1];
   uint8_t realm[STUN_MAX_REALM_SIZE + 1];
@@ -3644,9 +3644,9 @@ static int check_stun_auth(turn_turnserver *server, ts_ur_super_session *ss, stu
 
   /* MESSAGE_INTEGRITY ATTR: */
 
-  stun_attr_ref sar =
-      stun_attr_get_first_by_type_str(ioa_network_buffer_data(in_buffer->nbh),
-                                      ioa_network_buffer_get_size(in_buffer->nbh), STUN_ATTRIBUTE_MESSAGE_INTEGRITY);
+  stun_attr_ref sar = stun_attr_index_first(attrs, ioa_network_buffer_data(in_buffer->nbh),
+                                            ioa_network_buffer_get_size(in_buffer->nbh),
+                                            STUN_ATTRIBUTE_MESSAGE_INTEGRITY);
 
   if (!sar) {
     *err_code = 401;
@@ -3672,8 +3672,8 @@ static int check_stun_auth(turn_turnserver *server, ts_ur_super_session *ss, stu
 
     /* REALM ATTR: */
 
-    sar = stun_attr_get_first_by_type_str(ioa_network_buffer_data(in_buffer->nbh),
-                                          ioa_network_buffer_get_size(in_buffer->nbh), STUN_ATTRIBUTE_REALM);
+    sar = stun_attr_index_first(attrs, ioa_network_buffer_data(in_buffer->nbh),
+                                ioa_network_buffer_get_size(in_buffer->nbh), STUN_ATTRIBUTE_REALM);
 
     if (!sar) {
       *err_code = 400;
@@ -3719,8 +3719,8 @@ static int check_stun_auth(turn_turnserver *server, ts_ur_super_session *ss, stu
 
   /* USERNAME ATTR: */
 
-  sar = stun_attr_get_first_by_type_str(ioa_network_buffer_data(in_buffer->nbh),
-                                        ioa_network_buffer_get_size(in_buffer->nbh), STUN_ATTRIBUTE_USERNAME);
+  sar = stun_attr_index_first(attrs, ioa_network_buffer_data(in_buffer->nbh),
+                              ioa_network_buffer_get_size(in_buffer->nbh), STUN_ATTRIBUTE_USERNAME);
 
   if (!sar) {
     *err_code = 400;
@@ -3764,8 +3764,8 @@ static int check_stun_auth(turn_turnserver *server, ts_ur_super_session *ss, stu
   {
     /* NONCE ATTR: */
 
-    sar = stun_attr_get_first_by_type_str(ioa_network_buffer_data(in_buffer->nbh),
-                                          ioa_network_buffer_get_size(in_buffer->nbh), STUN_ATTRIBUTE_NONCE);
+    sar = stun_attr_index_first(attrs, ioa_network_buffer_data(in_buffer->nbh),
+                                ioa_network_buffer_get_size(in_buffer->nbh), STUN_ATTRIBUTE_NONCE);
 
     if (!sar) {
       *err_code = 400;
@@ -3841,9 +3841,9 @@ static int check_stun_auth(turn_turnserver *server, ts_ur_super_session *ss, stu
   }
 
   /* Check integrity */
-  if (stun_check_message_integrity_by_key_str(server->ct, ioa_network_buffer_data(in_buffer->nbh),
-                                              ioa_network_buffer_get_size(in_buffer->nbh), ss->hmackey, ss->pwd,
-                                              SHATYPE_DEFAULT) < 1) {
+  if (stun_check_message_integrity_ctx_str(&(ss->hmac_ctx), server->ct, ioa_network_buffer_data(in_buffer->nbh),
+                                           ioa_network_buffer_get_size(in_buffer->nbh), attrs, ss->hmackey, ss->pwd,
+                                           SHATYPE_DEFAULT) < 1) {
 
     if (can_resume) {
       (server->userkeycb)(server->id, server->ct, server->oauth, &(ss->oauth), usname, realm,
@@ -3927,6 +3927,10 @@ static int handle_turn_command(turn_turnserver *server, ts_ur_super_session *ss,
 
   stun_tid_from_message_str(ioa_network_buffer_data(in_buffer->nbh), ioa_network_buffer_get_size(in_buffer->nbh), &tid);
 
+  /* One walk over the attributes; the auth checks below look them up in it. */
+  stun_attr_index attrs;
+  stun_attr_index_build(ioa_network_buffer_data(in_buffer->nbh), ioa_network_buffer_get_size(in_buffer->nbh), &attrs);
+
   if (stun_is_request_str(ioa_network_buffer_data(in_buffer->nbh), ioa_network_buffer_get_size(in_buffer->nbh))) {
 
     if ((method == STUN_METHOD_BINDING) && (*(server->no_stun))) {
@@ -3993,7 +3997,8 @@ static int handle_turn_command(turn_turnserver *server, ts_ur_super_session *ss,
       }
 
       /* check that the realm is the same as in the original request */
-      if (ss->origin_set) {
+      if (ss->origin_set && (stun_attr_index_has(&attrs, STUN_ATTRIBUTE_ORIGIN) ||
+                             (server->check_origin && *(server->check_origin) && ss->origin[0]))) {
         stun_attr_ref sar = stun_attr_get_first_str(ioa_network_buffer_data(in_buffer->nbh),
                                                     ioa_network_buffer_get_size(in_buffer->nbh));
 
@@ -4051,7 +4056,8 @@ static int handle_turn_command(turn_turnserver *server, ts_ur_super_session *ss,
       }
 
       /* get the initial origin value */
-      if (!err_code && !(ss->origin_set) && (method == STUN_METHOD_ALLOCATE)) {
+      if (!err_code && !(ss->origin_set) && (method == STUN_METHOD_ALLOCATE) &&
+          stun_attr_index_has(&attrs, STUN_ATTRIBUTE_ORIGIN)) {
 
         stun_attr_ref sar = stun_attr_get_first_str(ioa_network_buffer_data(in_buffer->nbh),
                                                     ioa_network_buffer_get_size(in_buffer->nbh));
@@ -4092,7 +4098,7 @@ static int handle_turn_command(turn_turnserver *server, ts_ur_super_session *ss,
         } else if (!(*(server->mobility)) || (method != STUN_METHOD_REFRESH) ||
                    is_allocation_valid(get_allocation_ss(ss))) {
           int postpone_reply = 0;
-          check_stun_auth(server, ss, &tid, resp_constructed, &err_code, &reason, in_buffer, nbh, method,
+          check_stun_auth(server, ss, &tid, resp_constructed, &err_code, &reason, in_buffer, &attrs, nbh, method,
                           &message_integrity, &postpone_reply, can_resume);
           if (postpone_reply) {
             no_response = 1;
@@ -4150,7 +4156,7 @@ static int handle_turn_command(turn_turnserver *server, ts_ur_super_session *ss,
       case STUN_METHOD_REFRESH:
 
         handle_turn_refresh(server, ss, &tid, resp_constructed, &err_code, &reason, unknown_attrs, &ua_num, in_buffer,
-                            nbh, message_integrity, &no_response, can_resume);
+                            &attrs, nbh, message_integrity, &no_response, can_resume);
 
         if (server->verbose) {
           log_method(ss, "REFRESH", err_code, reason);
@@ -4345,8 +4351,8 @@ static int handle_turn_command(turn_turnserver *server, ts_ur_super_session *ss,
 
     if (message_integrity) {
       size_t len = ioa_network_buffer_get_size(nbh);
-      stun_attr_add_integrity_str(server->ct, ioa_network_buffer_data(nbh), &len, ss->hmackey, ss->pwd,
-                                  SHATYPE_DEFAULT);
+      stun_attr_add_integrity_ctx_str(&(ss->hmac_ctx), server->ct, ioa_network_buffer_data(nbh), &len, ss->hmackey,
+                                      ss->pwd, SHATYPE_DEFAULT);
       ioa_network_buffer_set_size(nbh, len);
     }
 
@@ -5276,6 +5282,17 @@ static int attach_socket_to_session(turn_turnserver *server, ioa_socket_handle s
   return ret;
 }
 
+static void set_to_be_allocated_timeout(turn_turnserver *server, ts_ur_super_session *ss) {
+  int at = TURN_MAX_ALLOCATE_TIMEOUT;
+  if (*(server->stun_only)) {
+    at = TURN_MAX_ALLOCATE_TIMEOUT_STUN_ONLY;
+  }
+
+  IOA_EVENT_DEL(ss->to_be_allocated_timeout_ev);
+  ss->to_be_allocated_timeout_ev = set_ioa_timer(server->e, at, 0, client_to_be_allocated_timeout_handler, ss, 1,
+                                                 "client_to_be_allocated_timeout_handler");
+}
+
 int open_client_connection_session(turn_turnserver *server, struct socket_message *sm) {
   int ret = 0;
   FUNCSTART;
@@ -5297,14 +5314,7 @@ int open_client_connection_session(turn_turnserver *server, struct socket_messag
 
   set_ioa_socket_session(ss->client_socket, ss);
 
-  int at = TURN_MAX_ALLOCATE_TIMEOUT;
-  if (*(server->stun_only)) {
-    at = TURN_MAX_ALLOCATE_TIMEOUT_STUN_ONLY;
-  }
-
-  IOA_EVENT_DEL(ss->to_be_allocated_timeout_ev);
-  ss->to_be_allocated_timeout_ev = set_ioa_timer(server->e, at, 0, client_to_be_allocated_timeout_handler, ss, 1,
-                                                 "client_to_be_allocated_timeout_handler");
+  set_to_be_allocated_timeout(server, ss);
 
   if (sm->nd.nbh) {
     client_input_handler(ss->client_socket, IOA_EV_READ, &(sm->nd), ss, sm->can_resume);
@@ -5333,45 +5343,46 @@ void turn_peer_input_handler(ioa_socket_handle s, int event_type, ioa_net_data *
   peer_input_handler(s, event_type, data, arg, can_resume);
 }
 
-static void peer_input_handler(ioa_socket_handle s, int event_type, ioa_net_data *in_buffer, void *arg,
-                               int can_resume) {
-
-  if (!(event_type & IOA_EV_READ) || !arg) {
-    return;
-  }
-
-  if (in_buffer->recv_ttl == 0) {
-    return;
-  }
-
-  UNUSED_ARG(can_resume);
+/* Permission and channel of the last peer address seen, so that a run of
+ * datagrams from one peer does a single lookup. */
+typedef struct _peer_route_cache {
+  const ioa_addr *addr;
+  turn_permission_info *tinfo;
+  uint16_t chnum;
+} peer_route_cache;
 
+/* Session-level checks shared by the single and batched peer input paths. */
+static turn_turnserver *peer_input_session_ready(ioa_socket_handle s, ts_ur_super_session *ss) {
   if (!s || ioa_socket_tobeclosed(s)) {
-    return;
-  }
-
-  ts_ur_super_session *ss = (ts_ur_super_session *)arg;
-
-  if (!ss) {
-    return;
+    return NULL;
   }
 
-  if (ss->to_be_closed) {
-    return;
+  if (!ss || ss->to_be_closed) {
+    return NULL;
   }
 
   if (!(ss->client_socket) || ioa_socket_tobeclosed(ss->client_socket)) {
-    return;
+    return NULL;
   }
 
   turn_turnserver *server = (turn_turnserver *)(ss->server);
 
   if (!server) {
-    return;
+    return NULL;
   }
 
   relay_endpoint_session *elem = get_relay_session_ss(ss, get_ioa_socket_address_family(s));
   if (elem->s == NULL) {
+    return NULL;
+  }
+
+  return server;
+}
+
+static void peer_input_forward(turn_turnserver *server, ts_ur_super_session *ss, ioa_net_data *in_buffer,
+                               peer_route_cache *route) {
+
+  if (in_buffer->recv_ttl == 0) {
     return;
   }
 
@@ -5392,14 +5403,17 @@ static void peer_input_handler(ioa_socket_handle s, int event_type, ioa_net_data
     return;
   }
 
-  uint16_t chnum = 0;
+  if (!(route->addr) || !addr_eq(route->addr, &(in_buffer->src_addr))) {
+    route->addr = &(in_buffer->src_addr);
+    route->tinfo = allocation_get_permission(a, &(in_buffer->src_addr));
+    route->chnum = route->tinfo ? get_turn_channel_number(route->tinfo, &(in_buffer->src_addr)) : 0;
+  }
+
+  const uint16_t chnum = route->chnum;
 
   ioa_network_buffer_handle nbh = NULL;
 
-  turn_permission_info *tinfo = allocation_get_permission(a, &(in_buffer->src_addr));
-  if (tinfo) {
-    chnum = get_turn_channel_number(tinfo, &(in_buffer->src_addr));
-  } else if (!(server->server_relay)) {
+  if (!(route->tinfo) && !(server->server_relay)) {
     return;
   }
 
@@ -5450,6 +5464,46 @@ static void peer_input_handler(ioa_socket_handle s, int event_type, ioa_net_data
   write_client_connection(server, ss, nbh, in_buffer->recv_ttl - 1, in_buffer->recv_tos);
 }
 
+static void peer_input_handler(ioa_socket_handle s, int event_type, ioa_net_data *in_buffer, void *arg,
+                               int can_resume) {
+
+  if (!(event_type & IOA_EV_READ) || !arg) {
+    return;
+  }
+
+  UNUSED_ARG(can_resume);
+
+  ts_ur_super_session *ss = (ts_ur_super_session *)arg;
+
+  turn_turnserver *server = peer_input_session_ready(s, ss);
+  if (!server) {
+    return;
+  }
+
+  peer_route_cache route = {0};
+  peer_input_forward(server, ss, in_buffer, &route);
+}
+
+void turn_peer_input_batch_handler(ioa_socket_handle s, int event_type, ioa_net_data *data, size_t count, void *arg) {
+
+  if (!(event_type & IOA_EV_READ) || !arg || !data) {
+    return;
+  }
+
+  ts_ur_super_session *ss = (ts_ur_super_session *)arg;
+  peer_route_cache route = {0};
+
+  for (size_t i = 0; i < count; ++i) {
+    /* Re-checked per datagram: a failed write may mark the client socket
+     * to be closed. */
+    turn_turnserver *server = peer_input_session_ready(s, ss);
+    if (!server) {
+      return;
+    }
+    peer_input_forward(server, ss, &(data[i]), &route);
+  }
+}
+
 static void client_input_handler(ioa_socket_handle s, int event_type, ioa_net_data *data, void *arg, int can_resume) {
 
   if (!arg) {
@@ -5482,6 +5536,192 @@ static void client_input_handler(ioa_socket_handle s, int event_type, ioa_net_da
   }
 }
 
+//////////////// session migration ////////////////////
+
+/* A session moves between relay threads only when all it owns is a TCP/TLS
+ * client connection and plain UDP relay endpoints: the kernel keeps their
+ * traffic queued while the session is in flight. UDP clients share the
+ * listener's socket, RFC 6062 data connections and multiplexed peers are
+ * tied to their thread, and a mobility ticket names its thread. */
+static bool session_can_migrate(turn_turnserver *server, ts_ur_super_session *ss) {
+  if (!ss || ss->to_be_closed || ss->is_tcp_relay || ss->is_mobile || ss->mobile_pending_resume ||
+      ss->mobile_resume_target || ss->alloc.tcs.sz || !is_allocation_valid(&(ss->alloc))) {
+    return false;
+  }
+
+  ioa_socket_handle s = ss->client_socket;
+  if (!s || ioa_socket_tobeclosed(s) || (get_ioa_socket_app_type(s) != CLIENT_SOCKET) ||
+      ((get_ioa_socket_type(s) != TCP_SOCKET) && (get_ioa_socket_type(s) != TLS_SOCKET))) {
+    return false;
+  }
+
+  int relays = 0;
+  for (size_t i = 0; i < ALLOC_PROTOCOLS_NUMBER; ++i) {
+    ioa_socket_handle rs = ss->alloc.relay_sessions[i].s;
+    if (rs) {
+      if (ioa_socket_tobeclosed(rs) || (get_ioa_socket_type(rs) != UDP_SOCKET) ||
+          is_multiplex_peer_udp_relay(server, rs)) {
+        return false;
+      }
+      ++relays;
+    }
+  }
+
+  return relays > 0;
+}
+
+/* (Re)attaches the session's sockets to this server's engine. */
+static int session_register_sockets(turn_turnserver *server, ts_ur_super_session *ss) {
+  int ret = register_callback_on_ioa_socket(server->e, ss->client_socket, IOA_EV_READ, client_input_handler, ss, 1);
+  for (size_t i = 0; i < ALLOC_PROTOCOLS_NUMBER; ++i) {
+    ioa_socket_handle rs = ss->alloc.relay_sessions[i].s;
+    if (rs && (register_callback_on_ioa_socket(server->e, rs, IOA_EV_READ, peer_input_handler, ss, 1) < 0)) {
+      ret = -1;
+    }
+  }
+  return ret;
+}
+
+static void permission_expiry_cancel(turn_permission_info *tinfo, void *arg) {
+  UNUSED_ARG(arg);
+  turn_timer_wheel_cancel(&(tinfo->expiry));
+}
+
+static void channel_expiry_cancel(ch_info *chn, void *arg) {
+  UNUSED_ARG(arg);
+  turn_timer_wheel_cancel(&(chn->expiry));
+}
+
+static void permission_expiry_rearm(turn_permission_info *tinfo, void *arg) {
+  ts_ur_super_session *ss = (ts_ur_super_session *)arg;
+  turn_turnserver *server = (turn_turnserver *)ss->server;
+  tinfo->session_id = ss->id;
+  schedule_expiry(&(server->permission_expiry_wheel), &(tinfo->expiry), tinfo->expiration_time);
+}
+
+static void channel_expiry_rearm(ch_info *chn, void *arg) {
+  ts_ur_super_session *ss = (ts_ur_super_session *)arg;
+  turn_turnserver *server = (turn_turnserver *)ss->server;
+  schedule_expiry(&(server->channel_expiry_wheel), &(chn->expiry), chn->expiration_time);
+}
+
+ts_ur_super_session *turn_detach_session(turn_turnserver *server, turnsession_id sid) {
+  ts_ur_super_session *ss = get_session_from_map(server, sid);
+  if (!session_can_migrate(server, ss)) {
+    return NULL;
+  }
+
+  /* The client connection is the one likely to hold buffered bytes. */
+  if (ioa_socket_suspend(ss->client_socket) < 0) {
+    return NULL;
+  }
+  for (size_t i = 0; i < ALLOC_PROTOCOLS_NUMBER; ++i) {
+    ioa_socket_handle rs = ss->alloc.relay_sessions[i].s;
+    if (rs && (ioa_socket_suspend(rs) < 0)) {
+      if (session_register_sockets(server, ss) < 0) {
+        shutdown_client_connection(server, ss, 1, "session migration failed");
+      }
+      return NULL;
+    }
+  }
+
+  /* The admin view forgets the old id; the new thread reports the new one. */
+  report_turn_session_info(server, ss, 1);
+  delete_session_from_map(ss);
+
+  IOA_EVENT_DEL(ss->to_be_allocated_timeout_ev);
+  for (size_t i = 0; i < ALLOC_PROTOCOLS_NUMBER; ++i) {
+    IOA_EVENT_DEL(ss->alloc.relay_sessions[i].lifetime_ev);
+  }
+  allocation_foreach_permission(&(ss->alloc), permission_expiry_cancel, NULL);
+  allocation_foreach_channel(&(ss->alloc), channel_expiry_cancel, NULL);
+  turn_timer_wheel_cancel(&(ss->mobile_transition_expiry));
+
+  ss->server = NULL;
+
+  return ss;
+}
+
+void turn_attach_session(turn_turnserver *server, ts_ur_super_session *ss) {
+  if (!server || !ss) {
+    return;
+  }
+
+  const turnsession_id old_id = ss->id;
+  const turn_time_t start_time = ss->start_time;
+
+  ss->server = server;
+  ss->id = 0;
+  put_session_into_map(ss);
+  ss->start_time = start_time;
+  ss->alloc.tcp_connections = server->tcp_relay_connections;
+
+  if (server->verbose) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_INFO, "session %018llu: migrated to thread %d as session %018llu\n",
+                  (unsigned long long)old_id, (int)server->id, (unsigned long long)ss->id);
+  }
+
+  if (session_register_sockets(server, ss) < 0) {
+    shutdown_client_connection(server, ss, 1, "session migration failed");
+    return;
+  }
+
+  for (size_t i = 0; i < ALLOC_PROTOCOLS_NUMBER; ++i) {
+    relay_endpoint_session *rsession = &(ss->alloc.relay_sessions[i]);
+    if (rsession->s) {
+      const turn_time_t exp_time = rsession->expiration_time;
+      const uint32_t lifetime = turn_time_before(server->ctime, exp_time) ? (uint32_t)(exp_time - server->ctime) : 1;
+      ioa_timer_handle ev = set_ioa_timer(server->e, lifetime, 0, client_ss_allocation_timeout_handler, rsession, 0,
+                                          "client_ss_allocation_timeout_handler");
+      set_allocation_lifetime_ev(&(ss->alloc), exp_time, ev, get_ioa_socket_address_family(rsession->s));
+    }
+  }
+  allocation_foreach_permission(&(ss->alloc), permission_expiry_rearm, ss);
+  allocation_foreach_channel(&(ss->alloc), channel_expiry_rearm, ss);
+  if (!is_allocation_valid(&(ss->alloc))) {
+    set_to_be_allocated_timeout(server, ss);
+  }
+
+  report_turn_session_info(server, ss, 0);
+}
+
+void turn_release_detached_session(turn_turnserver *server, ts_ur_super_session *ss) {
+  if (!server || !ss) {
+    return;
+  }
+
+  /* Not in any session map: its old id was dropped on detach and it has no
+     new one, so the map removal during teardown finds nothing. */
+  ss->server = server;
+  shutdown_client_connection(server, ss, 1, "relay thread stopped during migration");
+}
+
+struct migration_pick {
+  turn_turnserver *server;
+  uint64_t max_bps;
+  uint64_t best_bps;
+  turnsession_id best;
+};
+
+static bool pick_session_to_migrate(ur_map_key_type key, ur_map_value_type value, void *arg) {
+  struct migration_pick *pick = (struct migration_pick *)arg;
+  ts_ur_super_session *ss = (ts_ur_super_session *)value;
+  const uint64_t bps = (uint64_t)ss->total_rate;
+  if ((bps > pick->best_bps) && (bps <= pick->max_bps) && session_can_migrate(pick->server, ss)) {
+    pick->best_bps = bps;
+    pick->best = (turnsession_id)key;
+  }
+  return false;
+}
+
+turnsession_id turn_pick_session_to_migrate(turn_turnserver *server, uint64_t max_bps) {
+  struct migration_pick pick = {server, max_bps, 0, 0};
+  if (server) {
+    ur_map_foreach_arg(server->sessions_map, pick_session_to_migrate, &pick);
+  }
+  return pick.best;
+}
+
 ///////////////////////////////////////////////////////////
 
 void init_turn_server(turn_turnserver *server, turnserver_id id, int verbose, ioa_engine_handle e,
@@ -5513,6 +5753,9 @@ void init_turn_server(turn_turnserver *server, turnserver_id id, int verbose, io
   server->e = e;
   server->id = id;
   server->ctime = turn_time();
+  turn_timer_wheel_init(&(server->permission_expiry_wheel), server->ctime);
+  turn_timer_wheel_init(&(server->channel_expiry_wheel), server->ctime);
+  turn_timer_wheel_init(&(server->mobile_transition_wheel), server->ctime);
   server->session_id_counter = 0;
   server->sessions_map = ur_map_create();
   server->tcp_relay_connections = ur_map_create();
@@ -5555,6 +5798,14 @@ void init_turn_server(turn_turnserver *server, turnserver_id id, int verbose, io
   server->stun_only = stun_only;
   server->no_stun = no_stun;
   server->software_attribute = software_attribute;
+  if (software_attribute) {
+    const char *software = get_version(server);
+    stun_attr_image_init(&(server->software_attr), STUN_ATTRIBUTE_SOFTWARE, (const uint8_t *)software,
+                         strlen(software));
+  }
+  stun_resp_template_init(&(server->refresh_resp), STUN_METHOD_REFRESH, true);
+  stun_resp_template_init(&(server->permission_resp), STUN_METHOD_CREATE_PERMISSION, false);
+  stun_resp_template_init(&(server->channel_bind_resp), STUN_METHOD_CHANNEL_BIND, false);
   server->web_admin_listen_on_workers = web_admin_listen_on_workers;
 
   server->dont_fragment = dont_fragment;
@@ -74,7 +74,15 @@ extern int TURN_MAX_ALLOCATE_TIMEOUT_STUN_ONLY;
 
 typedef uint8_t turnserver_id;
 
-enum _MESSAGE_TO_RELAY_TYPE { RMT_UNKNOWN = 0, RMT_SOCKET, RMT_CB_SOCKET, RMT_MOBILE_SOCKET, RMT_CANCEL_SESSION };
+enum _MESSAGE_TO_RELAY_TYPE {
+  RMT_UNKNOWN = 0,
+  RMT_SOCKET,
+  RMT_CB_SOCKET,
+  RMT_MOBILE_SOCKET,
+  RMT_CANCEL_SESSION,
+  RMT_MIGRATE_SESSION, /* to the session's thread: move it */
+  RMT_ADOPT_SESSION    /* to the destination thread: the detached session */
+};
 typedef enum _MESSAGE_TO_RELAY_TYPE MESSAGE_TO_RELAY_TYPE;
 
 ///////// ALLOCATION DEFAULT ADDRESS FAMILY TYPES /////////////////////
@@ -126,6 +134,13 @@ struct _turn_turnserver {
 
   turn_time_t ctime;
 
+  /* Per-thread expiry wheels, advanced to ctime by the 1-second server timer.
+   * Permissions are reaped before channels within a tick, as the old
+   * full-session sweep did. */
+  turn_timer_wheel permission_expiry_wheel;
+  turn_timer_wheel channel_expiry_wheel;
+  turn_timer_wheel mobile_transition_wheel;
+
   ioa_engine_handle e;
   int verbose;
   int fingerprint;
@@ -138,6 +153,11 @@ struct _turn_turnserver {
   bool *stun_only;
   bool *no_stun;
   bool software_attribute;
+  /* Success responses and SOFTWARE, laid out once at init */
+  stun_attr_image software_attr;
+  stun_resp_template refresh_resp;
+  stun_resp_template permission_resp;
+  stun_resp_template channel_bind_resp;
   bool *web_admin_listen_on_workers;
   bool *secure_stun;
   turn_credential_type ct;
@@ -246,6 +266,15 @@ struct _turn_turnserver {
   bool *stateless_nonce;
   const uint8_t *stateless_nonce_key;
   size_t stateless_nonce_key_size;
+
+  /* Thread load, read by the listener threads that place new TCP/TLS
+   * clients (--relay-placement). relayed_bytes counts client-side bytes and
+   * is touched by this server's thread only; the 1-second timer publishes
+   * the smoothed rate in load_bps. load_sessions follows sessions_map. */
+  uint64_t relayed_bytes;
+  uint64_t relayed_bytes_sampled;
+  turn_atomic_u32 load_sessions;
+  turn_atomic_u32 load_bps;
 };
 
 const char *get_version(turn_turnserver *server);
@@ -303,8 +332,23 @@ turn_time_t get_turn_server_time(turn_turnserver *server);
 
 void turn_cancel_session(turn_turnserver *server, turnsession_id sid);
 
+/* Moving a session to another relay thread: turn_detach_session() runs on the
+ * session's thread and unhooks the session from it, or returns NULL if it
+ * cannot move right now; turn_attach_session() runs on the destination thread,
+ * where the session gets a new id and its sockets and timers are re-armed.
+ * turn_release_detached_session() ends a detached session that will never be
+ * attached, because the destination thread has stopped. */
+ts_ur_super_session *turn_detach_session(turn_turnserver *server, turnsession_id sid);
+void turn_attach_session(turn_turnserver *server, ts_ur_super_session *ss);
+void turn_release_detached_session(turn_turnserver *server, ts_ur_super_session *ss);
+/* The busiest movable session relaying at most max_bps client-side bytes per
+ * second, or 0. */
+turnsession_id turn_pick_session_to_migrate(turn_turnserver *server, uint64_t max_bps);
+
 /* Non-static relay input handler — called by multiplex-peer dispatch */
 void turn_peer_input_handler(ioa_socket_handle s, int event_type, ioa_net_data *data, void *arg, int can_resume);
+/* Same, for a run of datagrams that all belong to the session in arg. */
+void turn_peer_input_batch_handler(ioa_socket_handle s, int event_type, ioa_net_data *data, size_t count, void *arg);
 
 ///////////////////////////////////////////
 
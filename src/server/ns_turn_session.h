@@ -101,6 +101,7 @@ struct _ts_ur_super_session {
   uint8_t username[STUN_MAX_USERNAME_SIZE + 1];
   hmackey_t hmackey;
   int hmackey_set;
+  stun_hmac_ctx hmac_ctx; /* hmackey (or pwd) pre-keyed, for MESSAGE-INTEGRITY in and out */
   password_t pwd;
   int quota_used;
   int oauth;
@@ -114,6 +115,7 @@ struct _ts_ur_super_session {
   uint32_t sent_packets;
   uint32_t received_bytes;
   uint32_t sent_bytes;
+  uint32_t load_counted_bytes; /* of received_bytes + sent_bytes, already in the server's relayed_bytes */
   uint64_t t_received_packets;
   uint64_t t_sent_packets;
   uint64_t t_received_bytes;
@@ -145,6 +147,8 @@ struct _ts_ur_super_session {
   turnsession_id mobile_resume_target;    /* resuming session -> allocation session id being resumed */
   turnsession_id mobile_pending_resume;   /* allocation session -> resuming session id */
   turn_time_t mobile_transition_deadline; /* allocation session: promote/abort by this time */
+  /* Arms mobile_transition_deadline in the server's mobility transition wheel. */
+  turn_timer_wheel_entry mobile_transition_expiry;
   /* Bandwidth */
   band_limit_t bps;
 };
@@ -168,6 +172,7 @@ struct turn_session_info {
   SOCKET_TYPE peer_protocol;
   char tls_method[17];
   char tls_cipher[65];
+  char tls_offload[33];
   addr_data local_addr_data;
   addr_data remote_addr_data;
   addr_data relay_addr_data_ipv4;
@@ -0,0 +1,198 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * https://opensource.org/license/bsd-3-clause
+ *
+ * Copyright (C) 2011, 2012, 2013 Citrix Systems
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "ns_turn_timer_wheel.h"
+
+#include <string.h> // for memset
+
+/* Seconds reachable by the top level; later deadlines are parked at its edge. */
+#define TURN_TIMER_WHEEL_HORIZON ((turn_time_t)1 << (TURN_TIMER_WHEEL_LEVEL_BITS * TURN_TIMER_WHEEL_LEVELS))
+
+static void link_entry(turn_timer_wheel_entry **head, turn_timer_wheel_entry *entry) {
+  entry->next = *head;
+  if (entry->next) {
+    entry->next->pprev = &(entry->next);
+  }
+  entry->pprev = head;
+  *head = entry;
+}
+
+static void unlink_entry(turn_timer_wheel_entry *entry) {
+  if (entry->pprev) {
+    *(entry->pprev) = entry->next;
+    if (entry->next) {
+      entry->next->pprev = entry->pprev;
+    }
+    entry->next = NULL;
+    entry->pprev = NULL;
+  }
+}
+
+/* Move a whole slot list onto a caller-owned head, so that callbacks which
+ * cancel entries still in the list keep it consistent. */
+static void move_list(turn_timer_wheel_entry **from, turn_timer_wheel_entry **to) {
+  *to = *from;
+  *from = NULL;
+  if (*to) {
+    (*to)->pprev = to;
+  }
+}
+
+/* File an entry into the slot that is reached (directly, or by cascading from a
+ * higher level) at max(due, not_before). A level-L entry is at least 64^L and
+ * less than 64^(L+1) seconds ahead, so its slot is cascaded exactly once before
+ * the deadline, at the start of the 64^L-aligned block that contains it. */
+static void file_entry(turn_timer_wheel *w, turn_timer_wheel_entry *entry, turn_time_t not_before) {
+  turn_time_t slot_time = entry->due;
+  if (turn_time_before(slot_time, not_before)) {
+    slot_time = not_before;
+  }
+
+  turn_time_t delta = slot_time - w->now;
+  if (delta >= TURN_TIMER_WHEEL_HORIZON) {
+    slot_time = w->now + TURN_TIMER_WHEEL_HORIZON - 1;
+    delta = TURN_TIMER_WHEEL_HORIZON - 1;
+  }
+
+  size_t level = 0;
+  while ((level + 1 < TURN_TIMER_WHEEL_LEVELS) && (delta >> (TURN_TIMER_WHEEL_LEVEL_BITS * (level + 1)))) {
+    ++level;
+  }
+
+  const size_t index = (slot_time >> (TURN_TIMER_WHEEL_LEVEL_BITS * level)) & TURN_TIMER_WHEEL_LEVEL_MASK;
+  link_entry(&(w->slots[level][index]), entry);
+}
+
+/* Re-file the higher-level slots whose block starts at the current tick. */
+static void cascade(turn_timer_wheel *w) {
+  for (size_t level = 1; level < TURN_TIMER_WHEEL_LEVELS; ++level) {
+    const unsigned int shift = TURN_TIMER_WHEEL_LEVEL_BITS * level;
+    if (w->now & (((turn_time_t)1 << shift) - 1)) {
+      break;
+    }
+    turn_timer_wheel_entry *list = NULL;
+    move_list(&(w->slots[level][(w->now >> shift) & TURN_TIMER_WHEEL_LEVEL_MASK]), &list);
+    while (list) {
+      turn_timer_wheel_entry *entry = list;
+      unlink_entry(entry);
+      file_entry(w, entry, w->now);
+    }
+  }
+}
+
+/* Fire or re-file everything in the list; callbacks may cancel entries that are
+ * still in it. */
+static size_t expire_list(turn_timer_wheel *w, turn_timer_wheel_entry **list, turn_timer_wheel_cb cb, void *arg) {
+  size_t fired = 0;
+  while (*list) {
+    turn_timer_wheel_entry *entry = *list;
+    unlink_entry(entry);
+    if (turn_time_before(w->now, entry->due)) {
+      file_entry(w, entry, w->now + 1);
+    } else {
+      ++fired;
+      if (cb) {
+        cb(entry, arg);
+      }
+    }
+  }
+  return fired;
+}
+
+/* Jump straight to `now`: take every entry off every level at once and file
+ * it again against the new time, firing the ones that are due. This costs one
+ * pass over the armed entries however far the clock moved. */
+static size_t rebase(turn_timer_wheel *w, turn_time_t now, turn_timer_wheel_cb cb, void *arg) {
+  turn_timer_wheel_entry *list = NULL;
+  for (size_t level = 0; level < TURN_TIMER_WHEEL_LEVELS; ++level) {
+    for (size_t index = 0; index < TURN_TIMER_WHEEL_LEVEL_SIZE; ++index) {
+      while (w->slots[level][index]) {
+        turn_timer_wheel_entry *entry = w->slots[level][index];
+        unlink_entry(entry);
+        link_entry(&list, entry);
+      }
+    }
+  }
+  w->now = now;
+  return expire_list(w, &list, cb, arg);
+}
+
+void turn_timer_wheel_init(turn_timer_wheel *w, turn_time_t now) {
+  if (w) {
+    memset(w, 0, sizeof(turn_timer_wheel));
+    w->now = now;
+  }
+}
+
+void turn_timer_wheel_schedule(turn_timer_wheel *w, turn_timer_wheel_entry *entry, turn_time_t due) {
+  if (!w || !entry) {
+    return;
+  }
+  unlink_entry(entry);
+  entry->due = due;
+  file_entry(w, entry, w->now + 1);
+}
+
+void turn_timer_wheel_cancel(turn_timer_wheel_entry *entry) {
+  if (entry) {
+    unlink_entry(entry);
+  }
+}
+
+size_t turn_timer_wheel_advance(turn_timer_wheel *w, turn_time_t now, turn_timer_wheel_cb cb, void *arg) {
+  size_t fired = 0;
+
+  if (!w) {
+    return fired;
+  }
+
+  /* turn_time() is the wall clock: a step back, or forward by more than a
+   * level-0 revolution, re-files everything once instead of ticking through
+   * the gap (or waiting for the clock to catch up). */
+  if (turn_time_before(now, w->now) || (now - w->now > TURN_TIMER_WHEEL_LEVEL_SIZE)) {
+    return rebase(w, now, cb, arg);
+  }
+
+  while (turn_time_before(w->now, now)) {
+    ++(w->now);
+    cascade(w);
+
+    /* Anything not due yet was parked beyond the horizon and is re-filed. */
+    turn_timer_wheel_entry *list = NULL;
+    move_list(&(w->slots[0][w->now & TURN_TIMER_WHEEL_LEVEL_MASK]), &list);
+    fired += expire_list(w, &list, cb, arg);
+  }
+
+  return fired;
+}
@@ -0,0 +1,115 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * https://opensource.org/license/bsd-3-clause
+ *
+ * Copyright (C) 2011, 2012, 2013 Citrix Systems
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef __TURN_TIMER_WHEEL__
+#define __TURN_TIMER_WHEEL__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "ns_turn_defs.h" // for turn_time_t
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Hierarchical timing wheel with 1-second resolution, used by each relay
+ * thread's turn_turnserver to expire permissions, channels and mobility
+ * transitions without walking every session on every tick.
+ *
+ * Design:
+ *  - TURN_TIMER_WHEEL_LEVELS levels of TURN_TIMER_WHEEL_LEVEL_SIZE slots. A
+ *    level-L slot spans 64^L seconds, so four levels cover ~194 days; deadlines
+ *    further out are parked in the last level and re-filed when it cascades.
+ *  - Entries are intrusive (embedded in the object that owns the deadline) and
+ *    doubly linked through a back-pointer, so schedule, re-schedule and cancel
+ *    are O(1) and need no allocation. Cancel does not need the wheel itself.
+ *  - turn_timer_wheel_advance() only visits the level-0 slot of each elapsed
+ *    second plus, every 64th second, one slot of a higher level that is
+ *    cascaded downwards. The cost of a tick is proportional to the entries
+ *    that are due (or cascaded), not to the number of armed entries.
+ *  - An entry due at or before the wheel's current time fires on the next
+ *    advance. Entries are always re-checked against their deadline before
+ *    firing, so wall-clock steps in either direction never fire early.
+ *  - A wall-clock step backwards, or forwards by more than 64 seconds, moves
+ *    the wheel straight to the new time and re-files every armed entry once,
+ *    so the cost does not grow with the size of the step.
+ *
+ * The wheel is not thread-safe; it belongs to a single event loop.
+ */
+
+#define TURN_TIMER_WHEEL_LEVEL_BITS (6)
+#define TURN_TIMER_WHEEL_LEVEL_SIZE (1u << TURN_TIMER_WHEEL_LEVEL_BITS)
+#define TURN_TIMER_WHEEL_LEVEL_MASK (TURN_TIMER_WHEEL_LEVEL_SIZE - 1u)
+#define TURN_TIMER_WHEEL_LEVELS (4)
+
+typedef struct _turn_timer_wheel_entry {
+  struct _turn_timer_wheel_entry *next;
+  struct _turn_timer_wheel_entry **pprev; /* NULL when not scheduled */
+  turn_time_t due;
+} turn_timer_wheel_entry;
+
+typedef struct _turn_timer_wheel {
+  turn_time_t now;
+  turn_timer_wheel_entry *slots[TURN_TIMER_WHEEL_LEVELS][TURN_TIMER_WHEEL_LEVEL_SIZE];
+} turn_timer_wheel;
+
+/* Called for each entry that falls due. The entry is already unlinked, so the
+ * callback may re-schedule it, cancel others, or let its owner be freed. */
+typedef void (*turn_timer_wheel_cb)(turn_timer_wheel_entry *entry, void *arg);
+
+void turn_timer_wheel_init(turn_timer_wheel *w, turn_time_t now);
+
+/* Arm (or re-arm) an entry to fire once the wheel time reaches `due`. */
+void turn_timer_wheel_schedule(turn_timer_wheel *w, turn_timer_wheel_entry *entry, turn_time_t due);
+
+/* Disarm an entry. Safe on entries that are not scheduled, including
+ * zero-initialized ones. */
+void turn_timer_wheel_cancel(turn_timer_wheel_entry *entry);
+
+static inline bool turn_timer_wheel_is_scheduled(const turn_timer_wheel_entry *entry) {
+  return entry && entry->pprev;
+}
+
+/* Move the wheel to `now`, firing every entry whose deadline is not after
+ * `now`. Returns the number of entries fired. A `now` equal to the wheel's
+ * current time is a no-op; an earlier one re-files the entries against it. */
+size_t turn_timer_wheel_advance(turn_timer_wheel *w, turn_time_t now, turn_timer_wheel_cb cb, void *arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__TURN_TIMER_WHEEL__
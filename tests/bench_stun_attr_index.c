@@ -0,0 +1,110 @@
+/*
+ * STUN attribute lookup benchmark.
+ *
+ * check_stun_auth() used to find MESSAGE-INTEGRITY, REALM, USERNAME and NONCE
+ * with one stun_attr_get_first_by_type_str() walk each, and the integrity
+ * check walked once more for MESSAGE-INTEGRITY. This times those five walks
+ * against one stun_attr_index_build() plus five indexed lookups, over the
+ * authenticated Allocate, Refresh and CreatePermission requests a browser
+ * client sends.
+ *
+ * Usage: bench_stun_attr_index [iterations]   (default: 2000000)
+ */
+
+#include "ns_turn_msg.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct {
+  const char *name;
+  uint8_t buf[1024];
+  size_t len;
+} bench_msg;
+
+static const uint16_t auth_lookups[] = {STUN_ATTRIBUTE_MESSAGE_INTEGRITY, STUN_ATTRIBUTE_REALM,
+                                        STUN_ATTRIBUTE_USERNAME, STUN_ATTRIBUTE_NONCE,
+                                        STUN_ATTRIBUTE_MESSAGE_INTEGRITY};
+
+#define AUTH_LOOKUPS (sizeof(auth_lookups) / sizeof(auth_lookups[0]))
+
+static double now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec / 1e3;
+}
+
+static void seal(bench_msg *m) {
+  static const uint8_t uname[] = "1700000000:a1b2c3d4e5f6";
+  static const uint8_t realm[] = "turn.example.org";
+  static const uint8_t nonce[] = "0123456789abcdef0123456789abcdef";
+  static const uint8_t software[] = "Coturn-4.7.0 'Gorst'";
+  hmackey_t key;
+  stun_produce_integrity_key_str(uname, realm, (const uint8_t *)"secret", key, SHATYPE_DEFAULT);
+  stun_attr_add_str(m->buf, &m->len, STUN_ATTRIBUTE_SOFTWARE, software, (int)strlen((const char *)software));
+  stun_attr_add_integrity_by_key_str(m->buf, &m->len, uname, realm, key, nonce, SHATYPE_DEFAULT);
+  stun_attr_add_fingerprint_str(m->buf, &m->len);
+}
+
+static void build_messages(bench_msg *msgs) {
+  ioa_addr peer;
+  make_ioa_addr((const uint8_t *)"203.0.113.7", 50000, &peer);
+
+  msgs[0].name = "Allocate";
+  stun_set_allocate_request_str(msgs[0].buf, &msgs[0].len, 600, true, false, STUN_ATTRIBUTE_TRANSPORT_UDP_VALUE, false,
+                                NULL, -1);
+  seal(&msgs[0]);
+
+  msgs[1].name = "Refresh";
+  stun_init_request_str(STUN_METHOD_REFRESH, msgs[1].buf, &msgs[1].len);
+  const uint8_t lifetime[4] = {0, 0, 0x02, 0x58};
+  stun_attr_add_str(msgs[1].buf, &msgs[1].len, STUN_ATTRIBUTE_LIFETIME, lifetime, 4);
+  seal(&msgs[1]);
+
+  msgs[2].name = "CreatePermission";
+  stun_init_request_str(STUN_METHOD_CREATE_PERMISSION, msgs[2].buf, &msgs[2].len);
+  for (int i = 0; i < 4; ++i) {
+    addr_set_port(&peer, (uint16_t)(50000 + i));
+    stun_attr_add_addr_str(msgs[2].buf, &msgs[2].len, STUN_ATTRIBUTE_XOR_PEER_ADDRESS, &peer);
+  }
+  seal(&msgs[2]);
+}
+
+int main(int argc, char **argv) {
+  const unsigned long iterations = (argc > 1) ? strtoul(argv[1], NULL, 10) : 2000000UL;
+  bench_msg msgs[3];
+  memset(msgs, 0, sizeof(msgs));
+  build_messages(msgs);
+
+  uintptr_t sink = 0;
+  printf("%18s %6s %6s %12s %12s %9s\n", "request", "bytes", "attrs", "linear ns", "index ns", "speedup");
+  for (size_t m = 0; m < sizeof(msgs) / sizeof(msgs[0]); ++m) {
+    const uint8_t *buf = msgs[m].buf;
+    const size_t len = msgs[m].len;
+
+    double start = now_us();
+    for (unsigned long i = 0; i < iterations; ++i) {
+      for (size_t k = 0; k < AUTH_LOOKUPS; ++k) {
+        sink += (uintptr_t)stun_attr_get_first_by_type_str(buf, len, auth_lookups[k]);
+      }
+    }
+    const double linear = (now_us() - start) * 1e3 / (double)iterations;
+
+    stun_attr_index idx;
+    start = now_us();
+    for (unsigned long i = 0; i < iterations; ++i) {
+      stun_attr_index_build(buf, len, &idx);
+      for (size_t k = 0; k < AUTH_LOOKUPS; ++k) {
+        sink += (uintptr_t)stun_attr_index_first(&idx, buf, len, auth_lookups[k]);
+      }
+    }
+    const double indexed = (now_us() - start) * 1e3 / (double)iterations;
+
+    printf("%18s %6zu %6u %12.1f %12.1f %8.2fx\n", msgs[m].name, len, (unsigned)idx.count, linear, indexed,
+           indexed > 0 ? linear / indexed : 0.0);
+  }
+  printf("(checksum %lx)\n", (unsigned long)sink);
+  return 0;
+}
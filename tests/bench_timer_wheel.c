@@ -0,0 +1,177 @@
+/*
+ * Tick-cost benchmark for permission/channel expiry.
+ *
+ * Compares the per-tick cost of the former full sweep (walk every permission
+ * and channel slot of every allocation, as sweep_allocation_timed_events() did)
+ * against the per-thread timing wheel now used by ns_turn_server.c. Each
+ * allocation holds a few permissions with one channel each; deadlines are
+ * spread over the default lifetimes and every expiry is immediately refreshed,
+ * so the number of armed entries stays constant while ticks run.
+ *
+ * Usage: bench_timer_wheel [allocations ...]   (default: 1000 4000 16000)
+ */
+
+#include "ns_turn_allocation.h"
+#include "ns_turn_timer_wheel.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_PERMISSIONS_PER_ALLOCATION (4)
+#define BENCH_PERMISSION_LIFETIME (300)
+#define BENCH_CHANNEL_LIFETIME (600)
+#define BENCH_TICKS (120)
+#define BENCH_START_TIME (100000)
+
+typedef struct {
+  turn_time_t now;
+  size_t touched;
+} bench_state;
+
+static double now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec / 1e3;
+}
+
+static void populate(allocation *allocs, size_t n, turn_timer_wheel *pw, turn_timer_wheel *cw) {
+  unsigned int seed = 1;
+  for (size_t i = 0; i < n; ++i) {
+    for (size_t j = 0; j < BENCH_PERMISSIONS_PER_ALLOCATION; ++j) {
+      turn_permission_info *tinfo = &(allocs[i].addr_to_perm.table[j].main_slots[0].info);
+      tinfo->allocated = true;
+      tinfo->owner = &(allocs[i]);
+      tinfo->expiration_time = BENCH_START_TIME + 1 + (turn_time_t)(rand_r(&seed) % BENCH_PERMISSION_LIFETIME);
+      ch_info *chn = &(allocs[i].chns.table[j].main_chns[0]);
+      chn->allocated = true;
+      chn->owner = tinfo;
+      chn->expiration_time = BENCH_START_TIME + 1 + (turn_time_t)(rand_r(&seed) % BENCH_CHANNEL_LIFETIME);
+      if (pw) {
+        turn_timer_wheel_schedule(pw, &(tinfo->expiry), tinfo->expiration_time + 1);
+        turn_timer_wheel_schedule(cw, &(chn->expiry), chn->expiration_time + 1);
+      }
+    }
+  }
+}
+
+/* The loop structure of the former sweep_allocation_timed_events(). */
+static size_t sweep_allocation(allocation *a, turn_time_t ctime) {
+  size_t expired = 0;
+  for (size_t i = 0; i < TURN_PERMISSION_HASHTABLE_SIZE; ++i) {
+    turn_permission_array *parray = &(a->addr_to_perm.table[i]);
+    for (size_t j = 0; j < TURN_PERMISSION_ARRAY_SIZE; ++j) {
+      turn_permission_info *tinfo = &(parray->main_slots[j].info);
+      if (tinfo->allocated && turn_time_before(tinfo->expiration_time, ctime)) {
+        tinfo->expiration_time = ctime + BENCH_PERMISSION_LIFETIME;
+        ++expired;
+      }
+    }
+  }
+  for (size_t i = 0; i < CH_MAP_HASH_SIZE; ++i) {
+    ch_map_array *carray = &(a->chns.table[i]);
+    for (size_t j = 0; j < CH_MAP_ARRAY_SIZE; ++j) {
+      ch_info *chn = &(carray->main_chns[j]);
+      if (chn->allocated && turn_time_before(chn->expiration_time, ctime)) {
+        chn->expiration_time = ctime + BENCH_CHANNEL_LIFETIME;
+        ++expired;
+      }
+    }
+  }
+  return expired;
+}
+
+static turn_timer_wheel *bench_permission_wheel;
+static turn_timer_wheel *bench_channel_wheel;
+
+static void permission_cb(turn_timer_wheel_entry *entry, void *arg) {
+  bench_state *st = (bench_state *)arg;
+  turn_permission_info *tinfo = (turn_permission_info *)((char *)entry - offsetof(turn_permission_info, expiry));
+  tinfo->expiration_time = st->now + BENCH_PERMISSION_LIFETIME;
+  turn_timer_wheel_schedule(bench_permission_wheel, entry, tinfo->expiration_time + 1);
+  ++(st->touched);
+}
+
+static void channel_cb(turn_timer_wheel_entry *entry, void *arg) {
+  bench_state *st = (bench_state *)arg;
+  ch_info *chn = (ch_info *)((char *)entry - offsetof(ch_info, expiry));
+  chn->expiration_time = st->now + BENCH_CHANNEL_LIFETIME;
+  turn_timer_wheel_schedule(bench_channel_wheel, entry, chn->expiration_time + 1);
+  ++(st->touched);
+}
+
+static void report(const char *name, size_t n, double total, double worst, size_t expired) {
+  printf("%-6s %9zu %12.1f %12.1f %12zu\n", name, n, total / BENCH_TICKS, worst, expired / BENCH_TICKS);
+}
+
+static int bench(size_t n) {
+  allocation *allocs = (allocation *)calloc(n, sizeof(allocation));
+  turn_timer_wheel *wheels = (turn_timer_wheel *)calloc(2, sizeof(turn_timer_wheel));
+  if (!allocs || !wheels) {
+    free(allocs);
+    free(wheels);
+    fprintf(stderr, "cannot allocate %zu allocations\n", n);
+    return -1;
+  }
+
+  /* Full sweep. */
+  populate(allocs, n, NULL, NULL);
+  double total = 0;
+  double worst = 0;
+  size_t expired = 0;
+  for (turn_time_t t = BENCH_START_TIME + 1; t <= BENCH_START_TIME + BENCH_TICKS; ++t) {
+    const double start = now_us();
+    for (size_t i = 0; i < n; ++i) {
+      expired += sweep_allocation(&(allocs[i]), t);
+    }
+    const double elapsed = now_us() - start;
+    total += elapsed;
+    worst = elapsed > worst ? elapsed : worst;
+  }
+  report("sweep", n, total, worst, expired);
+
+  /* Timing wheel. */
+  bench_permission_wheel = &(wheels[0]);
+  bench_channel_wheel = &(wheels[1]);
+  turn_timer_wheel_init(bench_permission_wheel, BENCH_START_TIME);
+  turn_timer_wheel_init(bench_channel_wheel, BENCH_START_TIME);
+  populate(allocs, n, bench_permission_wheel, bench_channel_wheel);
+  total = 0;
+  worst = 0;
+  bench_state st = {0};
+  for (turn_time_t t = BENCH_START_TIME + 1; t <= BENCH_START_TIME + BENCH_TICKS; ++t) {
+    st.now = t;
+    const double start = now_us();
+    turn_timer_wheel_advance(bench_permission_wheel, t, permission_cb, &st);
+    turn_timer_wheel_advance(bench_channel_wheel, t, channel_cb, &st);
+    const double elapsed = now_us() - start;
+    total += elapsed;
+    worst = elapsed > worst ? elapsed : worst;
+  }
+  report("wheel", n, total, worst, st.touched);
+
+  free(allocs);
+  free(wheels);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  static const size_t defaults[] = {1000, 4000, 16000};
+
+  printf("%-6s %9s %12s %12s %12s\n", "mode", "allocs", "avg_us/tick", "max_us/tick", "expired/tick");
+  if (argc > 1) {
+    for (int i = 1; i < argc; ++i) {
+      if (bench((size_t)strtoul(argv[i], NULL, 10)) < 0) {
+        return 1;
+      }
+    }
+  } else {
+    for (size_t i = 0; i < sizeof(defaults) / sizeof(defaults[0]); ++i) {
+      if (bench(defaults[i]) < 0) {
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,126 @@
+/*
+ * UDP listener packet classification benchmark.
+ *
+ * Times the chain of checks the listener used to run on every datagram
+ * (ChannelData, then STUN, then the DTLS record header, then RFC 3489 STUN)
+ * against the one-pass udp_classify_packet(), over a synthetic batch that
+ * mixes ChannelData, STUN, DTLS records and garbage as a busy relay sees it.
+ *
+ * Usage: bench_udp_classify [rounds]   (default: 2000)
+ */
+
+#include "udp_classify.h"
+
+#include "ns_turn_msg.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BATCH (1024)
+#define PKT_MAX (1200)
+
+static double now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec / 1e3;
+}
+
+static bool legacy_is_dtls(const uint8_t *buf, size_t len) {
+  return (len > 3) && (buf[1] == 0xfe) && ((buf[2] == 0xff) || (buf[2] == 0xfd)) && (buf[0] >= 0x14) &&
+         (buf[0] <= 0x17);
+}
+
+static udp_packet_classification_t legacy_classify(const uint8_t *data, size_t blen, unsigned flags) {
+  size_t candidate_len = blen;
+  uint16_t chnum = 0;
+  uint32_t old_stun_cookie = 0;
+
+  if (stun_is_channel_message_str(data, &candidate_len, &chnum, false) ||
+      stun_is_command_message_str(data, candidate_len)) {
+    return UDP_PACKET_CLASS_STUN_OR_CHANNEL;
+  }
+  if ((flags & UDP_CLASSIFY_DTLS) && legacy_is_dtls(data, blen) && (data[0] == 0x16)) {
+    return UDP_PACKET_CLASS_DTLS_HANDSHAKE;
+  }
+  if ((flags & UDP_CLASSIFY_DTLS) && legacy_is_dtls(data, blen)) {
+    return UDP_PACKET_CLASS_DTLS_OTHER;
+  }
+  if ((flags & UDP_CLASSIFY_OLD_STUN) && old_stun_is_command_message_str(data, blen, &old_stun_cookie)) {
+    return UDP_PACKET_CLASS_OLD_STUN;
+  }
+  return UDP_PACKET_CLASS_INVALID;
+}
+
+typedef udp_packet_classification_t (*classify_fn)(const uint8_t *data, size_t blen, unsigned flags);
+
+static udp_packet_classification_t unified_classify(const uint8_t *data, size_t blen, unsigned flags) {
+  return udp_classify_packet(data, blen, flags);
+}
+
+static uint8_t *pkts[BATCH];
+static size_t lens[BATCH];
+
+/* 80% ChannelData, 10% STUN, 5% DTLS, 5% garbage. */
+static void build_batch(void) {
+  srand(1);
+  for (int i = 0; i < BATCH; ++i) {
+    uint8_t *p = (uint8_t *)malloc(PKT_MAX);
+    const int kind = rand() % 100;
+    size_t len = 0;
+    if (kind < 80) {
+      const size_t payload = 60 + (size_t)(rand() % 1000);
+      len = PKT_MAX;
+      stun_init_channel_message_str((uint16_t)(0x4000 + rand() % 64), p, &len, (int)payload, false);
+      len = 4 + payload;
+    } else if (kind < 90) {
+      stun_init_request_str(STUN_METHOD_BINDING, p, &len);
+    } else if (kind < 95) {
+      len = 100 + (size_t)(rand() % 200);
+      memset(p, 0, len);
+      p[0] = (rand() % 2) ? 0x16 : 0x17;
+      p[1] = 0xfe;
+      p[2] = 0xfd;
+    } else {
+      len = 20 + (size_t)(rand() % 500);
+      for (size_t j = 0; j < len; ++j) {
+        p[j] = (uint8_t)rand();
+      }
+      p[0] |= 0x80;
+    }
+    pkts[i] = p;
+    lens[i] = len;
+  }
+}
+
+/* Returns ns per packet; *sink keeps the calls from being optimised away. */
+static double run(classify_fn fn, unsigned flags, int rounds, unsigned *sink) {
+  const double start = now_us();
+  for (int r = 0; r < rounds; ++r) {
+    for (int i = 0; i < BATCH; ++i) {
+      *sink += (unsigned)fn(pkts[i], lens[i], flags);
+    }
+  }
+  return (now_us() - start) * 1e3 / ((double)rounds * BATCH);
+}
+
+int main(int argc, char **argv) {
+  const int rounds = (argc > 1) ? atoi(argv[1]) : 2000;
+  build_batch();
+
+  static const char *flag_names[] = {"none", "dtls", "old-stun", "dtls+old-stun"};
+  unsigned sink = 0;
+  printf("%-20s %12s %12s %10s\n", "flags", "chained ns", "one-pass ns", "speedup");
+  for (unsigned flags = 0; flags <= (UDP_CLASSIFY_DTLS | UDP_CLASSIFY_OLD_STUN); ++flags) {
+    const double legacy = run(legacy_classify, flags, rounds, &sink);
+    const double unified = run(unified_classify, flags, rounds, &sink);
+    printf("%-20s %12.2f %12.2f %9.2fx\n", flag_names[flags], legacy, unified, unified > 0 ? legacy / unified : 0.0);
+  }
+  printf("(checksum %u)\n", sink);
+
+  for (int i = 0; i < BATCH; ++i) {
+    free(pkts[i]);
+  }
+  return 0;
+}
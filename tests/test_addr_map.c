@@ -0,0 +1,189 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * https://opensource.org/license/bsd-3-clause
+ *
+ * ur_addr_map is the listener's per-5-tuple socket container and the relay's
+ * multiplex-peer demux table. It must keep exact IP:port semantics while
+ * growing far past its initial capacity, and deletion (including from inside
+ * a foreach callback) must never lose or duplicate other entries.
+ */
+
+#include "ns_turn_maps.h"
+
+#include <unity.h>
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define MANY_KEYS (50000)
+
+static ur_addr_map map;
+
+/* Distinct values for distinct keys; never NULL. */
+#define VALUE_OF(i) ((ur_addr_map_value_type)(uintptr_t)((i) + 1))
+
+static ioa_addr key_v4(size_t i) {
+  ioa_addr addr = {0};
+  char ip[INET_ADDRSTRLEN];
+  /* Few addresses, many ports: clients behind shared NATs. */
+  snprintf(ip, sizeof(ip), "198.51.100.%u", (unsigned int)(i % 7));
+  TEST_ASSERT_EQUAL_INT(0, make_ioa_addr((const uint8_t *)ip, (int)(1024 + i / 7), &addr));
+  return addr;
+}
+
+static ioa_addr key_v6(size_t i) {
+  ioa_addr addr = {0};
+  char ip[64];
+  snprintf(ip, sizeof(ip), "2001:db8::%x:%x", (unsigned int)(i >> 8), (unsigned int)(i & 0xff));
+  TEST_ASSERT_EQUAL_INT(0, make_ioa_addr((const uint8_t *)ip, 3478, &addr));
+  return addr;
+}
+
+void setUp(void) { ur_addr_map_init(&map); }
+void tearDown(void) { ur_addr_map_clean(&map); }
+
+static void test_empty_map(void) {
+  ioa_addr k = key_v4(1);
+  ur_addr_map_value_type v = NULL;
+  TEST_ASSERT_FALSE(ur_addr_map_get(&map, &k, &v));
+  TEST_ASSERT_FALSE(ur_addr_map_del(&map, &k, NULL));
+  TEST_ASSERT_EQUAL_size_t(0, ur_addr_map_num_elements(&map));
+  TEST_ASSERT_EQUAL_size_t(0, ur_addr_map_size(&map));
+}
+
+static void test_port_is_part_of_the_key(void) {
+  ioa_addr a = key_v4(0);
+  ioa_addr b = a;
+  addr_set_port(&b, (int)(addr_get_port(&a) + 1));
+
+  TEST_ASSERT_TRUE(ur_addr_map_put(&map, &a, VALUE_OF(0)));
+  ur_addr_map_value_type v = NULL;
+  TEST_ASSERT_FALSE(ur_addr_map_get(&map, &b, &v));
+  TEST_ASSERT_TRUE(ur_addr_map_get(&map, &a, &v));
+  TEST_ASSERT_EQUAL_PTR(VALUE_OF(0), v);
+}
+
+static void test_put_updates_and_null_value_removes(void) {
+  ioa_addr k = key_v6(42);
+  TEST_ASSERT_TRUE(ur_addr_map_put(&map, &k, VALUE_OF(1)));
+  TEST_ASSERT_TRUE(ur_addr_map_put(&map, &k, VALUE_OF(2)));
+  TEST_ASSERT_EQUAL_size_t(1, ur_addr_map_num_elements(&map));
+
+  ur_addr_map_value_type v = NULL;
+  TEST_ASSERT_TRUE(ur_addr_map_get(&map, &k, &v));
+  TEST_ASSERT_EQUAL_PTR(VALUE_OF(2), v);
+
+  TEST_ASSERT_TRUE(ur_addr_map_put(&map, &k, NULL));
+  TEST_ASSERT_FALSE(ur_addr_map_get(&map, &k, &v));
+  TEST_ASSERT_EQUAL_size_t(0, ur_addr_map_num_elements(&map));
+}
+
+static void test_grows_and_keeps_every_key(void) {
+  for (size_t i = 0; i < MANY_KEYS; ++i) {
+    ioa_addr k4 = key_v4(i);
+    ioa_addr k6 = key_v6(i);
+    TEST_ASSERT_TRUE(ur_addr_map_put(&map, &k4, VALUE_OF(i)));
+    TEST_ASSERT_TRUE(ur_addr_map_put(&map, &k6, VALUE_OF(MANY_KEYS + i)));
+  }
+  TEST_ASSERT_EQUAL_size_t(2 * MANY_KEYS, ur_addr_map_num_elements(&map));
+
+  const size_t capacity = ur_addr_map_size(&map);
+  TEST_ASSERT_EQUAL_size_t(0, capacity & (capacity - 1));
+  TEST_ASSERT_TRUE(2 * MANY_KEYS * ADDR_MAP_MAX_LOAD_DEN <= capacity * ADDR_MAP_MAX_LOAD_NUM);
+
+  /* Delete every third key; the rest must survive the backward shifts. */
+  for (size_t i = 0; i < MANY_KEYS; i += 3) {
+    ioa_addr k4 = key_v4(i);
+    ioa_addr k6 = key_v6(i);
+    TEST_ASSERT_TRUE(ur_addr_map_del(&map, &k4, NULL));
+    TEST_ASSERT_TRUE(ur_addr_map_del(&map, &k6, NULL));
+    TEST_ASSERT_FALSE(ur_addr_map_del(&map, &k6, NULL));
+  }
+
+  for (size_t i = 0; i < MANY_KEYS; ++i) {
+    ioa_addr k4 = key_v4(i);
+    ioa_addr k6 = key_v6(i);
+    ur_addr_map_value_type v = NULL;
+    if (i % 3 == 0) {
+      TEST_ASSERT_FALSE(ur_addr_map_get(&map, &k4, &v));
+      TEST_ASSERT_FALSE(ur_addr_map_get(&map, &k6, &v));
+    } else {
+      TEST_ASSERT_TRUE(ur_addr_map_get(&map, &k4, &v));
+      TEST_ASSERT_EQUAL_PTR(VALUE_OF(i), v);
+      TEST_ASSERT_TRUE(ur_addr_map_get(&map, &k6, &v));
+      TEST_ASSERT_EQUAL_PTR(VALUE_OF(MANY_KEYS + i), v);
+    }
+  }
+}
+
+static size_t delfunc_calls;
+static void count_delfunc(ur_addr_map_value_type value) {
+  UNUSED_ARG(value);
+  ++delfunc_calls;
+}
+
+static void test_del_calls_delfunc_once(void) {
+  ioa_addr k = key_v4(5);
+  delfunc_calls = 0;
+  TEST_ASSERT_TRUE(ur_addr_map_put(&map, &k, VALUE_OF(5)));
+  TEST_ASSERT_TRUE(ur_addr_map_del(&map, &k, count_delfunc));
+  TEST_ASSERT_FALSE(ur_addr_map_del(&map, &k, count_delfunc));
+  TEST_ASSERT_EQUAL_size_t(1, delfunc_calls);
+}
+
+static size_t visited_count[MANY_KEYS];
+
+static bool visit_and_delete_odd(const ioa_addr *key, ur_addr_map_value_type value, void *arg) {
+  UNUSED_ARG(arg);
+  const size_t i = (size_t)(uintptr_t)value - 1;
+  visited_count[i] += 1;
+  if (i & 1) {
+    ioa_addr k = *key;
+    TEST_ASSERT_TRUE(ur_addr_map_del(&map, &k, NULL));
+  }
+  return true;
+}
+
+static void test_foreach_may_delete_the_visited_entry(void) {
+  for (size_t i = 0; i < MANY_KEYS; ++i) {
+    ioa_addr k = key_v4(i);
+    TEST_ASSERT_TRUE(ur_addr_map_put(&map, &k, VALUE_OF(i)));
+    visited_count[i] = 0;
+  }
+
+  TEST_ASSERT_TRUE(ur_addr_map_foreach_key_arg(&map, visit_and_delete_odd, NULL));
+
+  for (size_t i = 0; i < MANY_KEYS; ++i) {
+    TEST_ASSERT_EQUAL_size_t(1, visited_count[i]);
+  }
+  TEST_ASSERT_EQUAL_size_t(MANY_KEYS / 2, ur_addr_map_num_elements(&map));
+}
+
+static bool stop_after_first(ur_addr_map_value_type value, void *arg) {
+  UNUSED_ARG(value);
+  *(size_t *)arg += 1;
+  return false;
+}
+
+static void test_foreach_stops_early(void) {
+  for (size_t i = 0; i < 100; ++i) {
+    ioa_addr k = key_v4(i);
+    TEST_ASSERT_TRUE(ur_addr_map_put(&map, &k, VALUE_OF(i)));
+  }
+  size_t calls = 0;
+  TEST_ASSERT_FALSE(ur_addr_map_foreach_arg(&map, stop_after_first, &calls));
+  TEST_ASSERT_EQUAL_size_t(1, calls);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_empty_map);
+  RUN_TEST(test_port_is_part_of_the_key);
+  RUN_TEST(test_put_updates_and_null_value_removes);
+  RUN_TEST(test_grows_and_keeps_every_key);
+  RUN_TEST(test_del_calls_delfunc_once);
+  RUN_TEST(test_foreach_may_delete_the_visited_entry);
+  RUN_TEST(test_foreach_stops_early);
+  return UNITY_END();
+}
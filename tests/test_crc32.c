@@ -0,0 +1,76 @@
+#include "ns_turn_crc32.h"
+
+#include <unity.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_LEN (4096)
+
+void setUp(void) {}
+void tearDown(void) {}
+
+typedef uint32_t (*crc32_fn)(const uint8_t *buf, size_t len);
+
+static const crc32_fn variants[] = {ns_turn_crc32, ns_turn_crc32_slice8, ns_turn_crc32_hw};
+
+static void test_check_value(void) {
+  /* The CRC-32/ISO-HDLC check value. */
+  static const uint8_t check[] = "123456789";
+  TEST_ASSERT_EQUAL_HEX32(0xCBF43926, ns_turn_crc32_bytewise(check, 9));
+  for (size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); ++v) {
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926, variants[v](check, 9));
+    TEST_ASSERT_EQUAL_HEX32(0, variants[v](check, 0));
+  }
+}
+
+/* Every length around the slicing and folding thresholds, at every alignment
+ * modulo 16, with the same bytes. */
+static void test_boundaries_and_alignment(void) {
+  static uint8_t buf[512 + 16];
+  srand(1);
+  for (size_t i = 0; i < sizeof(buf); ++i) {
+    buf[i] = (uint8_t)rand();
+  }
+  for (size_t off = 0; off < 16; ++off) {
+    for (size_t len = 0; len <= 512; ++len) {
+      const uint32_t expected = ns_turn_crc32_bytewise(buf + off, len);
+      for (size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); ++v) {
+        TEST_ASSERT_EQUAL_HEX32(expected, variants[v](buf + off, len));
+      }
+    }
+  }
+}
+
+static void test_random_buffers(void) {
+  static uint8_t buf[MAX_LEN + 16];
+  srand(12345);
+  for (int round = 0; round < 2000; ++round) {
+    const size_t off = (size_t)(rand() % 16);
+    const size_t len = (size_t)(rand() % (MAX_LEN + 1));
+    for (size_t i = 0; i < len; ++i) {
+      buf[off + i] = (uint8_t)rand();
+    }
+    const uint32_t expected = ns_turn_crc32_bytewise(buf + off, len);
+    for (size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); ++v) {
+      TEST_ASSERT_EQUAL_HEX32(expected, variants[v](buf + off, len));
+    }
+  }
+}
+
+static void test_hw_name_matches_availability(void) {
+  if (ns_turn_crc32_hw_available()) {
+    TEST_ASSERT_TRUE(strcmp(ns_turn_crc32_hw_name(), "none") != 0);
+  } else {
+    TEST_ASSERT_EQUAL_STRING("none", ns_turn_crc32_hw_name());
+  }
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_check_value);
+  RUN_TEST(test_boundaries_and_alignment);
+  RUN_TEST(test_random_buffers);
+  RUN_TEST(test_hw_name_matches_availability);
+  return UNITY_END();
+}
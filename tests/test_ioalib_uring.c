@@ -0,0 +1,250 @@
+#include "ns_ioalib_uring.h"
+
+#include <unity.h>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define MAX_SEEN (64)
+
+typedef struct {
+  int batches;
+  int count;
+  size_t batch_sizes[MAX_SEEN];
+  char payloads[MAX_SEEN][32];
+  uint16_t src_ports[MAX_SEEN];
+} seen_t;
+
+static ioa_uring *u;
+static int socks[2];
+static struct sockaddr_in addrs[2];
+static seen_t seen[2];
+
+static int loopback_socket(struct sockaddr_in *addr) {
+  const int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  TEST_ASSERT_TRUE(fd >= 0);
+  socklen_t len = sizeof(*addr);
+  memset(addr, 0, sizeof(*addr));
+  addr->sin_family = AF_INET;
+  addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  TEST_ASSERT_EQUAL_INT(0, bind(fd, (struct sockaddr *)addr, sizeof(*addr)));
+  TEST_ASSERT_EQUAL_INT(0, getsockname(fd, (struct sockaddr *)addr, &len));
+  return fd;
+}
+
+void setUp(void) {
+  memset(seen, 0, sizeof(seen));
+  u = NULL;
+  for (int i = 0; i < 2; ++i) {
+    socks[i] = loopback_socket(&(addrs[i]));
+  }
+}
+
+void tearDown(void) {
+  ioa_uring_free(u);
+  u = NULL;
+  for (int i = 0; i < 2; ++i) {
+    if (socks[i] >= 0) {
+      close(socks[i]);
+      socks[i] = -1;
+    }
+  }
+}
+
+static void record(void *ctx, ioa_uring_dgram *dgrams, size_t count) {
+  seen_t *s = (seen_t *)ctx;
+  if (s->batches < MAX_SEEN) {
+    s->batch_sizes[s->batches] = count;
+  }
+  ++s->batches;
+  for (size_t i = 0; i < count && s->count < MAX_SEEN; ++i) {
+    const size_t len = dgrams[i].len < 31 ? dgrams[i].len : 31;
+    memcpy(s->payloads[s->count], dgrams[i].data, len);
+    s->payloads[s->count][len] = 0;
+    TEST_ASSERT_EQUAL_UINT(sizeof(struct sockaddr_in), dgrams[i].msg.msg_namelen);
+    s->src_ports[s->count] = ntohs(((const struct sockaddr_in *)dgrams[i].msg.msg_name)->sin_port);
+    ++s->count;
+  }
+}
+
+static void send_to(int from, int to, const char *payload) {
+  TEST_ASSERT_EQUAL_INT((int)strlen(payload), (int)sendto(socks[from], payload, strlen(payload), 0,
+                                                          (const struct sockaddr *)&(addrs[to]), sizeof(addrs[to])));
+}
+
+/* Loopback sends are queued synchronously, so everything sent so far has
+ * completed once the ring fd turns readable and nothing more arrives. */
+static int poll_all(void) {
+  int total = 0;
+  for (int i = 0; i < 20; ++i) {
+    struct pollfd pfd = {ioa_uring_fd(u), POLLIN, 0};
+    if (poll(&pfd, 1, 50) <= 0) {
+      break;
+    }
+    total += ioa_uring_poll(u);
+  }
+  return total;
+}
+
+static void test_runs_from_one_source_are_batched(void) {
+  u = ioa_uring_create(8, 16, 0, 256);
+  TEST_ASSERT_NOT_NULL(u);
+  TEST_ASSERT_TRUE(ioa_uring_add_source(u, socks[0], record, NULL, &(seen[0])) >= 0);
+  TEST_ASSERT_TRUE(ioa_uring_add_source(u, socks[1], record, NULL, &(seen[1])) >= 0);
+
+  send_to(1, 0, "a1");
+  send_to(1, 0, "a2");
+  send_to(1, 0, "a3");
+  send_to(0, 1, "b1");
+  send_to(0, 1, "b2");
+  TEST_ASSERT_EQUAL_INT(5, poll_all());
+
+  TEST_ASSERT_EQUAL_INT(1, seen[0].batches);
+  TEST_ASSERT_EQUAL_UINT(3, seen[0].batch_sizes[0]);
+  TEST_ASSERT_EQUAL_STRING("a1", seen[0].payloads[0]);
+  TEST_ASSERT_EQUAL_STRING("a3", seen[0].payloads[2]);
+  TEST_ASSERT_EQUAL_UINT16(ntohs(addrs[1].sin_port), seen[0].src_ports[0]);
+  TEST_ASSERT_EQUAL_INT(1, seen[1].batches);
+  TEST_ASSERT_EQUAL_UINT(2, seen[1].batch_sizes[0]);
+  TEST_ASSERT_EQUAL_STRING("b2", seen[1].payloads[1]);
+  TEST_ASSERT_EQUAL_UINT16(ntohs(addrs[0].sin_port), seen[1].src_ports[1]);
+
+  const ioa_uring_stats *st = ioa_uring_get_stats(u);
+  TEST_ASSERT_EQUAL_UINT64(2, st->recv_batches);
+  TEST_ASSERT_EQUAL_UINT64(5, st->recv_datagrams);
+}
+
+static void test_truncated_datagrams_are_dropped(void) {
+  u = ioa_uring_create(8, 4, 0, 5);
+  TEST_ASSERT_NOT_NULL(u);
+  TEST_ASSERT_TRUE(ioa_uring_add_source(u, socks[0], record, NULL, &(seen[0])) >= 0);
+
+  send_to(1, 0, "this datagram is far too long for it");
+  send_to(1, 0, "short");
+  TEST_ASSERT_EQUAL_INT(1, poll_all());
+  TEST_ASSERT_EQUAL_STRING("short", seen[0].payloads[0]);
+  TEST_ASSERT_EQUAL_UINT64(1, ioa_uring_get_stats(u)->recv_truncated);
+}
+
+static void test_buffer_exhaustion_rearms(void) {
+  u = ioa_uring_create(8, 4, 0, 64);
+  TEST_ASSERT_NOT_NULL(u);
+  TEST_ASSERT_TRUE(ioa_uring_add_source(u, socks[0], record, NULL, &(seen[0])) >= 0);
+
+  char payload[8];
+  for (int i = 0; i < 10; ++i) {
+    snprintf(payload, sizeof(payload), "m%d", i);
+    send_to(1, 0, payload);
+  }
+  TEST_ASSERT_EQUAL_INT(10, poll_all());
+  TEST_ASSERT_EQUAL_INT(10, seen[0].count);
+  for (int i = 0; i < 10; ++i) {
+    snprintf(payload, sizeof(payload), "m%d", i);
+    TEST_ASSERT_EQUAL_STRING(payload, seen[0].payloads[i]);
+  }
+  TEST_ASSERT_TRUE(ioa_uring_get_stats(u)->recv_nobufs > 0);
+  TEST_ASSERT_TRUE(ioa_uring_get_stats(u)->recv_rearms > 0);
+}
+
+static int removing_source_id;
+
+static void record_and_remove(void *ctx, ioa_uring_dgram *dgrams, size_t count) {
+  record(ctx, dgrams, count);
+  ioa_uring_remove_source(u, removing_source_id);
+}
+
+static void test_removed_source_is_never_called_again(void) {
+  u = ioa_uring_create(8, 4, 0, 64);
+  TEST_ASSERT_NOT_NULL(u);
+  removing_source_id = ioa_uring_add_source(u, socks[0], record_and_remove, NULL, &(seen[0]));
+  TEST_ASSERT_TRUE(removing_source_id >= 0);
+
+  send_to(1, 0, "first");
+  TEST_ASSERT_EQUAL_INT(1, poll_all());
+  send_to(1, 0, "second");
+  TEST_ASSERT_EQUAL_INT(0, poll_all());
+  TEST_ASSERT_EQUAL_INT(1, seen[0].count);
+
+  /* The slot is reused with a new generation and all buffers are back. */
+  TEST_ASSERT_EQUAL_INT(removing_source_id, ioa_uring_add_source(u, socks[0], record, NULL, &(seen[1])));
+  for (int i = 0; i < 8; ++i) {
+    send_to(1, 0, "again");
+  }
+  TEST_ASSERT_EQUAL_INT(9, poll_all());
+  TEST_ASSERT_EQUAL_STRING("second", seen[1].payloads[0]);
+}
+
+static int send_results[MAX_SEEN];
+static int send_done_count;
+
+static void send_done(void *cookie, int res, void *arg) {
+  TEST_ASSERT_EQUAL_PTR(&send_done_count, arg);
+  send_results[(intptr_t)cookie] = res;
+  ++send_done_count;
+}
+
+static void test_queued_sends_go_out_in_one_submit(void) {
+  u = ioa_uring_create(8, 0, 0, 0);
+  TEST_ASSERT_NOT_NULL(u);
+  send_done_count = 0;
+
+  static const char *payloads[] = {"one", "two", "three", "four", "five"};
+  for (intptr_t i = 0; i < 5; ++i) {
+    TEST_ASSERT_EQUAL_INT(0, ioa_uring_send_queue(u, socks[0], (const struct sockaddr *)&(addrs[1]), sizeof(addrs[1]),
+                                                  payloads[i], strlen(payloads[i]), (void *)i));
+  }
+  TEST_ASSERT_EQUAL_UINT(5, ioa_uring_send_pending(u));
+  TEST_ASSERT_EQUAL_INT(5, ioa_uring_send_submit(u, send_done, &send_done_count));
+  TEST_ASSERT_EQUAL_UINT(0, ioa_uring_send_pending(u));
+  TEST_ASSERT_EQUAL_INT(5, send_done_count);
+
+  for (int i = 0; i < 5; ++i) {
+    TEST_ASSERT_EQUAL_INT((int)strlen(payloads[i]), send_results[i]);
+    char buf[32];
+    const ssize_t len = recv(socks[1], buf, sizeof(buf), MSG_DONTWAIT);
+    TEST_ASSERT_EQUAL_INT((int)strlen(payloads[i]), (int)len);
+    TEST_ASSERT_EQUAL_MEMORY(payloads[i], buf, (size_t)len);
+  }
+
+  const ioa_uring_stats *st = ioa_uring_get_stats(u);
+  TEST_ASSERT_EQUAL_UINT64(1, st->send_submits);
+  TEST_ASSERT_EQUAL_UINT64(5, st->send_sqes);
+  TEST_ASSERT_EQUAL_UINT64(0, st->send_errors);
+}
+
+static void test_send_ring_fills_up(void) {
+  u = ioa_uring_create(4, 0, 0, 0);
+  TEST_ASSERT_NOT_NULL(u);
+  send_done_count = 0;
+
+  int queued = 0;
+  while (queued < 64 && ioa_uring_send_queue(u, socks[0], (const struct sockaddr *)&(addrs[1]), sizeof(addrs[1]), "x",
+                                             1, (void *)(intptr_t)queued) == 0) {
+    ++queued;
+  }
+  TEST_ASSERT_EQUAL_INT(4, queued);
+  TEST_ASSERT_EQUAL_INT(4, ioa_uring_send_submit(u, send_done, &send_done_count));
+  TEST_ASSERT_EQUAL_INT(0, ioa_uring_send_queue(u, socks[0], (const struct sockaddr *)&(addrs[1]), sizeof(addrs[1]),
+                                                "y", 1, (void *)(intptr_t)4));
+  TEST_ASSERT_EQUAL_INT(1, ioa_uring_send_submit(u, send_done, &send_done_count));
+  TEST_ASSERT_EQUAL_INT(5, send_done_count);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  /* Kernels without multishot recvmsg (or non-Linux builds) have nothing to test. */
+  if (ioa_uring_supported()) {
+    RUN_TEST(test_runs_from_one_source_are_batched);
+    RUN_TEST(test_truncated_datagrams_are_dropped);
+    RUN_TEST(test_buffer_exhaustion_rearms);
+    RUN_TEST(test_removed_source_is_never_called_again);
+    RUN_TEST(test_queued_sends_go_out_in_one_submit);
+    RUN_TEST(test_send_ring_fills_up);
+  }
+  return UNITY_END();
+}
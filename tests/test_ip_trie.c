@@ -0,0 +1,171 @@
+#include "ns_turn_ip_trie.h"
+
+#include <unity.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_RANGES (256)
+
+static ip_range_t ranges[MAX_RANGES];
+static ip_range_list_t list;
+static ip_trie *trie;
+
+void setUp(void) {
+  memset(ranges, 0, sizeof(ranges));
+  list.rs = ranges;
+  list.ranges_number = 0;
+  trie = NULL;
+}
+void tearDown(void) { ip_trie_free(trie); }
+
+static void add_range(const char *min, const char *max, const char *realm) {
+  ip_range_t *r = &(ranges[list.ranges_number++]);
+  snprintf(r->str, sizeof(r->str), "%s-%s", min ? min : "", max ? max : "");
+  snprintf(r->realm, sizeof(r->realm), "%s", realm ? realm : "");
+  if (min) {
+    TEST_ASSERT_EQUAL_INT(0, make_ioa_addr((const uint8_t *)min, 0, &(r->enc.min)));
+  }
+  if (max) {
+    TEST_ASSERT_EQUAL_INT(0, make_ioa_addr((const uint8_t *)max, 0, &(r->enc.max)));
+  }
+}
+
+/* The reverse scan good_peer_addr() did before the trie existed. */
+static const ip_range_t *linear_match(const char *realm, const ioa_addr *addr) {
+  for (int i = (int)list.ranges_number - 1; i >= 0; --i) {
+    const char *r = ranges[i].realm;
+    if (r[0] && realm && realm[0] && strcmp(r, realm)) {
+      continue;
+    }
+    if (ioa_addr_in_range(&(ranges[i].enc), addr)) {
+      return &(ranges[i]);
+    }
+  }
+  return NULL;
+}
+
+static const ip_range_t *match(const char *realm, const char *saddr) {
+  ioa_addr addr;
+  TEST_ASSERT_EQUAL_INT(0, make_ioa_addr((const uint8_t *)saddr, 0, &addr));
+  const ip_range_t *r = ip_trie_match(trie, realm, &addr);
+  TEST_ASSERT_TRUE_MESSAGE(r == linear_match(realm, &addr), saddr);
+  return r;
+}
+
+static void test_empty(void) {
+  trie = ip_trie_create(&list);
+  TEST_ASSERT_NULL(match(NULL, "10.0.0.1"));
+  TEST_ASSERT_NULL(match("r", "::1"));
+  ip_trie_free(trie);
+  trie = ip_trie_create(NULL);
+  ioa_addr addr;
+  make_ioa_addr((const uint8_t *)"10.0.0.1", 0, &addr);
+  TEST_ASSERT_NULL(ip_trie_match(trie, NULL, &addr));
+}
+
+static void test_unaligned_ranges_and_last_match_wins(void) {
+  add_range("10.0.0.0", "10.255.255.255", NULL);
+  add_range("10.1.2.3", "10.1.9.200", NULL);
+  add_range("192.168.1.1", "192.168.1.1", NULL);
+  add_range("2001:db8::5", "2001:db8::1:0", NULL);
+  trie = ip_trie_create(&list);
+
+  TEST_ASSERT_EQUAL_PTR(&(ranges[1]), match(NULL, "10.1.2.3"));
+  TEST_ASSERT_EQUAL_PTR(&(ranges[1]), match(NULL, "10.1.9.200"));
+  TEST_ASSERT_EQUAL_PTR(&(ranges[0]), match(NULL, "10.1.2.2"));
+  TEST_ASSERT_EQUAL_PTR(&(ranges[0]), match(NULL, "10.1.9.201"));
+  TEST_ASSERT_EQUAL_PTR(&(ranges[2]), match(NULL, "192.168.1.1"));
+  TEST_ASSERT_NULL(match(NULL, "192.168.1.2"));
+  TEST_ASSERT_NULL(match(NULL, "11.0.0.0"));
+  TEST_ASSERT_EQUAL_PTR(&(ranges[3]), match(NULL, "2001:db8::ffff"));
+  TEST_ASSERT_NULL(match(NULL, "2001:db8::4"));
+  TEST_ASSERT_NULL(match(NULL, "2001:db8::1:1"));
+}
+
+static void test_realms(void) {
+  add_range("10.0.0.0", "10.0.0.255", "a.example");
+  add_range("10.0.0.0", "10.0.0.127", NULL);
+  add_range("10.0.0.64", "10.0.0.95", "b.example");
+  trie = ip_trie_create(&list);
+
+  TEST_ASSERT_EQUAL_PTR(&(ranges[2]), match(NULL, "10.0.0.70"));
+  TEST_ASSERT_EQUAL_PTR(&(ranges[2]), match("", "10.0.0.70"));
+  TEST_ASSERT_EQUAL_PTR(&(ranges[1]), match("a.example", "10.0.0.70"));
+  TEST_ASSERT_EQUAL_PTR(&(ranges[0]), match("a.example", "10.0.0.200"));
+  TEST_ASSERT_NULL(match("b.example", "10.0.0.200"));
+  TEST_ASSERT_EQUAL_PTR(&(ranges[2]), match("b.example", "10.0.0.70"));
+  TEST_ASSERT_NULL(match("c.example", "10.0.0.200"));
+}
+
+static void test_embedded_ipv4_and_open_bounds(void) {
+  add_range("1.0.0.0", "2001:db8::", NULL);
+  add_range(NULL, "1.2.3.4", NULL);
+  add_range("fc00::", NULL, NULL);
+  add_range(NULL, "::ff", NULL);
+  add_range("100.64.0.0", "100.127.255.255", NULL);
+  add_range("9.9.9.9", "9.9.9.1", NULL);
+  trie = ip_trie_create(&list);
+
+  TEST_ASSERT_EQUAL_PTR(&(ranges[4]), match(NULL, "::ffff:100.64.1.1"));
+  TEST_ASSERT_EQUAL_PTR(&(ranges[4]), match(NULL, "64:ff9b::100.100.0.1"));
+  TEST_ASSERT_EQUAL_PTR(&(ranges[4]), match(NULL, "2002:6440:0101::"));
+  match(NULL, "0.0.0.1");
+  match(NULL, "1.2.3.5");
+  match(NULL, "fe80::1");
+  match(NULL, "::1");
+  match(NULL, "::ffff:1.2.3.4");
+  match(NULL, "9.9.9.5");
+  match(NULL, "2001:db7::1");
+}
+
+static void random_addr(char *buf, size_t len, int v6) {
+  if (v6) {
+    snprintf(buf, len, "2001:db8:%x::%x:%x", rand() % 4, rand() % 0x10000, rand() % 0x10000);
+  } else {
+    snprintf(buf, len, "10.%d.%d.%d", rand() % 4, rand() % 256, rand() % 256);
+  }
+}
+
+static void test_randomized_equivalence(void) {
+  static const char *realms[] = {NULL, "a", "b", "c"};
+  srand(12345);
+  for (int round = 0; round < 20; ++round) {
+    setUp();
+    for (int i = 0; i < 64; ++i) {
+      const int v6 = rand() % 2;
+      char lo[64];
+      char hi[64];
+      random_addr(lo, sizeof(lo), v6);
+      random_addr(hi, sizeof(hi), v6);
+      ioa_addr a;
+      ioa_addr b;
+      make_ioa_addr((const uint8_t *)lo, 0, &a);
+      make_ioa_addr((const uint8_t *)hi, 0, &b);
+      if (!addr_less_eq(&a, &b) && (rand() % 8)) {
+        add_range(hi, lo, realms[rand() % 4]);
+      } else {
+        add_range(lo, hi, realms[rand() % 4]);
+      }
+    }
+    trie = ip_trie_create(&list);
+    for (int i = 0; i < 2000; ++i) {
+      char addr[64];
+      random_addr(addr, sizeof(addr), rand() % 2);
+      match(realms[rand() % 4], addr);
+      match("d", addr);
+    }
+    tearDown();
+  }
+  trie = NULL;
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_empty);
+  RUN_TEST(test_unaligned_ranges_and_last_match_wins);
+  RUN_TEST(test_realms);
+  RUN_TEST(test_embedded_ipv4_and_open_bounds);
+  RUN_TEST(test_randomized_equivalence);
+  return UNITY_END();
+}
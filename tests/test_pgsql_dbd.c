@@ -13,6 +13,9 @@
  * with values baked into the SQL and binds nothing); against the new
  * parameterized driver they pass. test_sql_injection_neutralized makes the
  * security difference explicit.
+ *
+ * The non-blocking user key lookups (--db-max-inflight) run on a real event
+ * base; the mock answers them through a socket pair per connection.
  */
 
 #include "unity.h"
@@ -20,15 +23,21 @@
 #include "apputils.h"            /* oauth_key_data_raw */
 #include "dbdrivers/dbd_pgsql.h" /* get_pgsql_dbdriver */
 #include "dbdrivers/dbdriver.h"  /* turn_dbdriver_t */
+#include "mainrelay.h"           /* turn_params */
 #include "ns_turn_msg.h"         /* password_t */
 #include "userdb.h"              /* secrets_list_t */
 
 #include "test_pgsql_stub.h"
 #include "test_sqlite_support.h" /* test_sqlite_support_init (shared relay stubs) */
 
+#include <event2/event.h>
+
 #include <string.h>
 
 static const turn_dbdriver_t *db;
+/* The driver keeps its non-blocking connections on the first base it sees, as
+ * an auth thread's base lives as long as the thread. */
+static struct event_base *base;
 
 void setUp(void) { pgstub_reset(); }
 void tearDown(void) {}
@@ -190,10 +199,89 @@ static void test_sql_injection_neutralized(void) {
   TEST_ASSERT_NULL_MESSAGE(strstr(pgstub_last_command(), "OR '1'='1"), "injection payload leaked into the SQL text");
 }
 
+#define KEY_HEX "000102030405060708090a0b0c0d0e0f10111213"
+
+typedef struct {
+  int ret;
+  int calls;
+  hmackey_t key;
+} lookup_result;
+
+static void lookup_done(int ret, void *arg) {
+  lookup_result *r = (lookup_result *)arg;
+  r->ret = ret;
+  r->calls++;
+}
+
+static void test_get_user_key_async_off(void) {
+  lookup_result r = {0};
+  turn_params.db_max_inflight = 0;
+  TEST_ASSERT_EQUAL_INT(-1, db->get_user_key_async(base, (uint8_t *)"alice", (uint8_t *)"north.gov", r.key,
+                                                   lookup_done, &r));
+  TEST_ASSERT_EQUAL_INT(0, r.calls);
+}
+
+/* Two connections in flight; the third lookup waits for one of them. */
+static void test_get_user_key_async_inflight_limit(void) {
+  lookup_result r[3];
+  memset(r, 0, sizeof(r));
+  const char *users[3] = {"alice", "bob", "carol"};
+  turn_params.db_max_inflight = 2;
+
+  for (int i = 0; i < 3; i++) {
+    TEST_ASSERT_EQUAL_INT(0, db->get_user_key_async(base, (uint8_t *)users[i], (uint8_t *)"north.gov", r[i].key,
+                                                    lookup_done, &(r[i])));
+  }
+  TEST_ASSERT_EQUAL_INT(2, pgstub_async_pending());
+  TEST_ASSERT_EQUAL_INT(2, pgstub_async_connections());
+  assert_parameterized("select hmackey from turnusers_lt where name=$1 and realm=$2", 2);
+  TEST_ASSERT_EQUAL_STRING("bob", pgstub_last_param(0));
+
+  pgstub_async_answer_all(KEY_HEX);
+  event_base_loop(base, EVLOOP_NONBLOCK);
+  TEST_ASSERT_EQUAL_INT(1, r[0].calls);
+  TEST_ASSERT_EQUAL_INT(0, r[0].ret);
+  TEST_ASSERT_EQUAL_INT(1, r[1].calls);
+  TEST_ASSERT_EQUAL_INT(0, r[1].ret);
+  TEST_ASSERT_EQUAL_UINT8(0x0f, r[1].key[15]);
+  TEST_ASSERT_EQUAL_INT(0, r[2].calls);
+
+  /* The queued lookup took over a freed connection. */
+  TEST_ASSERT_EQUAL_INT(1, pgstub_async_pending());
+  TEST_ASSERT_EQUAL_STRING("carol", pgstub_last_param(0));
+  pgstub_async_answer_all(KEY_HEX);
+  event_base_loop(base, EVLOOP_NONBLOCK);
+  TEST_ASSERT_EQUAL_INT(1, r[2].calls);
+  TEST_ASSERT_EQUAL_INT(0, r[2].ret);
+  TEST_ASSERT_EQUAL_INT(2, pgstub_async_connections());
+}
+
+static void test_get_user_key_async_broken_connection(void) {
+  lookup_result r[2];
+  memset(r, 0, sizeof(r));
+  turn_params.db_max_inflight = 2;
+
+  TEST_ASSERT_EQUAL_INT(0, db->get_user_key_async(base, (uint8_t *)"alice", (uint8_t *)"north.gov", r[0].key,
+                                                  lookup_done, &(r[0])));
+  pgstub_async_answer_all(NULL);
+  event_base_loop(base, EVLOOP_NONBLOCK);
+  TEST_ASSERT_EQUAL_INT(1, r[0].calls);
+  TEST_ASSERT_EQUAL_INT(-1, r[0].ret);
+
+  /* The next lookup opens a new connection. */
+  TEST_ASSERT_EQUAL_INT(0, db->get_user_key_async(base, (uint8_t *)"alice", (uint8_t *)"north.gov", r[1].key,
+                                                  lookup_done, &(r[1])));
+  pgstub_async_answer_all(KEY_HEX);
+  event_base_loop(base, EVLOOP_NONBLOCK);
+  TEST_ASSERT_EQUAL_INT(1, r[1].calls);
+  TEST_ASSERT_EQUAL_INT(0, r[1].ret);
+}
+
 int main(void) {
   test_sqlite_support_init("host=localhost dbname=coturn"); /* conninfo; mock ignores it */
   db = get_pgsql_dbdriver();
-  if (!db) {
+  base = event_base_new();
+  if (!db || !base) {
     return 2;
   }
 
@@ -210,5 +298,10 @@ int main(void) {
   RUN_TEST(test_permission_ip);
   RUN_TEST(test_admin_user);
   RUN_TEST(test_sql_injection_neutralized);
-  return UNITY_END();
+  RUN_TEST(test_get_user_key_async_off);
+  RUN_TEST(test_get_user_key_async_inflight_limit);
+  RUN_TEST(test_get_user_key_async_broken_connection);
+  const int ret = UNITY_END();
+  event_base_free(base);
+  return ret;
 }
@@ -9,6 +9,9 @@
  * parameter values) so the test can assert the driver keeps caller values out
  * of the SQL text. SELECTs return an empty (0-row) result, which is all the
  * tests need -- they assert the emitted command/params, not row contents.
+ * Non-blocking queries are answered by the test (pgstub_async_answer_all())
+ * through a socket pair per connection, so the driver's event handling runs
+ * for real.
  *
  * dbd_pgsql.c is compiled against the real <libpq-fe.h>, so these definitions
  * must match the real prototypes; only the implementations are fake.
@@ -17,22 +20,34 @@
 #include <libpq-fe.h>
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
 #include "test_pgsql_stub.h"
 
 /* opaque libpq types, completed here */
-struct pg_conn {
-  int dummy;
-};
 struct pg_result {
   ExecStatusType status;
+  int ntuples;
+  char value[256];
+};
+struct pg_conn {
+  int fds[2];   /* socket pair for non-blocking connections, else -1 */
+  int pending;  /* a non-blocking query waits for its answer */
+  int answered; /* the answer is in the socket */
+  int broken;
+  int delivered; /* the result went out; PQgetResult's NULL is next */
+  struct pg_result result;
 };
 
-static struct pg_conn g_conn;
 static struct pg_result g_result;
 
+#define PGSTUB_MAX_CONNS 64
+static struct pg_conn *g_async_conns[PGSTUB_MAX_CONNS];
+
 #define PGSTUB_MAX_PARAMS 8
 #define PGSTUB_STR 2048
 
@@ -69,15 +84,44 @@ static struct pg_result *result_for(const char *command) {
 
 /////////////////////// connection ///////////////////////
 
-ConnStatusType PQstatus(const PGconn *conn) {
-  (void)conn;
-  return CONNECTION_OK;
+ConnStatusType PQstatus(const PGconn *conn) { return (conn && conn->broken) ? CONNECTION_BAD : CONNECTION_OK; }
+void PQfinish(PGconn *conn) {
+  if (!conn) {
+    return;
+  }
+  for (int i = 0; i < PGSTUB_MAX_CONNS; ++i) {
+    if (g_async_conns[i] == conn) {
+      g_async_conns[i] = NULL;
+    }
+  }
+  if (conn->fds[0] >= 0) {
+    close(conn->fds[0]);
+    close(conn->fds[1]);
+  }
+  free(conn);
 }
-void PQfinish(PGconn *conn) { (void)conn; }
 PGconn *PQconnectdb(const char *conninfo) {
   (void)conninfo;
-  return &g_conn;
+  struct pg_conn *conn = calloc(1, sizeof(struct pg_conn));
+  conn->fds[0] = -1;
+  conn->fds[1] = -1;
+  return conn;
+}
+/* Non-blocking connections get the socket pair the test answers through. */
+int PQsetnonblocking(PGconn *conn, int arg) {
+  (void)arg;
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, conn->fds) < 0) {
+    return -1;
+  }
+  for (int i = 0; i < PGSTUB_MAX_CONNS; ++i) {
+    if (!g_async_conns[i]) {
+      g_async_conns[i] = conn;
+      return 0;
+    }
+  }
+  return -1;
 }
+int PQsocket(const PGconn *conn) { return conn->fds[0]; }
 PQconninfoOption *PQconninfoParse(const char *conninfo, char **errmsg) {
   (void)conninfo;
   if (errmsg) {
@@ -120,23 +164,80 @@ PGresult *PQexecParams(PGconn *conn, const char *command, int nParams, const Oid
   return result_for(g_command);
 }
 
+/////////////////////// non-blocking ///////////////////////
+
+int PQsendQueryParams(PGconn *conn, const char *command, int nParams, const Oid *paramTypes,
+                      const char *const *paramValues, const int *paramLengths, const int *paramFormats,
+                      int resultFormat) {
+  if (conn->broken || conn->pending) {
+    return 0;
+  }
+  PQexecParams(conn, command, nParams, paramTypes, paramValues, paramLengths, paramFormats, resultFormat);
+  conn->pending = 1;
+  conn->answered = 0;
+  conn->delivered = 0;
+  return 1;
+}
+int PQflush(PGconn *conn) { return conn->broken ? -1 : 0; }
+int PQconsumeInput(PGconn *conn) {
+  char buf[16];
+  while (recv(conn->fds[0], buf, sizeof(buf), MSG_DONTWAIT) > 0) {
+  }
+  return !conn->broken;
+}
+int PQisBusy(PGconn *conn) { return conn->pending && !conn->answered; }
+PGresult *PQgetResult(PGconn *conn) {
+  if (!conn->pending || !conn->answered) {
+    return NULL;
+  }
+  if (conn->delivered) {
+    conn->pending = 0;
+    return NULL;
+  }
+  conn->delivered = 1;
+  return &(conn->result);
+}
+
+int pgstub_async_pending(void) {
+  int n = 0;
+  for (int i = 0; i < PGSTUB_MAX_CONNS; ++i) {
+    n += (g_async_conns[i] && g_async_conns[i]->pending && !g_async_conns[i]->answered);
+  }
+  return n;
+}
+int pgstub_async_connections(void) {
+  int n = 0;
+  for (int i = 0; i < PGSTUB_MAX_CONNS; ++i) {
+    n += (g_async_conns[i] != NULL);
+  }
+  return n;
+}
+void pgstub_async_answer_all(const char *value) {
+  for (int i = 0; i < PGSTUB_MAX_CONNS; ++i) {
+    struct pg_conn *conn = g_async_conns[i];
+    if (conn && conn->pending && !conn->answered) {
+      conn->answered = 1;
+      conn->broken = (value == NULL);
+      conn->result.status = PGRES_TUPLES_OK;
+      conn->result.ntuples = 1;
+      snprintf(conn->result.value, sizeof(conn->result.value), "%s", value ? value : "");
+      (void)send(conn->fds[1], "x", 1, 0);
+    }
+  }
+}
+
 /////////////////////// results ///////////////////////
 
 ExecStatusType PQresultStatus(const PGresult *res) { return res ? res->status : PGRES_FATAL_ERROR; }
-int PQntuples(const PGresult *res) {
-  (void)res;
-  return 0;
-}
+int PQntuples(const PGresult *res) { return res ? res->ntuples : 0; }
 char *PQgetvalue(const PGresult *res, int tup_num, int field_num) {
-  (void)res;
   (void)tup_num;
   (void)field_num;
-  return (char *)"";
+  return res ? (char *)res->value : (char *)"";
 }
 int PQgetlength(const PGresult *res, int tup_num, int field_num) {
-  (void)res;
   (void)tup_num;
   (void)field_num;
-  return 0;
+  return res ? (int)strlen(res->value) : 0;
 }
 void PQclear(PGresult *res) { (void)res; }
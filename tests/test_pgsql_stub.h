@@ -14,4 +14,11 @@ int pgstub_last_nparams(void);         /* number of bound parameters */
 int pgstub_used_params(void);          /* 1 if via PQexecParams, 0 if PQexec */
 const char *pgstub_last_param(int i);  /* bound value i, or NULL */
 
+/* Non-blocking queries (PQsendQueryParams) wait for the test to answer them.
+ * Answering makes the connection's socket readable; the answer is one row
+ * holding `value`, or a broken connection when `value` is NULL. */
+int pgstub_async_pending(void); /* queries sent and not answered yet */
+int pgstub_async_connections(void);
+void pgstub_async_answer_all(const char *value);
+
 #endif /* TEST_PGSQL_STUB_H */
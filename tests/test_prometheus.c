@@ -39,8 +39,11 @@
 #include "prom.h"
 #include "unity.h"
 
+#include <pthread.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 /* The default registry is process-global and has no teardown in the minimal
  * client (it lives for the lifetime of turnserver), so initialize it once and
@@ -109,11 +112,175 @@ static void test_label_value_escaping(void) {
   free(out);
 }
 
+static void *inc_from_other_thread(void *arg) {
+  prom_gauge_inc((prom_gauge_t *)arg, NULL);
+  prom_gauge_inc((prom_gauge_t *)arg, NULL);
+  return NULL;
+}
+
+static void test_gauge_set_replaces_other_threads_adds(void) {
+  prom_gauge_t *g = prom_collector_registry_must_register_metric(prom_gauge_new("t_occupancy", "h", 0, NULL));
+  pthread_t thr;
+  TEST_ASSERT_EQUAL_INT(0, pthread_create(&thr, NULL, inc_from_other_thread, g));
+  pthread_join(thr, NULL);
+  prom_gauge_inc(g, NULL); /* 3, from two threads */
+
+  char *out = render();
+  TEST_ASSERT_NOT_NULL(strstr(out, "t_occupancy 3\n"));
+  free(out);
+
+  prom_gauge_set(g, 42, NULL);
+  out = render();
+  TEST_ASSERT_NOT_NULL(strstr(out, "t_occupancy 42\n"));
+  free(out);
+}
+
+/* A scrape must only ever see a value that was set, never a mix of two. */
+#define SET_ROUNDS (200000)
+
+static volatile int setter_done;
+
+static void *gauge_setter(void *arg) {
+  for (int i = 0; i < SET_ROUNDS; i++) {
+    prom_gauge_set((prom_gauge_t *)arg, (i & 1) ? 1000 : 7, NULL);
+  }
+  setter_done = 1;
+  return NULL;
+}
+
+static void test_gauge_set_is_atomic_against_scrapes(void) {
+  prom_gauge_t *g = prom_collector_registry_must_register_metric(prom_gauge_new("t_set_race", "h", 0, NULL));
+  prom_gauge_set(g, 7, NULL);
+
+  setter_done = 0;
+  pthread_t thr[2];
+  TEST_ASSERT_EQUAL_INT(0, pthread_create(&thr[0], NULL, gauge_setter, g));
+  TEST_ASSERT_EQUAL_INT(0, pthread_create(&thr[1], NULL, gauge_setter, g));
+  int scrapes = 0;
+  while (!setter_done || (scrapes == 0)) {
+    char *out = render();
+    const char *line = strstr(out, "\nt_set_race ");
+    TEST_ASSERT_NOT_NULL(line);
+    const long v = strtol(line + strlen("\nt_set_race "), NULL, 10);
+    TEST_ASSERT_TRUE((v == 7) || (v == 1000));
+    free(out);
+    scrapes++;
+  }
+  pthread_join(thr[0], NULL);
+  pthread_join(thr[1], NULL);
+}
+
+/* Relay threads finishing sessions with --prometheus-username-labels: every
+ * thread bumps per-user traffic counters (one user shared by all threads, one
+ * of its own) and the unlabelled totals, while a scraper renders throughout. */
+#define STRESS_THREADS (8)
+#define STRESS_UPDATES (100000)
+
+typedef struct {
+  prom_counter_t *traffic;
+  prom_counter_t *total;
+  int id;
+  unsigned shard;
+  double ns_per_update;
+} stress_arg;
+
+static double now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static void *stress_worker(void *arg) {
+  stress_arg *sa = (stress_arg *)arg;
+  char user[16];
+  snprintf(user, sizeof(user), "user%d", sa->id);
+  const char *own[] = {"north.gov", user};
+  const char *shared[] = {"north.gov", "bob"};
+  sa->shard = prom_thread_shard();
+  const double start = now_ns();
+  for (int i = 0; i < STRESS_UPDATES; i++) {
+    prom_counter_add(sa->traffic, 1, own);
+    prom_counter_add(sa->traffic, 2, shared);
+    prom_counter_add(sa->total, 3, NULL);
+  }
+  sa->ns_per_update = (now_ns() - start) / (3.0 * STRESS_UPDATES);
+  return NULL;
+}
+
+static volatile int stress_done;
+
+static void *stress_scraper(void *arg) {
+  int *scrapes = (int *)arg;
+  while (!stress_done) {
+    free(prom_collector_registry_bridge(PROM_COLLECTOR_REGISTRY_DEFAULT));
+    (*scrapes)++;
+  }
+  return NULL;
+}
+
+static void test_concurrent_updates_do_not_share_shards(void) {
+  const char *keys[] = {"realm", "user"};
+  prom_counter_t *traffic =
+      prom_collector_registry_must_register_metric(prom_counter_new("t_stress_traffic", "h", 2, keys));
+  prom_counter_t *total =
+      prom_collector_registry_must_register_metric(prom_counter_new("t_stress_total", "h", 0, NULL));
+
+  /* Baseline: one thread alone, as user<STRESS_THREADS>. */
+  stress_arg alone = {traffic, total, STRESS_THREADS, 0, 0.0};
+  pthread_t thr[STRESS_THREADS];
+  TEST_ASSERT_EQUAL_INT(0, pthread_create(&thr[0], NULL, stress_worker, &alone));
+  pthread_join(thr[0], NULL);
+
+  int scrapes = 0;
+  pthread_t scraper;
+  stress_done = 0;
+  TEST_ASSERT_EQUAL_INT(0, pthread_create(&scraper, NULL, stress_scraper, &scrapes));
+  stress_arg args[STRESS_THREADS];
+  for (int i = 0; i < STRESS_THREADS; i++) {
+    args[i] = (stress_arg){traffic, total, i, 0, 0.0};
+    TEST_ASSERT_EQUAL_INT(0, pthread_create(&thr[i], NULL, stress_worker, &args[i]));
+  }
+  double worst = 0.0;
+  for (int i = 0; i < STRESS_THREADS; i++) {
+    pthread_join(thr[i], NULL);
+    worst = args[i].ns_per_update > worst ? args[i].ns_per_update : worst;
+  }
+  stress_done = 1;
+  pthread_join(scraper, NULL);
+
+  /* Each worker wrote its own shard. */
+  for (int i = 0; i < STRESS_THREADS; i++) {
+    for (int j = i + 1; j < STRESS_THREADS; j++) {
+      TEST_ASSERT_NOT_EQUAL(args[i].shard, args[j].shard);
+    }
+  }
+
+  char expect[128];
+  char *out = render();
+  snprintf(expect, sizeof(expect), "t_stress_traffic{realm=\"north.gov\",user=\"bob\"} %d\n",
+           2 * STRESS_UPDATES * (STRESS_THREADS + 1));
+  TEST_ASSERT_NOT_NULL(strstr(out, expect));
+  for (int i = 0; i <= STRESS_THREADS; i++) {
+    snprintf(expect, sizeof(expect), "t_stress_traffic{realm=\"north.gov\",user=\"user%d\"} %d\n", i,
+             STRESS_UPDATES);
+    TEST_ASSERT_NOT_NULL(strstr(out, expect));
+  }
+  snprintf(expect, sizeof(expect), "t_stress_total %d\n", 3 * STRESS_UPDATES * (STRESS_THREADS + 1));
+  TEST_ASSERT_NOT_NULL(strstr(out, expect));
+  free(out);
+
+  printf("ns per update: %.1f alone, %.1f worst of %d threads; %d concurrent scrapes\n", alone.ns_per_update, worst,
+         STRESS_THREADS, scrapes);
+}
+
 int main(void) {
   UNITY_BEGIN();
   RUN_TEST(test_counter_accumulates_per_label_set);
   RUN_TEST(test_counter_ignores_negative_delta);
   RUN_TEST(test_gauge_inc_dec);
   RUN_TEST(test_label_value_escaping);
+  RUN_TEST(test_gauge_set_replaces_other_threads_adds);
+  RUN_TEST(test_gauge_set_is_atomic_against_scrapes);
+  RUN_TEST(test_concurrent_updates_do_not_share_shards);
   return UNITY_END();
 }
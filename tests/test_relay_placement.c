@@ -0,0 +1,123 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * https://opensource.org/license/bsd-3-clause
+ *
+ * Tests for the relay thread placement policies in
+ * src/apps/relay/netengine.c (--relay-placement). netengine.c is compiled
+ * into this translation unit, as in test_alt_server_list.c, to reach the
+ * static place_socket_on_relay(); the relay threads are plain structs whose
+ * published load the tests set directly.
+ */
+
+#include <unity.h>
+
+#include <string.h>
+
+#include "netengine.c"
+
+turn_params_t turn_params;
+
+#define THREADS (4)
+
+static struct relay_server threads[THREADS];
+
+static void set_load(int i, uint32_t sessions, uint32_t bps) {
+  turn_atomic_store_u32(&(threads[i].server.load_sessions), sessions);
+  turn_atomic_store_u32(&(threads[i].server.load_bps), bps);
+}
+
+void setUp(void) {
+  memset(threads, 0, sizeof(threads));
+  turn_params.general_relay_servers_number = THREADS;
+  for (int i = 0; i < THREADS; i++) {
+    threads[i].id = (turnserver_id)i;
+    general_relay_servers[i] = &(threads[i]);
+  }
+}
+
+void tearDown(void) {
+  for (int i = 0; i < THREADS; i++) {
+    general_relay_servers[i] = NULL;
+  }
+}
+
+static void test_listener_keeps_the_accepting_thread(void) {
+  turn_params.relay_placement = RELAY_PLACEMENT_LISTENER;
+  set_load(0, 100, 1000000);
+  TEST_ASSERT_EQUAL_PTR(&(threads[0]), place_socket_on_relay(&(threads[0])));
+}
+
+static void test_least_loaded_picks_fewest_sessions(void) {
+  turn_params.relay_placement = RELAY_PLACEMENT_LEAST_LOADED;
+  set_load(0, 10, 0);
+  set_load(1, 5, 0);
+  set_load(2, 2, 0);
+  set_load(3, 7, 0);
+  TEST_ASSERT_EQUAL_PTR(&(threads[2]), place_socket_on_relay(&(threads[0])));
+}
+
+static void test_least_loaded_weighs_traffic(void) {
+  turn_params.relay_placement = RELAY_PLACEMENT_LEAST_LOADED;
+  /* Same sessions everywhere; thread 1 relays far less. */
+  for (int i = 0; i < THREADS; i++) {
+    set_load(i, 4, 1000000);
+  }
+  set_load(1, 4, 1000);
+  TEST_ASSERT_EQUAL_PTR(&(threads[1]), place_socket_on_relay(&(threads[3])));
+}
+
+static void test_ties_keep_the_accepting_thread(void) {
+  turn_params.relay_placement = RELAY_PLACEMENT_LEAST_LOADED;
+  for (int i = 0; i < THREADS; i++) {
+    set_load(i, 3, 5000);
+  }
+  TEST_ASSERT_EQUAL_PTR(&(threads[2]), place_socket_on_relay(&(threads[2])));
+}
+
+static void test_in_flight_connections_count(void) {
+  turn_params.relay_placement = RELAY_PLACEMENT_LEAST_LOADED;
+  /* Thread 1 looks idle, but a burst of connections is on its way there. */
+  set_load(0, 3, 0);
+  set_load(1, 0, 0);
+  set_load(2, 3, 0);
+  set_load(3, 3, 0);
+  turn_atomic_store_u32(&(threads[1].placed), 5);
+  TEST_ASSERT_EQUAL_PTR(&(threads[0]), place_socket_on_relay(&(threads[0])));
+}
+
+static void test_two_choices_never_moves_to_a_heavier_thread(void) {
+  turn_params.relay_placement = RELAY_PLACEMENT_TWO_CHOICES;
+  set_load(0, 50, 0);
+  set_load(1, 10, 0);
+  set_load(2, 20, 0);
+  set_load(3, 60, 0);
+  int moved = 0;
+  for (int i = 0; i < 200; i++) {
+    struct relay_server *rs = place_socket_on_relay(&(threads[2]));
+    TEST_ASSERT_TRUE((rs == &(threads[2])) || (rs == &(threads[1])));
+    moved += (rs == &(threads[1]));
+  }
+  /* One in four samples is thread 1. */
+  TEST_ASSERT_TRUE(moved > 0);
+  TEST_ASSERT_TRUE(moved < 200);
+}
+
+static void test_single_thread_is_left_alone(void) {
+  turn_params.relay_placement = RELAY_PLACEMENT_LEAST_LOADED;
+  turn_params.general_relay_servers_number = 1;
+  set_load(0, 100, 0);
+  TEST_ASSERT_EQUAL_PTR(&(threads[0]), place_socket_on_relay(&(threads[0])));
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_listener_keeps_the_accepting_thread);
+  RUN_TEST(test_least_loaded_picks_fewest_sessions);
+  RUN_TEST(test_least_loaded_weighs_traffic);
+  RUN_TEST(test_ties_keep_the_accepting_thread);
+  RUN_TEST(test_in_flight_connections_count);
+  RUN_TEST(test_two_choices_never_moves_to_a_heavier_thread);
+  RUN_TEST(test_single_thread_is_left_alone);
+  return UNITY_END();
+}
@@ -0,0 +1,182 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * https://opensource.org/license/bsd-3-clause
+ *
+ * Tests for the inter-thread message queue in src/apps/relay/relay_queue.c:
+ * ordering, the bound, depth accounting, concurrent producers, and the
+ * eventfd wakeup that drains the queue on its event base.
+ */
+
+#include "relay_queue.h"
+
+#include <unity.h>
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+
+#define PRODUCERS (4)
+#define PER_PRODUCER (50000)
+
+/* Messages are tagged pointers, never dereferenced: producer in the top bits,
+ * sequence number below. Zero is not a valid message. */
+#define MSG(p, n) ((void *)(((uintptr_t)(p) << 24) | ((uintptr_t)(n) + 1)))
+#define MSG_PRODUCER(m) ((unsigned)((uintptr_t)(m) >> 24))
+#define MSG_SEQ(m) ((unsigned)(((uintptr_t)(m) & 0xffffff) - 1))
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static void test_fifo_and_bound(void) {
+  relay_queue *q = relay_queue_new(NULL, 5, NULL, NULL);
+  TEST_ASSERT_NOT_NULL(q);
+  TEST_ASSERT_NULL(relay_queue_pop(q));
+
+  /* Rounded up to 8. */
+  for (unsigned i = 0; i < 8; i++) {
+    TEST_ASSERT_EQUAL_INT(0, relay_queue_push(q, MSG(0, i)));
+  }
+  TEST_ASSERT_EQUAL_INT(-1, relay_queue_push(q, MSG(0, 8)));
+  TEST_ASSERT_EQUAL_UINT32(8, relay_queue_depth(q));
+
+  for (unsigned i = 0; i < 8; i++) {
+    TEST_ASSERT_EQUAL_PTR(MSG(0, i), relay_queue_pop(q));
+  }
+  TEST_ASSERT_NULL(relay_queue_pop(q));
+  TEST_ASSERT_EQUAL_UINT32(0, relay_queue_depth(q));
+  TEST_ASSERT_EQUAL_UINT32(8, relay_queue_high_water(q));
+
+  /* Positions keep going around the ring. */
+  for (unsigned i = 0; i < 100; i++) {
+    TEST_ASSERT_EQUAL_INT(0, relay_queue_push(q, MSG(1, i)));
+    TEST_ASSERT_EQUAL_INT(0, relay_queue_push(q, MSG(2, i)));
+    TEST_ASSERT_EQUAL_PTR(MSG(1, i), relay_queue_pop(q));
+    TEST_ASSERT_EQUAL_PTR(MSG(2, i), relay_queue_pop(q));
+  }
+  TEST_ASSERT_EQUAL_UINT32(8, relay_queue_high_water(q));
+
+  TEST_ASSERT_EQUAL_INT(-1, relay_queue_push(q, NULL));
+  relay_queue_free(q);
+}
+
+typedef struct {
+  relay_queue *q;
+  unsigned id;
+  unsigned full; /* pushes refused while the consumer lagged */
+} producer_arg;
+
+static void *producer(void *arg) {
+  producer_arg *pa = (producer_arg *)arg;
+  for (unsigned i = 0; i < PER_PRODUCER; i++) {
+    while (relay_queue_push(pa->q, MSG(pa->id + 1, i)) < 0) {
+      pa->full++;
+      sched_yield();
+    }
+  }
+  return NULL;
+}
+
+static void test_concurrent_producers(void) {
+  relay_queue *q = relay_queue_new(NULL, 1024, NULL, NULL);
+  TEST_ASSERT_NOT_NULL(q);
+
+  pthread_t thr[PRODUCERS];
+  producer_arg args[PRODUCERS];
+  for (unsigned i = 0; i < PRODUCERS; i++) {
+    args[i].q = q;
+    args[i].id = i;
+    args[i].full = 0;
+    TEST_ASSERT_EQUAL_INT(0, pthread_create(&thr[i], NULL, producer, &args[i]));
+  }
+
+  /* Every message arrives once, and each producer's in its own order. */
+  unsigned next[PRODUCERS + 1] = {0};
+  unsigned total = 0;
+  while (total < PRODUCERS * PER_PRODUCER) {
+    void *m = relay_queue_pop(q);
+    if (m) {
+      const unsigned p = MSG_PRODUCER(m);
+      TEST_ASSERT_TRUE((p >= 1) && (p <= PRODUCERS));
+      TEST_ASSERT_EQUAL_UINT(next[p], MSG_SEQ(m));
+      next[p]++;
+      total++;
+    } else {
+      sched_yield();
+    }
+  }
+
+  for (unsigned i = 0; i < PRODUCERS; i++) {
+    pthread_join(thr[i], NULL);
+  }
+  TEST_ASSERT_NULL(relay_queue_pop(q));
+  TEST_ASSERT_EQUAL_UINT32(0, relay_queue_depth(q));
+  TEST_ASSERT_TRUE(relay_queue_high_water(q) <= 1024);
+  relay_queue_free(q);
+}
+
+typedef struct {
+  struct event_base *base;
+  unsigned received;
+  unsigned expected;
+  unsigned next[PRODUCERS + 1];
+  int out_of_order;
+} consumer_state;
+
+static void consume(void *msg, void *arg) {
+  consumer_state *cs = (consumer_state *)arg;
+  const unsigned p = MSG_PRODUCER(msg);
+  if ((p > PRODUCERS) || (cs->next[p] != MSG_SEQ(msg))) {
+    cs->out_of_order++;
+  } else {
+    cs->next[p]++;
+  }
+  if (++cs->received == cs->expected) {
+    event_base_loopbreak(cs->base);
+  }
+}
+
+static void test_wakeup_drains_on_event_base(void) {
+  consumer_state cs = {0};
+  cs.base = event_base_new();
+  TEST_ASSERT_NOT_NULL(cs.base);
+  relay_queue *q = relay_queue_new(cs.base, RELAY_QUEUE_SIZE_DEFAULT, consume, &cs);
+  TEST_ASSERT_NOT_NULL(q);
+
+  /* More than one batch queued before the loop runs. */
+  for (unsigned i = 0; i < 3 * RELAY_QUEUE_BATCH + 1; i++) {
+    TEST_ASSERT_EQUAL_INT(0, relay_queue_push(q, MSG(0, i)));
+  }
+  cs.expected = 3 * RELAY_QUEUE_BATCH + 1;
+  TEST_ASSERT_EQUAL_INT(0, event_base_dispatch(cs.base));
+  TEST_ASSERT_EQUAL_UINT(cs.expected, cs.received);
+
+  /* Then producers on other threads, while the loop runs. */
+  pthread_t thr[PRODUCERS];
+  producer_arg args[PRODUCERS];
+  cs.expected += PRODUCERS * PER_PRODUCER;
+  for (unsigned i = 0; i < PRODUCERS; i++) {
+    args[i].q = q;
+    args[i].id = i;
+    args[i].full = 0;
+    TEST_ASSERT_EQUAL_INT(0, pthread_create(&thr[i], NULL, producer, &args[i]));
+  }
+  TEST_ASSERT_EQUAL_INT(0, event_base_dispatch(cs.base));
+  for (unsigned i = 0; i < PRODUCERS; i++) {
+    pthread_join(thr[i], NULL);
+  }
+
+  TEST_ASSERT_EQUAL_UINT(cs.expected, cs.received);
+  TEST_ASSERT_EQUAL_INT(0, cs.out_of_order);
+  TEST_ASSERT_EQUAL_UINT32(0, relay_queue_depth(q));
+  relay_queue_free(q);
+  event_base_free(cs.base);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_fifo_and_bound);
+  RUN_TEST(test_concurrent_producers);
+  RUN_TEST(test_wakeup_drains_on_event_base);
+  return UNITY_END();
+}
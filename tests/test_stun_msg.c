@@ -775,6 +775,228 @@ static void test_covered_walk_hides_message_integrity_sha256_from_420(void) {
   TEST_ASSERT_EQUAL_INT(0, count_attrs_of_type(buf, len, TEST_ATTR_MESSAGE_INTEGRITY_SHA256, true));
 }
 
+static void test_attr_index_matches_linear_lookup(void) {
+  uint8_t buf[1024] = {0};
+  size_t len = 0;
+  uint8_t sha256_hmac[32] = {0};
+
+  build_authenticated_allocate(buf, &len);
+  TEST_ASSERT_TRUE(stun_attr_add_str(buf, &len, STUN_ATTRIBUTE_LIFETIME, TEST_LIFETIME_1, 4));
+  TEST_ASSERT_TRUE(stun_attr_add_str(buf, &len, TEST_ATTR_MESSAGE_INTEGRITY_SHA256, sha256_hmac, 32));
+
+  stun_attr_index idx;
+  stun_attr_index_build(buf, len, &idx);
+  uint16_t walked = 0;
+  for (stun_attr_ref sar = stun_attr_get_first_str(buf, len); sar; sar = stun_attr_get_next_str(buf, len, sar)) {
+    ++walked;
+  }
+  TEST_ASSERT_EQUAL_UINT16(walked, idx.count);
+
+  /* Indexed, absent, and not indexed at all. */
+  const uint16_t types[] = {STUN_ATTRIBUTE_USERNAME,           STUN_ATTRIBUTE_REALM,
+                            STUN_ATTRIBUTE_NONCE,              STUN_ATTRIBUTE_MESSAGE_INTEGRITY,
+                            STUN_ATTRIBUTE_LIFETIME,           STUN_ATTRIBUTE_REQUESTED_TRANSPORT,
+                            STUN_ATTRIBUTE_ORIGIN,             STUN_ATTRIBUTE_XOR_PEER_ADDRESS,
+                            TEST_ATTR_MESSAGE_INTEGRITY_SHA256, STUN_ATTRIBUTE_BANDWIDTH};
+  for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); ++i) {
+    TEST_ASSERT_EQUAL_PTR(stun_attr_get_first_by_type_str(buf, len, types[i]),
+                          stun_attr_index_first(&idx, buf, len, types[i]));
+  }
+  TEST_ASSERT_TRUE(stun_attr_index_has(&idx, STUN_ATTRIBUTE_NONCE));
+  TEST_ASSERT_FALSE(stun_attr_index_has(&idx, STUN_ATTRIBUTE_ORIGIN));
+
+  /* The trailing LIFETIME is the last one, not the first. */
+  stun_attr_ref last = stun_attr_index_last(&idx, buf, len, STUN_ATTRIBUTE_LIFETIME);
+  TEST_ASSERT_NOT_NULL(last);
+  TEST_ASSERT_TRUE(last != stun_attr_index_first(&idx, buf, len, STUN_ATTRIBUTE_LIFETIME));
+  TEST_ASSERT_EQUAL_MEMORY(TEST_LIFETIME_1, stun_attr_get_value(last), 4);
+  TEST_ASSERT_NOT_NULL(stun_attr_index_last(&idx, buf, len, TEST_ATTR_MESSAGE_INTEGRITY_SHA256));
+}
+
+static void test_attr_index_integrity_check(void) {
+  uint8_t buf[1024] = {0};
+  size_t len = 0;
+  hmackey_t key;
+
+  build_authenticated_allocate(buf, &len);
+  test_integrity_key(key);
+
+  stun_attr_index idx;
+  stun_attr_index_build(buf, len, &idx);
+  TEST_ASSERT_EQUAL_INT(1, stun_check_message_integrity_by_key_idx_str(TURN_CREDENTIALS_LONG_TERM, buf, len, &idx, key,
+                                                                       NULL, SHATYPE_DEFAULT));
+  key[0] ^= 1;
+  TEST_ASSERT_EQUAL_INT(0, stun_check_message_integrity_by_key_idx_str(TURN_CREDENTIALS_LONG_TERM, buf, len, &idx, key,
+                                                                       NULL, SHATYPE_DEFAULT));
+
+  /* No MESSAGE-INTEGRITY, nothing to check against. */
+  len = 0;
+  stun_init_request_str(STUN_METHOD_REFRESH, buf, &len);
+  TEST_ASSERT_TRUE(stun_attr_add_str(buf, &len, STUN_ATTRIBUTE_LIFETIME, TEST_LIFETIME_600, 4));
+  stun_attr_index_build(buf, len, &idx);
+  TEST_ASSERT_EQUAL_UINT16(1, idx.count);
+  TEST_ASSERT_EQUAL_INT(-1, stun_check_message_integrity_by_key_idx_str(TURN_CREDENTIALS_LONG_TERM, buf, len, &idx,
+                                                                        key, NULL, SHATYPE_DEFAULT));
+}
+
+static void test_hmac_ctx_matches_one_shot_hmac(void) {
+  static const uint8_t msg[] = "The quick brown fox jumps over the lazy dog";
+  static const uint8_t key2[] = "another key";
+  hmackey_t key;
+  test_integrity_key(key);
+
+  stun_hmac_ctx hc;
+  memset(&hc, 0, sizeof(hc));
+  const SHATYPE types[] = {SHATYPE_SHA1, SHATYPE_SHA256, SHATYPE_SHA1};
+  for (size_t t = 0; t < sizeof(types) / sizeof(types[0]); ++t) {
+    uint8_t expected[MAXSHASIZE] = {0};
+    unsigned int expected_len = 0;
+    TEST_ASSERT_TRUE(stun_calculate_hmac(msg, sizeof(msg) - 1, key, 16, expected, &expected_len, types[t]));
+
+    /* Twice with the same key, the second time from the saved state, and
+       in pieces. */
+    for (int round = 0; round < 2; ++round) {
+      uint8_t got[MAXSHASIZE] = {0};
+      unsigned int got_len = 0;
+      TEST_ASSERT_TRUE(stun_hmac_ctx_begin(&hc, key, 16, types[t]));
+      TEST_ASSERT_TRUE(stun_hmac_ctx_update(&hc, msg, 10));
+      TEST_ASSERT_TRUE(stun_hmac_ctx_update(&hc, msg + 10, sizeof(msg) - 1 - 10));
+      TEST_ASSERT_TRUE(stun_hmac_ctx_final(&hc, got, &got_len));
+      TEST_ASSERT_EQUAL_UINT(expected_len, got_len);
+      TEST_ASSERT_EQUAL_MEMORY(expected, got, expected_len);
+    }
+  }
+
+  /* A different key re-keys the context. */
+  uint8_t expected[MAXSHASIZE] = {0};
+  uint8_t got[MAXSHASIZE] = {0};
+  unsigned int expected_len = 0;
+  unsigned int got_len = 0;
+  TEST_ASSERT_TRUE(
+      stun_calculate_hmac(msg, sizeof(msg) - 1, key2, sizeof(key2) - 1, expected, &expected_len, SHATYPE_SHA1));
+  TEST_ASSERT_TRUE(stun_hmac_ctx_begin(&hc, key2, sizeof(key2) - 1, SHATYPE_SHA1));
+  TEST_ASSERT_TRUE(stun_hmac_ctx_update(&hc, msg, sizeof(msg) - 1));
+  TEST_ASSERT_TRUE(stun_hmac_ctx_final(&hc, got, &got_len));
+  TEST_ASSERT_EQUAL_MEMORY(expected, got, expected_len);
+
+  stun_hmac_ctx_clean(&hc);
+  TEST_ASSERT_NULL(hc.mac);
+}
+
+static void test_hmac_ctx_signs_and_verifies_messages(void) {
+  hmackey_t key;
+  test_integrity_key(key);
+  stun_hmac_ctx hc;
+  memset(&hc, 0, sizeof(hc));
+
+  for (int i = 0; i < 3; ++i) {
+    uint8_t one_shot[1024] = {0};
+    uint8_t kept[1024] = {0};
+    size_t one_shot_len = 0;
+    size_t kept_len = 0;
+    const uint8_t lifetime[4] = {0, 0, 0, (uint8_t)i};
+
+    stun_init_request_str(STUN_METHOD_REFRESH, one_shot, &one_shot_len);
+    TEST_ASSERT_TRUE(stun_attr_add_str(one_shot, &one_shot_len, STUN_ATTRIBUTE_LIFETIME, lifetime, 4));
+    memcpy(kept, one_shot, one_shot_len);
+    kept_len = one_shot_len;
+
+    TEST_ASSERT_TRUE(stun_attr_add_integrity_str(TURN_CREDENTIALS_LONG_TERM, one_shot, &one_shot_len, key, NULL,
+                                                 SHATYPE_DEFAULT));
+    TEST_ASSERT_TRUE(stun_attr_add_integrity_ctx_str(&hc, TURN_CREDENTIALS_LONG_TERM, kept, &kept_len, key, NULL,
+                                                     SHATYPE_DEFAULT));
+    TEST_ASSERT_EQUAL_size_t(one_shot_len, kept_len);
+    TEST_ASSERT_EQUAL_MEMORY(one_shot, kept, kept_len);
+
+    TEST_ASSERT_EQUAL_INT(1, stun_check_message_integrity_ctx_str(&hc, TURN_CREDENTIALS_LONG_TERM, kept, kept_len, NULL,
+                                                                  key, NULL, SHATYPE_DEFAULT));
+  }
+
+  uint8_t buf[1024] = {0};
+  size_t len = 0;
+  build_authenticated_allocate(buf, &len);
+  stun_attr_index idx;
+  stun_attr_index_build(buf, len, &idx);
+  TEST_ASSERT_EQUAL_INT(1, stun_check_message_integrity_ctx_str(&hc, TURN_CREDENTIALS_LONG_TERM, buf, len, &idx, key,
+                                                                NULL, SHATYPE_DEFAULT));
+  key[3] ^= 0x40;
+  TEST_ASSERT_EQUAL_INT(0, stun_check_message_integrity_ctx_str(&hc, TURN_CREDENTIALS_LONG_TERM, buf, len, &idx, key,
+                                                                NULL, SHATYPE_DEFAULT));
+
+  stun_hmac_ctx_clean(&hc);
+}
+
+/* Templates must produce what the attribute-by-attribute build did. */
+static void test_resp_template_matches_generic_build(void) {
+  stun_tid tid;
+  stun_tid_generate(&tid);
+
+  static const uint16_t methods[] = {STUN_METHOD_REFRESH, STUN_METHOD_CREATE_PERMISSION, STUN_METHOD_CHANNEL_BIND};
+  for (size_t i = 0; i < sizeof(methods) / sizeof(methods[0]); ++i) {
+    const bool with_lifetime = (methods[i] == STUN_METHOD_REFRESH);
+    uint8_t generic[256] = {0};
+    uint8_t fast[256];
+    size_t generic_len = 0;
+    size_t fast_len = 0;
+    memset(fast, 0xa5, sizeof(fast));
+
+    stun_init_success_response_str(methods[i], generic, &generic_len, &tid);
+    if (with_lifetime) {
+      const uint32_t lt = nswap32(600);
+      TEST_ASSERT_TRUE(stun_attr_add_str(generic, &generic_len, STUN_ATTRIBUTE_LIFETIME, (const uint8_t *)&lt, 4));
+    }
+
+    stun_resp_template t;
+    stun_resp_template_init(&t, methods[i], with_lifetime);
+    stun_resp_template_emit_str(&t, fast, &fast_len, &tid, 600);
+
+    TEST_ASSERT_EQUAL_size_t(generic_len, fast_len);
+    TEST_ASSERT_EQUAL_MEMORY(generic, fast, fast_len);
+    TEST_ASSERT_TRUE(stun_is_success_response_str(fast, fast_len));
+    TEST_ASSERT_EQUAL_UINT16(methods[i], stun_get_method_str(fast, fast_len));
+
+    stun_tid got;
+    stun_tid_from_message_str(fast, fast_len, &got);
+    TEST_ASSERT_TRUE(stun_tid_equals(&tid, &got));
+  }
+}
+
+static void test_attr_image_matches_attr_add(void) {
+  /* Lengths around the padding boundary. */
+  static const char *values[] = {"", "a", "abcd", "Coturn-4.x 'Gorst'"};
+  for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); ++i) {
+    uint8_t generic[256] = {0};
+    uint8_t fast[256];
+    size_t generic_len = 0;
+    size_t fast_len = 0;
+    memset(fast, 0xa5, sizeof(fast));
+
+    stun_init_request_str(STUN_METHOD_BINDING, generic, &generic_len);
+    memcpy(fast, generic, generic_len);
+    fast_len = generic_len;
+
+    TEST_ASSERT_TRUE(stun_attr_add_str(generic, &generic_len, STUN_ATTRIBUTE_SOFTWARE, (const uint8_t *)values[i],
+                                       (int)strlen(values[i])));
+    stun_attr_image a;
+    TEST_ASSERT_TRUE(
+        stun_attr_image_init(&a, STUN_ATTRIBUTE_SOFTWARE, (const uint8_t *)values[i], strlen(values[i])));
+    TEST_ASSERT_TRUE(stun_attr_image_add_str(&a, fast, &fast_len));
+
+    TEST_ASSERT_EQUAL_size_t(generic_len, fast_len);
+    TEST_ASSERT_EQUAL_MEMORY(generic, fast, fast_len);
+  }
+
+  /* Too long to pre-encode: the caller keeps the generic path. */
+  uint8_t big[STUN_ATTR_IMAGE_SIZE] = {0};
+  stun_attr_image a;
+  TEST_ASSERT_FALSE(stun_attr_image_init(&a, STUN_ATTRIBUTE_SOFTWARE, big, sizeof(big)));
+  uint8_t buf[64] = {0};
+  size_t len = 0;
+  stun_init_request_str(STUN_METHOD_BINDING, buf, &len);
+  TEST_ASSERT_FALSE(stun_attr_image_add_str(&a, buf, &len));
+  TEST_ASSERT_EQUAL_size_t(STUN_HEADER_LENGTH, len);
+}
+
 /* RFC 8656 par. 12: ChannelBind may only establish channels 0x4000-0x4FFF;
    0x5000-0xFFFF is reserved for RFC 7983 demultiplexing. The receive-side
    macro deliberately keeps the RFC 5766 range so legacy ChannelData frames
@@ -915,6 +1137,12 @@ int main(void) {
   RUN_TEST(test_covered_walk_yields_message_integrity_itself);
   RUN_TEST(test_covered_walk_is_full_walk_without_message_integrity);
   RUN_TEST(test_covered_walk_hides_message_integrity_sha256_from_420);
+  RUN_TEST(test_attr_index_matches_linear_lookup);
+  RUN_TEST(test_attr_index_integrity_check);
+  RUN_TEST(test_hmac_ctx_matches_one_shot_hmac);
+  RUN_TEST(test_hmac_ctx_signs_and_verifies_messages);
+  RUN_TEST(test_resp_template_matches_generic_build);
+  RUN_TEST(test_attr_image_matches_attr_add);
   RUN_TEST(test_channel_bind_macro_is_strict_rfc8656_range);
   RUN_TEST(test_channel_bind_request_stays_in_rfc8656_range);
   RUN_TEST(test_channel_bind_request_keeps_explicit_valid_channel);
@@ -0,0 +1,200 @@
+#include "ns_turn_timer_wheel.h"
+
+#include <unity.h>
+
+#include <stddef.h>
+
+#define TEST_ENTRIES (512)
+
+typedef struct {
+  turn_timer_wheel_entry entry;
+  turn_time_t fired_at;
+  int fired;
+} test_timer;
+
+static turn_timer_wheel wheel;
+static test_timer timers[TEST_ENTRIES];
+
+static void fire_cb(turn_timer_wheel_entry *entry, void *arg) {
+  test_timer *t = (test_timer *)((char *)entry - offsetof(test_timer, entry));
+  t->fired_at = *(const turn_time_t *)arg;
+  ++(t->fired);
+}
+
+/* Advance one second at a time, as the relay's 1-second timer does. */
+static size_t run_until(turn_time_t end) {
+  size_t fired = 0;
+  while (turn_time_before(wheel.now, end)) {
+    turn_time_t now = wheel.now + 1;
+    fired += turn_timer_wheel_advance(&wheel, now, fire_cb, &now);
+  }
+  return fired;
+}
+
+void setUp(void) {
+  turn_timer_wheel_init(&wheel, 1000);
+  for (size_t i = 0; i < TEST_ENTRIES; ++i) {
+    timers[i] = (test_timer){0};
+  }
+}
+void tearDown(void) {}
+
+static void test_fires_exactly_at_deadline_on_every_level(void) {
+  /* Deadlines straddling each level boundary (64, 64^2, 64^3 seconds). */
+  static const turn_time_t deltas[] = {1, 2, 63, 64, 65, 127, 128, 4095, 4096, 4097, 262143, 262144, 262145};
+  const size_t n = sizeof(deltas) / sizeof(deltas[0]);
+
+  for (size_t i = 0; i < n; ++i) {
+    turn_timer_wheel_schedule(&wheel, &(timers[i].entry), wheel.now + deltas[i]);
+  }
+
+  TEST_ASSERT_EQUAL_size_t(n, run_until(1000 + 262145));
+  for (size_t i = 0; i < n; ++i) {
+    TEST_ASSERT_EQUAL_INT(1, timers[i].fired);
+    TEST_ASSERT_EQUAL_UINT32(1000 + deltas[i], timers[i].fired_at);
+    TEST_ASSERT_FALSE(turn_timer_wheel_is_scheduled(&(timers[i].entry)));
+  }
+}
+
+static void test_unaligned_start_and_reschedule(void) {
+  turn_timer_wheel_init(&wheel, 4095 * 7 + 13);
+  const turn_time_t start = wheel.now;
+
+  for (size_t i = 0; i < TEST_ENTRIES; ++i) {
+    turn_timer_wheel_schedule(&wheel, &(timers[i].entry), start + 1 + (turn_time_t)(i * 37 % 9000));
+  }
+  /* Push every other deadline out; the old position must not fire. */
+  for (size_t i = 0; i < TEST_ENTRIES; i += 2) {
+    turn_timer_wheel_schedule(&wheel, &(timers[i].entry), timers[i].entry.due + 300);
+  }
+
+  TEST_ASSERT_EQUAL_size_t(TEST_ENTRIES, run_until(start + 9300));
+  for (size_t i = 0; i < TEST_ENTRIES; ++i) {
+    TEST_ASSERT_EQUAL_INT(1, timers[i].fired);
+    TEST_ASSERT_EQUAL_UINT32(timers[i].entry.due, timers[i].fired_at);
+  }
+}
+
+static void test_cancel(void) {
+  turn_timer_wheel_schedule(&wheel, &(timers[0].entry), wheel.now + 10);
+  turn_timer_wheel_schedule(&wheel, &(timers[1].entry), wheel.now + 5000);
+  turn_timer_wheel_schedule(&wheel, &(timers[2].entry), wheel.now + 10);
+  TEST_ASSERT_TRUE(turn_timer_wheel_is_scheduled(&(timers[0].entry)));
+
+  turn_timer_wheel_cancel(&(timers[0].entry));
+  turn_timer_wheel_cancel(&(timers[1].entry));
+  turn_timer_wheel_cancel(&(timers[1].entry));
+  turn_timer_wheel_cancel(&(timers[3].entry)); /* never scheduled */
+
+  TEST_ASSERT_EQUAL_size_t(1, run_until(wheel.now + 6000));
+  TEST_ASSERT_EQUAL_INT(0, timers[0].fired);
+  TEST_ASSERT_EQUAL_INT(0, timers[1].fired);
+  TEST_ASSERT_EQUAL_INT(1, timers[2].fired);
+}
+
+static void test_past_deadline_fires_on_next_tick(void) {
+  turn_timer_wheel_schedule(&wheel, &(timers[0].entry), wheel.now - 50);
+  turn_timer_wheel_schedule(&wheel, &(timers[1].entry), wheel.now);
+  TEST_ASSERT_EQUAL_size_t(2, run_until(wheel.now + 1));
+  TEST_ASSERT_EQUAL_UINT32(1001, timers[0].fired_at);
+  TEST_ASSERT_EQUAL_UINT32(1001, timers[1].fired_at);
+}
+
+static void test_large_step_and_backward_step(void) {
+  turn_timer_wheel_schedule(&wheel, &(timers[0].entry), 1100);
+  turn_timer_wheel_schedule(&wheel, &(timers[1].entry), 9000);
+
+  /* A wall-clock step backwards moves the wheel back without firing, so a
+   * deadline taken from the new clock is not held until the old time. */
+  turn_time_t now = 500;
+  TEST_ASSERT_EQUAL_size_t(0, turn_timer_wheel_advance(&wheel, now, fire_cb, &now));
+  TEST_ASSERT_EQUAL_UINT32(500, wheel.now);
+  turn_timer_wheel_schedule(&wheel, &(timers[2].entry), 600);
+  TEST_ASSERT_EQUAL_size_t(1, run_until(600));
+  TEST_ASSERT_EQUAL_UINT32(600, timers[2].fired_at);
+
+  /* One big step fires everything due in between. */
+  now = 5000;
+  TEST_ASSERT_EQUAL_size_t(1, turn_timer_wheel_advance(&wheel, now, fire_cb, &now));
+  TEST_ASSERT_EQUAL_INT(1, timers[0].fired);
+  TEST_ASSERT_EQUAL_INT(0, timers[1].fired);
+
+  /* The entries left behind still fire exactly on time. */
+  TEST_ASSERT_EQUAL_size_t(1, run_until(9000));
+  TEST_ASSERT_EQUAL_UINT32(9000, timers[1].fired_at);
+}
+
+static void test_forward_jump_refiles_every_level(void) {
+  for (size_t i = 0; i < TEST_ENTRIES; ++i) {
+    turn_timer_wheel_schedule(&wheel, &(timers[i].entry), wheel.now + 1 + (turn_time_t)(i * 7919 % 300000));
+  }
+
+  /* About 70 hours in one call: one pass over the entries, not one tick per
+   * second. */
+  turn_time_t now = wheel.now + 250000;
+  size_t fired = turn_timer_wheel_advance(&wheel, now, fire_cb, &now);
+  TEST_ASSERT_EQUAL_UINT32(now, wheel.now);
+  for (size_t i = 0; i < TEST_ENTRIES; ++i) {
+    TEST_ASSERT_EQUAL_INT(turn_time_before(now, timers[i].entry.due) ? 0 : 1, timers[i].fired);
+  }
+
+  fired += run_until(1000 + 300000);
+  TEST_ASSERT_EQUAL_size_t(TEST_ENTRIES, fired);
+  for (size_t i = 0; i < TEST_ENTRIES; ++i) {
+    TEST_ASSERT_EQUAL_INT(1, timers[i].fired);
+    if (turn_time_before(now, timers[i].entry.due)) {
+      TEST_ASSERT_EQUAL_UINT32(timers[i].entry.due, timers[i].fired_at);
+    }
+  }
+}
+
+static void test_deadline_beyond_horizon(void) {
+  const turn_time_t far = wheel.now + (1u << 24) + 1000;
+  turn_timer_wheel_schedule(&wheel, &(timers[0].entry), far);
+
+  turn_time_t now = far - 1;
+  TEST_ASSERT_EQUAL_size_t(0, turn_timer_wheel_advance(&wheel, now, fire_cb, &now));
+  now = far;
+  TEST_ASSERT_EQUAL_size_t(1, turn_timer_wheel_advance(&wheel, now, fire_cb, &now));
+}
+
+static void cancel_partner_cb(turn_timer_wheel_entry *entry, void *arg) {
+  UNUSED_ARG(arg);
+  test_timer *t = (test_timer *)((char *)entry - offsetof(test_timer, entry));
+  ++(t->fired);
+  /* Tearing down a permission cancels its channels, which may share the slot. */
+  turn_timer_wheel_cancel(&(timers[(size_t)(t - timers) ^ 1u].entry));
+}
+
+static void test_callback_may_cancel_entries_in_same_slot(void) {
+  for (size_t i = 0; i < 4; ++i) {
+    turn_timer_wheel_schedule(&wheel, &(timers[i].entry), wheel.now + 3);
+  }
+  turn_time_t now = wheel.now + 3;
+  TEST_ASSERT_EQUAL_size_t(2, turn_timer_wheel_advance(&wheel, now, cancel_partner_cb, NULL));
+  TEST_ASSERT_EQUAL_INT(1, timers[0].fired + timers[1].fired);
+  TEST_ASSERT_EQUAL_INT(1, timers[2].fired + timers[3].fired);
+}
+
+static void test_time_wrap(void) {
+  turn_timer_wheel_init(&wheel, 0xFFFFFFF0u);
+  turn_timer_wheel_schedule(&wheel, &(timers[0].entry), 0x20u);
+  turn_timer_wheel_schedule(&wheel, &(timers[1].entry), 0x2000u);
+  TEST_ASSERT_EQUAL_size_t(2, run_until(0x2000u));
+  TEST_ASSERT_EQUAL_UINT32(0x20u, timers[0].fired_at);
+  TEST_ASSERT_EQUAL_UINT32(0x2000u, timers[1].fired_at);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_fires_exactly_at_deadline_on_every_level);
+  RUN_TEST(test_unaligned_start_and_reschedule);
+  RUN_TEST(test_cancel);
+  RUN_TEST(test_past_deadline_fires_on_next_tick);
+  RUN_TEST(test_large_step_and_backward_step);
+  RUN_TEST(test_forward_jump_refiles_every_level);
+  RUN_TEST(test_deadline_beyond_horizon);
+  RUN_TEST(test_callback_may_cancel_entries_in_same_slot);
+  RUN_TEST(test_time_wrap);
+  return UNITY_END();
+}
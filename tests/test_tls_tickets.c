@@ -0,0 +1,252 @@
+#include "tls_tickets.h"
+
+#include <unity.h>
+
+#include <openssl/evp.h>
+#include <openssl/x509.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+static EVP_PKEY *pkey;
+static X509 *cert;
+static SSL_CTX *client_ctx;
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static void make_cert(void) {
+  pkey = EVP_EC_gen("P-256");
+  TEST_ASSERT_NOT_NULL(pkey);
+  cert = X509_new();
+  ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+  X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+  X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+  X509_set_pubkey(cert, pkey);
+  X509_NAME *name = X509_get_subject_name(cert);
+  X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char *)"turn", -1, -1, 0);
+  X509_set_issuer_name(cert, name);
+  TEST_ASSERT_TRUE(X509_sign(cert, pkey, EVP_sha256()) > 0);
+}
+
+/* A listener context as set_ctx() builds it. */
+static SSL_CTX *server_ctx(bool tickets) {
+  SSL_CTX *ctx = SSL_CTX_new(TLS_server_method());
+  TEST_ASSERT_NOT_NULL(ctx);
+  TEST_ASSERT_EQUAL_INT(1, SSL_CTX_use_certificate(ctx, cert));
+  TEST_ASSERT_EQUAL_INT(1, SSL_CTX_use_PrivateKey(ctx, pkey));
+  SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+  tls_tickets_setup_ctx(ctx, tickets, 60);
+  return ctx;
+}
+
+/* Runs one handshake over a BIO pair, offering `in` for resumption. Returns
+ * the client's session for the next connection and whether this one resumed. */
+static SSL_SESSION *handshake(SSL_CTX *sctx, int version, SSL_SESSION *in, bool *resumed) {
+  SSL *server = SSL_new(sctx);
+  SSL *client = SSL_new(client_ctx);
+  BIO *sbio = NULL;
+  BIO *cbio = NULL;
+  TEST_ASSERT_EQUAL_INT(1, BIO_new_bio_pair(&sbio, 0, &cbio, 0));
+  SSL_set_bio(server, sbio, sbio);
+  SSL_set_bio(client, cbio, cbio);
+  SSL_set_min_proto_version(client, version);
+  SSL_set_max_proto_version(client, version);
+  if (in) {
+    TEST_ASSERT_EQUAL_INT(1, SSL_set_session(client, in));
+  }
+  SSL_set_connect_state(client);
+  SSL_set_accept_state(server);
+
+  int cdone = 0;
+  int sdone = 0;
+  for (int i = 0; i < 32 && (cdone != 1 || sdone != 1); ++i) {
+    if (cdone != 1) {
+      cdone = SSL_do_handshake(client);
+    }
+    if (sdone != 1) {
+      sdone = SSL_do_handshake(server);
+    }
+  }
+  TEST_ASSERT_EQUAL_INT(1, cdone);
+  TEST_ASSERT_EQUAL_INT(1, sdone);
+
+  /* TLS 1.3 tickets arrive after the handshake. */
+  unsigned char byte;
+  SSL_read(client, &byte, 1);
+
+  *resumed = tls_tickets_count_handshake(server);
+  TEST_ASSERT_EQUAL_INT(*resumed ? 1 : 0, SSL_session_reused(client));
+
+  SSL_SESSION *out = SSL_get1_session(client);
+  /* Without a close_notify the session is marked not resumable. */
+  SSL_shutdown(client);
+  SSL_free(client);
+  SSL_free(server);
+  return out;
+}
+
+static void test_resumes_with_ticket(void) {
+  static const int versions[] = {TLS1_2_VERSION, TLS1_3_VERSION};
+  SSL_CTX *ctx = server_ctx(true);
+  for (size_t v = 0; v < sizeof(versions) / sizeof(versions[0]); ++v) {
+    tls_ticket_stats before;
+    tls_ticket_stats after;
+    tls_tickets_get_stats(&before);
+    bool resumed = true;
+    SSL_SESSION *sess = handshake(ctx, versions[v], NULL, &resumed);
+    TEST_ASSERT_FALSE(resumed);
+    TEST_ASSERT_TRUE(SSL_SESSION_has_ticket(sess));
+    SSL_SESSION *next = handshake(ctx, versions[v], sess, &resumed);
+    TEST_ASSERT_TRUE(resumed);
+    tls_tickets_get_stats(&after);
+    TEST_ASSERT_EQUAL_UINT64(before.full_handshakes + 1, after.full_handshakes);
+    TEST_ASSERT_EQUAL_UINT64(before.resumed_handshakes + 1, after.resumed_handshakes);
+    TEST_ASSERT_EQUAL_UINT64(before.tickets_renewed, after.tickets_renewed);
+    SSL_SESSION_free(next);
+    SSL_SESSION_free(sess);
+  }
+  SSL_CTX_free(ctx);
+}
+
+static void test_tickets_outlive_the_context(void) {
+  SSL_CTX *ctx = server_ctx(true);
+  bool resumed = true;
+  SSL_SESSION *sess = handshake(ctx, TLS1_2_VERSION, NULL, &resumed);
+  SSL_CTX_free(ctx);
+
+  /* A certificate reload replaces the context; the ring stays. */
+  ctx = server_ctx(true);
+  SSL_SESSION *next = handshake(ctx, TLS1_2_VERSION, sess, &resumed);
+  TEST_ASSERT_TRUE(resumed);
+  SSL_SESSION_free(next);
+  SSL_SESSION_free(sess);
+  SSL_CTX_free(ctx);
+}
+
+static void test_rotation_renews_then_expires(void) {
+  SSL_CTX *ctx = server_ctx(true);
+  bool resumed = true;
+  SSL_SESSION *sess = handshake(ctx, TLS1_2_VERSION, NULL, &resumed);
+
+  tls_ticket_stats before;
+  tls_ticket_stats after;
+  tls_tickets_get_stats(&before);
+  TEST_ASSERT_EQUAL_INT(0, tls_tickets_rotate());
+  SSL_SESSION *renewed = handshake(ctx, TLS1_2_VERSION, sess, &resumed);
+  TEST_ASSERT_TRUE(resumed);
+  tls_tickets_get_stats(&after);
+  TEST_ASSERT_EQUAL_UINT64(before.tickets_renewed + 1, after.tickets_renewed);
+  TEST_ASSERT_EQUAL_UINT64(before.key_changes + 1, after.key_changes);
+
+  for (int i = 1; i < TLS_TICKET_MAX_KEYS; ++i) {
+    TEST_ASSERT_EQUAL_INT(0, tls_tickets_rotate());
+  }
+  TEST_ASSERT_EQUAL_UINT(TLS_TICKET_MAX_KEYS, tls_tickets_key_count());
+
+  /* The original key is gone; the renewed ticket's key is the oldest left. */
+  SSL_SESSION *next = handshake(ctx, TLS1_2_VERSION, sess, &resumed);
+  TEST_ASSERT_FALSE(resumed);
+  SSL_SESSION_free(next);
+  next = handshake(ctx, TLS1_2_VERSION, renewed, &resumed);
+  TEST_ASSERT_TRUE(resumed);
+  tls_tickets_get_stats(&after);
+  TEST_ASSERT_EQUAL_UINT64(before.tickets_unknown + 1, after.tickets_unknown);
+
+  SSL_SESSION_free(next);
+  SSL_SESSION_free(renewed);
+  SSL_SESSION_free(sess);
+  SSL_CTX_free(ctx);
+}
+
+static void write_file(const char *path, const uint8_t *data, size_t len) {
+  FILE *f = fopen(path, "wb");
+  TEST_ASSERT_NOT_NULL(f);
+  TEST_ASSERT_EQUAL_UINT(len, fwrite(data, 1, len, f));
+  fclose(f);
+}
+
+static void test_key_file(void) {
+  char path[] = "/tmp/test_tls_tickets_XXXXXX";
+  const int fd = mkstemp(path);
+  TEST_ASSERT_TRUE(fd >= 0);
+  close(fd);
+
+  uint8_t records[2 * TLS_TICKET_KEY_RECORD_SIZE + 1];
+  for (size_t i = 0; i < sizeof(records); ++i) {
+    records[i] = (uint8_t)(i * 7 + 3);
+  }
+  write_file(path, records, 2 * TLS_TICKET_KEY_RECORD_SIZE);
+
+  tls_ticket_stats before;
+  tls_ticket_stats after;
+  tls_tickets_get_stats(&before);
+  TEST_ASSERT_EQUAL_INT(2, tls_tickets_load_file(path));
+  TEST_ASSERT_EQUAL_INT(2, tls_tickets_load_file(path));
+  tls_tickets_get_stats(&after);
+  TEST_ASSERT_EQUAL_UINT64(before.key_changes + 1, after.key_changes);
+  TEST_ASSERT_EQUAL_UINT(2, tls_tickets_key_count());
+
+  /* A ring that no longer holds the file's keys cannot resume the session;
+   * loading the file -- as another process sharing it would -- can. */
+  SSL_CTX *ctx = server_ctx(true);
+  bool resumed = true;
+  SSL_SESSION *sess = handshake(ctx, TLS1_3_VERSION, NULL, &resumed);
+  for (int i = 0; i < TLS_TICKET_MAX_KEYS; ++i) {
+    TEST_ASSERT_EQUAL_INT(0, tls_tickets_rotate());
+  }
+  SSL_SESSION *next = handshake(ctx, TLS1_3_VERSION, sess, &resumed);
+  TEST_ASSERT_FALSE(resumed);
+  SSL_SESSION_free(next);
+  TEST_ASSERT_EQUAL_INT(2, tls_tickets_load_file(path));
+  next = handshake(ctx, TLS1_3_VERSION, sess, &resumed);
+  TEST_ASSERT_TRUE(resumed);
+  SSL_SESSION_free(next);
+  SSL_SESSION_free(sess);
+  SSL_CTX_free(ctx);
+
+  /* Partial records and unreadable files leave the ring alone. */
+  write_file(path, records, sizeof(records));
+  TEST_ASSERT_EQUAL_INT(-1, tls_tickets_load_file(path));
+  write_file(path, records, 0);
+  TEST_ASSERT_EQUAL_INT(-1, tls_tickets_load_file(path));
+  remove(path);
+  TEST_ASSERT_EQUAL_INT(-1, tls_tickets_load_file(path));
+  TEST_ASSERT_EQUAL_UINT(2, tls_tickets_key_count());
+}
+
+static void test_disabled(void) {
+  static const int versions[] = {TLS1_2_VERSION, TLS1_3_VERSION};
+  SSL_CTX *ctx = server_ctx(false);
+  for (size_t v = 0; v < sizeof(versions) / sizeof(versions[0]); ++v) {
+    bool resumed = true;
+    SSL_SESSION *sess = handshake(ctx, versions[v], NULL, &resumed);
+    TEST_ASSERT_FALSE(resumed);
+    SSL_SESSION *next = handshake(ctx, versions[v], sess, &resumed);
+    TEST_ASSERT_FALSE(resumed);
+    SSL_SESSION_free(next);
+    SSL_SESSION_free(sess);
+  }
+  SSL_CTX_free(ctx);
+}
+
+int main(void) {
+  tls_tickets_init();
+  make_cert();
+  client_ctx = SSL_CTX_new(TLS_client_method());
+  SSL_CTX_set_verify(client_ctx, SSL_VERIFY_NONE, NULL);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_resumes_with_ticket);
+  RUN_TEST(test_tickets_outlive_the_context);
+  RUN_TEST(test_rotation_renews_then_expires);
+  RUN_TEST(test_key_file);
+  RUN_TEST(test_disabled);
+  const int ret = UNITY_END();
+
+  SSL_CTX_free(client_ctx);
+  X509_free(cert);
+  EVP_PKEY_free(pkey);
+  return ret;
+}
@@ -245,6 +245,79 @@ static void test_evenport_r1_reserves_sibling(void) {
   free(t);
 }
 
+/* ---- sharded mode -------------------------------------------------------- */
+
+static uint16_t shard_first(const turnportshards *ps, size_t i) { return ps->shards[i]->range_start; }
+static uint16_t shard_last(const turnportshards *ps, size_t i) { return ps->shards[i]->range_stop; }
+
+/* Slices must tile the range exactly, and every internal boundary must be
+ * even so an RTP/RTCP pair never straddles two shards - including when the
+ * range itself starts on an odd port. */
+static void test_shards_tile_range_on_even_boundaries(void) {
+  turnportshards *ps = turnportshards_create(NULL, 50001, 50100, 4);
+  TEST_ASSERT_NOT_NULL(ps);
+  TEST_ASSERT_EQUAL_size_t(4, ps->nshards);
+
+  TEST_ASSERT_EQUAL_UINT16(50001, shard_first(ps, 0));
+  TEST_ASSERT_EQUAL_UINT16(50100, shard_last(ps, ps->nshards - 1));
+  for (size_t i = 1; i < ps->nshards; ++i) {
+    TEST_ASSERT_EQUAL_UINT16(shard_last(ps, i - 1) + 1, shard_first(ps, i));
+    TEST_ASSERT_EQUAL_INT(0, shard_first(ps, i) & 1);
+  }
+  for (uint32_t port = 50001; port <= 50100; ++port) {
+    turnports *owner = turnportshards_owner(ps, (uint16_t)port);
+    TEST_ASSERT_NOT_NULL(owner);
+    TEST_ASSERT_TRUE(port >= owner->range_start && port <= owner->range_stop);
+  }
+
+  /* More shards than port pairs: clamp instead of creating empty slices. */
+  turnportshards *tiny = turnportshards_create(NULL, 50000, 50003, 16);
+  TEST_ASSERT_NOT_NULL(tiny);
+  TEST_ASSERT_EQUAL_size_t(2, tiny->nshards);
+}
+
+/* A thread drains its own slice before touching any other, and each
+ * allocation taken from a foreign slice is counted as a steal. */
+static void test_shard_allocates_locally_then_steals(void) {
+  turnportshards *ps = turnportshards_create(NULL, TEST_PORT_START, TEST_PORT_END, 2);
+  TEST_ASSERT_NOT_NULL(ps);
+  const uint16_t own = turnports_size(ps->shards[1]);
+  const uint64_t steals0 = turnipports_thread_steals();
+
+  for (uint16_t i = 0; i < own; ++i) {
+    const int port = turnportshards_allocate(ps, 1, 0, 0, NULL);
+    TEST_ASSERT_TRUE(port >= shard_first(ps, 1) && port <= shard_last(ps, 1));
+  }
+  TEST_ASSERT_EQUAL_UINT64(steals0, turnipports_thread_steals());
+
+  const int stolen = turnportshards_allocate(ps, 1, 0, 0, NULL);
+  TEST_ASSERT_TRUE(stolen >= shard_first(ps, 0) && stolen <= shard_last(ps, 0));
+  TEST_ASSERT_EQUAL_UINT64(steals0 + 1, turnipports_thread_steals());
+
+  /* Whoever releases it, the port goes back to the slice that owns it. */
+  turnportshards_release(ps, (uint16_t)stolen);
+  TEST_ASSERT_TRUE(turnportshards_is_available(ps, (uint16_t)stolen));
+  TEST_ASSERT_EQUAL_UINT16(own, turnports_size(ps->shards[0]));
+  TEST_ASSERT_EQUAL_UINT16(0, turnports_size(ps->shards[1]));
+}
+
+/* EVEN-PORT with R=1 keeps pairing across shards, stolen pairs included. */
+static void test_shard_even_port_pairs_stay_paired(void) {
+  turnportshards *ps = turnportshards_create(NULL, TEST_PORT_START, TEST_PORT_END, 2);
+  TEST_ASSERT_NOT_NULL(ps);
+
+  for (int i = 0; i < TEST_NPORTS / 2; ++i) {
+    uint64_t token = 0;
+    const int port = turnportshards_allocate(ps, 0, 1, 1, &token);
+    TEST_ASSERT_TRUE(port >= TEST_PORT_START && port <= TEST_PORT_END);
+    TEST_ASSERT_EQUAL_INT(0, port & 1);
+    TEST_ASSERT_EQUAL_PTR(turnportshards_owner(ps, (uint16_t)port), turnportshards_owner(ps, (uint16_t)(port + 1)));
+    TEST_ASSERT_TRUE(turnportshards_is_allocated(ps, (uint16_t)port));
+    TEST_ASSERT_TRUE(turnportshards_is_allocated(ps, (uint16_t)(port + 1)));
+  }
+  TEST_ASSERT_EQUAL_INT(-1, turnportshards_allocate(ps, 0, 1, 1, NULL));
+}
+
 /* ---- harness ----------------------------------------------------------- */
 
 void setUp(void) {}
@@ -258,5 +331,8 @@ int main(void) {
   RUN_TEST(test_evenport_r0_alloc_release_does_not_leak);
   RUN_TEST(test_evenport_failure_keeps_foreign_port);
   RUN_TEST(test_evenport_r1_reserves_sibling);
+  RUN_TEST(test_shards_tile_range_on_even_boundaries);
+  RUN_TEST(test_shard_allocates_locally_then_steals);
+  RUN_TEST(test_shard_even_port_pairs_stay_paired);
   return UNITY_END();
 }
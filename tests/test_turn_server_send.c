@@ -91,15 +91,20 @@ void ioa_network_buffer_delete(ioa_engine_handle e, ioa_network_buffer_handle nb
  * ---------------------------------------------------------------- */
 
 /* Stands in for an ioa_socket_handle. Only its address is compared, except for
- * the family/type the multiplex-peer check reads. */
+ * the family/type the multiplex-peer check reads and the close flag the peer
+ * input path reads. */
 typedef struct {
   int family;
+  int tobeclosed;
 } test_socket;
 
-static test_socket relay_socket_v4 = {AF_INET};
+static test_socket relay_socket_v4 = {AF_INET, 0};
+static test_socket client_socket_v4 = {AF_INET, 0};
 
 int get_ioa_socket_address_family(const ioa_socket_handle s) { return ((const test_socket *)s)->family; }
 
+int ioa_socket_tobeclosed(ioa_socket_handle s) { return ((const test_socket *)s)->tobeclosed; }
+
 SOCKET_TYPE get_ioa_socket_type(const ioa_socket_handle s) {
   (void)s;
   return UDP_SOCKET;
@@ -173,21 +178,20 @@ ioa_socket_handle mp_get_socket(ioa_engine_handle e, int family) {
 /* Engine-wide peer access lists, consulted by good_peer_addr() on the
  * CreatePermission and ChannelBind paths. Empty here: the per-server lists in
  * turn_turnserver are what the tests configure. */
-const ip_range_list_t *ioa_get_whitelist(ioa_engine_handle e) {
+const ip_range_t *ioa_match_whitelist(ioa_engine_handle e, const char *realm, const ioa_addr *addr) {
   UNUSED_ARG(e);
+  UNUSED_ARG(realm);
+  UNUSED_ARG(addr);
   return NULL;
 }
 
-const ip_range_list_t *ioa_get_blacklist(ioa_engine_handle e) {
+const ip_range_t *ioa_match_blacklist(ioa_engine_handle e, const char *realm, const ioa_addr *addr) {
   UNUSED_ARG(e);
+  UNUSED_ARG(realm);
+  UNUSED_ARG(addr);
   return NULL;
 }
 
-void ioa_lock_whitelist(ioa_engine_handle e) { UNUSED_ARG(e); }
-void ioa_unlock_whitelist(ioa_engine_handle e) { UNUSED_ARG(e); }
-void ioa_lock_blacklist(ioa_engine_handle e) { UNUSED_ARG(e); }
-void ioa_unlock_blacklist(ioa_engine_handle e) { UNUSED_ARG(e); }
-
 /* ---------------------------------------------------------------- *
  * Fixture                                                           *
  * ---------------------------------------------------------------- */
@@ -742,6 +746,127 @@ static void test_channel_bind_permits_only_the_first_peer(void) {
   TEST_ASSERT_FALSE(has_permission(PEER_B, PEER_PORT_B));
 }
 
+/* Advances the server clock and runs its expiry wheels, as the 1-second
+ * timer_timeout_handler() does. */
+static void run_expiry_at(turn_time_t now) {
+  server.ctime = now;
+  turn_server_expire_timed_events(&server);
+}
+
+/* A permission is reaped on the first tick after its lifetime, and a refresh
+ * moves it in the expiry wheel rather than leaving the old deadline armed. */
+static void test_permission_expires_after_its_refreshed_lifetime(void) {
+  ioa_addr peer;
+  make_addr(&peer, PEER_A, PEER_PORT_A);
+
+  msg_begin(STUN_METHOD_CREATE_PERMISSION, false);
+  msg_add_peer(&peer);
+  msg_finish();
+  TEST_ASSERT_EQUAL_INT(0, run_create_permission(NULL));
+
+  run_expiry_at(200);
+  TEST_ASSERT_EQUAL_INT(0, run_create_permission(NULL));
+
+  run_expiry_at(STUN_DEFAULT_PERMISSION_LIFETIME + 1);
+  TEST_ASSERT_TRUE(has_permission(PEER_A, PEER_PORT_A));
+  run_expiry_at(200 + STUN_DEFAULT_PERMISSION_LIFETIME);
+  TEST_ASSERT_TRUE(has_permission(PEER_A, PEER_PORT_A));
+  run_expiry_at(200 + STUN_DEFAULT_PERMISSION_LIFETIME + 1);
+  TEST_ASSERT_FALSE(has_permission(PEER_A, PEER_PORT_A));
+}
+
+/* A channel and the permission it installed both live for the channel
+ * lifetime and are reaped together. */
+static void test_channel_expires_with_its_permission(void) {
+  ioa_addr peer;
+  make_addr(&peer, PEER_A, PEER_PORT_A);
+
+  msg_begin(STUN_METHOD_CHANNEL_BIND, false);
+  msg_add_channel_number(TEST_CHANNEL_NUMBER);
+  msg_add_peer(&peer);
+  msg_finish();
+  TEST_ASSERT_EQUAL_INT(0, run_channel_bind(NULL));
+
+  run_expiry_at(STUN_DEFAULT_CHANNEL_LIFETIME);
+  TEST_ASSERT_NOT_NULL(allocation_get_ch_info(&(ss.alloc), TEST_CHANNEL_NUMBER));
+  TEST_ASSERT_TRUE(has_permission(PEER_A, PEER_PORT_A));
+
+  run_expiry_at(STUN_DEFAULT_CHANNEL_LIFETIME + 1);
+  TEST_ASSERT_NULL(allocation_get_ch_info(&(ss.alloc), TEST_CHANNEL_NUMBER));
+  TEST_ASSERT_FALSE(has_permission(PEER_A, PEER_PORT_A));
+}
+
+/* Loads a peer datagram into one of the batch buffers. */
+static test_buffer peer_bufs[4];
+
+static void make_peer_datagram(ioa_net_data *nd, size_t i, const char *ip, uint16_t port, uint8_t marker) {
+  memset(nd, 0, sizeof(*nd));
+  memset(&(peer_bufs[i]), 0, sizeof(peer_bufs[i]));
+  /* Headroom for the ChannelData header, as the relay's receive buffers have. */
+  peer_bufs[i].offset = STUN_CHANNEL_HEADER_LENGTH;
+  peer_bufs[i].buf[STUN_CHANNEL_HEADER_LENGTH] = marker;
+  peer_bufs[i].len = 1;
+  make_addr(&(nd->src_addr), ip, port);
+  nd->nbh = &(peer_bufs[i]);
+  nd->recv_ttl = recv_ttl;
+}
+
+/* A recvmmsg batch for one session is relayed as ChannelData, one write per
+ * datagram in arrival order. A datagram from a peer without a permission in
+ * the middle of the run is dropped and left with the caller. */
+static void test_peer_batch_relays_each_permitted_datagram(void) {
+  ioa_addr peer;
+  make_addr(&peer, PEER_A, PEER_PORT_A);
+
+  msg_begin(STUN_METHOD_CHANNEL_BIND, false);
+  msg_add_channel_number(TEST_CHANNEL_NUMBER);
+  msg_add_peer(&peer);
+  msg_finish();
+  TEST_ASSERT_EQUAL_INT(0, run_channel_bind(NULL));
+
+  ss.client_socket = (ioa_socket_handle)&client_socket_v4;
+
+  ioa_net_data batch[4];
+  make_peer_datagram(&(batch[0]), 0, PEER_A, PEER_PORT_A, 0x11);
+  make_peer_datagram(&(batch[1]), 1, PEER_A, PEER_PORT_A, 0x22);
+  make_peer_datagram(&(batch[2]), 2, PEER_B, PEER_PORT_B, 0x33);
+  make_peer_datagram(&(batch[3]), 3, PEER_A, PEER_PORT_A, 0x44);
+
+  turn_peer_input_batch_handler((ioa_socket_handle)&relay_socket_v4, IOA_EV_READ, batch, 4, &ss);
+
+  TEST_ASSERT_EQUAL_INT(3, sent_capture.calls);
+  TEST_ASSERT_TRUE(sent_capture.s == (ioa_socket_handle)&client_socket_v4);
+  TEST_ASSERT_EQUAL_size_t(STUN_CHANNEL_HEADER_LENGTH + 1, sent_capture.len);
+  TEST_ASSERT_EQUAL_HEX8(TEST_CHANNEL_NUMBER >> 8, sent_capture.payload[0]);
+  TEST_ASSERT_EQUAL_HEX8(TEST_CHANNEL_NUMBER & 0xff, sent_capture.payload[1]);
+  TEST_ASSERT_EQUAL_HEX8(0x44, sent_capture.payload[STUN_CHANNEL_HEADER_LENGTH]);
+  TEST_ASSERT_NULL(batch[0].nbh);
+  TEST_ASSERT_NULL(batch[1].nbh);
+  TEST_ASSERT_NOT_NULL(batch[2].nbh);
+  TEST_ASSERT_NULL(batch[3].nbh);
+  TEST_ASSERT_EQUAL_UINT32(4, ss.peer_received_packets);
+}
+
+/* Once the client socket is marked to be closed, the rest of the batch is
+ * left untouched. */
+static void test_peer_batch_stops_when_the_client_socket_closes(void) {
+  add_permission(PEER_A, PEER_PORT_A);
+  client_socket_v4.tobeclosed = 1;
+  ss.client_socket = (ioa_socket_handle)&client_socket_v4;
+
+  ioa_net_data batch[2];
+  make_peer_datagram(&(batch[0]), 0, PEER_A, PEER_PORT_A, 0x11);
+  make_peer_datagram(&(batch[1]), 1, PEER_A, PEER_PORT_A, 0x22);
+
+  turn_peer_input_batch_handler((ioa_socket_handle)&relay_socket_v4, IOA_EV_READ, batch, 2, &ss);
+  client_socket_v4.tobeclosed = 0;
+
+  TEST_ASSERT_EQUAL_INT(0, sent_capture.calls);
+  TEST_ASSERT_NOT_NULL(batch[0].nbh);
+  TEST_ASSERT_NOT_NULL(batch[1].nbh);
+  TEST_ASSERT_EQUAL_UINT32(0, ss.peer_received_packets);
+}
+
 /* Spelled as a literal, not as TURN_RANDOM_NONCE_LENGTH: the generator bounds
  * itself with that macro, so asserting it would hold for any width the macro
  * happened to take. 16 is the wire format. */
@@ -797,6 +922,10 @@ int main(void) {
   RUN_TEST(test_channel_bind_binds_the_peer_address);
   RUN_TEST(test_channel_bind_uses_first_of_duplicate_peer_addresses);
   RUN_TEST(test_channel_bind_permits_only_the_first_peer);
+  RUN_TEST(test_permission_expires_after_its_refreshed_lifetime);
+  RUN_TEST(test_channel_expires_with_its_permission);
+  RUN_TEST(test_peer_batch_relays_each_permitted_datagram);
+  RUN_TEST(test_peer_batch_stops_when_the_client_socket_closes);
   RUN_TEST(test_random_challenge_nonce_is_sixteen_lowercase_hex_chars);
   return UNITY_END();
 }
@@ -41,10 +41,10 @@ LINK_STUB(get_ioa_socket_session)
 LINK_STUB(get_ioa_socket_ssl_method)
 LINK_STUB(get_ioa_socket_tls_cipher)
 LINK_STUB(get_ioa_socket_tls_method)
+LINK_STUB(get_ioa_socket_tls_offload)
 LINK_STUB(get_local_addr_from_ioa_socket)
 LINK_STUB(get_local_mtu_ioa_socket)
 LINK_STUB(get_remote_addr_from_ioa_socket)
-LINK_STUB(ioa_socket_tobeclosed)
 LINK_STUB(register_callback_on_ioa_socket)
 LINK_STUB(set_ioa_socket_app_type)
 LINK_STUB(set_ioa_socket_buf_size)
@@ -56,6 +56,7 @@ LINK_STUB(set_ioa_socket_tobeclosed)
 LINK_STUB(create_relay_ioa_sockets)
 LINK_STUB(ioa_create_connecting_tcp_relay_socket)
 LINK_STUB(set_do_not_use_df)
+LINK_STUB(splice_ioa_sockets)
 
 /* Timers. */
 LINK_STUB(delete_ioa_timer)
@@ -0,0 +1,141 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * https://opensource.org/license/bsd-3-clause
+ *
+ * Tests for the UDP listener's one-pass packet classifier in
+ * src/apps/relay/udp_classify.h: on crafted and random datagrams it must give
+ * the same answer as the checks the listener used to chain.
+ */
+
+#include "udp_classify.h"
+
+#include "ns_turn_msg.h"
+
+#include <unity.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static bool reference_is_dtls(const uint8_t *buf, size_t len) {
+  return (len > 3) && (buf[1] == 0xfe) && ((buf[2] == 0xff) || (buf[2] == 0xfd)) && (buf[0] >= 0x14) &&
+         (buf[0] <= 0x17);
+}
+
+/* The former classify_udp_packet(), with turn_params replaced by flags. */
+static udp_packet_classification_t reference_classify(const uint8_t *data, size_t blen, unsigned flags) {
+  size_t candidate_len = blen;
+  uint16_t chnum = 0;
+  uint32_t old_stun_cookie = 0;
+
+  if (stun_is_channel_message_str(data, &candidate_len, &chnum, false) ||
+      stun_is_command_message_str(data, candidate_len)) {
+    return UDP_PACKET_CLASS_STUN_OR_CHANNEL;
+  }
+  if ((flags & UDP_CLASSIFY_DTLS) && reference_is_dtls(data, blen) && (data[0] == 0x16)) {
+    return UDP_PACKET_CLASS_DTLS_HANDSHAKE;
+  }
+  if ((flags & UDP_CLASSIFY_DTLS) && reference_is_dtls(data, blen)) {
+    return UDP_PACKET_CLASS_DTLS_OTHER;
+  }
+  if ((flags & UDP_CLASSIFY_OLD_STUN) && old_stun_is_command_message_str(data, blen, &old_stun_cookie)) {
+    return UDP_PACKET_CLASS_OLD_STUN;
+  }
+  return UDP_PACKET_CLASS_INVALID;
+}
+
+static void assert_same_for_all_flags(const uint8_t *data, size_t blen) {
+  for (unsigned flags = 0; flags <= (UDP_CLASSIFY_DTLS | UDP_CLASSIFY_OLD_STUN); ++flags) {
+    TEST_ASSERT_EQUAL_INT(reference_classify(data, blen, flags), udp_classify_packet(data, blen, flags));
+  }
+}
+
+static void test_well_formed_packets(void) {
+  uint8_t buf[512];
+  size_t len = 0;
+
+  stun_init_request_str(STUN_METHOD_BINDING, buf, &len);
+  TEST_ASSERT_EQUAL_INT(UDP_PACKET_CLASS_STUN_OR_CHANNEL, udp_classify_packet(buf, len, 0));
+  assert_same_for_all_flags(buf, len);
+
+  /* RFC 3489: no magic cookie. */
+  turn_write_u32(buf + 4, 0x01020304);
+  TEST_ASSERT_EQUAL_INT(UDP_PACKET_CLASS_INVALID, udp_classify_packet(buf, len, 0));
+  TEST_ASSERT_EQUAL_INT(UDP_PACKET_CLASS_OLD_STUN, udp_classify_packet(buf, len, UDP_CLASSIFY_OLD_STUN));
+  assert_same_for_all_flags(buf, len);
+
+  /* ChannelData, exact and with UDP's optional padding. */
+  const uint8_t payload[5] = {1, 2, 3, 4, 5};
+  len = sizeof(buf);
+  TEST_ASSERT_TRUE(stun_init_channel_message_str(0x4001, buf, &len, sizeof(payload), false));
+  memcpy(buf + 4, payload, sizeof(payload));
+  TEST_ASSERT_EQUAL_INT(UDP_PACKET_CLASS_STUN_OR_CHANNEL, udp_classify_packet(buf, 4 + sizeof(payload), 0));
+  for (size_t padded = 4 + sizeof(payload); padded <= 4 + sizeof(payload) + 4; ++padded) {
+    assert_same_for_all_flags(buf, padded);
+  }
+
+  /* DTLS 1.2 ClientHello record and application data. */
+  uint8_t dtls[64] = {0x16, 0xfe, 0xfd};
+  TEST_ASSERT_EQUAL_INT(UDP_PACKET_CLASS_INVALID, udp_classify_packet(dtls, sizeof(dtls), 0));
+  TEST_ASSERT_EQUAL_INT(UDP_PACKET_CLASS_DTLS_HANDSHAKE, udp_classify_packet(dtls, sizeof(dtls), UDP_CLASSIFY_DTLS));
+  dtls[0] = 0x17;
+  TEST_ASSERT_EQUAL_INT(UDP_PACKET_CLASS_DTLS_OTHER, udp_classify_packet(dtls, sizeof(dtls), UDP_CLASSIFY_DTLS));
+  assert_same_for_all_flags(dtls, sizeof(dtls));
+}
+
+static void test_short_and_null_input(void) {
+  const uint8_t buf[4] = {0x40, 0x00, 0x00, 0x00};
+  TEST_ASSERT_EQUAL_INT(UDP_PACKET_CLASS_INVALID, udp_classify_packet(NULL, 100, UDP_CLASSIFY_DTLS));
+  for (size_t len = 0; len <= sizeof(buf); ++len) {
+    assert_same_for_all_flags(buf, len);
+  }
+}
+
+/* Random headers, with the first byte and length fields drawn so that every
+ * branch is taken often. */
+static void test_random_datagrams_match_reference(void) {
+  static const uint8_t first_bytes[] = {0x00, 0x01, 0x11, 0x14, 0x15, 0x16, 0x17, 0x3f,
+                                        0x40, 0x41, 0x4f, 0x50, 0x7f, 0x80, 0xc0, 0xff};
+  uint8_t buf[300];
+  srand(7);
+  for (int i = 0; i < 200000; ++i) {
+    const size_t blen = (size_t)(rand() % (int)sizeof(buf));
+    for (size_t j = 0; j < blen; ++j) {
+      buf[j] = (uint8_t)rand();
+    }
+    if (blen >= 4) {
+      buf[0] = first_bytes[rand() % (int)sizeof(first_bytes)];
+      switch (rand() % 4) {
+      case 0: /* STUN-shaped length */
+        turn_write_u16(buf + 2, (uint16_t)((blen >= STUN_HEADER_LENGTH) ? blen - STUN_HEADER_LENGTH : 0));
+        break;
+      case 1: { /* ChannelData length, maybe padded */
+        const size_t pad = (size_t)(rand() % 4);
+        turn_write_u16(buf + 2, (uint16_t)((blen - 4 >= pad) ? blen - 4 - pad : 0));
+        break;
+      }
+      default:
+        break;
+      }
+      if (rand() % 2) {
+        buf[1] = 0xfe;
+        buf[2] = (rand() % 2) ? 0xfd : 0xff;
+      }
+      if ((blen >= 8) && (rand() % 2)) {
+        turn_write_u32(buf + 4, STUN_MAGIC_COOKIE);
+      }
+    }
+    assert_same_for_all_flags(buf, blen);
+  }
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_well_formed_packets);
+  RUN_TEST(test_short_and_null_input);
+  RUN_TEST(test_random_datagrams_match_reference);
+  return UNITY_END();
+}